@@ -346,6 +346,10 @@ key_opts_create(struct key_opts *opts, const char *map)
 	if (opts->run_size_ratio <= 1)
 		tnt_raise(ClientError, ER_WRONG_SPACE_OPTIONS, INDEX_OPTS,
 			  "run_size_ratio must be > 1");
+	if (opts->bloom_fpr <= 0 || opts->bloom_fpr > 1)
+		tnt_raise(ClientError, ER_WRONG_INDEX_OPTIONS, INDEX_OPTS,
+			  "bloom_fpr must be greater than 0 and "
+			  "less than or equal to 1");
 	return map;
 }
 
@@ -640,6 +644,14 @@ space_opts_create(struct space_opts *opts, struct tuple *tuple)
 		opts_create_from_field(opts, space_opts_reg, data,
 				       ER_WRONG_SPACE_OPTIONS, OPTS);
 	}
+	if (opts->compressionbuf[0] != '\0') {
+		opts->compression = STR2ENUM(tuple_compression_type,
+					     opts->compressionbuf);
+		if (opts->compression == tuple_compression_type_MAX) {
+			tnt_raise(ClientError, ER_WRONG_SPACE_OPTIONS, OPTS,
+				  "compression must be either 'none' or 'zstd'");
+		}
+	}
 }
 
 /**
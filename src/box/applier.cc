@@ -47,12 +47,15 @@
 #include "trigger.h"
 #include "xrow_io.h"
 #include "error.h"
+#include "rmean.h"
 
 /* TODO: add configuration options */
 static const int RECONNECT_DELAY = 1;
 
 STRS(applier_state, applier_STATE);
 
+static const char *applier_stat_strs[] = { "rows" };
+
 static inline void
 applier_set_state(struct applier *applier, enum applier_state state)
 {
@@ -278,6 +281,32 @@ finish:
 	applier_set_state(applier, APPLIER_CONNECTED);
 }
 
+/**
+ * Decode the next row from @a in if it has been received
+ * completely, don't read from the socket.
+ * @retval true  the row is decoded, the buffer is advanced
+ * @retval false the buffer doesn't contain a complete row
+ */
+static bool
+applier_decode_buffered_xrow(struct ibuf *in, struct xrow_header *row)
+{
+	const char *pos = in->rpos;
+	if (pos == in->wpos)
+		return false;
+	if (mp_typeof(*pos) != MP_UINT) {
+		tnt_raise(ClientError, ER_INVALID_MSGPACK,
+			  "packet length");
+	}
+	if (mp_check_uint(pos, in->wpos) > 0)
+		return false;
+	uint32_t len = mp_decode_uint(&pos);
+	if ((size_t) (in->wpos - pos) < len)
+		return false;
+	xrow_header_decode_xc(row, &pos, pos + len);
+	in->rpos = (char *) pos;
+	return true;
+}
+
 /**
  * Execute and process SUBSCRIBE request (follow updates from a master).
  */
@@ -345,15 +374,54 @@ applier_subscribe(struct applier *applier)
 
 	/*
 	 * Process a stream of rows from the binary log.
+	 *
+	 * While a batch is being written to WAL, the master
+	 * keeps sending rows, so by the time we're back there
+	 * is usually more than one row in the input buffer.
+	 * Apply all of them at once: the subscribe stream
+	 * groups them into as few transactions as possible,
+	 * so a single WAL write covers the whole batch.
 	 */
+	struct xrow_header *rows = applier->rows;
 	while (true) {
-		coio_read_xrow(coio, &iobuf->in, &row);
-		applier->lag = ev_now(loop()) - row.tm;
+		coio_read_xrow(coio, &iobuf->in, &rows[0]);
+		int count = 0;
+		struct xrow_header *error = NULL;
+		if (iproto_type_is_error(rows[0].type))
+			error = &rows[0];
+		else
+			count++;
+		/*
+		 * Only decode rows which are already in the
+		 * buffer: reading more could reallocate it and
+		 * invalidate the bodies of the rows decoded
+		 * so far.
+		 */
+		while (error == NULL && count < APPLIER_BATCH_ROWS_MAX &&
+		       applier_decode_buffered_xrow(&iobuf->in,
+						    &rows[count])) {
+			if (iproto_type_is_error(rows[count].type))
+				error = &rows[count];
+			else
+				count++;
+		}
+		struct xrow_header *last = error != NULL ?
+					   error : &rows[count - 1];
+		applier->lag = ev_now(loop()) - last->tm;
 		applier->last_row_time = ev_now(loop());
 
-		if (iproto_type_is_error(row.type))
-			xrow_decode_error(&row);  /* error */
-		xstream_write(applier->subscribe_stream, &row);
+		/* Apply the rows preceding the error first */
+		if (count > 0) {
+			xstream_write_batch(applier->subscribe_stream,
+					    rows, count);
+			applier->batch_count++;
+			if (count > applier->batch_max)
+				applier->batch_max = count;
+			rmean_collect(applier->rmean, APPLIER_STAT_ROWS,
+				      count);
+		}
+		if (error != NULL)
+			xrow_decode_error(error);  /* error */
 
 		iobuf_reset(iobuf);
 		fiber_gc();
@@ -483,6 +551,19 @@ applier_new(const char *uri, struct xstream *initial_join_stream,
 			 "struct applier");
 		return NULL;
 	}
+	applier->rows = (struct xrow_header *)
+		calloc(APPLIER_BATCH_ROWS_MAX, sizeof(struct xrow_header));
+	applier->rmean = rmean_new(applier_stat_strs, APPLIER_STAT_LAST);
+	if (applier->rows == NULL || applier->rmean == NULL) {
+		diag_set(OutOfMemory, APPLIER_BATCH_ROWS_MAX *
+			 sizeof(struct xrow_header), "malloc",
+			 "struct applier");
+		if (applier->rmean != NULL)
+			rmean_delete(applier->rmean);
+		free(applier->rows);
+		free(applier);
+		return NULL;
+	}
 	coio_init(&applier->io, -1);
 	applier->iobuf = iobuf_new();
 	vclock_create(&applier->vclock);
@@ -512,6 +593,8 @@ applier_delete(struct applier *applier)
 	assert(applier->io.fd == -1);
 	ipc_channel_destroy(&applier->pause);
 	trigger_destroy(&applier->on_state);
+	rmean_delete(applier->rmean);
+	free(applier->rows);
 	free(applier);
 }
 
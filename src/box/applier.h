@@ -43,8 +43,12 @@
 #include "ipc.h"
 
 struct xstream;
+struct xrow_header;
+struct rmean;
 
 enum { APPLIER_SOURCE_MAXLEN = 1024 }; /* enough to fit URI with passwords */
+/** Max number of rows applied in one batch during SUBSCRIBE */
+enum { APPLIER_BATCH_ROWS_MAX = 512 };
 
 #define applier_STATE(_)                                             \
 	_(APPLIER_OFF, 0)                                            \
@@ -62,6 +66,11 @@ enum { APPLIER_SOURCE_MAXLEN = 1024 }; /* enough to fit URI with passwords */
 ENUM(applier_state, applier_STATE);
 extern const char *applier_state_strs[];
 
+enum applier_stat {
+	APPLIER_STAT_ROWS,
+	APPLIER_STAT_LAST
+};
+
 /**
  * State of a replication connection to the master
  */
@@ -74,6 +83,14 @@ struct applier {
 	ev_tstamp last_row_time;
 	/** Number of seconds this server is behind the remote master */
 	ev_tstamp lag;
+	/** Number of row batches applied since the start */
+	int64_t batch_count;
+	/** Number of rows in the largest batch applied */
+	int batch_max;
+	/** Rows of the batch being applied, APPLIER_BATCH_ROWS_MAX */
+	struct xrow_header *rows;
+	/** Statistics of applied rows, see applier_stat */
+	struct rmean *rmean;
 	/** The last known vclock of the remote master */
 	struct vclock vclock;
 	/** The last box_error_code() logged to avoid log flooding */
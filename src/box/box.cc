@@ -67,6 +67,9 @@
 #include "xrow_io.h"
 #include "authentication.h"
 #include "path_lock.h"
+#include "uring.h"
+#include "memtx_arena.h"
+#include "memtx_compact.h"
 
 static char status[64] = "unknown";
 
@@ -121,6 +124,26 @@ box_check_slab_alloc_minimal(ssize_t slab_alloc_minimal)
 		  "specified value is out of bounds");
 }
 
+static void
+box_check_slab_compaction(double rate, double threshold)
+{
+	if (rate < 0)
+		tnt_raise(ClientError, ER_CFG, "slab_compaction_rate",
+			  "the value must not be negative");
+	if (threshold <= 0 || threshold > 1)
+		tnt_raise(ClientError, ER_CFG, "slab_compaction_threshold",
+			  "the value must be in range (0, 1]");
+}
+
+static void
+box_check_slab_alloc_numa(const char *numa)
+{
+	if (numa != NULL && memtx_arena_check_numa(numa) != 0)
+		tnt_raise(ClientError, ER_CFG, "slab_alloc_numa",
+			  "expected 'interleave' or a list of NUMA nodes, "
+			  "like '0,2-3'");
+}
+
 /**
  * Convert a request accessing a secondary key to a primary key undo
  * record, given it found a tuple.
@@ -301,6 +324,52 @@ apply_subscribe_row(struct xstream *stream, struct xrow_header *row)
 	apply_row(stream, row);
 }
 
+/**
+ * Apply a batch of rows received from a replication master.
+ * The rows are applied in order in as few transactions as
+ * possible, so that they are written to WAL together. A row
+ * of a system space is applied in a transaction of its own,
+ * since DDL can't be part of a multi-statement transaction,
+ * and a row of a space of another engine starts a new
+ * transaction, since a transaction can't span engines.
+ */
+static void
+apply_subscribe_batch(struct xstream *stream, struct xrow_header *rows,
+		      int count)
+{
+	(void) stream;
+	Engine *engine = NULL;
+	try {
+		for (int i = 0; i < count; i++) {
+			struct xrow_header *row = &rows[i];
+			/* Check lsn */
+			int64_t current_lsn = vclock_get(&recovery->vclock,
+							 row->server_id);
+			if (row->lsn <= current_lsn)
+				continue;
+			assert(row->bodycnt == 1); /* always 1 for read */
+			struct request *request = xrow_decode_request(row);
+			struct space *space = space_cache_find(request->space_id);
+			bool is_system = space_is_system(space);
+			struct txn *txn = in_txn();
+			if (txn != NULL &&
+			    (is_system || space->handler->engine != engine))
+				txn_commit(txn);
+			if (in_txn() == NULL && !is_system) {
+				txn_begin(false);
+				engine = space->handler->engine;
+			}
+			process_rw(request, space, NULL);
+		}
+		struct txn *txn = in_txn();
+		if (txn != NULL)
+			txn_commit(txn);
+	} catch (Exception *) {
+		txn_rollback();
+		throw;
+	}
+}
+
 /* {{{ configuration bindings */
 
 static void
@@ -360,6 +429,37 @@ box_check_readahead(int readahead)
 	}
 }
 
+static int
+box_check_net_threads(int net_threads)
+{
+	if (net_threads < 1 || net_threads > IPROTO_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "net_threads",
+			  "specified value is out of bounds");
+	}
+	return net_threads;
+}
+
+static int64_t
+box_check_net_zero_copy_size(int64_t size)
+{
+	if (size < 0) {
+		tnt_raise(ClientError, ER_CFG, "net_zero_copy_size",
+			  "the value must not be negative");
+	}
+	return size;
+}
+
+static int
+box_check_snap_threads(int snap_threads)
+{
+	enum { SNAP_THREADS_MAX = 64 };
+	if (snap_threads < 1 || snap_threads > SNAP_THREADS_MAX) {
+		tnt_raise(ClientError, ER_CFG, "snap_threads",
+			  "specified value is out of bounds");
+	}
+	return snap_threads;
+}
+
 static int64_t
 box_check_rows_per_wal(int64_t rows_per_wal)
 {
@@ -371,6 +471,26 @@ box_check_rows_per_wal(int64_t rows_per_wal)
 	return rows_per_wal;
 }
 
+static double
+box_check_wal_group_commit_delay(double delay)
+{
+	if (delay < 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_group_commit_delay",
+			  "the value must not be negative");
+	}
+	return delay;
+}
+
+static int64_t
+box_check_wal_group_commit_bytes(int64_t bytes)
+{
+	if (bytes <= 0) {
+		tnt_raise(ClientError, ER_CFG, "wal_group_commit_bytes",
+			  "the value must be greater than zero");
+	}
+	return bytes;
+}
+
 void
 box_check_config()
 {
@@ -378,12 +498,27 @@ box_check_config()
 	box_check_uri(cfg_gets("listen"), "listen");
 	box_check_replication_source();
 	box_check_readahead(cfg_geti("readahead"));
+	box_check_net_threads(cfg_geti("net_threads"));
+	box_check_net_zero_copy_size(cfg_geti64("net_zero_copy_size"));
+	box_check_snap_threads(cfg_geti("snap_threads"));
 	box_check_rows_per_wal(cfg_geti64("rows_per_wal"));
 	box_check_wal_mode(cfg_gets("wal_mode"));
+	box_check_wal_group_commit_delay(cfg_getd("wal_group_commit_delay"));
+	box_check_wal_group_commit_bytes(
+		cfg_geti64("wal_group_commit_bytes"));
 	box_check_slab_alloc_minimal(cfg_geti64("slab_alloc_minimal"));
+	box_check_slab_alloc_numa(cfg_gets("slab_alloc_numa"));
+	box_check_slab_compaction(cfg_getd("slab_compaction_rate"),
+				  cfg_getd("slab_compaction_threshold"));
 	if (cfg_geti64("vinyl.page_size") > cfg_geti64("vinyl.range_size"))
 		tnt_raise(ClientError, ER_CFG, "vinyl.page_size",
 			  "can't be greather then vinyl.range_size");
+	if (cfg_geti("vinyl.read_ahead") < 0)
+		tnt_raise(ClientError, ER_CFG, "vinyl.read_ahead",
+			  "the value must not be negative");
+	if (cfg_getd("vinyl.page_cache") < 0)
+		tnt_raise(ClientError, ER_CFG, "vinyl.page_cache",
+			  "the value must not be negative");
 }
 
 /*
@@ -500,12 +635,43 @@ box_set_snap_io_rate_limit(void)
 		memtx->setSnapIoRateLimit(cfg_getd("snap_io_rate_limit"));
 }
 
+void
+box_set_snap_threads(void)
+{
+	int snap_threads = box_check_snap_threads(cfg_geti("snap_threads"));
+	MemtxEngine *memtx = (MemtxEngine *) engine_find("memtx");
+	if (memtx)
+		memtx->setSnapThreads(snap_threads);
+}
+
+void
+box_set_slab_compaction(void)
+{
+	double rate = cfg_getd("slab_compaction_rate");
+	double threshold = cfg_getd("slab_compaction_threshold");
+	box_check_slab_compaction(rate, threshold);
+	MemtxEngine *memtx = (MemtxEngine *) engine_find("memtx");
+	if (memtx)
+		memtx_compact_cfg(memtx, rate, threshold);
+}
+
 void
 box_set_too_long_threshold(void)
 {
 	too_long_threshold = cfg_getd("too_long_threshold");
 }
 
+void
+box_set_wal_group_commit(void)
+{
+	double delay = box_check_wal_group_commit_delay(
+		cfg_getd("wal_group_commit_delay"));
+	int64_t bytes = box_check_wal_group_commit_bytes(
+		cfg_geti64("wal_group_commit_bytes"));
+	wal_group_commit_delay = delay;
+	wal_group_commit_bytes = bytes;
+}
+
 void
 box_set_readahead(void)
 {
@@ -514,6 +680,14 @@ box_set_readahead(void)
 	iobuf_set_readahead(readahead);
 }
 
+void
+box_set_net_zero_copy_size(void)
+{
+	int64_t size = box_check_net_zero_copy_size(
+		cfg_geti64("net_zero_copy_size"));
+	iproto_set_zero_copy_size(size);
+}
+
 /* }}} configuration bindings */
 
 /**
@@ -1320,7 +1494,10 @@ engine_init()
 					     cfg_getd("slab_alloc_arena"),
 					     cfg_geti("slab_alloc_minimal"),
 					     cfg_geti("slab_alloc_maximal"),
-					     cfg_getd("slab_alloc_factor"));
+					     cfg_getd("slab_alloc_factor"),
+					     cfg_geti("slab_alloc_huge_pages"),
+					     cfg_gets("slab_alloc_numa"),
+					     cfg_geti("memtx_use_mvcc_engine"));
 	engine_register(memtx);
 
 	SysviewEngine *sysview = new SysviewEngine();
@@ -1452,6 +1629,9 @@ box_init(void)
 	rmean_box = rmean_new(iproto_type_strs, IPROTO_TYPE_STAT_MAX);
 	rmean_error = rmean_new(rmean_error_strings, RMEAN_ERROR_LAST);
 
+	/* Before any thread doing disk I/O is started. */
+	uring_init(cfg_geti("io_uring"));
+
 	engine_init();
 
 	schema_init();
@@ -1465,16 +1645,19 @@ box_init(void)
 
 	cluster_init();
 	port_init();
-	iproto_init();
+	iproto_init(box_check_net_threads(cfg_geti("net_threads")));
+	box_set_net_zero_copy_size();
 
 	title("loading");
 
 	box_set_too_long_threshold();
+	box_set_wal_group_commit();
 	struct wal_stream wal_stream;
 	wal_stream_create(&wal_stream, cfg_geti64("rows_per_wal"));
 	xstream_create(&initial_join_stream, apply_initial_join_row);
 	xstream_create(&final_join_stream, apply_row);
 	xstream_create(&subscribe_stream, apply_subscribe_row);
+	subscribe_stream.write_batch = apply_subscribe_batch;
 
 	struct vclock checkpoint_vclock;
 	vclock_create(&checkpoint_vclock);
@@ -113,8 +113,12 @@ void box_set_replication_source(void);
 void box_set_log_level(void);
 void box_set_io_collect_interval(void);
 void box_set_snap_io_rate_limit(void);
+void box_set_snap_threads(void);
+void box_set_slab_compaction(void);
 void box_set_too_long_threshold(void);
+void box_set_wal_group_commit(void);
 void box_set_readahead(void);
+void box_set_net_zero_copy_size(void);
 void box_set_panic_on_wal_error(void);
 
 extern "C" {
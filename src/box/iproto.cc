@@ -33,6 +33,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <msgpuck.h>
 #include "third_party/base64.h"
@@ -61,6 +62,10 @@
 
 /* The number of iproto messages in flight */
 enum { IPROTO_MSG_MAX = 768 };
+/* The lower bound of per-thread messages in flight */
+enum { IPROTO_THREAD_MSG_MIN = 64 };
+
+struct iproto_thread;
 
 /* {{{ iproto_msg - declaration */
 
@@ -93,6 +98,20 @@ struct iproto_msg: public cmsg
 	size_t len;
 	/** End of write position in the output buffer */
 	struct obuf_svp write_end;
+	/**
+	 * Tuples of a SELECT reply which are sent right from
+	 * tuple memory, see tx_process_select(). They follow
+	 * the reply header in the output and stay referenced
+	 * until written. Empty for other replies.
+	 */
+	struct port port;
+	/** Position of the tuples in the output buffer. */
+	struct obuf_svp splice_svp;
+	/** The first tuple not fully written yet and its written bytes. */
+	struct port_entry *splice_entry;
+	size_t splice_offset;
+	/** Link in iproto_connection::splices. */
+	struct rlist in_splices;
 	/**
 	 * Used in "connect" msgs, true if connect trigger failed
 	 * and the connection must be closed.
@@ -100,30 +119,17 @@ struct iproto_msg: public cmsg
 	bool close_connection;
 };
 
-static struct mempool iproto_msg_pool;
-
 static struct iproto_msg *
-iproto_msg_new(struct iproto_connection *con)
-{
-	struct iproto_msg *msg =
-		(struct iproto_msg *) mempool_alloc_xc(&iproto_msg_pool);
-	msg->connection = con;
-	return msg;
-}
+iproto_msg_new(struct iproto_connection *con);
 
 /**
  * Resume stopped connections, if any.
  */
 static void
-iproto_resume();
-
+iproto_resume(struct iproto_thread *thread);
 
 static inline void
-iproto_msg_delete(struct cmsg *msg)
-{
-	mempool_free(&iproto_msg_pool, msg);
-	iproto_resume();
-}
+iproto_msg_delete(struct cmsg *msg);
 
 struct IprotoMsgGuard {
 	struct iproto_msg *msg;
@@ -138,31 +144,82 @@ struct IprotoMsgGuard {
 
 /* {{{ iproto connection and requests */
 
-/**
- * A single global queue for all requests in all connections. All
- * requests from all connections are processed concurrently.
- * Is also used as a queue for just established connections and to
- * execute disconnect triggers. A few notes about these triggers:
- * - they need to be run in a fiber
- * - unlike an ordinary request failure, on_connect trigger
- *   failure must lead to connection close.
- * - on_connect trigger must be processed before any other
- *   request on this connection.
- */
-static struct cpipe tx_pipe;
-static struct cpipe net_pipe;
 /* A pointer to the transaction processor cord. */
 struct cord *tx_cord;
 
-struct rmean *rmean_net;
+/**
+ * Minimal average tuple size of a SELECT reply sent right from
+ * tuple memory, 0 if disabled. Used in the tx thread.
+ */
+static size_t iproto_zero_copy_size;
 
 enum rmean_net_name {
 	IPROTO_SENT,
 	IPROTO_RECEIVED,
+	IPROTO_CONNECTIONS,
 	IPROTO_LAST,
 };
 
-const char *rmean_net_strings[IPROTO_LAST] = { "SENT", "RECEIVED" };
+const char *rmean_net_strings[IPROTO_LAST] = {
+	"SENT", "RECEIVED", "CONNECTIONS"
+};
+
+/**
+ * A network io thread. Each thread runs its own event loop and
+ * owns its own message and connection pools, statistics and
+ * pipes to and from the tx thread. All threads accept on the same
+ * listening socket, and a connection is served by the thread
+ * which has accepted it until it is closed.
+ */
+struct iproto_thread
+{
+	/** The network io cord. */
+	struct cord net_cord;
+	/** Cbus endpoint name of the thread. */
+	char name[FIBER_NAME_MAX];
+	/**
+	 * A queue for all requests in all connections of the thread.
+	 * All requests from all connections are processed concurrently.
+	 * Is also used as a queue for just established connections and to
+	 * execute disconnect triggers. A few notes about these triggers:
+	 * - they need to be run in a fiber
+	 * - unlike an ordinary request failure, on_connect trigger
+	 *   failure must lead to connection close.
+	 * - on_connect trigger must be processed before any other
+	 *   request on this connection.
+	 */
+	struct cpipe tx_pipe;
+	/** A pipe to this thread, used by the tx thread. */
+	struct cpipe net_pipe;
+	struct mempool iproto_msg_pool;
+	struct mempool iproto_connection_pool;
+	/** Connections stopped by throttling, see iproto_resume(). */
+	struct rlist stopped_connections;
+	/** The max number of messages in flight for this thread. */
+	size_t msg_max;
+	/** Network statistics of this thread. */
+	struct rmean *rmean_net;
+	/**
+	 * Binary protocol listener. The first thread owns the
+	 * acceptor socket, others are attached to it.
+	 */
+	struct evio_service binary;
+	/*
+	 * Message routes. A route returns a message back to the
+	 * thread it was received on, so each thread has its own.
+	 */
+	struct cmsg_hop disconnect_route[2];
+	struct cmsg_hop misc_route[2];
+	struct cmsg_hop select_route[2];
+	struct cmsg_hop process1_route[2];
+	struct cmsg_hop sync_route[2];
+	struct cmsg_hop connect_route[2];
+	struct cmsg_hop splice_route[2];
+	const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX];
+};
+
+static struct iproto_thread *iproto_threads;
+static int iproto_threads_count;
 
 /** Context of a single client connection. */
 struct iproto_connection
@@ -195,10 +252,34 @@ struct iproto_connection
 	/* Pre-allocated disconnect msg. */
 	struct iproto_msg *disconnect;
 	struct rlist in_stop_list;
+	/** The network thread serving this connection. */
+	struct iproto_thread *thread;
+	/**
+	 * Zero-copy replies which tuples are not written yet,
+	 * in the order of their positions in the output.
+	 */
+	struct rlist splices;
 };
 
-static struct mempool iproto_connection_pool;
-static RLIST_HEAD(stopped_connections);
+static struct iproto_msg *
+iproto_msg_new(struct iproto_connection *con)
+{
+	struct iproto_thread *thread = con->thread;
+	struct iproto_msg *msg = (struct iproto_msg *)
+		mempool_alloc_xc(&thread->iproto_msg_pool);
+	msg->connection = con;
+	port_create(&msg->port);
+	return msg;
+}
+
+static inline void
+iproto_msg_delete(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	struct iproto_thread *thread = msg->connection->thread;
+	mempool_free(&thread->iproto_msg_pool, msg);
+	iproto_resume(thread);
+}
 
 /**
  * Returns true if we have enough spare messages
@@ -206,11 +287,12 @@ static RLIST_HEAD(stopped_connections);
  * discounted: they are mostly reserved and idle.
  */
 static inline bool
-iproto_stop_input()
+iproto_stop_input(struct iproto_thread *thread)
 {
-	size_t connection_count = mempool_count(&iproto_connection_pool);
-	size_t request_count = mempool_count(&iproto_msg_pool);
-	return request_count > connection_count + IPROTO_MSG_MAX;
+	size_t connection_count =
+		mempool_count(&thread->iproto_connection_pool);
+	size_t request_count = mempool_count(&thread->iproto_msg_pool);
+	return request_count > connection_count + thread->msg_max;
 }
 
 /**
@@ -220,20 +302,20 @@ iproto_stop_input()
  * object in the message pool.
  */
 static void
-iproto_resume()
+iproto_resume(struct iproto_thread *thread)
 {
 	/*
 	 * Most of the time we have nothing to do here: throttling
 	 * is not active.
 	 */
-	if (rlist_empty(&stopped_connections))
+	if (rlist_empty(&thread->stopped_connections))
 		return;
-	if (iproto_stop_input())
+	if (iproto_stop_input(thread))
 		return;
 
 	struct iproto_connection *con;
-	con = rlist_first_entry(&stopped_connections, struct iproto_connection,
-				in_stop_list);
+	con = rlist_first_entry(&thread->stopped_connections,
+				struct iproto_connection, in_stop_list);
 	ev_feed_event(con->loop, &con->input, EV_READ);
 }
 
@@ -264,7 +346,7 @@ iproto_connection_stop(struct iproto_connection *con)
 {
 	assert(rlist_empty(&con->in_stop_list));
 	ev_io_stop(con->loop, &con->input);
-	rlist_add_tail(&stopped_connections, &con->in_stop_list);
+	rlist_add_tail(&con->thread->stopped_connections, &con->in_stop_list);
 }
 
 static void
@@ -290,7 +372,7 @@ iproto_connection_delete(struct iproto_connection *con)
 	iobuf_delete_mt(con->iobuf[1]);
 	if (con->disconnect)
 		iproto_msg_delete(con->disconnect);
-	mempool_free(&iproto_connection_pool, con);
+	mempool_free(&con->thread->iproto_connection_pool, con);
 }
 
 static void
@@ -301,6 +383,10 @@ static void
 tx_process_select(struct cmsg *msg);
 static void
 net_send_msg(struct cmsg *msg);
+static void
+tx_release_splice(struct cmsg *msg);
+static void
+net_end_splice(struct cmsg *msg);
 
 static void
 tx_process_join_subscribe(struct cmsg *msg);
@@ -339,56 +425,62 @@ static void
 net_finish_disconnect(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
-	/* Runs the trigger, which may yield. */
-	iproto_connection_delete(msg->connection);
+	struct iproto_connection *con = msg->connection;
+	/*
+	 * The message is freed first, since it refers to
+	 * the connection to find its memory pool.
+	 */
 	iproto_msg_delete(msg);
+	iproto_connection_delete(con);
 }
 
-static const struct cmsg_hop disconnect_route[] = {
-	{ tx_process_disconnect, &net_pipe },
-	{ net_finish_disconnect, NULL },
-};
-
-static const struct cmsg_hop misc_route[] = {
-	{ tx_process_misc, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop select_route[] = {
-	{ tx_process_select, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop process1_route[] = {
-	{ tx_process1, &net_pipe },
-	{ net_send_msg, NULL },
-};
-
-static const struct cmsg_hop *dml_route[IPROTO_TYPE_STAT_MAX] = {
-	NULL,                                   /* IPROTO_OK */
-	select_route,                           /* IPROTO_SELECT */
-	process1_route,                         /* IPROTO_INSERT */
-	process1_route,                         /* IPROTO_REPLACE */
-	process1_route,                         /* IPROTO_UPDATE */
-	process1_route,                         /* IPROTO_DELETE */
-	misc_route,                             /* IPROTO_CALL_16 */
-	misc_route,                             /* IPROTO_AUTH */
-	misc_route,                             /* IPROTO_EVAL */
-	process1_route,                         /* IPROTO_UPSERT */
-	misc_route                              /* IPROTO_CALL */
-};
+static void
+tx_process_connect(struct cmsg *m);
+static void
+net_send_greeting(struct cmsg *m);
 
-static const struct cmsg_hop sync_route[] = {
-	{ tx_process_join_subscribe, &net_pipe },
-	{ net_end_join_subscribe, NULL },
-};
+/** Bind message routes to the net pipe of the thread. */
+static void
+iproto_thread_init_routes(struct iproto_thread *thread)
+{
+	struct cpipe *net_pipe = &thread->net_pipe;
+
+	thread->disconnect_route[0] = { tx_process_disconnect, net_pipe };
+	thread->disconnect_route[1] = { net_finish_disconnect, NULL };
+	thread->misc_route[0] = { tx_process_misc, net_pipe };
+	thread->misc_route[1] = { net_send_msg, NULL };
+	thread->select_route[0] = { tx_process_select, net_pipe };
+	thread->select_route[1] = { net_send_msg, NULL };
+	thread->process1_route[0] = { tx_process1, net_pipe };
+	thread->process1_route[1] = { net_send_msg, NULL };
+	thread->sync_route[0] = { tx_process_join_subscribe, net_pipe };
+	thread->sync_route[1] = { net_end_join_subscribe, NULL };
+	thread->connect_route[0] = { tx_process_connect, net_pipe };
+	thread->connect_route[1] = { net_send_greeting, NULL };
+	thread->splice_route[0] = { tx_release_splice, net_pipe };
+	thread->splice_route[1] = { net_end_splice, NULL };
+
+	const struct cmsg_hop **dml_route = thread->dml_route;
+	dml_route[IPROTO_OK] = NULL;
+	dml_route[IPROTO_SELECT] = thread->select_route;
+	dml_route[IPROTO_INSERT] = thread->process1_route;
+	dml_route[IPROTO_REPLACE] = thread->process1_route;
+	dml_route[IPROTO_UPDATE] = thread->process1_route;
+	dml_route[IPROTO_DELETE] = thread->process1_route;
+	dml_route[IPROTO_CALL_16] = thread->misc_route;
+	dml_route[IPROTO_AUTH] = thread->misc_route;
+	dml_route[IPROTO_EVAL] = thread->misc_route;
+	dml_route[IPROTO_UPSERT] = thread->process1_route;
+	dml_route[IPROTO_CALL] = thread->misc_route;
+}
 
 static struct iproto_connection *
-iproto_connection_new(const char *name, int fd)
+iproto_connection_new(struct iproto_thread *thread, const char *name, int fd)
 {
 	(void) name;
 	struct iproto_connection *con = (struct iproto_connection *)
-		mempool_alloc_xc(&iproto_connection_pool);
+		mempool_alloc_xc(&thread->iproto_connection_pool);
+	con->thread = thread;
 	con->input.data = con->output.data = con;
 	con->loop = loop();
 	ev_io_init(&con->input, iproto_connection_on_input, fd, EV_READ);
@@ -398,12 +490,25 @@ iproto_connection_new(const char *name, int fd)
 	con->parse_size = 0;
 	con->session = NULL;
 	rlist_create(&con->in_stop_list);
+	rlist_create(&con->splices);
 	/* It may be very awkward to allocate at close. */
 	con->disconnect = iproto_msg_new(con);
-	cmsg_init(con->disconnect, disconnect_route);
+	cmsg_init(con->disconnect, thread->disconnect_route);
 	return con;
 }
 
+/**
+ * Return a zero-copy reply to the tx thread to unreference
+ * its tuples, see tx_release_splice().
+ */
+static inline void
+iproto_release_splice(struct iproto_msg *msg)
+{
+	struct iproto_thread *thread = msg->connection->thread;
+	cmsg_init(msg, thread->splice_route);
+	cpipe_push(&thread->tx_pipe, msg);
+}
+
 /**
  * Initiate a connection shutdown. This method may
  * be invoked many times, and does the internal
@@ -428,6 +533,17 @@ iproto_connection_close(struct iproto_connection *con)
 		 * is done only once.
 		 */
 		con->iobuf[0]->in.wpos -= con->parse_size;
+		/*
+		 * Tuples of zero-copy replies will never be sent,
+		 * release them. Their requests are discarded from
+		 * the input buffer when the tuples are released.
+		 */
+		while (! rlist_empty(&con->splices)) {
+			struct iproto_msg *msg =
+				rlist_shift_entry(&con->splices,
+						  struct iproto_msg, in_splices);
+			iproto_release_splice(msg);
+		}
 	}
 	/*
 	 * If the connection has no outstanding requests in the
@@ -445,7 +561,7 @@ iproto_connection_close(struct iproto_connection *con)
 		assert(con->disconnect != NULL);
 		struct iproto_msg *msg = con->disconnect;
 		con->disconnect = NULL;
-		cpipe_push(&tx_pipe, msg);
+		cpipe_push(&con->thread->tx_pipe, msg);
 	}
 	rlist_del(&con->in_stop_list);
 }
@@ -547,6 +663,7 @@ static void
 iproto_decode_msg(struct iproto_msg *msg, const char **pos, const char *reqend,
 		  bool *stop_input)
 {
+	struct iproto_thread *thread = msg->connection->thread;
 	xrow_header_decode_xc(&msg->header, pos, reqend);
 	assert(*pos == reqend);
 	request_create(&msg->request, msg->header.type);
@@ -577,15 +694,15 @@ iproto_decode_msg(struct iproto_msg *msg, const char **pos, const char *reqend,
 		request_decode_xc(&msg->request,
 				 (const char *) msg->header.body[0].iov_base,
 				 msg->header.body[0].iov_len);
-		assert(msg->header.type < sizeof(dml_route)/sizeof(*dml_route));
-		cmsg_init(msg, dml_route[msg->header.type]);
+		assert(msg->header.type < IPROTO_TYPE_STAT_MAX);
+		cmsg_init(msg, thread->dml_route[msg->header.type]);
 		break;
 	case IPROTO_PING:
-		cmsg_init(msg, misc_route);
+		cmsg_init(msg, thread->misc_route);
 		break;
 	case IPROTO_JOIN:
 	case IPROTO_SUBSCRIBE:
-		cmsg_init(msg, sync_route);
+		cmsg_init(msg, thread->sync_route);
 		*stop_input = true;
 		break;
 	default:
@@ -623,7 +740,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 
 		try {
 			iproto_decode_msg(msg, &pos, reqend, &stop_input);
-			cpipe_push_input(&tx_pipe, guard.release());
+			cpipe_push_input(&con->thread->tx_pipe, guard.release());
 			n_requests++;
 		} catch (Exception *e) {
 			/*
@@ -681,7 +798,7 @@ iproto_enqueue_batch(struct iproto_connection *con, struct ibuf *in)
 		 */
 		ev_feed_event(con->loop, &con->input, EV_READ);
 	}
-	cpipe_flush_input(&tx_pipe);
+	cpipe_flush_input(&con->thread->tx_pipe);
 }
 
 static void
@@ -700,7 +817,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 		 * resume one more connection which might have
 		 * input.
 		 */
-		iproto_resume();
+		iproto_resume(con->thread);
 	}
 	/*
 	 * Throttle if there are too many pending requests,
@@ -709,7 +826,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	 * another fiber waiting for write to complete).
 	 * Ignore iproto_connection->disconnect messages.
 	 */
-	if (iproto_stop_input()) {
+	if (iproto_stop_input(con->thread)) {
 		iproto_connection_stop(con);
 		return;
 	}
@@ -734,7 +851,7 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 			return;
 		}
 		/* Count statistics */
-		rmean_collect(rmean_net, IPROTO_RECEIVED, nrd);
+		rmean_collect(con->thread->rmean_net, IPROTO_RECEIVED, nrd);
 
 		/* Update the read position and connection state. */
 		in->wpos += nrd;
@@ -749,11 +866,32 @@ iproto_connection_on_input(ev_loop *loop, struct ev_io *watcher,
 	}
 }
 
+/** The first zero-copy reply in an iobuf waiting to be written. */
+static inline struct iproto_msg *
+iproto_connection_splice(struct iproto_connection *con, struct iobuf *iobuf)
+{
+	struct iproto_msg *msg;
+	rlist_foreach_entry(msg, &con->splices, in_splices) {
+		if (msg->iobuf == iobuf)
+			return msg;
+	}
+	return NULL;
+}
+
+/** True if there is something to write from an iobuf. */
+static inline bool
+iproto_connection_has_output(struct iproto_connection *con,
+			     struct iobuf *iobuf)
+{
+	return obuf_used(&iobuf->out) > 0 ||
+	       iproto_connection_splice(con, iobuf) != NULL;
+}
+
 /** Get the iobuf which is currently being flushed. */
 static inline struct iobuf *
 iproto_connection_output_iobuf(struct iproto_connection *con)
 {
-	if (obuf_used(&con->iobuf[1]->out) > 0)
+	if (iproto_connection_has_output(con, con->iobuf[1]))
 		return con->iobuf[1];
 	/*
 	 * Don't try to write from a newer buffer if an older one
@@ -762,19 +900,23 @@ iproto_connection_output_iobuf(struct iproto_connection *con)
 	 * pieces of replies from both buffers.
 	 */
 	if (ibuf_used(&con->iobuf[1]->in) == 0 &&
-	    obuf_used(&con->iobuf[0]->out) > 0)
+	    iproto_connection_has_output(con, con->iobuf[0]))
 		return con->iobuf[0];
 	return NULL;
 }
 
-/** writev() to the socket and handle the result. */
-
+/**
+ * writev() the output buffer up to @a end to the socket and
+ * handle the result.
+ * @retval 0 all of it is written
+ * @retval -1 the socket is not ready
+ */
 static int
-iproto_flush(struct iobuf *iobuf, struct iproto_connection *con)
+iproto_flush_obuf(struct iobuf *iobuf, struct iproto_connection *con,
+		  const struct obuf_svp *end)
 {
 	int fd = con->output.fd;
 	struct obuf_svp *begin = &iobuf->out.wpos;
-	struct obuf_svp *end = &iobuf->out.wend;
 	assert(begin->used < end->used);
 	struct iovec iov[SMALL_OBUF_IOV_MAX+1];
 	struct iovec *src = iobuf->out.iov;
@@ -791,18 +933,11 @@ iproto_flush(struct iobuf *iobuf, struct iproto_connection *con)
 	ssize_t nwr = sio_writev(fd, iov, iovcnt);
 
 	/* Count statistics */
-	rmean_collect(rmean_net, IPROTO_SENT, nwr);
+	rmean_collect(con->thread->rmean_net, IPROTO_SENT, nwr);
 	if (nwr > 0) {
 		if (begin->used + nwr == end->used) {
-			if (ibuf_used(&iobuf->in) == 0) {
-				/* Quickly recycle the buffer if it's idle. */
-				assert(end->used == obuf_size(&iobuf->out));
-				/* resets wpos and wpend to zero pos */
-				iobuf_reset_mt(iobuf);
-			} else { /* Avoid assignment reordering. */
-				/* Advance write position. */
-				*begin = *end;
-			}
+			/* Advance write position. */
+			*begin = *end;
 			return 0;
 		}
 		size_t offset = 0;
@@ -816,6 +951,87 @@ iproto_flush(struct iobuf *iobuf, struct iproto_connection *con)
 	return -1;
 }
 
+/**
+ * writev() tuples of a zero-copy reply to the socket right
+ * from tuple memory.
+ * @retval 0 all of them are written
+ * @retval -1 the socket is not ready
+ */
+static int
+iproto_flush_splice(struct iproto_msg *msg, struct iproto_connection *con)
+{
+	int fd = con->output.fd;
+	struct iovec iov[SMALL_OBUF_IOV_MAX + 1];
+	while (msg->splice_entry != NULL) {
+		int iovcnt = 0;
+		size_t size = 0;
+		struct port_entry *e = msg->splice_entry;
+		for (; e != NULL && iovcnt < (int) lengthof(iov); e = e->next) {
+			uint32_t bsize;
+			iov[iovcnt].iov_base =
+				(void *) tuple_data_range(e->tuple, &bsize);
+			iov[iovcnt].iov_len = bsize;
+			size += bsize;
+			iovcnt++;
+		}
+		sio_add_to_iov(iov, -msg->splice_offset);
+		size -= msg->splice_offset;
+
+		ssize_t nwr = sio_writev(fd, iov, iovcnt);
+
+		/* Count statistics */
+		rmean_collect(con->thread->rmean_net, IPROTO_SENT, nwr);
+		if (nwr < (ssize_t) size) {
+			/* Skip the written tuples and remember the rest. */
+			size_t offset = msg->splice_offset + MAX(nwr, 0);
+			while (offset >= msg->splice_entry->tuple->bsize) {
+				offset -= msg->splice_entry->tuple->bsize;
+				msg->splice_entry = msg->splice_entry->next;
+			}
+			msg->splice_offset = offset;
+			return -1;
+		}
+		msg->splice_entry = e;
+		msg->splice_offset = 0;
+	}
+	return 0;
+}
+
+/**
+ * Write everything from an iobuf to the socket: the output
+ * buffer and tuples of zero-copy replies at their positions in
+ * it.
+ * @retval 0 all of it is written
+ * @retval -1 the socket is not ready
+ */
+static int
+iproto_flush(struct iobuf *iobuf, struct iproto_connection *con)
+{
+	struct obuf_svp *begin = &iobuf->out.wpos;
+	struct obuf_svp *end = &iobuf->out.wend;
+	struct iproto_msg *msg;
+	while ((msg = iproto_connection_splice(con, iobuf)) != NULL) {
+		assert(msg->splice_svp.used <= end->used);
+		if (begin->used < msg->splice_svp.used &&
+		    iproto_flush_obuf(iobuf, con, &msg->splice_svp) < 0)
+			return -1;
+		if (iproto_flush_splice(msg, con) < 0)
+			return -1;
+		rlist_del_entry(msg, in_splices);
+		iproto_release_splice(msg);
+	}
+	if (begin->used < end->used &&
+	    iproto_flush_obuf(iobuf, con, end) < 0)
+		return -1;
+	if (ibuf_used(&iobuf->in) == 0) {
+		/* Quickly recycle the buffer if it's idle. */
+		assert(end->used == obuf_size(&iobuf->out));
+		/* resets wpos and wpend to zero pos */
+		iobuf_reset_mt(iobuf);
+	}
+	return 0;
+}
+
 static void
 iproto_connection_on_output(ev_loop *loop, struct ev_io *watcher,
 			    int /* revents */)
@@ -888,13 +1104,33 @@ error:
 	msg->write_end = obuf_create_svp(out);
 }
 
+/**
+ * Return the size of tuples of a SELECT reply if they are large
+ * enough to be sent right from tuple memory, 0 otherwise.
+ * Compressed tuples can't be sent as is.
+ */
+static size_t
+tx_zero_copy_bsize(struct port *port)
+{
+	if (iproto_zero_copy_size == 0 || port->size == 0)
+		return 0;
+	size_t bsize = 0;
+	for (struct port_entry *e = port->first; e != NULL; e = e->next) {
+		if (e->tuple->is_compressed)
+			return 0;
+		bsize += e->tuple->bsize;
+	}
+	return bsize / port->size >= iproto_zero_copy_size ? bsize : 0;
+}
+
 static void
 tx_process_select(struct cmsg *m)
 {
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct obuf *out = &msg->iobuf->out;
 	struct obuf_svp svp;
-	struct port port;
+	struct port *port = &msg->port;
+	size_t bsize;
 	int rc;
 	struct request *req = &msg->request;
 
@@ -902,18 +1138,44 @@ tx_process_select(struct cmsg *m)
 
 	if (tx_check_schema(msg->header.schema_id))
 		goto error;
+	if (req->fields != NULL &&
+	    tuple_fields_check(req->fields, req->index_base) != 0)
+		goto error;
 
-	port_create(&port);
-	rc = box_select((struct port *) &port,
-			req->space_id, req->index_id,
+	rc = box_select(port, req->space_id, req->index_id,
 			req->iterator, req->offset, req->limit,
 			req->key, req->key_end);
 	if (rc < 0 || iproto_prepare_select(out, &svp) != 0) {
-		port_destroy(&port);
+		port_destroy(port);
+		port_create(port);
 		goto error;
 	}
-	port_dump(&port, out);
-	iproto_reply_select(out, &svp, msg->header.sync, port.size);
+	/* A projection is copied to the output buffer anyway. */
+	bsize = req->fields == NULL ? tx_zero_copy_bsize(port) : 0;
+	if (bsize > 0) {
+		/*
+		 * Only the header goes to the output buffer, the
+		 * net thread sends the tuples after it and returns
+		 * the message to release them, see net_send_msg().
+		 */
+		iproto_reply_select_ext(out, &svp, msg->header.sync,
+					port->size, bsize);
+		msg->splice_svp = obuf_create_svp(out);
+	} else {
+		if (req->fields != NULL)
+			rc = port_dump_fields(port, out, req->fields,
+					      req->index_base);
+		else
+			rc = port_dump(port, out);
+		if (rc != 0) {
+			/* The tuples are released, drop the partial reply. */
+			port_create(port);
+			obuf_rollback_to_svp(out, &svp);
+			goto error;
+		}
+		iproto_reply_select(out, &svp, msg->header.sync, port->size);
+		port_create(port);
+	}
 	msg->write_end = obuf_create_svp(out);
 	return;
 error:
@@ -1009,9 +1271,27 @@ net_send_msg(struct cmsg *m)
 	struct iproto_msg *msg = (struct iproto_msg *) m;
 	struct iproto_connection *con = msg->connection;
 	struct iobuf *iobuf = msg->iobuf;
+	iobuf->out.wend = msg->write_end;
+	if (msg->port.size > 0) {
+		/*
+		 * Tuples of a zero-copy reply. Queue them for
+		 * writing after the reply header. The request is
+		 * kept in the input buffer until they are released,
+		 * so the iobuf and the connection stay in use.
+		 */
+		if (evio_has_fd(&con->output)) {
+			msg->splice_entry = msg->port.first;
+			msg->splice_offset = 0;
+			rlist_add_tail_entry(&con->splices, msg, in_splices);
+			if (! ev_is_active(&con->output))
+				ev_feed_event(con->loop, &con->output, EV_WRITE);
+		} else {
+			iproto_release_splice(msg);
+		}
+		return;
+	}
 	/* Discard request (see iproto_enqueue_batch()) */
 	iobuf->in.rpos += msg->len;
-	iobuf->out.wend = msg->write_end;
 
 	if (evio_has_fd(&con->output)) {
 		if (! ev_is_active(&con->output))
@@ -1022,6 +1302,42 @@ net_send_msg(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
+/** Unreference tuples of a written zero-copy reply. */
+static void
+tx_release_splice(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	port_destroy(&msg->port);
+}
+
+static void
+net_end_splice(struct cmsg *m)
+{
+	struct iproto_msg *msg = (struct iproto_msg *) m;
+	struct iproto_connection *con = msg->connection;
+	struct iobuf *iobuf = msg->iobuf;
+	/* Discard request (see iproto_enqueue_batch()) */
+	iobuf->in.rpos += msg->len;
+	/* Recycle the buffer if it's idle, see iproto_flush(). */
+	if (iobuf_is_idle(iobuf))
+		iobuf_reset_mt(iobuf);
+
+	if (evio_has_fd(&con->output)) {
+		/*
+		 * The released iobuf may be what the input and
+		 * the output of the other one were waiting for.
+		 */
+		if (! ev_is_active(&con->input) &&
+		    rlist_empty(&con->in_stop_list))
+			ev_feed_event(con->loop, &con->input, EV_READ);
+		if (! ev_is_active(&con->output))
+			ev_feed_event(con->loop, &con->output, EV_WRITE);
+	} else if (iproto_connection_is_idle(con)) {
+		iproto_connection_close(con);
+	}
+	iproto_msg_delete(msg);
+}
+
 static void
 net_end_join_subscribe(struct cmsg *m)
 {
@@ -1084,7 +1400,7 @@ net_send_greeting(struct cmsg *m)
 						 obuf_iovcnt(out));
 
 			/* Count statistics */
-			rmean_collect(rmean_net, IPROTO_SENT, nwr);
+			rmean_collect(con->thread->rmean_net, IPROTO_SENT, nwr);
 		} catch (Exception *e) {
 			e->log();
 		}
@@ -1105,98 +1421,137 @@ net_send_greeting(struct cmsg *m)
 	iproto_msg_delete(msg);
 }
 
-static const struct cmsg_hop connect_route[] = {
-	{ tx_process_connect, &net_pipe },
-	{ net_send_greeting, NULL },
-};
-
 /** }}} */
 
 /**
  * Create a connection and start input.
  */
 static void
-iproto_on_accept(struct evio_service * /* service */, int fd,
+iproto_on_accept(struct evio_service *service, int fd,
 		 struct sockaddr *addr, socklen_t addrlen)
 {
+	struct iproto_thread *thread =
+		(struct iproto_thread *) service->on_accept_param;
 	char name[SERVICE_NAME_MAXLEN];
 	snprintf(name, sizeof(name), "%s/%s", "iobuf",
 		sio_strfaddr(addr, addrlen));
 
 	struct iproto_connection *con;
 
-	con = iproto_connection_new(name, fd);
+	con = iproto_connection_new(thread, name, fd);
+	rmean_collect(thread->rmean_net, IPROTO_CONNECTIONS, 1);
 	/*
 	 * Ignore msg allocation failure - the queue size is
 	 * fixed so there is a limited number of msgs in
 	 * use, all stored in just a few blocks of the memory pool.
 	 */
 	struct iproto_msg *msg = iproto_msg_new(con);
-	cmsg_init(msg, connect_route);
+	cmsg_init(msg, thread->connect_route);
 	msg->iobuf = con->iobuf[0];
 	msg->close_connection = false;
-	cpipe_push(&tx_pipe, msg);
+	cpipe_push(&thread->tx_pipe, msg);
 }
 
-static struct evio_service binary; /* iproto binary listener */
-
 /**
  * The network io thread main function:
  * begin serving the message bus.
  */
 static int
-net_cord_f(va_list /* ap */)
+net_cord_f(va_list ap)
 {
+	struct iproto_thread *thread = va_arg(ap, struct iproto_thread *);
+
 	/* Got to be called in every thread using iobuf */
 	iobuf_init();
-	mempool_create(&iproto_msg_pool, &cord()->slabc,
+	mempool_create(&thread->iproto_msg_pool, &cord()->slabc,
 		       sizeof(struct iproto_msg));
-	mempool_create(&iproto_connection_pool, &cord()->slabc,
+	mempool_create(&thread->iproto_connection_pool, &cord()->slabc,
 		       sizeof(struct iproto_connection));
 
-	evio_service_init(loop(), &binary, "binary",
-			  iproto_on_accept, NULL);
-
+	evio_service_init(loop(), &thread->binary, "binary",
+			  iproto_on_accept, thread);
+	/* Take turns with other threads accepting a burst. */
+	if (iproto_threads_count > 1)
+		thread->binary.accept_batch = IPROTO_ACCEPT_BATCH;
 
 	/* Init statistics counter */
-	rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
+	thread->rmean_net = rmean_new(rmean_net_strings, IPROTO_LAST);
 
-	if (rmean_net == NULL) {
+	if (thread->rmean_net == NULL) {
 		tnt_raise(OutOfMemory, sizeof(struct rmean),
 			  "rmean", "struct rmean");
 	}
 
 	/* Create "net" endpoint. */
-	cbus_join("net");
+	cbus_join(thread->name);
 	/* Create a pipe to "tx" thread. */
-	cpipe_create(&tx_pipe, "tx");
-	cpipe_set_max_input(&tx_pipe, IPROTO_MSG_MAX/2);
+	cpipe_create(&thread->tx_pipe, "tx");
+	cpipe_set_max_input(&thread->tx_pipe, thread->msg_max / 2);
 	/*
 	 * Nothing to do in the fiber so far, the service
 	 * will take care of creating events for incoming
 	 * connections.
 	 */
 	fiber_yield();
-	if (evio_service_is_active(&binary))
-		evio_service_stop(&binary);
+	if (thread == &iproto_threads[0]) {
+		if (evio_service_is_active(&thread->binary))
+			evio_service_stop(&thread->binary);
+	} else {
+		evio_service_detach(&thread->binary);
+	}
 
-	rmean_delete(rmean_net);
+	rmean_delete(thread->rmean_net);
 	return 0;
 }
 
-/** Initialize the iproto subsystem and start network io thread */
 void
-iproto_init()
+iproto_set_zero_copy_size(size_t size)
 {
-	tx_cord = cord();
+	iproto_zero_copy_size = size;
+}
 
-	static struct cord net_cord;
-	if (cord_costart(&net_cord, "iproto", net_cord_f, NULL))
-		panic("failed to initialize iproto thread");
+/** Initialize the iproto subsystem and start network io threads */
+void
+iproto_init(int threads_count)
+{
+	tx_cord = cord();
 
-	/* Create a pipe to "net" thread. */
-	cpipe_create(&net_pipe, "net");
-	cpipe_set_max_input(&net_pipe, IPROTO_MSG_MAX/2);
+	assert(threads_count > 0);
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpu > 0 && threads_count > ncpu) {
+		say_warn("net_threads = %d exceeds the number of online "
+			 "CPUs (%ld)", threads_count, ncpu);
+	}
+	iproto_threads = (struct iproto_thread *)
+		calloc(threads_count, sizeof(struct iproto_thread));
+	if (iproto_threads == NULL)
+		panic("failed to allocate iproto threads");
+	iproto_threads_count = threads_count;
+
+	size_t msg_max = MAX(IPROTO_MSG_MAX / threads_count,
+			     IPROTO_THREAD_MSG_MIN);
+	for (int i = 0; i < threads_count; i++) {
+		struct iproto_thread *thread = &iproto_threads[i];
+		/* Keep the name of the first thread for compatibility. */
+		if (i == 0) {
+			snprintf(thread->name, sizeof(thread->name), "net");
+		} else {
+			snprintf(thread->name, sizeof(thread->name),
+				 "net%d", i);
+		}
+		rlist_create(&thread->stopped_connections);
+		thread->msg_max = msg_max;
+		iproto_thread_init_routes(thread);
+
+		if (cord_costart(&thread->net_cord,
+				 i == 0 ? "iproto" : thread->name,
+				 net_cord_f, thread))
+			panic("failed to initialize iproto thread");
+
+		/* Create a pipe to "net" thread. */
+		cpipe_create(&thread->net_pipe, thread->name);
+		cpipe_set_max_input(&thread->net_pipe, msg_max / 2);
+	}
 }
 
 /**
@@ -1214,11 +1569,12 @@ static int
 iproto_do_bind(struct cbus_call_msg *m)
 {
 	const char *uri  = ((struct iproto_bind_msg *) m)->uri;
+	struct evio_service *binary = &iproto_threads[0].binary;
 	try {
-		if (evio_service_is_active(&binary))
-			evio_service_stop(&binary);
+		if (evio_service_is_active(binary))
+			evio_service_stop(binary);
 		if (uri != NULL)
-			evio_service_bind(&binary, uri);
+			evio_service_bind(binary, uri);
 	} catch (Exception *e) {
 		return -1;
 	}
@@ -1229,21 +1585,73 @@ static int
 iproto_do_listen(struct cbus_call_msg *m)
 {
 	(void) m;
+	struct evio_service *binary = &iproto_threads[0].binary;
 	try {
-		if (evio_service_is_active(&binary))
-			evio_service_listen(&binary);
+		if (evio_service_is_active(binary))
+			evio_service_listen(binary);
 	} catch (Exception *e) {
 		return -1;
 	}
 	return 0;
 }
 
+/** A call to a secondary network thread. */
+struct iproto_thread_msg: public cbus_call_msg
+{
+	struct iproto_thread *thread;
+};
+
+/**
+ * Start accepting connections on the socket of the first
+ * thread. The socket isn't changed while the tx thread
+ * waits for the call to complete, so it's safe to read it
+ * from another thread.
+ */
+static int
+iproto_do_attach(struct cbus_call_msg *m)
+{
+	struct iproto_thread *thread = ((struct iproto_thread_msg *) m)->thread;
+	struct evio_service *binary = &iproto_threads[0].binary;
+	if (evio_service_is_active(binary))
+		evio_service_attach(&thread->binary, binary);
+	return 0;
+}
+
+static int
+iproto_do_detach(struct cbus_call_msg *m)
+{
+	struct iproto_thread *thread = ((struct iproto_thread_msg *) m)->thread;
+	evio_service_detach(&thread->binary);
+	return 0;
+}
+
+/**
+ * Invoke a function in every network thread but the first
+ * one, which owns the acceptor socket.
+ */
+static void
+iproto_call_secondary(cbus_call_f func)
+{
+	for (int i = 1; i < iproto_threads_count; i++) {
+		struct iproto_thread *thread = &iproto_threads[i];
+		/* Declare static to avoid stack corruption on fiber cancel. */
+		static struct iproto_thread_msg m;
+		m.thread = thread;
+		if (cbus_call(&thread->net_pipe, &thread->tx_pipe, &m, func,
+			      NULL, TIMEOUT_INFINITY))
+			diag_raise();
+	}
+}
+
 void
 iproto_bind(const char *uri)
 {
+	/* Secondary threads must not accept on a closed socket. */
+	iproto_call_secondary(iproto_do_detach);
+	struct iproto_thread *thread = &iproto_threads[0];
 	static struct iproto_bind_msg m;
 	m.uri = uri;
-	if (cbus_call(&net_pipe, &tx_pipe, &m, iproto_do_bind,
+	if (cbus_call(&thread->net_pipe, &thread->tx_pipe, &m, iproto_do_bind,
 		      NULL, TIMEOUT_INFINITY))
 		diag_raise();
 }
@@ -1251,11 +1659,55 @@ iproto_bind(const char *uri)
 void
 iproto_listen()
 {
+	struct iproto_thread *thread = &iproto_threads[0];
 	/* Declare static to avoid stack corruption on fiber cancel. */
 	static struct cbus_call_msg m;
-	if (cbus_call(&net_pipe, &tx_pipe, &m, iproto_do_listen,
-		      NULL, TIMEOUT_INFINITY))
+	if (cbus_call(&thread->net_pipe, &thread->tx_pipe, &m,
+		      iproto_do_listen, NULL, TIMEOUT_INFINITY))
 		diag_raise();
+	iproto_call_secondary(iproto_do_attach);
+}
+
+int
+iproto_thread_count()
+{
+	return iproto_threads_count;
+}
+
+int
+iproto_thread_rmean_foreach(int thread_id, rmean_cb cb, void *cb_ctx)
+{
+	assert(thread_id >= 0 && thread_id < iproto_threads_count);
+	struct rmean *rmean = iproto_threads[thread_id].rmean_net;
+	for (size_t i = 0; i < IPROTO_LAST; i++) {
+		int64_t mean = rmean != NULL ? rmean_mean(rmean, i) : 0;
+		int64_t total = rmean != NULL ? rmean_total(rmean, i) : 0;
+		int rc = cb(rmean_net_strings[i], mean, total, cb_ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
+}
+
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx)
+{
+	for (size_t i = 0; i < IPROTO_LAST; i++) {
+		int64_t mean = 0;
+		int64_t total = 0;
+		for (int j = 0; j < iproto_threads_count; j++) {
+			struct rmean *rmean = iproto_threads[j].rmean_net;
+			/* Not initialized yet. */
+			if (rmean == NULL)
+				continue;
+			mean += rmean_mean(rmean, i);
+			total += rmean_total(rmean, i);
+		}
+		int rc = cb(rmean_net_strings[i], mean, total, cb_ctx);
+		if (rc != 0)
+			return rc;
+	}
+	return 0;
 }
 
 /* vim: set foldmethod=marker */
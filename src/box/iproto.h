@@ -30,8 +30,50 @@
  * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
+#include "rmean.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+enum {
+	/** The max number of network io threads. */
+	IPROTO_THREADS_MAX = 64,
+	/**
+	 * The max number of connections a network io thread
+	 * accepts per event loop iteration if there are several
+	 * threads.
+	 */
+	IPROTO_ACCEPT_BATCH = 1,
+};
+
+/** The number of network io threads. */
+int
+iproto_thread_count();
+
+/**
+ * Invoke a callback for every network statistics item of
+ * the network io thread with the given number, starting at 0.
+ */
+int
+iproto_thread_rmean_foreach(int thread_id, rmean_cb cb, void *cb_ctx);
+
+/**
+ * Invoke a callback for every network statistics item,
+ * summed up over all network io threads.
+ */
+int
+iproto_rmean_foreach(rmean_cb cb, void *cb_ctx);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+
+/**
+ * Initialize the iproto subsystem and start
+ * @a threads_count network io threads.
+ */
 void
-iproto_init();
+iproto_init(int threads_count);
 
 void
 iproto_bind(const char *uri);
@@ -39,4 +81,14 @@ iproto_bind(const char *uri);
 void
 iproto_listen();
 
+/**
+ * Send tuples of SELECT replies right from tuple memory,
+ * without copying them to the output buffer, if their average
+ * size is at least @a size. 0 disables it.
+ */
+void
+iproto_set_zero_copy_size(size_t size);
+
+#endif /* defined(__cplusplus) */
+
 #endif
@@ -49,6 +49,14 @@ iproto_prepare_select(struct obuf *buf, struct obuf_svp *svp);
 void
 iproto_reply_select(struct obuf *buf, struct obuf_svp *svp, uint64_t sync,
 		    uint32_t count);
+
+/**
+ * Same as iproto_reply_select(), but @a ext_size more bytes of
+ * the reply data are sent after the buffer contents.
+ */
+void
+iproto_reply_select_ext(struct obuf *buf, struct obuf_svp *svp,
+			uint64_t sync, uint32_t count, uint32_t ext_size);
 #if defined(__cplusplus)
 } /*  extern "C" */
 
@@ -39,6 +39,7 @@
 #include "space.h"
 #include "schema.h"
 #include "tuple_compare.h"
+#include "tuple_hash.h"
 
 const char *field_type_strs[] = {
 	/* [FIELD_TYPE_ANY]      = */ "any",
@@ -87,6 +88,8 @@ const char *index_type_strs[] = { "HASH", "TREE", "BITSET", "RTREE" };
 
 const char *rtree_index_distance_type_strs[] = { "EUCLID", "MANHATTAN" };
 
+const char *tuple_compression_type_strs[] = { "none", "zstd" };
+
 const char *func_language_strs[] = {"LUA", "C"};
 
 const uint32_t key_mp_type[] = {
@@ -119,6 +122,9 @@ const struct key_opts key_opts_default = {
 	/* .page_size           = */ 0,
 	/* .run_count_per_level = */ 2,
 	/* .run_size_ratio      = */ 3.5,
+	/* .bloom_fpr           = */ 0.05,
+	/* .hint                = */ false,
+	/* .compact             = */ false,
 	/* .lsn                 = */ 0,
 };
 
@@ -131,6 +137,9 @@ const struct opt_def key_opts_reg[] = {
 	OPT_DEF("page_size", OPT_INT, struct key_opts, page_size),
 	OPT_DEF("run_count_per_level", OPT_INT, struct key_opts, run_count_per_level),
 	OPT_DEF("run_size_ratio", OPT_FLOAT, struct key_opts, run_size_ratio),
+	OPT_DEF("bloom_fpr", OPT_FLOAT, struct key_opts, bloom_fpr),
+	OPT_DEF("hint", OPT_BOOL, struct key_opts, hint),
+	OPT_DEF("compact", OPT_BOOL, struct key_opts, compact),
 	OPT_DEF("lsn", OPT_INT, struct key_opts, lsn),
 	{ NULL, opt_type_MAX, 0, 0 },
 };
@@ -162,6 +171,7 @@ key_def_set_cmp(struct key_def *def)
 {
 	def->tuple_compare = tuple_compare_create(def);
 	def->tuple_compare_with_key = tuple_compare_with_key_create(def);
+	tuple_hash_func_set(def);
 }
 
 struct key_def *
@@ -321,6 +331,20 @@ key_def_check(struct key_def *key_def)
 		}
 	}
 
+	if (key_def->opts.hint && (key_def->type != TREE ||
+	    strcmp(space->handler->engine->name, "memtx") != 0)) {
+		tnt_raise(ClientError, ER_MODIFY_INDEX,
+			  key_def->name,
+			  space_name(space),
+			  "hint is supported only by memtx TREE index");
+	}
+	if (key_def->opts.compact && key_def->type != BITSET) {
+		tnt_raise(ClientError, ER_MODIFY_INDEX,
+			  key_def->name,
+			  space_name(space),
+			  "compact is supported only by BITSET index");
+	}
+
 	/* validate key_def->type */
 	space->handler->engine->keydefCheck(space, key_def);
 }
@@ -415,10 +439,18 @@ key_validate_parts(struct key_def *key_def, const char *key,
 
 const struct space_opts space_opts_default = {
 	/* .temporary = */ false,
+	/* .field_offsets = */ 0,
+	/* .compressionbuf = */ { '\0' },
+	/* .compression = */ TUPLE_COMPRESSION_NONE,
+	/* .compression_threshold = */ 256,
 };
 
 const struct opt_def space_opts_reg[] = {
 	OPT_DEF("temporary", OPT_BOOL, struct space_opts, temporary),
+	OPT_DEF("field_offsets", OPT_INT, struct space_opts, field_offsets),
+	OPT_DEF("compression", OPT_STR, struct space_opts, compressionbuf),
+	OPT_DEF("compression_threshold", OPT_INT, struct space_opts,
+		compression_threshold),
 	{ NULL, opt_type_MAX, 0, 0 }
 };
 
@@ -451,6 +483,33 @@ space_def_check(struct space_def *def, uint32_t namelen, uint32_t engine_namelen
 				  def->name,
 			         "space does not support temporary flag");
 	}
+	if (def->opts.field_offsets < 0) {
+		tnt_raise(ClientError, errcode,
+			  def->name,
+			  "field_offsets must be non-negative");
+	}
+	if (def->opts.field_offsets > BOX_INDEX_FIELD_MAX) {
+		tnt_raise(ClientError, errcode,
+			  def->name,
+			  "field_offsets is too big");
+	}
+	if (def->opts.field_offsets != 0 &&
+	    strcmp(def->engine_name, "memtx") != 0) {
+		tnt_raise(ClientError, errcode,
+			  def->name,
+			  "space does not support field_offsets");
+	}
+	if (def->opts.compression != TUPLE_COMPRESSION_NONE &&
+	    strcmp(def->engine_name, "memtx") != 0) {
+		tnt_raise(ClientError, errcode,
+			  def->name,
+			  "space does not support compression");
+	}
+	if (def->opts.compression_threshold < 0) {
+		tnt_raise(ClientError, errcode,
+			  def->name,
+			  "compression_threshold must be non-negative");
+	}
 }
 
 bool
@@ -162,6 +162,15 @@ enum rtree_index_distance_type {
 };
 extern const char *rtree_index_distance_type_strs[];
 
+enum tuple_compression_type {
+	/* Tuples are stored as is */
+	TUPLE_COMPRESSION_NONE,
+	/* Large tuples are compressed with zstd and a dictionary */
+	TUPLE_COMPRESSION_ZSTD,
+	tuple_compression_type_MAX
+};
+extern const char *tuple_compression_type_strs[];
+
 /** Descriptor of a single part in a multipart key. */
 struct key_part {
 	uint32_t fieldno;
@@ -201,6 +210,21 @@ struct key_opts {
 	 * previous one.
 	 */
 	double run_size_ratio;
+	/**
+	 * False positive rate of run bloom filters.
+	 * 1 disables bloom filters.
+	 */
+	double bloom_fpr;
+	/**
+	 * Store a comparison hint of the first key part
+	 * along with each element of a memtx TREE index.
+	 */
+	bool hint;
+	/**
+	 * Store sparse pages of a memtx BITSET index as
+	 * sorted arrays of bit offsets instead of raw bits.
+	 */
+	bool compact;
 	/**
 	 * LSN from the time of index creation.
 	 */
@@ -219,6 +243,10 @@ key_opts_cmp(const struct key_opts *o1, const struct key_opts *o2)
 		return o1->dimension < o2->dimension ? -1 : 1;
 	if (o1->distance != o2->distance)
 		return o1->distance < o2->distance ? -1 : 1;
+	if (o1->hint != o2->hint)
+		return o1->hint < o2->hint ? -1 : 1;
+	if (o1->compact != o2->compact)
+		return o1->compact < o2->compact ? -1 : 1;
 	return 0;
 }
 
@@ -232,6 +260,10 @@ typedef int (*tuple_compare_with_key_t)(const struct tuple *tuple_a,
 typedef int (*tuple_compare_t)(const struct tuple *tuple_a,
 			   const struct tuple *tuple_b,
 			   const struct key_def *key_def);
+typedef uint32_t (*tuple_hash_t)(const struct tuple *tuple,
+				 const struct key_def *key_def);
+typedef uint32_t (*key_hash_t)(const char *key,
+			       const struct key_def *key_def);
 
 /* Descriptor of a multipart key. */
 struct key_def {
@@ -250,6 +282,10 @@ struct key_def {
 	tuple_compare_t tuple_compare;
 	/** tuple <-> key comparison function */
 	tuple_compare_with_key_t tuple_compare_with_key;
+	/** tuple hash function */
+	tuple_hash_t tuple_hash;
+	/** key hash function */
+	key_hash_t key_hash;
 	/** The size of the 'parts' array. */
 	uint32_t part_count;
 	/** Description of parts of a multipart index. */
@@ -353,6 +389,21 @@ struct space_opts {
 	 * - changes are not part of a snapshot
 	 */
 	bool temporary;
+	/**
+	 * Number of leading fields which offsets are stored
+	 * in every tuple of the space along with offsets of
+	 * indexed fields, so that access to a non-indexed field
+	 * does not need to skip all fields before it.
+	 */
+	int64_t field_offsets;
+	/**
+	 * Compression of tuples of a memtx space, see
+	 * tuple_compression.h.
+	 */
+	char compressionbuf[16];
+	enum tuple_compression_type compression;
+	/** Tuples smaller than this many bytes are not compressed. */
+	int64_t compression_threshold;
 };
 
 extern const struct space_opts space_opts_default;
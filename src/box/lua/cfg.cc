@@ -109,6 +109,17 @@ lbox_cfg_set_readahead(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_net_zero_copy_size(struct lua_State *L)
+{
+	try {
+		box_set_net_zero_copy_size();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
 static int
 lbox_cfg_set_io_collect_interval(struct lua_State *L)
 {
@@ -131,6 +142,17 @@ lbox_cfg_set_too_long_threshold(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_wal_group_commit(struct lua_State *L)
+{
+	try {
+		box_set_wal_group_commit();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
 static int
 lbox_cfg_set_snap_io_rate_limit(struct lua_State *L)
 {
@@ -142,6 +164,28 @@ lbox_cfg_set_snap_io_rate_limit(struct lua_State *L)
 	return 0;
 }
 
+static int
+lbox_cfg_set_snap_threads(struct lua_State *L)
+{
+	try {
+		box_set_snap_threads();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
+static int
+lbox_cfg_set_slab_compaction(struct lua_State *L)
+{
+	try {
+		box_set_slab_compaction();
+	} catch (Exception *) {
+		luaT_error(L);
+	}
+	return 0;
+}
+
 static int
 lbox_cfg_set_read_only(struct lua_State *L)
 {
@@ -163,9 +207,13 @@ box_lua_cfg_init(struct lua_State *L)
 		{"cfg_set_replication_source", lbox_cfg_set_replication_source},
 		{"cfg_set_log_level", lbox_cfg_set_log_level},
 		{"cfg_set_readahead", lbox_cfg_set_readahead},
+		{"cfg_set_net_zero_copy_size", lbox_cfg_set_net_zero_copy_size},
 		{"cfg_set_io_collect_interval", lbox_cfg_set_io_collect_interval},
 		{"cfg_set_too_long_threshold", lbox_cfg_set_too_long_threshold},
+		{"cfg_set_wal_group_commit", lbox_cfg_set_wal_group_commit},
 		{"cfg_set_snap_io_rate_limit", lbox_cfg_set_snap_io_rate_limit},
+		{"cfg_set_snap_threads", lbox_cfg_set_snap_threads},
+		{"cfg_set_slab_compaction", lbox_cfg_set_slab_compaction},
 		{"cfg_set_read_only", lbox_cfg_set_read_only},
 		{NULL, NULL}
 	};
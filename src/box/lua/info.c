@@ -50,6 +50,10 @@
 #include "fiber.h"
 
 #include "box/vinyl.h"
+#include "box/memtx_build.h"
+#include "histogram.h"
+#include "rmean.h"
+#include "uring.h"
 
 static void
 lbox_pushvclock(struct lua_State *L, struct vclock *vclock)
@@ -100,6 +104,19 @@ lbox_pushreplica(lua_State *L, struct server *server)
 		lua_pushnumber(L, ev_now(loop()) - applier->last_row_time);
 		lua_settable(L, -3);
 
+		lua_pushstring(L, "rows_per_sec");
+		lua_pushnumber(L, rmean_mean(applier->rmean,
+					     APPLIER_STAT_ROWS));
+		lua_settable(L, -3);
+
+		lua_pushstring(L, "batches");
+		luaL_pushint64(L, applier->batch_count);
+		lua_settable(L, -3);
+
+		lua_pushstring(L, "batch_max");
+		lua_pushnumber(L, applier->batch_max);
+		lua_settable(L, -3);
+
 		struct error *e = diag_last_error(&applier->reader->diag);
 		if (e != NULL) {
 			lua_pushstring(L, "message");
@@ -269,6 +286,120 @@ lbox_info_vinyl(struct lua_State *L)
 	return 1;
 }
 
+static int
+lbox_info_memtx(struct lua_State *L)
+{
+	int count;
+	const struct memtx_build_stat *stats = memtx_build_stats(&count);
+
+	lua_createtable(L, 0, 1);
+	lua_pushstring(L, "index_build");
+	lua_createtable(L, count, 0);
+	for (int i = 0; i < count; i++) {
+		const struct memtx_build_stat *stat = &stats[i];
+		lua_createtable(L, 0, 5);
+
+		lua_pushstring(L, "space");
+		lua_pushstring(L, stat->space_name);
+		lua_settable(L, -3);
+
+		lua_pushstring(L, "index");
+		lua_pushstring(L, stat->index_name);
+		lua_settable(L, -3);
+
+		lua_pushstring(L, "tuples");
+		lua_pushnumber(L, stat->tuple_count);
+		lua_settable(L, -3);
+
+		lua_pushstring(L, "state");
+		lua_pushstring(L, memtx_build_state_strs[stat->state]);
+		lua_settable(L, -3);
+
+		lua_pushstring(L, "time");
+		lua_pushnumber(L, stat->time);
+		lua_settable(L, -3);
+
+		lua_rawseti(L, -2, i + 1);
+	}
+	lua_settable(L, -3);
+	return 1;
+}
+
+static int
+lbox_info_wal(struct lua_State *L)
+{
+	const struct wal_stat *stat = wal_get_stat();
+	if (stat == NULL) {
+		lua_pushnil(L);
+		return 1;
+	}
+	char buf[1024];
+
+	lua_createtable(L, 0, 10);
+
+	lua_pushstring(L, "batch_count");
+	luaL_pushint64(L, stat->batch_count);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "async_count");
+	luaL_pushint64(L, stat->async_count);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "batch_rows_avg");
+	lua_pushnumber(L, stat->batch_count == 0 ? 0 :
+		       (double) stat->batch_rows_total / stat->batch_count);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "batch_bytes_avg");
+	lua_pushnumber(L, stat->batch_count == 0 ? 0 :
+		       (double) stat->batch_bytes_total / stat->batch_count);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "ring_rows");
+	luaL_pushint64(L, stat->ring_rows);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "ring_misses");
+	luaL_pushint64(L, stat->ring_misses);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "batch_rows");
+	histogram_snprint(buf, sizeof(buf), stat->batch_rows);
+	lua_pushstring(L, buf);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "commit_latency");
+	histogram_snprint(buf, sizeof(buf), stat->commit_latency);
+	lua_pushstring(L, buf);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "commit_latency_p50");
+	luaL_pushint64(L, histogram_percentile(stat->commit_latency, 50));
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "commit_latency_p99");
+	luaL_pushint64(L, histogram_percentile(stat->commit_latency, 99));
+	lua_settable(L, -3);
+
+	return 1;
+}
+
+static int
+lbox_info_io_uring(struct lua_State *L)
+{
+	lua_createtable(L, 0, 2);
+
+	lua_pushstring(L, "enabled");
+	lua_pushboolean(L, uring_is_enabled());
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "submitted");
+	luaL_pushint64(L, uring_submitted());
+	lua_settable(L, -3);
+
+	return 1;
+}
+
 static const struct luaL_reg
 lbox_info_dynamic_meta [] =
 {
@@ -280,6 +411,9 @@ lbox_info_dynamic_meta [] =
 	{"pid", lbox_info_pid},
 	{"cluster", lbox_info_cluster},
 	{"vinyl", lbox_info_vinyl},
+	{"memtx", lbox_info_memtx},
+	{"wal", lbox_info_wal},
+	{"io_uring", lbox_info_io_uring},
 	{NULL, NULL}
 };
 
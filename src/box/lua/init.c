@@ -30,6 +30,8 @@
  */
 #include "box/lua/init.h"
 
+#include <string.h>
+
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
@@ -75,7 +77,23 @@ static const char *lua_sources[] = {
 static int
 lbox_commit(lua_State *L)
 {
-	if (box_txn_commit() != 0)
+	bool is_async = false;
+	if (lua_gettop(L) >= 1 && !lua_isnil(L, 1)) {
+		const char *usage = "box.commit({wait = 'complete' | 'none'})";
+		if (!lua_istable(L, 1))
+			return luaL_error(L, "Usage: %s", usage);
+		lua_getfield(L, 1, "wait");
+		if (!lua_isnil(L, -1)) {
+			const char *wait = lua_tostring(L, -1);
+			if (wait != NULL && strcmp(wait, "none") == 0)
+				is_async = true;
+			else if (wait == NULL || strcmp(wait, "complete") != 0)
+				return luaL_error(L, "Usage: %s", usage);
+		}
+		lua_pop(L, 1);
+	}
+	int rc = is_async ? box_txn_commit_async() : box_txn_commit();
+	if (rc != 0)
 		return luaT_error(L);
 	return 0;
 }
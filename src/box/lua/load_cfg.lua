@@ -14,6 +14,9 @@ local default_vinyl_cfg = {
     range_size          = 1024 * 1024 * 1024,
     page_size           = 8 * 1024,
     cache               = 0.5, -- 512MB
+    bloom_fpr           = 0.05,
+    read_ahead          = 4,
+    page_cache          = 0.125, -- 128MB
 }
 
 -- all available options
@@ -23,6 +26,11 @@ local default_cfg = {
     slab_alloc_minimal  = 16,
     slab_alloc_maximal  = 1024 * 1024,
     slab_alloc_factor   = 1.1,
+    slab_alloc_huge_pages = false,
+    slab_alloc_numa     = nil,
+    slab_compaction_rate = 0,
+    slab_compaction_threshold = 0.7,
+    memtx_use_mvcc_engine = false,
     work_dir            = nil,
     snap_dir            = ".",
     wal_dir             = ".",
@@ -33,11 +41,17 @@ local default_cfg = {
     log_level           = 5,
     io_collect_interval = nil,
     readahead           = 16320,
+    net_threads         = 1,
+    net_zero_copy_size  = 0,
     snap_io_rate_limit  = nil, -- no limit
+    snap_threads        = 2,
     too_long_threshold  = 0.5,
     wal_mode            = "write",
     rows_per_wal        = 500000,
     wal_dir_rescan_delay= 2,
+    wal_group_commit_delay = 0,
+    wal_group_commit_bytes = 1048576,
+    io_uring            = false,
     panic_on_snap_error = true,
     panic_on_wal_error  = true,
     replication_source  = nil,
@@ -63,6 +77,9 @@ local vinyl_template_cfg = {
     range_size          = 'number',
     page_size           = 'number',
     cache               = 'number',
+    bloom_fpr           = 'number',
+    read_ahead          = 'number',
+    page_cache          = 'number',
 }
 
 -- types of available options
@@ -73,6 +90,11 @@ local template_cfg = {
     slab_alloc_minimal  = 'number',
     slab_alloc_maximal  = 'number',
     slab_alloc_factor   = 'number',
+    slab_alloc_huge_pages = 'boolean',
+    slab_alloc_numa     = 'string',
+    slab_compaction_rate = 'number',
+    slab_compaction_threshold = 'number',
+    memtx_use_mvcc_engine = 'boolean',
     work_dir            = 'string',
     snap_dir            = 'string',
     wal_dir             = 'string',
@@ -83,11 +105,17 @@ local template_cfg = {
     log_level           = 'number',
     io_collect_interval = 'number',
     readahead           = 'number',
+    net_threads         = 'number',
+    net_zero_copy_size  = 'number',
     snap_io_rate_limit  = 'number',
+    snap_threads        = 'number',
     too_long_threshold  = 'number',
     wal_mode            = 'string',
     rows_per_wal        = 'number',
     wal_dir_rescan_delay= 'number',
+    wal_group_commit_delay = 'number',
+    wal_group_commit_bytes = 'number',
+    io_uring            = 'boolean',
     panic_on_snap_error = 'boolean',
     panic_on_wal_error  = 'boolean',
     replication_source  = 'string, number, table',
@@ -134,8 +162,14 @@ local dynamic_cfg = {
     log_level               = private.cfg_set_log_level,
     io_collect_interval     = private.cfg_set_io_collect_interval,
     readahead               = private.cfg_set_readahead,
+    net_zero_copy_size      = private.cfg_set_net_zero_copy_size,
     too_long_threshold      = private.cfg_set_too_long_threshold,
+    wal_group_commit_delay  = private.cfg_set_wal_group_commit,
+    wal_group_commit_bytes  = private.cfg_set_wal_group_commit,
     snap_io_rate_limit      = private.cfg_set_snap_io_rate_limit,
+    snap_threads            = private.cfg_set_snap_threads,
+    slab_compaction_rate    = private.cfg_set_slab_compaction,
+    slab_compaction_threshold = private.cfg_set_slab_compaction,
     panic_on_wal_error      = function() end,
     read_only               = private.cfg_set_read_only,
     -- snapshot_daemon
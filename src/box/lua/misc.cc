@@ -37,6 +37,7 @@
 
 #include "box/box.h"
 #include "box/port.h"
+#include "box/tuple.h"
 #include "box/lua/tuple.h"
 
 /** {{{ Miscellaneous utils **/
@@ -57,7 +58,10 @@ lbox_encode_tuple_on_gc(lua_State *L, int idx, size_t *p_len)
 
 /* }}} */
 
-/** {{{ Lua/C implementation of index:select(): used only by Vinyl **/
+/**
+ * {{{ Lua/C implementation of index:select(): used by Vinyl and
+ * for selects of some fields only
+ */
 
 static inline void
 lbox_port_to_table(lua_State *L, struct port *port)
@@ -71,13 +75,44 @@ lbox_port_to_table(lua_State *L, struct port *port)
 	}
 }
 
+/**
+ * Push a table of new tuples made of the given fields of the
+ * tuples in the port.
+ */
+static inline void
+lbox_port_fields_to_table(lua_State *L, struct port *port,
+			  const char *fields)
+{
+	lua_createtable(L, port->size, 0);
+	struct port_entry *entry = port->first;
+	box_tuple_format_t *format = box_tuple_format_default();
+	struct region *gc = &fiber()->gc;
+	for (size_t i = 0 ; i < port->size; i++) {
+		size_t used = region_used(gc);
+		uint32_t size;
+		char *data = tuple_extract_fields(entry->tuple, fields, 1,
+						  &size);
+		struct tuple *tuple = data == NULL ? NULL :
+			box_tuple_new(format, data, data + size);
+		region_truncate(gc, used);
+		if (tuple == NULL) {
+			port_destroy(port);
+			luaT_error(L);
+		}
+		luaT_pushtuple(L, tuple);
+		lua_rawseti(L, -2, i + 1);
+		entry = entry->next;
+	}
+}
+
 static int
 lbox_select(lua_State *L)
 {
-	if (lua_gettop(L) != 6 || !lua_isnumber(L, 1) || !lua_isnumber(L, 2) ||
+	int argc = lua_gettop(L);
+	if (argc < 6 || argc > 7 || !lua_isnumber(L, 1) || !lua_isnumber(L, 2) ||
 		!lua_isnumber(L, 3) || !lua_isnumber(L, 4) || !lua_isnumber(L, 5)) {
 		return luaL_error(L, "Usage index:select(iterator, offset, "
-				  "limit, key)");
+				  "limit, key[, fields])");
 	}
 
 	uint32_t space_id = lua_tointeger(L, 1);
@@ -88,6 +123,13 @@ lbox_select(lua_State *L)
 
 	size_t key_len;
 	const char *key = lbox_encode_tuple_on_gc(L, 6, &key_len);
+	const char *fields = NULL;
+	if (argc == 7 && !lua_isnil(L, 7)) {
+		size_t fields_len;
+		fields = lbox_encode_tuple_on_gc(L, 7, &fields_len);
+		if (tuple_fields_check(fields, 1) != 0)
+			return luaT_error(L);
+	}
 
 	struct port port;
 	port_create(&port);
@@ -106,7 +148,10 @@ lbox_select(lua_State *L)
 	 * table always crashed the first (can't be fixed with pcall).
 	 * https://github.com/tarantool/tarantool/issues/1182
 	 */
-	lbox_port_to_table(L, &port);
+	if (fields != NULL)
+		lbox_port_fields_to_table(L, &port, fields);
+	else
+		lbox_port_to_table(L, &port);
 	port_destroy(&port);
 	return 1; /* lua table with tuples */
 }
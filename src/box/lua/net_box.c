@@ -38,11 +38,15 @@
 #include "box/iproto_constants.h"
 #include "box/lua/tuple.h" /* luamp_convert_tuple() / luamp_convert_key() */
 #include "box/xrow.h"
+#include "box/tuple.h"
+#include "box/memtx_tuple.h" /* box_tuple_new() */
 
 #include "lua/msgpack.h"
+#include "lua/utils.h" /* luaT_error() */
 #include "third_party/base64.h"
 
 #include "coio.h"
+#include "fiber.h"
 #include "box/errcode.h"
 #include "lua/fiber.h"
 
@@ -227,12 +231,13 @@ netbox_encode_select(lua_State *L)
 	if (lua_gettop(L) < 9)
 		return luaL_error(L, "Usage netbox.encode_select(ibuf, sync, "
 				  "schema_id, space_id, index_id, iterator, "
-				  "offset, limit, key)");
+				  "offset, limit, key[, fields])");
+	bool has_fields = lua_gettop(L) >= 10 && !lua_isnil(L, 10);
 
 	struct mpstream stream;
 	size_t svp = netbox_prepare_request(L, &stream, IPROTO_SELECT);
 
-	luamp_encode_map(cfg, &stream, 6);
+	luamp_encode_map(cfg, &stream, has_fields ? 8 : 6);
 
 	uint32_t space_id = lua_tointeger(L, 4);
 	uint32_t index_id = lua_tointeger(L, 5);
@@ -264,6 +269,14 @@ netbox_encode_select(lua_State *L)
 	luamp_encode_uint(cfg, &stream, IPROTO_KEY);
 	luamp_convert_key(L, cfg, &stream, 9);
 
+	if (has_fields) {
+		/* encode field numbers, one-based as in Lua */
+		luamp_encode_uint(cfg, &stream, IPROTO_INDEX_BASE);
+		luamp_encode_uint(cfg, &stream, 1);
+		luamp_encode_uint(cfg, &stream, IPROTO_FIELDS);
+		luamp_encode_tuple(L, cfg, &stream, 10);
+	}
+
 	netbox_encode_request(&stream, svp);
 	return 0;
 }
@@ -450,6 +463,314 @@ netbox_decode_greeting(lua_State *L)
 	return 1;
 }
 
+/** Header of a response, see netbox_read_header(). */
+struct netbox_header {
+	uint64_t sync;
+	uint64_t status;
+	uint64_t schema_id;
+	size_t body_len;
+};
+
+/**
+ * Decode the length and the header of the first response in the
+ * receive buffer and skip them, leaving the body at
+ * recv_buf->rpos.
+ * @retval  0 the header is decoded
+ * @retval >0 the response is incomplete, the buffer is left
+ *            intact, the number of bytes it needs to have
+ * @retval -1 the response is invalid
+ */
+static ssize_t
+netbox_read_header(struct ibuf *recv_buf, struct netbox_header *header)
+{
+	const char *pos = recv_buf->rpos;
+	const char *end = recv_buf->wpos;
+	/* The server always encodes the length in 5 bytes. */
+	size_t required = mp_sizeof_uint(UINT32_MAX);
+	if ((size_t) (end - pos) < required)
+		return required;
+	if (mp_typeof(*pos) != MP_UINT || mp_check_uint(pos, end) > 0)
+		return -1;
+	uint64_t len = mp_decode_uint(&pos);
+	required = (pos - recv_buf->rpos) + len;
+	if ((size_t) (end - recv_buf->rpos) < required)
+		return required;
+	end = pos + len;
+	const char *map = pos;
+	if (len == 0 || mp_typeof(*pos) != MP_MAP || mp_check(&map, end))
+		return -1;
+
+	header->sync = 0;
+	header->status = 0;
+	header->schema_id = 0;
+	uint32_t size = mp_decode_map(&pos);
+	for (uint32_t i = 0; i < size; i++) {
+		if (mp_typeof(*pos) != MP_UINT) {
+			mp_next(&pos);
+			mp_next(&pos);
+			continue;
+		}
+		uint64_t key = mp_decode_uint(&pos);
+		if (mp_typeof(*pos) != MP_UINT) {
+			mp_next(&pos);
+			continue;
+		}
+		uint64_t value = mp_decode_uint(&pos);
+		switch (key) {
+		case IPROTO_REQUEST_TYPE:
+			header->status = value;
+			break;
+		case IPROTO_SYNC:
+			header->sync = value;
+			break;
+		case IPROTO_SCHEMA_ID:
+			header->schema_id = value;
+			break;
+		default:
+			break;
+		}
+	}
+	header->body_len = end - pos;
+	recv_buf->rpos = (char *) pos;
+	return 0;
+}
+
+/**
+ * decode_header(recv_buf)
+ *  -> sync, status, schema_id, body_len
+ *  -> nil, required
+ *
+ * Decode the length and the header of the first response in the
+ * receive buffer and skip them, leaving the body of body_len
+ * bytes at recv_buf.rpos, see decode_body(). If the response is
+ * incomplete, the buffer is left intact and the number of bytes
+ * it needs to have is returned.
+ */
+static int
+netbox_decode_header(lua_State *L)
+{
+	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 1);
+	struct netbox_header header;
+	ssize_t required = netbox_read_header(recv_buf, &header);
+	if (required < 0)
+		return luaL_error(L, "net.box: invalid response");
+	if (required > 0) {
+		lua_pushnil(L);
+		lua_pushinteger(L, required);
+		return 2;
+	}
+	luaL_pushuint64(L, header.sync);
+	luaL_pushuint64(L, header.status);
+	luaL_pushuint64(L, header.schema_id);
+	lua_pushinteger(L, header.body_len);
+	return 4;
+}
+
+/**
+ * Push a tuple made of a MessagePack value. A value other than
+ * an array becomes a tuple of one field, as in box.tuple.new().
+ */
+static void
+netbox_push_tuple(lua_State *L, const char *data, const char *end)
+{
+	box_tuple_format_t *format = box_tuple_format_default();
+	box_tuple_t *tuple;
+	if (mp_typeof(*data) == MP_ARRAY) {
+		tuple = box_tuple_new(format, data, end);
+	} else {
+		struct region *gc = &fiber()->gc;
+		size_t used = region_used(gc);
+		size_t size = mp_sizeof_array(1) + (end - data);
+		char *buf = (char *) region_alloc(gc, size);
+		if (buf == NULL) {
+			diag_set(OutOfMemory, size, "region", "tuple");
+			luaT_error(L);
+		}
+		char *pos = mp_encode_array(buf, 1);
+		memcpy(pos, data, end - data);
+		tuple = box_tuple_new(format, buf, buf + size);
+		region_truncate(gc, used);
+	}
+	if (tuple == NULL)
+		luaT_error(L);
+	luaT_pushtuple(L, tuple);
+}
+
+/**
+ * Push the data or the error message of the response body
+ * [pos, end), nil if the body has none, in the given mode,
+ * see decode_body().
+ * @retval 0 success
+ * @retval -1 the body is invalid, nothing is pushed
+ */
+static int
+netbox_push_body(lua_State *L, const char *pos, const char *end,
+		 const char *mode)
+{
+	bool raw = mode != NULL && strcmp(mode, "raw") == 0;
+	bool tuples = mode != NULL && strcmp(mode, "tuples") == 0;
+	if (pos == end) {
+		lua_pushnil(L);
+		return 0;
+	}
+	const char *body = pos;
+	if (mp_typeof(*pos) != MP_MAP || mp_check(&body, end))
+		return -1;
+	lua_pushnil(L);
+	uint32_t size = mp_decode_map(&pos);
+	for (uint32_t i = 0; i < size; i++) {
+		if (mp_typeof(*pos) != MP_UINT) {
+			mp_next(&pos);
+			mp_next(&pos);
+			continue;
+		}
+		uint64_t key = mp_decode_uint(&pos);
+		const char *value = pos;
+		mp_next(&pos);
+		if (key != IPROTO_DATA && key != IPROTO_ERROR)
+			continue;
+		lua_pop(L, 1);
+		if (key == IPROTO_DATA && raw) {
+			lua_pushlstring(L, value, pos - value);
+		} else if (key == IPROTO_DATA && tuples &&
+			   mp_typeof(*value) == MP_ARRAY) {
+			uint32_t count = mp_decode_array(&value);
+			lua_createtable(L, count, 0);
+			for (uint32_t j = 0; j < count; j++) {
+				const char *field = value;
+				mp_next(&value);
+				netbox_push_tuple(L, field, value);
+				lua_rawseti(L, -2, j + 1);
+			}
+		} else {
+			luamp_decode(L, cfg, &value);
+		}
+	}
+	return 0;
+}
+
+/**
+ * decode_body(recv_buf, body_len[, mode]) -> data or error
+ *
+ * Decode the body of the response which header was skipped by
+ * decode_header() and skip it. Returns the response data or the
+ * error message, nil if the body has none. The mode sets how the
+ * data is returned:
+ *  - nil: decoded into Lua objects;
+ *  - 'tuples': an array of tuples, made right of the MessagePack
+ *    without converting it into Lua objects and back;
+ *  - 'raw': not decoded, as a string with MessagePack.
+ */
+static int
+netbox_decode_body(lua_State *L)
+{
+	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 1);
+	size_t body_len = lua_tointeger(L, 2);
+	const char *mode = lua_tostring(L, 3);
+	const char *pos = recv_buf->rpos;
+	const char *end = pos + body_len;
+	assert(end <= recv_buf->wpos);
+	recv_buf->rpos = (char *) end;
+	if (netbox_push_body(L, pos, end, mode) != 0)
+		return luaL_error(L, "net.box: invalid response");
+	return 1;
+}
+
+/**
+ * Complete the request on top of the stack, which response data
+ * is right above it: store the error code and the data in
+ * request.errno and request.response and wake up request.client.
+ */
+static void
+netbox_complete_request(lua_State *L, uint64_t status)
+{
+	if (status != 0)
+		lua_pushinteger(L, status & (IPROTO_TYPE_ERROR - 1));
+	else
+		lua_pushnil(L);
+	lua_setfield(L, -3, "errno");
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -3, "response");
+	lua_getfield(L, -2, "client");
+	uint32_t fid = *(uint32_t *) luaL_checkudata(L, -1, "fiber");
+	lua_pop(L, 1);
+	struct fiber *client = fiber_find(fid);
+	/* It's unsafe to wake up fibers which don't expect it. */
+	if (client != NULL && !fiber_is_dead(client) &&
+	    (client->flags & FIBER_IS_CANCELLABLE) != 0)
+		fiber_wakeup(client);
+}
+
+/**
+ * dispatch(recv_buf, requests, schema_id)
+ *  -> nil, required
+ *  -> response_schema_id, error
+ *
+ * Decode all complete responses in the receive buffer and pass
+ * each to the request waiting for it in the requests table,
+ * keyed by sync: the request is removed from the table, gets
+ * errno and response set as decode_body() returns them in
+ * request.mode, and request.client is woken up. Responses nobody
+ * waits for are skipped without decoding.
+ *
+ * Stops at the first incomplete response and returns the number
+ * of bytes the buffer needs to have, or right after a response
+ * with a schema id other than schema_id and returns that schema
+ * id and the error message of the response, if any.
+ */
+static int
+netbox_dispatch(lua_State *L)
+{
+	struct ibuf *recv_buf = (struct ibuf *) lua_topointer(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	uint64_t schema_id = luaL_checkuint64(L, 3);
+	int top = lua_gettop(L);
+	while (true) {
+		struct netbox_header header;
+		ssize_t required = netbox_read_header(recv_buf, &header);
+		if (required < 0)
+			return luaL_error(L, "net.box: invalid response");
+		if (required > 0) {
+			lua_pushnil(L);
+			lua_pushinteger(L, required);
+			return 2;
+		}
+		const char *body = recv_buf->rpos;
+		const char *body_end = body + header.body_len;
+		recv_buf->rpos = (char *) body_end;
+
+		luaL_pushuint64(L, header.sync);
+		lua_rawget(L, 2);
+		bool is_waited = !lua_isnil(L, -1);
+		/* The error message is needed for a schema change. */
+		if (is_waited || header.status != 0) {
+			const char *mode = NULL;
+			if (is_waited && header.status == 0) {
+				lua_getfield(L, -1, "mode");
+				mode = lua_tostring(L, -1);
+				lua_pop(L, 1);
+			}
+			if (netbox_push_body(L, body, body_end, mode) != 0)
+				return luaL_error(L, "net.box: invalid response");
+			if (is_waited) {
+				luaL_pushuint64(L, header.sync);
+				lua_pushnil(L);
+				lua_rawset(L, 2);
+				netbox_complete_request(L, header.status);
+			}
+		}
+		if (header.schema_id > 0 && header.schema_id != schema_id) {
+			luaL_pushuint64(L, header.schema_id);
+			if (header.status != 0)
+				lua_pushvalue(L, -2);
+			else
+				lua_pushnil(L);
+			return 2;
+		}
+		lua_settop(L, top);
+	}
+}
+
 /**
  * communicate(fd, send_buf, recv_buf, limit_or_boundary, timeout)
  *  -> errno, error
@@ -573,6 +894,9 @@ luaopen_net_box(struct lua_State *L)
 		{ "encode_upsert",  netbox_encode_upsert },
 		{ "encode_auth",    netbox_encode_auth },
 		{ "decode_greeting",netbox_decode_greeting },
+		{ "decode_header",  netbox_decode_header },
+		{ "decode_body",    netbox_decode_body },
+		{ "dispatch",       netbox_dispatch },
 		{ "communicate",    netbox_communicate },
 		{ NULL, NULL}
 	};
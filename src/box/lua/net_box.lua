@@ -4,7 +4,6 @@ local ffi      = require('ffi')
 local buffer   = require('buffer')
 local socket   = require('socket')
 local fiber    = require('fiber')
-local msgpack  = require('msgpack')
 local errno    = require('errno')
 local urilib   = require('uri')
 local internal = require('net.box.lib')
@@ -14,7 +13,6 @@ local band          = bit.band
 local max           = math.max
 local fiber_time    = fiber.time
 local fiber_self    = fiber.self
-local ibuf_decode   = msgpack.ibuf_decode
 
 local table_new           = require('table.new')
 local check_iterator_type = box.internal.check_iterator_type
@@ -23,18 +21,16 @@ local communicate     = internal.communicate
 local encode_auth     = internal.encode_auth
 local encode_select   = internal.encode_select
 local decode_greeting = internal.decode_greeting
+local decode_header   = internal.decode_header
+local decode_body     = internal.decode_body
+local dispatch        = internal.dispatch
 
 local sequence_mt      = { __serialize = 'sequence' }
 local TIMEOUT_INFINITY = 500 * 365 * 86400
 local VSPACE_ID        = 281
 local VINDEX_ID        = 289
 
-local IPROTO_STATUS_KEY    = 0x00
 local IPROTO_ERRNO_MASK    = 0x7FFF
-local IPROTO_SYNC_KEY      = 0x01
-local IPROTO_SCHEMA_ID_KEY = 0x05
-local IPROTO_DATA_KEY      = 0x30
-local IPROTO_ERROR_KEY     = 0x31
 local IPROTO_GREETING_SIZE = 128
 
 -- select errors from box.error
@@ -70,9 +66,14 @@ local method_codec           = {
 
         local key_is_nil = (key == nil or
                             (type(key) == 'table' and #key == 0))
+        local fields = type(opts) == 'table' and opts.fields or nil
+        if fields ~= nil and type(fields) ~= 'table' then
+            box.error(box.error.ILLEGAL_PARAMS,
+                      "fields must be an array of field numbers")
+        end
         encode_select(buf, id, schema_id, spaceno, indexno,
                       check_iterator_type(opts, key_is_nil),
-                      offset, limit, key)
+                      offset, limit, key, fields)
     end,
     -- inject raw data into connection, used by console and tests
     inject = function(buf, id, schema_id, bytes)
@@ -86,7 +87,8 @@ local function next_id(id) return band(id + 1, 0x7FFFFFFF) end
 
 -- function create_transport(host, port, user, password, callback)
 --
--- Transport methods: connect(), close(), perfrom_request(), wait_state()
+-- Transport methods: connect(), close(), perfrom_request(),
+-- perform_raw_request(), wait_state()
 --
 -- Basically, *transport* is a TCP connection speaking one of
 -- Tarantool network protocols. This is a low-level interface.
@@ -95,6 +97,9 @@ local function next_id(id) return band(id + 1, 0x7FFFFFFF) end
 --    multiplexing support in the protocol;
 --  * schema-aware (optional) - snoops responses and initiates
 --    schema reload when a request fails due to schema version mismatch;
+--  * responses are decoded in C right from the receive buffer, tuples
+--    are made of the received MessagePack as is, and
+--    perform_raw_request() returns the data not decoded at all;
 --  * delivers transport events via the callback.
 --
 -- Transport state machine:
@@ -233,7 +238,18 @@ local function create_transport(host, port, user, password, callback)
     end
 
     -- REQUEST/RESPONSE --
-    local function perform_request(timeout, method, schema_id, ...)
+    -- How to decode the data of a response, see decode_body().
+    local function response_mode(raw, method)
+        if raw then
+            return 'raw'
+        end
+        if method ~= 'eval' and method ~= 'call_17' and
+           rawget(box, 'tuple') then
+            return 'tuples'
+        end
+    end
+
+    local function do_perform_request(timeout, raw, method, schema_id, ...)
         if state ~= 'active' then
             return last_errno or E_NO_CONNECTION, last_error
         end
@@ -246,10 +262,11 @@ local function create_transport(host, port, user, password, callback)
         local id = next_request_id
         method_codec[method](send_buf, id, schema_id, ...)
         next_request_id = next_id(id)
-        local request = table_new(0, 5) -- reserve space for 5 keys
+        local request = table_new(0, 6) -- reserve space for 6 keys
         request.client = fiber_self()
         request.method = method
         request.schema_id = schema_id
+        request.mode = response_mode(raw, method)
         requests[id] = request
         repeat
             local timeout = max(0, deadline - fiber_time())
@@ -261,6 +278,16 @@ local function create_transport(host, port, user, password, callback)
         return request.errno, request.response
     end
 
+    local function perform_request(timeout, method, schema_id, ...)
+        return do_perform_request(timeout, false, method, schema_id, ...)
+    end
+
+    -- Same as perform_request(), but the response data is returned
+    -- as a string with MessagePack.
+    local function perform_raw_request(timeout, method, schema_id, ...)
+        return do_perform_request(timeout, true, method, schema_id, ...)
+    end
+
     local function dispatch_response(id, errno, response)
         local request = requests[id]
         if request then -- someone is waiting for the response
@@ -271,15 +298,23 @@ local function create_transport(host, port, user, password, callback)
         end
     end
 
-    local function dispatch_response_iproto(hdr, body)
-        local id = hdr[IPROTO_SYNC_KEY]
-        local status = hdr[IPROTO_STATUS_KEY]
+    -- Decode the body of the response which header has just been
+    -- read and pass it to the waiting client, if any. Returns the
+    -- error message if the request failed.
+    local function dispatch_response_iproto(id, status, body_len)
+        local request = requests[id]
         if status ~= 0 then
-            return dispatch_response(id, band(status, IPROTO_ERRNO_MASK),
-                                     body[IPROTO_ERROR_KEY])
-        else
-            return dispatch_response(id, nil, body[IPROTO_DATA_KEY])
+            local err = decode_body(recv_buf, body_len)
+            dispatch_response(id, band(status, IPROTO_ERRNO_MASK), err)
+            return err
+        end
+        if request == nil then
+            -- nobody is waiting for the response, don't decode it
+            recv_buf.rpos = recv_buf.rpos + body_len
+            return
         end
+        local data = decode_body(recv_buf, body_len, request.mode)
+        return dispatch_response(id, nil, data)
     end
 
     local function new_request_id()
@@ -294,26 +329,15 @@ local function create_transport(host, port, user, password, callback)
                            limit_or_boundary, timeout)
     end
 
+    -- Wait for a whole response and read its header. The body is
+    -- left in the buffer for dispatch_response_iproto() or
+    -- decode_body().
     local function send_and_recv_iproto(timeout)
-        local data_len = recv_buf.wpos - recv_buf.rpos
-        local required = 0
-        if data_len < 5 then
-            required = 5
-        else
-            -- PWN! insufficient input validation
-            local rpos, len = ibuf_decode(recv_buf.rpos)
-            required = (rpos - recv_buf.rpos) + len
-            if data_len >= required then
-                local hdr
-                rpos, hdr = ibuf_decode(rpos)
-                local body = {}
-                if rpos - recv_buf.rpos < required then
-                    rpos, body = ibuf_decode(rpos)
-                end
-                recv_buf.rpos = rpos
-                return nil, hdr, body
-            end
+        local id, status, schema_id, body_len = decode_header(recv_buf)
+        if id ~= nil then
+            return nil, id, status, schema_id, body_len
         end
+        local required = status
         local deadline = fiber_time() + (timeout or TIMEOUT_INFINITY)
         local err, extra = send_and_recv(required, timeout)
         if err then
@@ -399,15 +423,16 @@ local function create_transport(host, port, user, password, callback)
             return iproto_schema_sm()
         end
         encode_auth(send_buf, new_request_id(), nil, user, password, salt)
-        local err, hdr, body = send_and_recv_iproto()
+        local err, id, status, schema_id, body_len = send_and_recv_iproto()
         if err then
-            return error_sm(err, hdr)
+            return error_sm(err, id)
         end
-        if hdr[IPROTO_STATUS_KEY] ~= 0 then
-            return error_sm(E_NO_CONNECTION, body[IPROTO_ERROR_KEY])
+        local body = decode_body(recv_buf, body_len)
+        if status ~= 0 then
+            return error_sm(E_NO_CONNECTION, body)
         end
         set_state('fetch_schema')
-        return iproto_schema_sm(hdr[IPROTO_SCHEMA_ID_KEY])
+        return iproto_schema_sm(schema_id)
     end
 
     iproto_schema_sm = function(schema_id)
@@ -425,16 +450,14 @@ local function create_transport(host, port, user, password, callback)
         schema_id = nil -- any schema_id will do provided that
                         -- it is consistent across responses
         repeat
-            local err, hdr, body = send_and_recv_iproto()
-            if err then return error_sm(err, hdr) end
-            dispatch_response_iproto(hdr, body)
-            local id = hdr[IPROTO_SYNC_KEY]
+            local err, id, status, response_schema_id, body_len =
+                send_and_recv_iproto()
+            if err then return error_sm(err, id) end
             if id == select1_id or id == select2_id then
                 -- response to a schema query we've submitted
-                local status = hdr[IPROTO_STATUS_KEY]
-                local response_schema_id = hdr[IPROTO_SCHEMA_ID_KEY]
+                local body = decode_body(recv_buf, body_len)
                 if status ~= 0 then
-                    return error_sm(E_NO_CONNECTION, body[IPROTO_ERROR_KEY])
+                    return error_sm(E_NO_CONNECTION, body)
                 end
                 if schema_id == nil then
                     schema_id = response_schema_id
@@ -442,7 +465,9 @@ local function create_transport(host, port, user, password, callback)
                     -- schema changed while fetching schema; restart loader
                     return iproto_schema_sm()
                 end
-                response[id] = body[IPROTO_DATA_KEY]
+                response[id] = body
+            else
+                dispatch_response_iproto(id, status, body_len)
             end
         until response[select1_id] and response[select2_id]
         callback('did_fetch_schema', schema_id,
@@ -451,21 +476,21 @@ local function create_transport(host, port, user, password, callback)
         return iproto_sm(schema_id)
     end
 
+    -- Responses are decoded and passed to the waiting clients by
+    -- dispatch(), in C, as many as the receive buffer holds.
     iproto_sm = function(schema_id)
-        local err, hdr, body = send_and_recv_iproto()
-        if err then return error_sm(err, hdr) end
-        dispatch_response_iproto(hdr, body)
-        local status = hdr[IPROTO_STATUS_KEY]
-        local response_schema_id = hdr[IPROTO_SCHEMA_ID_KEY]
-        if response_schema_id > 0 and response_schema_id ~= schema_id then
-            -- schema_id has been changed - start to load a new version.
-            -- Sic: self._schema_id will be updated only after reload.
-            set_state('fetch_schema',
-                      E_WRONG_SCHEMA_VERSION, body[IPROTO_ERROR_KEY],
-                      response_schema_id)
-            return iproto_schema_sm(schema_id)
+        local response_schema_id, msg = dispatch(recv_buf, requests,
+                                                 schema_id)
+        if response_schema_id == nil then
+            local err, extra = send_and_recv(msg)
+            if err then return error_sm(err, extra) end
+            return iproto_sm(schema_id)
         end
-        return iproto_sm(schema_id)
+        -- schema_id has been changed - start to load a new version.
+        -- Sic: self._schema_id will be updated only after reload.
+        set_state('fetch_schema', E_WRONG_SCHEMA_VERSION, msg,
+                  response_schema_id)
+        return iproto_schema_sm(schema_id)
     end
 
     error_sm = function(err, msg)
@@ -485,7 +510,8 @@ local function create_transport(host, port, user, password, callback)
         close           = close,
         connect         = connect,
         wait_state      = wait_state,
-        perform_request = perform_request
+        perform_request = perform_request,
+        perform_raw_request = perform_raw_request
     }
 end
 
@@ -646,10 +672,11 @@ function remote_methods:wait_connected(timeout)
     return self._transport.wait_state('active', timeout)
 end
 
-function remote_methods:_request(method, ...)
+local function request(self, raw, method, ...)
     local this_fiber = fiber_self()
     local transport = self._transport
-    local perform_request = transport.perform_request
+    local perform_request = raw and transport.perform_raw_request or
+                            transport.perform_request
     local wait_state = transport.wait_state
     local deadlines = self._deadlines
     local deadline = deadlines[this_fiber]
@@ -663,13 +690,8 @@ function remote_methods:_request(method, ...)
         err, res = perform_request(timeout, method,
                                    self._schema_id, ...)
         if not err then
-            setmetatable(res, sequence_mt)
-            local postproc = method ~= 'eval' and method ~= 'call_17'
-            if postproc and rawget(box, 'tuple') then
-                local tnew = box.tuple.new
-                for i, v in pairs(res) do
-                    res[i] = tnew(v)
-                end
+            if type(res) == 'table' then
+                setmetatable(res, sequence_mt)
             end
             return res
         elseif err == E_WRONG_SCHEMA_VERSION then
@@ -679,6 +701,16 @@ function remote_methods:_request(method, ...)
     box.error({code = err, reason = res})
 end
 
+function remote_methods:_request(method, ...)
+    return request(self, false, method, ...)
+end
+
+-- Same as _request(), but returns the response data as a string
+-- with MessagePack, without decoding it.
+function remote_methods:_request_raw(method, ...)
+    return request(self, true, method, ...)
+end
+
 function remote_methods:ping()
     remote_check(self, 'ping')
     local deadline = self._deadlines[fiber_self()]
@@ -848,6 +880,15 @@ local function one_tuple(tab)
     if tab[1] ~= nil then return tab[1] end
 end
 
+-- With opts.raw the selected tuples are returned as a string
+-- with a MessagePack array, not decoded.
+local function remote_select(remote, space_id, index_id, key, opts)
+    if type(opts) == 'table' and opts.raw then
+        return remote:_request_raw('select', space_id, index_id, key, opts)
+    end
+    return remote:_request('select', space_id, index_id, key, opts)
+end
+
 space_metatable = function(remote)
     local methods = {}
 
@@ -863,7 +904,7 @@ space_metatable = function(remote)
 
     function methods:select(key, opts)
         space_check(self, 'select')
-        return remote:_request('select', self.id, 0, key, opts)
+        return remote_select(remote, self.id, 0, key, opts)
     end
 
     function methods:delete(key)
@@ -904,7 +945,7 @@ index_metatable = function(remote)
 
     function methods:select(key, opts)
         index_check(self, 'select')
-        return remote:_request('select', self.space.id, self.id, key, opts)
+        return remote_select(remote, self.space.id, self.id, key, opts)
     end
 
     function methods:get(key)
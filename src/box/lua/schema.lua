@@ -240,6 +240,9 @@ box.schema.space.create = function(name, options)
         user = 'string, number',
         format = 'table',
         temporary = 'boolean',
+        field_offsets = 'number',
+        compression = 'string',
+        compression_threshold = 'number',
     }
     local options_defaults = {
         engine = 'memtx',
@@ -281,6 +284,9 @@ box.schema.space.create = function(name, options)
     -- filter out global parameters from the options array
     local space_options = setmetatable({
         temporary = options.temporary and true or nil,
+        field_offsets = options.field_offsets,
+        compression = options.compression,
+        compression_threshold = options.compression_threshold,
     }, { __serialize = 'map' })
     _space:insert{id, uid, name, options.engine, options.field_count,
         space_options, format}
@@ -388,6 +394,9 @@ box.schema.index.create = function(space_id, name, options)
         range_size = 'number',
         run_count_per_level = 'number',
         run_size_ratio = 'number',
+        bloom_fpr = 'number',
+        hint = 'boolean',
+        compact = 'boolean',
     }
     check_param_table(options, options_template)
     local options_defaults = {
@@ -411,6 +420,7 @@ box.schema.index.create = function(space_id, name, options)
             range_size = box.cfg.vinyl.range_size,
             run_count_per_level = box.cfg.vinyl.run_count_per_level,
             run_size_ratio = box.cfg.vinyl.run_size_ratio,
+            bloom_fpr = box.cfg.vinyl.bloom_fpr,
         }
     else
         options_defaults = {}
@@ -458,6 +468,9 @@ box.schema.index.create = function(space_id, name, options)
             range_size = options.range_size,
             run_count_per_level = options.run_count_per_level,
             run_size_ratio = options.run_size_ratio,
+            bloom_fpr = options.bloom_fpr,
+            hint = options.hint,
+            compact = options.compact,
             lsn = box.info.cluster.signature,
     }
     local field_type_aliases = {
@@ -847,11 +860,19 @@ function box.schema.space.bless(space)
             if opts.limit ~= nil then
                 limit = opts.limit
             end
+            if opts.fields ~= nil and type(opts.fields) ~= 'table' then
+                box.error(box.error.ILLEGAL_PARAMS,
+                          "fields must be an array of field numbers")
+            end
         end
         return iterator, offset, limit
     end
 
     index_mt.select_ffi = function(index, key, opts)
+        if opts ~= nil and type(opts) == 'table' and opts.fields ~= nil then
+            -- tuples made of some fields are created in C
+            return index_mt.select_luac(index, key, opts)
+        end
         local key, key_end = tuple_encode(key)
         local iterator, offset, limit = check_select_opts(opts, key + 1 >= key_end)
 
@@ -875,8 +896,9 @@ function box.schema.space.bless(space)
     index_mt.select_luac = function(index, key, opts)
         local key = keify(key)
         local iterator, offset, limit = check_select_opts(opts, #key == 0)
+        local fields = type(opts) == 'table' and opts.fields or nil
         return internal.select(index.space_id, index.id, iterator,
-            offset, limit, key)
+            offset, limit, key, fields)
     end
 
     index_mt.update = function(index, key, ops)
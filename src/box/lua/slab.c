@@ -41,6 +41,9 @@
 #include "small/small.h"
 #include "small/quota.h"
 #include "memory.h"
+#include "box/tuple_compression.h"
+#include "box/memtx_arena.h"
+#include "box/memtx_compact.h"
 
 extern struct small_alloc memtx_alloc;
 extern struct mempool memtx_index_extent_pool;
@@ -164,6 +167,18 @@ lbox_slab_info(struct lua_State *L)
 	lua_pushstring(L, ratio_buf);
 	lua_settable(L, -3);
 
+	/**
+	 * How much of the tuple data is compressed, before and
+	 * after compression.
+	 */
+	lua_pushstring(L, "compressed_raw_size");
+	luaL_pushuint64(L, tuple_compression_stat.raw_size);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "compressed_size");
+	luaL_pushuint64(L, tuple_compression_stat.size);
+	lua_settable(L, -3);
+
 	/** How much address space has been already touched
 	 * (tuples and indexes) */
 	lua_pushstring(L, "arena_size");
@@ -215,6 +230,20 @@ lbox_slab_info(struct lua_State *L)
 	lua_pushstring(L, ratio_buf);
 	lua_settable(L, -3);
 
+	/**
+	 * Huge pages backing the arena, see
+	 * box.cfg.slab_alloc_huge_pages.
+	 */
+	struct memtx_arena_stat arena_stat;
+	memtx_arena_stat(tuple_arena, &arena_stat);
+	lua_pushstring(L, "huge_page_size");
+	luaL_pushuint64(L, arena_stat.huge_page_size);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "huge_pages_used");
+	luaL_pushuint64(L, arena_stat.huge_pages_used);
+	lua_settable(L, -3);
+
 	return 1;
 }
 
@@ -241,6 +270,31 @@ lbox_runtime_info(struct lua_State *L)
 	return 1;
 }
 
+/** Statistics of the background compaction, @sa memtx_compact.h */
+static int
+lbox_slab_compaction_info(struct lua_State *L)
+{
+	lua_newtable(L);
+
+	lua_pushstring(L, "rounds");
+	luaL_pushuint64(L, memtx_compact_stat.rounds);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "examined");
+	luaL_pushuint64(L, memtx_compact_stat.examined);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "moved");
+	luaL_pushuint64(L, memtx_compact_stat.moved);
+	lua_settable(L, -3);
+
+	lua_pushstring(L, "moved_size");
+	luaL_pushuint64(L, memtx_compact_stat.moved_size);
+	lua_settable(L, -3);
+
+	return 1;
+}
+
 static int
 lbox_slab_check(MAYBE_UNUSED struct lua_State *L)
 {
@@ -264,6 +318,10 @@ box_lua_slab_init(struct lua_State *L)
 	lua_pushcfunction(L, lbox_slab_stats);
 	lua_settable(L, -3);
 
+	lua_pushstring(L, "compaction_info");
+	lua_pushcfunction(L, lbox_slab_compaction_info);
+	lua_settable(L, -3);
+
 	lua_pushstring(L, "check");
 	lua_pushcfunction(L, lbox_slab_check);
 	lua_settable(L, -3);
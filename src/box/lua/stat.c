@@ -33,6 +33,7 @@
 
 #include <string.h>
 #include <rmean.h>
+#include "box/iproto.h"
 
 #include <lua.h>
 #include <lauxlib.h>
@@ -42,8 +43,6 @@
 
 extern struct rmean *rmean_box;
 extern struct rmean *rmean_error;
-/** network statistics (iproto & cbus) */
-extern struct rmean *rmean_net;
 extern struct rmean *rmean_tx_wal_bus;
 
 static void
@@ -113,14 +112,31 @@ static int
 lbox_stat_net_index(struct lua_State *L)
 {
 	luaL_checkstring(L, -1);
-	return rmean_foreach(rmean_net, seek_stat_item, L);
+	return iproto_rmean_foreach(seek_stat_item, L);
 }
 
 static int
 lbox_stat_net_call(struct lua_State *L)
 {
 	lua_newtable(L);
-	rmean_foreach(rmean_net, set_stat_item, L);
+	iproto_rmean_foreach(set_stat_item, L);
+	return 1;
+}
+
+/**
+ * Return an array of network statistics of every network
+ * io thread, in the format of box.stat.net().
+ */
+static int
+lbox_stat_net_thread(struct lua_State *L)
+{
+	int count = iproto_thread_count();
+	lua_createtable(L, count, 0);
+	for (int i = 0; i < count; i++) {
+		lua_newtable(L);
+		iproto_thread_rmean_foreach(i, set_stat_item, L);
+		lua_rawseti(L, -2, i + 1);
+	}
 	return 1;
 }
 
@@ -178,7 +194,12 @@ box_lua_stat_init(struct lua_State *L)
 	lua_pop(L, 1); /* stat module */
 
 
-	luaL_register_module(L, "box.stat.net", statlib);
+	static const struct luaL_reg netlib [] = {
+		{"thread", lbox_stat_net_thread},
+		{NULL, NULL}
+	};
+
+	luaL_register_module(L, "box.stat.net", netlib);
 
 	lua_newtable(L);
 	luaL_register(L, NULL, lbox_stat_net_meta);
@@ -196,6 +196,8 @@ lbox_tuple_slice(struct lua_State *L)
 		return luaL_error(L, "tuple.slice(): start must be less than end");
 
 	box_tuple_iterator_t *it = box_tuple_iterator(tuple);
+	if (it == NULL)
+		return luaT_error(L);
 	lua_pushcfunction(L, lbox_tuple_slice_wrapper);
 	lua_pushlightuserdata(L, it);
 	lua_pushinteger(L, start);
@@ -251,7 +253,10 @@ tuple_to_mpstream(struct tuple *tuple, struct mpstream *stream)
 {
 	size_t bsize = box_tuple_bsize(tuple);
 	char *ptr = mpstream_reserve(stream, bsize);
-	box_tuple_to_buf(tuple, ptr, bsize);
+	if (box_tuple_to_buf(tuple, ptr, bsize) < 0) {
+		stream->error(stream->error_ctx);
+		return;
+	}
 	mpstream_advance(stream, bsize);
 }
 
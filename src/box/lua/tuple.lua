@@ -168,6 +168,10 @@ local function tuple_next(tuple, pos)
     end
     local field = builtin.box_tuple_field(tuple, pos)
     if field == nil then
+        if pos < builtin.box_tuple_field_count(tuple) then
+            -- A compressed tuple failed to decompress
+            box.error()
+        end
         return nil
     end
     return pos + 1, (msgpackffi.decode_unchecked(field))
@@ -267,7 +271,9 @@ local function tuple_to_msgpack(buf, tuple)
     assert(ffi.istype(tuple_t, tuple))
     local bsize = builtin.box_tuple_bsize(tuple)
     buf:reserve(bsize)
-    builtin.box_tuple_to_buf(tuple, buf.wpos, bsize)
+    if builtin.box_tuple_to_buf(tuple, buf.wpos, bsize) < 0 then
+        box.error()
+    end
     buf.wpos = buf.wpos + bsize
 end
 
@@ -298,6 +304,11 @@ local methods = {
 local tuple_field = function(tuple, field_n)
     local field = builtin.box_tuple_field(tuple, field_n - 1)
     if field == nil then
+        if field_n >= 1 and
+           field_n <= builtin.box_tuple_field_count(tuple) then
+            -- A compressed tuple failed to decompress
+            box.error()
+        end
         return nil
     end
     -- Use () to shrink stack to the first return value
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "memtx_arena.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "small/slab_arena.h"
+#include "say.h"
+
+enum {
+	/** Default huge page size on x86_64 and aarch64. */
+	HUGE_PAGE_SIZE_DEFAULT = 2 * 1024 * 1024,
+	/** Max number of NUMA nodes accepted in slab_alloc_numa. */
+	NUMA_NODE_MAX = 1024,
+	/** Memory policies, see <linux/mempolicy.h>. */
+	NUMA_MPOL_BIND = 2,
+	NUMA_MPOL_INTERLEAVE = 3,
+};
+
+#define NODEMASK_WORD_BIT (sizeof(unsigned long) * CHAR_BIT)
+
+/** How the memtx arena is actually mapped. */
+static enum memtx_arena_pages memtx_arena_pages = MEMTX_ARENA_PAGES_REGULAR;
+
+size_t
+memtx_arena_huge_page_size(void)
+{
+	static size_t huge_page_size = 0;
+	if (huge_page_size != 0)
+		return huge_page_size;
+	huge_page_size = HUGE_PAGE_SIZE_DEFAULT;
+	FILE *f = fopen("/proc/meminfo", "r");
+	if (f == NULL)
+		return huge_page_size;
+	char line[128];
+	size_t kb;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, "Hugepagesize: %zu kB", &kb) == 1) {
+			if (kb > 0)
+				huge_page_size = kb * 1024;
+			break;
+		}
+	}
+	fclose(f);
+	return huge_page_size;
+}
+
+/**
+ * Parse a list of NUMA nodes, like '0,2-3', into a node mask.
+ * @retval 0 success
+ * @retval -1 the list is malformed
+ */
+static int
+numa_parse_nodes(const char *str, unsigned long *mask)
+{
+	memset(mask, 0, NUMA_NODE_MAX / CHAR_BIT);
+	const char *pos = str;
+	do {
+		char *end;
+		unsigned long first = strtoul(pos, &end, 10);
+		if (end == pos || first >= NUMA_NODE_MAX)
+			return -1;
+		unsigned long last = first;
+		pos = end;
+		if (*pos == '-') {
+			last = strtoul(++pos, &end, 10);
+			if (end == pos || last < first || last >= NUMA_NODE_MAX)
+				return -1;
+			pos = end;
+		}
+		for (unsigned long node = first; node <= last; node++) {
+			mask[node / NODEMASK_WORD_BIT] |=
+				1UL << (node % NODEMASK_WORD_BIT);
+		}
+	} while (*pos++ == ',');
+	return pos[-1] == '\0' || pos[-1] == '\n' ? 0 : -1;
+}
+
+/**
+ * Convert box.cfg.slab_alloc_numa to a memory policy and a node
+ * mask. 'interleave' spreads pages over all online nodes.
+ */
+static int
+numa_parse(const char *numa, int *mode, unsigned long *mask)
+{
+	if (strcmp(numa, "interleave") != 0) {
+		*mode = NUMA_MPOL_BIND;
+		return numa_parse_nodes(numa, mask);
+	}
+	*mode = NUMA_MPOL_INTERLEAVE;
+	char nodes[256] = "0";
+	FILE *f = fopen("/sys/devices/system/node/online", "r");
+	if (f != NULL) {
+		if (fgets(nodes, sizeof(nodes), f) == NULL)
+			strcpy(nodes, "0");
+		fclose(f);
+	}
+	return numa_parse_nodes(nodes, mask);
+}
+
+int
+memtx_arena_check_numa(const char *numa)
+{
+	if (strcmp(numa, "interleave") == 0)
+		return 0;
+	unsigned long mask[NUMA_NODE_MAX / NODEMASK_WORD_BIT];
+	return numa_parse_nodes(numa, mask);
+}
+
+static void
+memtx_arena_set_numa(struct slab_arena *arena, const char *numa)
+{
+	int mode;
+	unsigned long mask[NUMA_NODE_MAX / NODEMASK_WORD_BIT];
+	if (numa_parse(numa, &mode, mask) != 0) {
+		say_warn("failed to parse the list of online NUMA nodes, "
+			 "slab_alloc_numa is ignored");
+		return;
+	}
+#if defined(__linux__) && defined(SYS_mbind)
+	/*
+	 * No page of the arena is touched yet, so the policy
+	 * applies to all of them. Call mbind(2) directly to not
+	 * depend on libnuma.
+	 */
+	if (syscall(SYS_mbind, arena->arena, arena->prealloc, mode, mask,
+		    (unsigned long) NUMA_NODE_MAX + 1, 0) != 0) {
+		say_syserror("failed to set NUMA policy '%s' for the "
+			     "tuple arena", numa);
+		return;
+	}
+	say_info("tuple arena NUMA policy: %s", numa);
+#else
+	(void) arena;
+	(void) mode;
+	say_warn("NUMA policies are not supported on this platform, "
+		 "slab_alloc_numa is ignored");
+#endif
+}
+
+int
+memtx_arena_create(struct slab_arena *arena, struct quota *quota,
+		   size_t prealloc, uint32_t slab_size, bool huge_pages,
+		   const char *numa)
+{
+	memtx_arena_pages = MEMTX_ARENA_PAGES_REGULAR;
+#if defined(MAP_HUGETLB)
+	if (huge_pages && slab_size % memtx_arena_huge_page_size() == 0) {
+		if (slab_arena_create(arena, quota, prealloc, slab_size,
+				      MAP_PRIVATE | MAP_HUGETLB) == 0) {
+			memtx_arena_pages = MEMTX_ARENA_PAGES_HUGETLB;
+			say_info("tuple arena is mapped with %zu kB huge pages",
+				 memtx_arena_huge_page_size() / 1024);
+			goto numa;
+		}
+		say_warn("failed to map the tuple arena with huge pages: %s, "
+			 "check vm.nr_hugepages", strerror(errno));
+	}
+#endif
+	if (slab_arena_create(arena, quota, prealloc, slab_size,
+			      MAP_PRIVATE) != 0)
+		return -1;
+	if (huge_pages) {
+#if defined(MADV_HUGEPAGE)
+		if (arena->prealloc == 0 ||
+		    madvise(arena->arena, arena->prealloc,
+			    MADV_HUGEPAGE) == 0) {
+			memtx_arena_pages = MEMTX_ARENA_PAGES_THP;
+			say_info("tuple arena uses transparent huge pages");
+			goto numa;
+		}
+		say_syserror("madvise(MADV_HUGEPAGE)");
+#endif
+		say_warn("huge pages are not available, the tuple arena "
+			 "uses regular pages");
+	}
+numa:
+	if (numa != NULL && arena->prealloc > 0)
+		memtx_arena_set_numa(arena, numa);
+	return 0;
+}
+
+/**
+ * Sum AnonHugePages of the mappings of the arena in
+ * /proc/self/smaps. Transparent huge pages are allocated on
+ * page faults and may be split by the kernel at any time.
+ */
+static size_t
+memtx_arena_thp_used(const struct slab_arena *arena)
+{
+	FILE *f = fopen("/proc/self/smaps", "r");
+	if (f == NULL)
+		return 0;
+	uintptr_t begin = (uintptr_t) arena->arena;
+	uintptr_t end = begin + arena->prealloc;
+	bool is_arena = false;
+	size_t used = 0;
+	char line[512];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		uintptr_t start, stop;
+		size_t kb;
+		if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " ",
+			   &start, &stop) == 2)
+			is_arena = start < end && stop > begin;
+		else if (is_arena &&
+			 sscanf(line, "AnonHugePages: %zu kB", &kb) == 1)
+			used += kb * 1024;
+	}
+	fclose(f);
+	return used;
+}
+
+void
+memtx_arena_stat(const struct slab_arena *arena,
+		 struct memtx_arena_stat *stat)
+{
+	switch (memtx_arena_pages) {
+	case MEMTX_ARENA_PAGES_HUGETLB:
+		stat->huge_page_size = memtx_arena_huge_page_size();
+		stat->huge_pages_used = arena->used;
+		break;
+	case MEMTX_ARENA_PAGES_THP:
+		stat->huge_page_size = memtx_arena_huge_page_size();
+		stat->huge_pages_used = memtx_arena_thp_used(arena);
+		break;
+	default:
+		stat->huge_page_size = 0;
+		stat->huge_pages_used = 0;
+	}
+}
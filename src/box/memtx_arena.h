@@ -0,0 +1,108 @@
+#ifndef TARANTOOL_BOX_MEMTX_ARENA_H_INCLUDED
+#define TARANTOOL_BOX_MEMTX_ARENA_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * Mapping of the memtx arena, which backs both tuples and
+ * index extents, with huge pages and a NUMA memory policy.
+ *
+ * Explicit huge pages (MAP_HUGETLB) are tried first. They need
+ * vm.nr_hugepages to be reserved by the administrator. If the
+ * reservation is not big enough, the arena is mapped with
+ * regular pages and advised to be backed by transparent huge
+ * pages. If neither works, the arena uses regular pages.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+struct slab_arena;
+struct quota;
+
+enum memtx_arena_pages {
+	/** Regular pages. */
+	MEMTX_ARENA_PAGES_REGULAR,
+	/** Transparent huge pages, madvise(MADV_HUGEPAGE). */
+	MEMTX_ARENA_PAGES_THP,
+	/** Explicit huge pages, mmap(MAP_HUGETLB). */
+	MEMTX_ARENA_PAGES_HUGETLB,
+};
+
+struct memtx_arena_stat {
+	/** Size of a huge page, 0 if huge pages are not used. */
+	size_t huge_page_size;
+	/** How much of the arena is backed by huge pages. */
+	size_t huge_pages_used;
+};
+
+/**
+ * Size of a huge page. The arena slab size must be a multiple
+ * of it for the arena to be mapped with huge pages.
+ */
+size_t
+memtx_arena_huge_page_size(void);
+
+/**
+ * Check the box.cfg.slab_alloc_numa value: either 'interleave'
+ * or a list of NUMA nodes, like '0,2-3'.
+ * @retval 0 the value is valid
+ * @retval -1 the value is invalid
+ */
+int
+memtx_arena_check_numa(const char *numa);
+
+/**
+ * Create the memtx arena, @sa slab_arena_create(). Try to map
+ * it with huge pages if @a huge_pages is set, and apply the
+ * @a numa policy if it is not NULL. Failures to do either are
+ * logged and the arena falls back to the default mapping.
+ * @retval 0 success
+ * @retval -1 the arena could not be mapped, errno is set
+ */
+int
+memtx_arena_create(struct slab_arena *arena, struct quota *quota,
+		   size_t prealloc, uint32_t slab_size, bool huge_pages,
+		   const char *numa);
+
+/** Huge page usage statistics of an arena. */
+void
+memtx_arena_stat(const struct slab_arena *arena,
+		 struct memtx_arena_stat *stat);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_BOX_MEMTX_ARENA_H_INCLUDED */
@@ -36,6 +36,7 @@
 #include "trivia/util.h"
 
 #include "tuple.h"
+#include "memtx_tx.h"
 
 #ifndef OLD_GOOD_BITSET
 #include "memtx_engine.h"
@@ -168,8 +169,8 @@ bitset_index_iterator_free(struct iterator *iterator)
 	free(it);
 }
 
-struct tuple *
-bitset_index_iterator_next(struct iterator *iterator)
+static struct tuple *
+bitset_index_iterator_next_base(struct iterator *iterator)
 {
 	assert(iterator->free == bitset_index_iterator_free);
 	struct bitset_index_iterator *it = bitset_index_iterator(iterator);
@@ -185,6 +186,8 @@ bitset_index_iterator_next(struct iterator *iterator)
 #endif /* #ifndef OLD_GOOD_BITSET */
 }
 
+MEMTX_TX_WRAP_ITERATOR(bitset_index_iterator_next)
+
 MemtxBitset::MemtxBitset(struct key_def *key_def_arg)
 	: MemtxIndex(key_def_arg)
 {
@@ -202,7 +205,9 @@ MemtxBitset::MemtxBitset(struct key_def *key_def_arg)
 	if (!m_tuple_to_id)
 		panic_syserror("bitset_index_create");
 #endif /* #ifndef OLD_GOOD_BITSET */
-	if (bitset_index_create(&m_index, realloc) != 0)
+	enum bitset_layout layout = key_def->opts.compact ?
+		BITSET_LAYOUT_COMPACT : BITSET_LAYOUT_BITMAP;
+	if (bitset_index_create_layout(&m_index, layout, realloc) != 0)
 		panic_syserror("bitset_index_create");
 
 }
@@ -246,6 +251,7 @@ MemtxBitset::allocIterator() const
 	memset(it, 0, sizeof(*it));
 	it->base.next = bitset_index_iterator_next;
 	it->base.free = bitset_index_iterator_free;
+	it->base.index = (Index *) this;
 
 	bitset_iterator_create(&it->bitset_it, realloc);
 #ifndef OLD_GOOD_BITSET
@@ -397,6 +403,9 @@ size_t
 MemtxBitset::count(enum iterator_type type, const char *key,
 		   uint32_t part_count) const
 {
+	/* Bitset counts include uncommitted tuples. */
+	if (memtx_tx_has_stories())
+		return MemtxIndex::count(type, key, part_count);
 	if (type == ITER_ALL)
 		return bitset_index_size(&m_index);
 
@@ -0,0 +1,306 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "memtx_build.h"
+
+#include <unistd.h>
+
+#include "memtx_index.h"
+#include "space.h"
+#include "clock.h"
+#include "fiber.h"
+#include "say.h"
+#include "tt_pthread.h"
+
+const char *memtx_build_state_strs[] = {
+	"pending",
+	"in progress",
+	"done",
+	"failed",
+};
+
+/** Statistics of the last bulk build of secondary keys. */
+static struct memtx_build_stat *build_stats;
+static int build_stat_count;
+
+const struct memtx_build_stat *
+memtx_build_stats(int *count)
+{
+	*count = build_stat_count;
+	return build_stats;
+}
+
+static void
+memtx_build_stats_reset(void)
+{
+	for (int i = 0; i < build_stat_count; i++) {
+		free(build_stats[i].space_name);
+		free(build_stats[i].index_name);
+	}
+	free(build_stats);
+	build_stats = NULL;
+	build_stat_count = 0;
+}
+
+struct memtx_build_task {
+	struct space *space;
+	MemtxIndex *index;
+	/** True if the index can be prepared in a build thread. */
+	bool in_thread;
+	/** Progress of the build, points into build_stats. */
+	struct memtx_build_stat *stat;
+	/** Result of the build and the error if it failed. */
+	int status;
+	struct diag diag;
+};
+
+void
+memtx_builder_create(struct memtx_builder *builder)
+{
+	builder->tasks = NULL;
+	builder->task_count = 0;
+	builder->next_task = 0;
+	tt_pthread_mutex_init(&builder->mutex, NULL);
+}
+
+void
+memtx_builder_destroy(struct memtx_builder *builder)
+{
+	for (int i = 0; i < builder->task_count; i++)
+		diag_destroy(&builder->tasks[i].diag);
+	free(builder->tasks);
+	tt_pthread_mutex_destroy(&builder->mutex);
+}
+
+void
+memtx_builder_add_space(struct memtx_builder *builder, struct space *space)
+{
+	if (space->index_count <= 1)
+		return;
+	int task_count = builder->task_count + space->index_count - 1;
+	struct memtx_build_task *tasks = (struct memtx_build_task *)
+		realloc(builder->tasks, task_count * sizeof(*tasks));
+	if (tasks == NULL) {
+		tnt_raise(OutOfMemory, task_count * sizeof(*tasks),
+			  "realloc", "struct memtx_build_task");
+	}
+	builder->tasks = tasks;
+	for (uint32_t j = 1; j < space->index_count; j++) {
+		struct memtx_build_task *task =
+			&builder->tasks[builder->task_count++];
+		task->space = space;
+		task->index = (MemtxIndex *) space->index[j];
+		task->in_thread = task->index->canPrepareBuildInThread();
+		task->stat = NULL;
+		task->status = 0;
+		diag_create(&task->diag);
+	}
+}
+
+/**
+ * Feed all tuples of the primary key to an index being built
+ * and prepare it for endBuild(). Doesn't use the primary key
+ * position iterator, so it may be called from several threads
+ * at once.
+ */
+static void
+memtx_build_task_prepare(struct memtx_build_task *task)
+{
+	struct memtx_build_stat *stat = task->stat;
+	MemtxIndex *index = task->index;
+	MemtxIndex *pk = (MemtxIndex *) task->space->index[0];
+	uint32_t estimated_tuples = stat->tuple_count * 1.2;
+
+	stat->state = MEMTX_BUILD_IN_PROGRESS;
+	double start = clock_monotonic();
+	index->beginBuild();
+	index->reserve(estimated_tuples);
+
+	if (stat->tuple_count > 0) {
+		say_info("Adding %" PRIu32 " keys to %s index '%s' ...",
+			 stat->tuple_count,
+			 index_type_strs[index->key_def->type],
+			 index_name(index));
+	}
+
+	struct iterator *it = pk->allocIterator();
+	IteratorGuard guard(it);
+	pk->initIterator(it, ITER_ALL, NULL, 0);
+	struct tuple *tuple;
+	while ((tuple = it->next(it)))
+		index->buildNext(tuple);
+
+	index->prepareBuild();
+	stat->time += clock_monotonic() - start;
+}
+
+/** Finish a build. Must be called from tx. */
+static void
+memtx_build_task_end(struct memtx_build_task *task)
+{
+	struct memtx_build_stat *stat = task->stat;
+	double start = clock_monotonic();
+	task->index->endBuild();
+	stat->time += clock_monotonic() - start;
+	stat->state = MEMTX_BUILD_DONE;
+	if (stat->tuple_count > 0) {
+		say_info("Space '%s': index '%s' built in %.3f sec",
+			 stat->space_name, stat->index_name, stat->time);
+	}
+}
+
+static void
+memtx_build_task_exec(struct memtx_build_task *task,
+		      void (*f)(struct memtx_build_task *))
+{
+	try {
+		f(task);
+	} catch (Exception *) {
+		task->status = -1;
+		task->stat->state = MEMTX_BUILD_FAILED;
+		diag_move(diag_get(), &task->diag);
+	}
+}
+
+/**
+ * Check out indexes one by one and prepare them until there
+ * are no indexes left. Called from build threads and tx.
+ */
+static void
+memtx_builder_prepare(struct memtx_builder *builder)
+{
+	while (true) {
+		struct memtx_build_task *task = NULL;
+		tt_pthread_mutex_lock(&builder->mutex);
+		while (builder->next_task < builder->task_count) {
+			task = &builder->tasks[builder->next_task++];
+			if (task->in_thread)
+				break;
+			task = NULL;
+		}
+		tt_pthread_mutex_unlock(&builder->mutex);
+		if (task == NULL)
+			break;
+		memtx_build_task_exec(task, memtx_build_task_prepare);
+	}
+}
+
+static int
+memtx_build_thread_f(va_list ap)
+{
+	struct memtx_builder *builder = va_arg(ap, struct memtx_builder *);
+	memtx_builder_prepare(builder);
+	return 0;
+}
+
+void
+memtx_builder_run(struct memtx_builder *builder)
+{
+	memtx_build_stats_reset();
+	if (builder->task_count == 0)
+		return;
+	build_stats = (struct memtx_build_stat *)
+		calloc(builder->task_count, sizeof(*build_stats));
+	if (build_stats == NULL) {
+		tnt_raise(OutOfMemory,
+			  builder->task_count * sizeof(*build_stats),
+			  "calloc", "struct memtx_build_stat");
+	}
+	int thread_task_count = 0;
+	for (int i = 0; i < builder->task_count; i++) {
+		struct memtx_build_task *task = &builder->tasks[i];
+		struct memtx_build_stat *stat = &build_stats[i];
+		build_stat_count++;
+		task->stat = stat;
+		stat->space_name = strdup(space_name(task->space));
+		stat->index_name = strdup(index_name(task->index));
+		if (stat->space_name == NULL || stat->index_name == NULL) {
+			tnt_raise(OutOfMemory, BOX_NAME_MAX,
+				  "strdup", "memtx_build_stat");
+		}
+		stat->tuple_count = task->space->index[0]->size();
+		stat->state = MEMTX_BUILD_PENDING;
+		if (task->in_thread)
+			thread_task_count++;
+	}
+
+	/*
+	 * Sorting a single index may use several cores on its
+	 * own (@sa qsort_arg_mt), so don't start more build
+	 * threads than there are cores. tx joins them after
+	 * it is done with indexes which must be built in tx.
+	 */
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	int thread_count = MIN(thread_task_count - 1, ncpu - 1);
+	struct cord *threads = NULL;
+	if (thread_count > 0) {
+		threads = (struct cord *) calloc(thread_count,
+						 sizeof(*threads));
+		if (threads == NULL)
+			thread_count = 0;
+	}
+	for (int i = 0; i < thread_count; i++) {
+		if (cord_costart(&threads[i], "memtx.build",
+				 memtx_build_thread_f, builder) != 0) {
+			/* The rest will be done by running threads. */
+			thread_count = i;
+			break;
+		}
+	}
+
+	for (int i = 0; i < builder->task_count; i++) {
+		struct memtx_build_task *task = &builder->tasks[i];
+		if (task->in_thread)
+			continue;
+		memtx_build_task_exec(task, memtx_build_task_prepare);
+		if (task->status == 0)
+			memtx_build_task_exec(task, memtx_build_task_end);
+	}
+	memtx_builder_prepare(builder);
+
+	for (int i = 0; i < thread_count; i++) {
+		if (cord_cojoin(&threads[i]) != 0)
+			error_log(diag_last_error(diag_get()));
+	}
+	free(threads);
+
+	struct memtx_build_task *failed = NULL;
+	for (int i = 0; i < builder->task_count; i++) {
+		struct memtx_build_task *task = &builder->tasks[i];
+		if (task->in_thread && task->status == 0)
+			memtx_build_task_exec(task, memtx_build_task_end);
+		if (task->status != 0 && failed == NULL)
+			failed = task;
+	}
+	if (failed != NULL) {
+		diag_move(&failed->diag, diag_get());
+		diag_raise();
+	}
+}
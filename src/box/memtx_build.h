@@ -0,0 +1,117 @@
+#ifndef TARANTOOL_BOX_MEMTX_BUILD_H_INCLUDED
+#define TARANTOOL_BOX_MEMTX_BUILD_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+enum memtx_build_state {
+	MEMTX_BUILD_PENDING,
+	MEMTX_BUILD_IN_PROGRESS,
+	MEMTX_BUILD_DONE,
+	MEMTX_BUILD_FAILED,
+	memtx_build_state_MAX
+};
+
+extern const char *memtx_build_state_strs[];
+
+/** Progress of a secondary key bulk build at recovery. */
+struct memtx_build_stat {
+	char *space_name;
+	char *index_name;
+	/** Number of tuples in the space. */
+	uint32_t tuple_count;
+	/**
+	 * Updated by build threads, so may be slightly
+	 * out of date when read from tx.
+	 */
+	enum memtx_build_state state;
+	/** Time spent building the index, in seconds. */
+	double time;
+};
+
+/**
+ * Get statistics of the last bulk build of secondary keys.
+ * @param[out] count number of built indexes
+ */
+const struct memtx_build_stat *
+memtx_build_stats(int *count);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+
+struct space;
+
+/**
+ * Bulk builder of secondary keys of spaces loaded at recovery.
+ * Indexes which support it (TREE, RTREE) are collected and sorted by
+ * a pool of threads, one index per thread at a time, while
+ * the rest is built in tx. Then all indexes are finished in
+ * tx, since it is the only thread which may use the memtx
+ * index allocator.
+ */
+struct memtx_builder {
+	/** Indexes to build. */
+	struct memtx_build_task *tasks;
+	int task_count;
+	/**
+	 * Position in tasks to look up the next index to
+	 * prepare in a build thread from.
+	 */
+	int next_task;
+	/** Protects next_task. */
+	pthread_mutex_t mutex;
+};
+
+void
+memtx_builder_create(struct memtx_builder *builder);
+
+void
+memtx_builder_destroy(struct memtx_builder *builder);
+
+/** Schedule a build of all secondary keys of a space. */
+void
+memtx_builder_add_space(struct memtx_builder *builder, struct space *space);
+
+/**
+ * Build all scheduled indexes.
+ * @throws an exception if any of the builds failed.
+ */
+void
+memtx_builder_run(struct memtx_builder *builder);
+
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_BOX_MEMTX_BUILD_H_INCLUDED */
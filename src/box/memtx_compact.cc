@@ -0,0 +1,373 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "memtx_compact.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "small/small.h"
+#include "msgpuck/msgpuck.h"
+#include "memtx_engine.h"
+#include "memtx_space.h"
+#include "memtx_index.h"
+#include "memtx_tuple.h"
+#include "schema.h"
+#include "space.h"
+#include "index.h"
+#include "tuple.h"
+#include "fiber.h"
+#include "say.h"
+
+extern struct small_alloc memtx_alloc;
+
+struct memtx_compact_stat memtx_compact_stat;
+
+enum {
+	/** Max number of tuples examined in one event loop iteration. */
+	MEMTX_COMPACT_BATCH = 100,
+};
+
+/** How long to wait before retrying if compaction is not possible. */
+static const double MEMTX_COMPACT_RETRY_DELAY = 0.1;
+/** How long to wait before the next pass if nothing is fragmented. */
+static const double MEMTX_COMPACT_IDLE_DELAY = 1;
+
+/** A size class of the tuple allocator. */
+struct memtx_compact_class {
+	uint32_t objsize;
+	uint32_t slab_size;
+	/** Set if the tuples of this class should be moved. */
+	bool is_sparse;
+};
+
+static struct memtx_compactor {
+	MemtxEngine *engine;
+	struct fiber *fiber;
+	/** Max number of tuples examined per second. */
+	double rate;
+	/** Compact size classes used less than this. */
+	double threshold;
+	/** Size classes sorted by item size. */
+	struct memtx_compact_class *classes;
+	uint32_t class_count;
+	uint32_t class_capacity;
+	/** Number of sparse size classes. */
+	uint32_t sparse_count;
+	/** The space to continue from. */
+	uint32_t space_id;
+	/**
+	 * The primary key of the last tuple examined in the
+	 * space, NULL to start from the first tuple.
+	 */
+	char *key;
+	uint32_t key_size;
+} compactor;
+
+static int
+memtx_compact_class_cb(const struct mempool_stats *stats, void *cb_ctx)
+{
+	(void) cb_ctx;
+	struct memtx_compactor *c = &compactor;
+	if (c->class_count == c->class_capacity) {
+		uint32_t capacity = MAX(c->class_capacity * 2, 64);
+		struct memtx_compact_class *classes =
+			(struct memtx_compact_class *)
+			realloc(c->classes, capacity * sizeof(*classes));
+		if (classes == NULL)
+			return 1;
+		c->classes = classes;
+		c->class_capacity = capacity;
+	}
+	struct memtx_compact_class *cls = &c->classes[c->class_count++];
+	cls->objsize = stats->objsize;
+	cls->slab_size = stats->slabsize;
+	/*
+	 * A class is worth compacting if it has at least
+	 * a slab worth of free items.
+	 */
+	size_t free_size = stats->totals.total - stats->totals.used;
+	cls->is_sparse = free_size >= stats->slabsize &&
+			 stats->totals.used < c->threshold * stats->totals.total;
+	if (cls->is_sparse)
+		c->sparse_count++;
+	return 0;
+}
+
+static int
+memtx_compact_class_cmp(const void *a, const void *b)
+{
+	uint32_t objsize_a = ((const struct memtx_compact_class *) a)->objsize;
+	uint32_t objsize_b = ((const struct memtx_compact_class *) b)->objsize;
+	return objsize_a < objsize_b ? -1 : objsize_a > objsize_b;
+}
+
+/** Refresh the list of size classes and their usage. */
+static void
+memtx_compact_update_classes(void)
+{
+	struct memtx_compactor *c = &compactor;
+	c->class_count = 0;
+	c->sparse_count = 0;
+	struct small_stats totals;
+	small_stats(&memtx_alloc, &totals, memtx_compact_class_cb, NULL);
+	qsort(c->classes, c->class_count, sizeof(*c->classes),
+	      memtx_compact_class_cmp);
+}
+
+/**
+ * Find the size class of an item: classes don't overlap, so it
+ * is the one with the smallest item size that fits.
+ */
+static const struct memtx_compact_class *
+memtx_compact_find_class(size_t size)
+{
+	struct memtx_compactor *c = &compactor;
+	uint32_t begin = 0, end = c->class_count;
+	while (begin < end) {
+		uint32_t mid = begin + (end - begin) / 2;
+		if (c->classes[mid].objsize < size)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+	return begin < c->class_count ? &c->classes[begin] : NULL;
+}
+
+static bool
+memtx_compact_space_is_eligible(struct space *space)
+{
+	if (!space_is_memtx(space) || space_is_system(space) ||
+	    space_index(space, 0) == NULL)
+		return false;
+	/* Secondary keys are built after recovery. */
+	struct MemtxSpace *handler = (struct MemtxSpace *) space->handler;
+	if (handler->replace != memtx_replace_all_keys)
+		return false;
+	/*
+	 * Any change of a BITSET or RTREE index ends all its
+	 * open iterators, so moving a tuple would cut short an
+	 * iteration held across a yield. Leave such spaces be.
+	 */
+	for (uint32_t i = 0; i < space->index_count; i++) {
+		enum index_type type = space->index[i]->key_def->type;
+		if (type != TREE && type != HASH)
+			return false;
+	}
+	return true;
+}
+
+static void
+memtx_compact_next_space_cb(struct space *space, void *udata)
+{
+	struct space **next = (struct space **) udata;
+	if (space_id(space) < compactor.space_id ||
+	    !memtx_compact_space_is_eligible(space))
+		return;
+	if (*next == NULL || space_id(space) < space_id(*next))
+		*next = space;
+}
+
+/**
+ * Replace a tuple with its copy in all indexes of the space.
+ * Like memtx_replace_all_keys(), either all indexes are changed
+ * or none.
+ */
+static void
+memtx_compact_replace(struct space *space, struct tuple *old_tuple,
+		      struct tuple *new_tuple)
+{
+	memtx_index_extent_reserve(RESERVE_EXTENTS_BEFORE_REPLACE);
+	uint32_t i = 0;
+	try {
+		for (; i < space->index_count; i++) {
+			Index *index = space->index[i];
+			index->replace(old_tuple, new_tuple,
+				       i == 0 ? DUP_REPLACE : DUP_INSERT);
+		}
+	} catch (Exception *) {
+		for (; i > 0; i--) {
+			Index *index = space->index[i - 1];
+			index->replace(new_tuple, old_tuple, DUP_INSERT);
+		}
+		throw;
+	}
+}
+
+/** Move a tuple if it belongs to a sparse size class. */
+static void
+memtx_compact_tuple(struct space *space, struct tuple *tuple)
+{
+	/* The tuple is referenced by someone except the space. */
+	if (tuple->refs != 1)
+		return;
+	size_t size = memtx_tuple_size(tuple);
+	const struct memtx_compact_class *cls = memtx_compact_find_class(size);
+	if (cls == NULL || !cls->is_sparse)
+		return;
+	struct tuple *copy = memtx_tuple_relocate(tuple, cls->slab_size);
+	if (copy == NULL)
+		return;
+	tuple_ref(copy);
+	try {
+		memtx_compact_replace(space, tuple, copy);
+	} catch (Exception *) {
+		tuple_unref(copy);
+		throw;
+	}
+	tuple_unref(tuple);
+	memtx_compact_stat.moved++;
+	memtx_compact_stat.moved_size += size;
+}
+
+/**
+ * Examine up to @a limit tuples, starting from the position
+ * saved by the previous call. Doesn't yield.
+ * @return the number of tuples examined.
+ */
+static uint32_t
+memtx_compact_step(uint32_t limit)
+{
+	struct memtx_compactor *c = &compactor;
+	struct space *space = NULL;
+	space_foreach(memtx_compact_next_space_cb, &space);
+	if (space == NULL || space_id(space) != c->space_id) {
+		/* The space is dropped or done, go on to the next one. */
+		free(c->key);
+		c->key = NULL;
+		if (space == NULL) {
+			c->space_id = 0;
+			memtx_compact_stat.rounds++;
+			return 0;
+		}
+		c->space_id = space_id(space);
+	}
+
+	MemtxIndex *pk = (MemtxIndex *) space->index[0];
+	const char *key = c->key;
+	uint32_t part_count = key != NULL ? mp_decode_array(&key) : 0;
+	if (key != NULL && primary_key_validate(pk->key_def, key,
+						part_count) != 0) {
+		/* The space was recreated with another key. */
+		diag_clear(diag_get());
+		key = NULL;
+		part_count = 0;
+	}
+	struct tuple *batch[MEMTX_COMPACT_BATCH];
+	uint32_t count = 0;
+	struct iterator *it = pk->position();
+	pk->initIterator(it, key != NULL ? ITER_GT : ITER_ALL, key,
+			 part_count);
+	struct tuple *tuple;
+	limit = MIN(limit, (uint32_t) MEMTX_COMPACT_BATCH);
+	while (count < limit && (tuple = it->next(it)) != NULL)
+		batch[count++] = tuple;
+
+	if (count < limit) {
+		/* The space is done. */
+		free(c->key);
+		c->key = NULL;
+		c->space_id++;
+	} else {
+		uint32_t key_size;
+		const char *last = tuple_extract_key(batch[count - 1],
+						     pk->key_def, &key_size);
+		char *buf = (char *) realloc(c->key, key_size);
+		if (last == NULL || buf == NULL) {
+			free(buf != NULL ? buf : c->key);
+			c->key = NULL;
+			c->space_id++;
+			return count;
+		}
+		memcpy(buf, last, key_size);
+		c->key = buf;
+		c->key_size = key_size;
+	}
+	/* The tuples are not moved until the iterator is done. */
+	for (uint32_t i = 0; i < count; i++)
+		memtx_compact_tuple(space, batch[i]);
+	memtx_compact_stat.examined += count;
+	return count;
+}
+
+static int
+memtx_compact_f(va_list ap)
+{
+	(void) ap;
+	struct memtx_compactor *c = &compactor;
+	struct region *region = &fiber()->gc;
+	while (!fiber_is_cancelled()) {
+		if (c->rate == 0) {
+			fiber_yield();
+			continue;
+		}
+		if (!c->engine->canRelocateTuples()) {
+			fiber_sleep(MEMTX_COMPACT_RETRY_DELAY);
+			continue;
+		}
+		memtx_compact_update_classes();
+		if (c->sparse_count == 0) {
+			fiber_sleep(MEMTX_COMPACT_IDLE_DELAY);
+			continue;
+		}
+		uint32_t limit = MAX(c->rate * MEMTX_COMPACT_RETRY_DELAY, 1.);
+		uint64_t rounds = memtx_compact_stat.rounds;
+		uint32_t count;
+		try {
+			count = memtx_compact_step(limit);
+		} catch (Exception *e) {
+			/* Out of memory, try again later. */
+			e->log();
+			count = limit;
+		}
+		region_free(region);
+		if (memtx_compact_stat.rounds != rounds)
+			fiber_sleep(MEMTX_COMPACT_IDLE_DELAY);
+		else
+			fiber_sleep(count / c->rate);
+	}
+	return 0;
+}
+
+void
+memtx_compact_cfg(MemtxEngine *engine, double rate, double threshold)
+{
+	struct memtx_compactor *c = &compactor;
+	c->engine = engine;
+	c->rate = rate;
+	c->threshold = threshold;
+	if (c->fiber == NULL && rate > 0) {
+		c->fiber = fiber_new_xc("memtx.compact", memtx_compact_f);
+		fiber_start(c->fiber);
+	} else if (c->fiber != NULL) {
+		/* Apply the new rate right away. */
+		fiber_wakeup(c->fiber);
+	}
+}
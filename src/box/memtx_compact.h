@@ -0,0 +1,87 @@
+#ifndef TARANTOOL_BOX_MEMTX_COMPACT_H_INCLUDED
+#define TARANTOOL_BOX_MEMTX_COMPACT_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * Background compaction of the memtx tuple arena.
+ *
+ * After massive deletes most slabs of a size class may be only
+ * sparsely used, but a single tuple is enough to keep a slab
+ * from being returned to the arena. The compactor walks the
+ * primary keys of memtx spaces in small batches and copies the
+ * tuples of such size classes to a new place. A mempool hands
+ * out items of the slab with the lowest address first, so a
+ * tuple is only moved if its copy lands in a slab with a lower
+ * address. This way tuples flow to the beginning of the arena
+ * and the slabs at its end become empty and are freed.
+ *
+ * A tuple referenced by anyone but its space, e.g. from Lua,
+ * is never moved. Nothing is moved while a transaction or a
+ * checkpoint is in progress, nor in spaces with a BITSET or
+ * RTREE index.
+ */
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+struct memtx_compact_stat {
+	/** Number of complete passes over all spaces. */
+	uint64_t rounds;
+	/** Number of tuples examined. */
+	uint64_t examined;
+	/** Number of tuples moved. */
+	uint64_t moved;
+	/** Total size of the moved tuples. */
+	uint64_t moved_size;
+};
+
+extern struct memtx_compact_stat memtx_compact_stat;
+
+#if defined(__cplusplus)
+} /* extern "C" */
+
+struct MemtxEngine;
+
+/**
+ * Configure the compactor. @a rate is the max number of tuples
+ * examined per second, 0 to disable compaction. Size classes
+ * with items_used_ratio below @a threshold are compacted. The
+ * compactor fiber is started on the first call with a non-zero
+ * rate.
+ */
+void
+memtx_compact_cfg(MemtxEngine *engine, double rate, double threshold);
+
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_BOX_MEMTX_COMPACT_H_INCLUDED */
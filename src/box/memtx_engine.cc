@@ -31,9 +31,14 @@
 #include "memtx_engine.h"
 #include "memtx_space.h"
 #include "memtx_tuple.h"
+#include "memtx_build.h"
+#include "memtx_tx.h"
 
 #include "coeio_file.h"
 #include "scoped_guard.h"
+#include "tt_pthread.h"
+#include "cbus.h"
+#include "ipc.h"
 
 #include "tuple.h"
 #include "txn.h"
@@ -41,9 +46,11 @@
 #include "iproto_constants.h"
 #include "xrow.h"
 #include "xstream.h"
+#include "recovery.h"
 #include "bootstrap.h"
 #include "cluster.h"
 #include "schema.h"
+#include "errinj.h"
 
 /** For all memory used by all indexes.
  * If you decide to use memtx_index_arena or
@@ -84,51 +91,77 @@ memtx_end_build_primary_key(struct space *space, void *param)
 	handler->replace = memtx_replace_primary_key;
 }
 
-/**
- * Secondary indexes are built in bulk after all data is
- * recovered. This function enables secondary keys on a space.
- * Data dictionary spaces are an exception, they are fully
- * built right from the start.
- */
-void
-memtx_build_secondary_keys(struct space *space, void *param)
+static bool
+memtx_space_needs_secondary_keys(struct space *space)
 {
 	struct MemtxSpace *handler = (struct MemtxSpace *) space->handler;
-	if (handler->engine != param || space_index(space, 0) == NULL ||
-	    handler->replace == memtx_replace_all_keys)
+	return space_is_memtx(space) && space_index(space, 0) != NULL &&
+	       handler->replace != memtx_replace_all_keys;
+}
+
+static void
+memtx_add_secondary_keys(struct space *space, void *param)
+{
+	struct memtx_builder *builder = (struct memtx_builder *) param;
+	if (!memtx_space_needs_secondary_keys(space))
 		return;
 
 	if (space->index_id_max > 0) {
 		MemtxIndex *pk = (MemtxIndex *) space->index[0];
-		uint32_t n_tuples = pk->size();
-
-		if (n_tuples > 0) {
+		if (pk->size() > 0) {
 			say_info("Building secondary indexes in space '%s'...",
 				 space_name(space));
 		}
-
-		for (uint32_t j = 1; j < space->index_count; j++)
-			index_build((MemtxIndex *) space->index[j], pk);
-
-		if (n_tuples > 0) {
-			say_info("Space '%s': done", space_name(space));
-		}
+		memtx_builder_add_space(builder, space);
 	}
+}
+
+static void
+memtx_enable_secondary_keys(struct space *space, void * /* param */)
+{
+	struct MemtxSpace *handler = (struct MemtxSpace *) space->handler;
+	if (!memtx_space_needs_secondary_keys(space))
+		return;
 	handler->replace = memtx_replace_all_keys;
 }
 
+/**
+ * Secondary indexes are built in bulk after all data is
+ * recovered. This function builds secondary keys of all
+ * spaces at once, using several threads, and enables them.
+ * Data dictionary spaces are an exception, they are fully
+ * built right from the start.
+ */
+static void
+memtx_build_secondary_keys()
+{
+	struct memtx_builder builder;
+	memtx_builder_create(&builder);
+	auto guard = make_scoped_guard([&]{
+		memtx_builder_destroy(&builder);
+	});
+	space_foreach(memtx_add_secondary_keys, &builder);
+	memtx_builder_run(&builder);
+	space_foreach(memtx_enable_secondary_keys, NULL);
+}
+
 MemtxEngine::MemtxEngine(const char *snap_dirname, bool panic_on_snap_error,
 			 bool panic_on_wal_error,
 			 float tuple_arena_max_size, uint32_t objsize_min,
-			 uint32_t objsize_max, float alloc_factor)
+			 uint32_t objsize_max, float alloc_factor,
+			 bool huge_pages, const char *numa,
+			 bool use_mvcc_engine)
 	:Engine("memtx", &memtx_tuple_format_vtab),
 	m_checkpoint(0),
 	m_state(MEMTX_INITIALIZED),
 	m_snap_io_rate_limit(0),
-	m_panic_on_wal_error(panic_on_wal_error)
+	m_snap_threads(1),
+	m_panic_on_wal_error(panic_on_wal_error),
+	m_txn_count(0)
 {
 	memtx_tuple_init(tuple_arena_max_size, objsize_min, objsize_max,
-			 alloc_factor);
+			 alloc_factor, huge_pages, numa);
+	memtx_tx_manager_init(this, use_mvcc_engine);
 
 	flags = ENGINE_CAN_BE_TEMPORARY;
 	xdir_create(&m_snap_dir, snap_dirname, SNAP, &SERVER_UUID);
@@ -148,9 +181,17 @@ MemtxEngine::~MemtxEngine()
 {
 	xdir_destroy(&m_snap_dir);
 
+	memtx_tx_manager_free();
 	memtx_tuple_free();
 }
 
+bool
+MemtxEngine::canRelocateTuples() const
+{
+	return m_state == MEMTX_OK && m_checkpoint == NULL &&
+	       m_txn_count == 0 && !memtx_tx_manager_use_mvcc_engine;
+}
+
 int64_t
 MemtxEngine::lastCheckpoint(struct vclock *vclock)
 {
@@ -162,6 +203,327 @@ MemtxEngine::lastCheckpoint(struct vclock *vclock)
 	return vclock->signature;
 }
 
+enum {
+	/** Max number of rows in a snapshot recovery batch. */
+	SNAP_BATCH_ROWS_MAX = 1024,
+	/** Max size of row bodies in a snapshot recovery batch. */
+	SNAP_BATCH_SIZE_MAX = 512 * 1024,
+	/** Number of batches in flight between the reader and tx. */
+	SNAP_BATCH_COUNT = 4,
+};
+
+/**
+ * Snapshot rows read, decompressed and decoded to requests by
+ * the snapshot reader thread, to be applied by the tx thread.
+ */
+struct snap_batch {
+	/** Delivers the batch to the tx thread. */
+	struct cmsg base;
+	struct snap_reader *reader;
+	/** Link in snap_reader::free or snap_reader::ready. */
+	struct stailq_entry in_list;
+	uint32_t row_count;
+	struct xrow_header rows[SNAP_BATCH_ROWS_MAX];
+	struct request requests[SNAP_BATCH_ROWS_MAX];
+	/** Copies of the row bodies, the requests point here. */
+	char *data;
+	size_t data_size;
+	size_t data_capacity;
+};
+
+/**
+ * Reads the snapshot file in a separate thread, so that disk
+ * reads, decompression and decoding of rows overlap with
+ * building of the primary keys in the tx thread. Decoded rows
+ * are passed to the tx thread in batches over cbus, applied
+ * batches are returned to the reader via the free list.
+ */
+struct snap_reader {
+	struct cord cord;
+	const char *filename;
+	bool panic_if_error;
+	/** Set by the reader before the first message to tx. */
+	struct tt_uuid server_uuid;
+	/** Set by the reader if the file has an EOF marker. */
+	bool is_eof;
+	/** Reader status and the error if it failed. */
+	int status;
+	struct diag diag;
+	/** Pipe from the reader thread to tx. */
+	struct cpipe tx_pipe;
+	/** Tells tx the reader is done, sent after all batches. */
+	struct cmsg done;
+	struct snap_batch *batches;
+	/** Batches the reader can fill, protected by mutex. */
+	struct stailq free;
+	/** Set by tx to stop the reader, protected by mutex. */
+	bool is_cancelled;
+	pthread_mutex_t mutex;
+	/** Signaled when a batch is freed or the reader is cancelled. */
+	pthread_cond_t cond;
+	/** Batches received by tx, but not applied yet. */
+	struct stailq ready;
+	/** Set in tx when the done message is received. */
+	bool is_done;
+	/** Signaled when a message from the reader is received. */
+	struct ipc_cond ready_cond;
+};
+
+static void
+snap_batch_deliver(struct cmsg *m)
+{
+	struct snap_batch *batch = (struct snap_batch *) m;
+	struct snap_reader *reader = batch->reader;
+	stailq_add_tail_entry(&reader->ready, batch, in_list);
+	ipc_cond_signal(&reader->ready_cond);
+}
+
+static void
+snap_reader_deliver_done(struct cmsg *m)
+{
+	struct snap_reader *reader = container_of(m, struct snap_reader, done);
+	reader->is_done = true;
+	ipc_cond_signal(&reader->ready_cond);
+}
+
+/**
+ * Wait for a batch to fill. Returns NULL if the reader was
+ * cancelled. Called from the reader thread.
+ */
+static struct snap_batch *
+snap_reader_get_batch(struct snap_reader *reader)
+{
+	struct snap_batch *batch = NULL;
+	tt_pthread_mutex_lock(&reader->mutex);
+	while (!reader->is_cancelled && stailq_empty(&reader->free))
+		tt_pthread_cond_wait(&reader->cond, &reader->mutex);
+	if (!reader->is_cancelled) {
+		batch = stailq_shift_entry(&reader->free, struct snap_batch,
+					   in_list);
+	}
+	tt_pthread_mutex_unlock(&reader->mutex);
+	return batch;
+}
+
+/** Return an applied batch to the reader. Called from tx. */
+static void
+snap_reader_put_batch(struct snap_reader *reader, struct snap_batch *batch)
+{
+	batch->row_count = 0;
+	batch->data_size = 0;
+	tt_pthread_mutex_lock(&reader->mutex);
+	stailq_add_tail_entry(&reader->free, batch, in_list);
+	tt_pthread_cond_signal(&reader->cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+}
+
+static void
+snap_reader_send_batch(struct snap_reader *reader, struct snap_batch *batch)
+{
+	static const struct cmsg_hop route[] = {
+		{ snap_batch_deliver, NULL },
+	};
+	cmsg_init(&batch->base, route);
+	cpipe_push(&reader->tx_pipe, &batch->base);
+}
+
+/**
+ * Copy a row to the batch and decode it to a request.
+ *
+ * @retval  0 success
+ * @retval  1 the batch is full, the row wasn't added
+ * @retval -1 the row can't be decoded, check diag
+ */
+static int
+snap_batch_add_row(struct snap_batch *batch, struct xrow_header *row)
+{
+	assert(row->bodycnt == 1); /* always 1 for read */
+	size_t size = row->body[0].iov_len;
+	if (batch->row_count == SNAP_BATCH_ROWS_MAX ||
+	    (batch->row_count > 0 &&
+	     batch->data_size + size > batch->data_capacity))
+		return 1;
+	if (row->type != IPROTO_INSERT) {
+		tnt_error(ClientError, ER_UNKNOWN_REQUEST_TYPE,
+			  (uint32_t) row->type);
+		return -1;
+	}
+	if (size > batch->data_capacity) {
+		/* A row larger than a batch goes alone. */
+		assert(batch->data_size == 0);
+		size_t capacity = MAX(size, (size_t) SNAP_BATCH_SIZE_MAX);
+		char *data = (char *) realloc(batch->data, capacity);
+		if (data == NULL) {
+			tnt_error(OutOfMemory, capacity, "realloc",
+				  "snapshot batch");
+			return -1;
+		}
+		batch->data = data;
+		batch->data_capacity = capacity;
+	}
+	char *body = batch->data + batch->data_size;
+	memcpy(body, row->body[0].iov_base, size);
+	struct xrow_header *copy = &batch->rows[batch->row_count];
+	*copy = *row;
+	copy->body[0].iov_base = body;
+	struct request *request = &batch->requests[batch->row_count];
+	request_create(request, row->type);
+	if (request_decode(request, body, size) != 0)
+		return -1;
+	request->header = copy;
+	batch->data_size += size;
+	batch->row_count++;
+	return 0;
+}
+
+/**
+ * Read the snapshot rows and send them to tx in batches.
+ * Returns on EOF, error or when cancelled.
+ */
+static int
+snap_reader_read(struct snap_reader *reader, struct xlog_cursor *cursor)
+{
+	struct snap_batch *batch = NULL;
+	struct xrow_header row;
+	/* Set if the row was read but not added to a batch yet. */
+	bool has_row = false;
+	int rc = 0;
+	while (true) {
+		if (!has_row) {
+			rc = xlog_cursor_next(cursor, &row,
+					      reader->panic_if_error);
+			if (rc != 0)
+				break;
+			has_row = true;
+		}
+		if (batch == NULL) {
+			batch = snap_reader_get_batch(reader);
+			if (batch == NULL)
+				return 0; /* cancelled */
+		}
+		rc = snap_batch_add_row(batch, &row);
+		if (rc > 0) {
+			snap_reader_send_batch(reader, batch);
+			batch = NULL;
+			continue;
+		}
+		has_row = false;
+		if (rc < 0) {
+			if (reader->panic_if_error)
+				break;
+			say_error("can't apply row: ");
+			error_log(diag_last_error(diag_get()));
+			diag_clear(diag_get());
+		}
+	}
+	/* Rows read before an error are applied anyway. */
+	if (batch != NULL && batch->row_count > 0)
+		snap_reader_send_batch(reader, batch);
+	else if (batch != NULL)
+		snap_reader_put_batch(reader, batch);
+	return rc < 0 ? -1 : 0;
+}
+
+static int
+snap_reader_f(va_list ap)
+{
+	struct snap_reader *reader = va_arg(ap, struct snap_reader *);
+	cpipe_create(&reader->tx_pipe, "tx");
+	/*
+	 * The reader doesn't yield to the event loop,
+	 * so deliver every message as soon as it's pushed.
+	 */
+	cpipe_set_max_input(&reader->tx_pipe, 1);
+
+	struct xlog_cursor cursor;
+	reader->status = xlog_cursor_open(&cursor, reader->filename);
+	if (reader->status == 0) {
+		reader->server_uuid = cursor.meta.server_uuid;
+		reader->status = snap_reader_read(reader, &cursor);
+		reader->is_eof = cursor.state == XLOG_CURSOR_EOF;
+		xlog_cursor_close(&cursor, false);
+	}
+	if (reader->status != 0)
+		diag_move(diag_get(), &reader->diag);
+
+	static const struct cmsg_hop route[] = {
+		{ snap_reader_deliver_done, NULL },
+	};
+	cmsg_init(&reader->done, route);
+	cpipe_push(&reader->tx_pipe, &reader->done);
+	return 0;
+}
+
+static void
+snap_reader_start(struct snap_reader *reader, const char *filename,
+		  bool panic_if_error)
+{
+	reader->batches = (struct snap_batch *)
+		calloc(SNAP_BATCH_COUNT, sizeof(struct snap_batch));
+	if (reader->batches == NULL) {
+		tnt_raise(OutOfMemory, SNAP_BATCH_COUNT *
+			  sizeof(struct snap_batch), "calloc",
+			  "snapshot batches");
+	}
+	reader->filename = filename;
+	reader->panic_if_error = panic_if_error;
+	reader->is_eof = false;
+	reader->status = 0;
+	diag_create(&reader->diag);
+	stailq_create(&reader->free);
+	stailq_create(&reader->ready);
+	for (int i = 0; i < SNAP_BATCH_COUNT; i++) {
+		struct snap_batch *batch = &reader->batches[i];
+		batch->reader = reader;
+		stailq_add_tail_entry(&reader->free, batch, in_list);
+	}
+	reader->is_cancelled = false;
+	reader->is_done = false;
+	tt_pthread_mutex_init(&reader->mutex, NULL);
+	tt_pthread_cond_init(&reader->cond, NULL);
+	ipc_cond_create(&reader->ready_cond);
+	if (cord_costart(&reader->cord, "snapshot.reader",
+			 snap_reader_f, reader) != 0)
+		panic("failed to start snapshot reader thread");
+}
+
+/**
+ * Wait for the next batch read from the snapshot.
+ * Returns NULL when the reader is done.
+ */
+static struct snap_batch *
+snap_reader_next_batch(struct snap_reader *reader)
+{
+	while (stailq_empty(&reader->ready)) {
+		if (reader->is_done)
+			return NULL;
+		ipc_cond_wait(&reader->ready_cond);
+	}
+	return stailq_shift_entry(&reader->ready, struct snap_batch, in_list);
+}
+
+static void
+snap_reader_stop(struct snap_reader *reader)
+{
+	tt_pthread_mutex_lock(&reader->mutex);
+	reader->is_cancelled = true;
+	tt_pthread_cond_signal(&reader->cond);
+	tt_pthread_mutex_unlock(&reader->mutex);
+	/* Drain the pipe: the reader memory must outlive messages. */
+	struct snap_batch *batch;
+	while ((batch = snap_reader_next_batch(reader)) != NULL)
+		snap_reader_put_batch(reader, batch);
+	cord_join(&reader->cord);
+
+	ipc_cond_destroy(&reader->ready_cond);
+	tt_pthread_cond_destroy(&reader->cond);
+	tt_pthread_mutex_destroy(&reader->mutex);
+	diag_destroy(&reader->diag);
+	for (int i = 0; i < SNAP_BATCH_COUNT; i++)
+		free(reader->batches[i].data);
+	free(reader->batches);
+}
+
 void
 MemtxEngine::recoverSnapshot()
 {
@@ -176,37 +538,43 @@ MemtxEngine::recoverSnapshot()
 						    NONE);
 
 	say_info("recovering from `%s'", filename);
-	struct xlog_cursor cursor;
-	xlog_cursor_open_xc(&cursor, filename);
-	SERVER_UUID = cursor.meta.server_uuid;
+	struct snap_reader reader;
+	snap_reader_start(&reader, filename, m_snap_dir.panic_if_error);
 	auto reader_guard = make_scoped_guard([&]{
-		xlog_cursor_close(&cursor, false);
+		snap_reader_stop(&reader);
 	});
 
-	struct xrow_header row;
-	uint64_t row_count = 0;
-	while (xlog_cursor_next_xc(&cursor, &row,
-				   m_snap_dir.panic_if_error) == 0) {
-		try {
-			recoverSnapshotRow(&row);
-		} catch (ClientError *e) {
-			if (m_snap_dir.panic_if_error)
-				throw;
-			say_error("can't apply row: ");
-			e->log();
+	struct recovery_progress progress;
+	recovery_progress_create(&progress);
+	struct snap_batch *batch;
+	while ((batch = snap_reader_next_batch(&reader)) != NULL) {
+		/* Set by the reader before sending anything. */
+		SERVER_UUID = reader.server_uuid;
+		for (uint32_t i = 0; i < batch->row_count; i++) {
+			try {
+				recoverSnapshotRequest(&batch->requests[i]);
+			} catch (ClientError *e) {
+				if (m_snap_dir.panic_if_error)
+					throw;
+				say_error("can't apply row: ");
+				e->log();
+			}
+			recovery_progress_add_row(&progress);
 		}
-		++row_count;
-		if (row_count % 100000 == 0)
-			say_info("%.1fM rows processed",
-				 row_count / 1000000.);
+		snap_reader_put_batch(&reader, batch);
+	}
+	if (reader.status != 0) {
+		diag_move(&reader.diag, diag_get());
+		diag_raise();
 	}
+	SERVER_UUID = reader.server_uuid;
 
 	/**
 	 * We should never try to read snapshots with no EOF
 	 * marker - such snapshots are very likely corrupted and
 	 * should not be trusted.
 	 */
-	if (cursor.state != XLOG_CURSOR_EOF)
+	if (!reader.is_eof)
 		panic("snapshot `%s' has no EOF marker", filename);
 
 }
@@ -221,6 +589,12 @@ MemtxEngine::recoverSnapshotRow(struct xrow_header *row)
 	}
 
 	struct request *request = xrow_decode_request(row);
+	recoverSnapshotRequest(request);
+}
+
+void
+MemtxEngine::recoverSnapshotRequest(struct request *request)
+{
 	struct space *space = space_cache_find(request->space_id);
 	/* memtx snapshot must contain only memtx spaces */
 	if (space->handler->engine != this)
@@ -281,7 +655,7 @@ MemtxEngine::beginFinalRecovery()
 		 * unique keys.
 		 */
 		m_state = MEMTX_OK;
-		space_foreach(memtx_build_secondary_keys, this);
+		memtx_build_secondary_keys();
 	}
 }
 
@@ -297,7 +671,7 @@ MemtxEngine::endRecovery()
 	if (m_state != MEMTX_OK) {
 		assert(m_state == MEMTX_FINAL_RECOVERY);
 		m_state = MEMTX_OK;
-		space_foreach(memtx_build_secondary_keys, this);
+		memtx_build_secondary_keys();
 	}
 }
 
@@ -388,7 +762,17 @@ MemtxEngine::buildSecondaryKey(struct space *old_space,
 	 * new index' constraints. If any tuple can not be
 	 * added to the index (insufficient number of fields,
 	 * etc., the build is aborted.
+	 *
+	 * An RTREE index has no uniqueness constraint to check,
+	 * so it is bulk loaded, which is much faster and gives
+	 * a better tree than inserting tuples one by one.
 	 */
+	MemtxIndex *index = (MemtxIndex *) new_index;
+	bool bulk = new_key_def->type == RTREE;
+	if (bulk) {
+		index->beginBuild();
+		index->reserve(pk->size());
+	}
 	/* Build the new index. */
 	struct tuple *tuple;
 	struct tuple_format *format = new_space->format;
@@ -399,6 +783,23 @@ MemtxEngine::buildSecondaryKey(struct space *old_space,
 		 */
 		if (tuple_validate(format, tuple))
 			diag_raise();
+		/*
+		 * Indexes read the fields of a compressed tuple
+		 * right from its data, so they may only use the
+		 * fields which were indexed when the tuple was
+		 * compressed.
+		 */
+		if (tuple->is_compressed &&
+		    tuple_format(tuple)->field_count < format->field_count) {
+			tnt_raise(ClientError, ER_ALTER_SPACE,
+				  space_name(new_space),
+				  "can not index a field of compressed tuples "
+				  "which was not indexed before");
+		}
+		if (bulk) {
+			index->buildNext(tuple);
+			continue;
+		}
 		/*
 		 * @todo: better message if there is a duplicate.
 		 */
@@ -407,6 +808,8 @@ MemtxEngine::buildSecondaryKey(struct space *old_space,
 		assert(old_tuple == NULL); /* Guaranteed by DUP_INSERT. */
 		(void) old_tuple;
 	}
+	if (bulk)
+		index->endBuild();
 }
 
 void
@@ -488,6 +891,8 @@ MemtxEngine::keydefCheck(struct space *space, struct key_def *key_def)
 void
 MemtxEngine::prepare(struct txn *txn)
 {
+	if (memtx_tx_manager_use_mvcc_engine)
+		memtx_tx_prepare(txn);
 	if (txn->is_autocommit)
 		return;
 	/*
@@ -502,6 +907,7 @@ MemtxEngine::prepare(struct txn *txn)
 void
 MemtxEngine::begin(struct txn *txn)
 {
+	m_txn_count++;
 	/*
 	 * Register a trigger to rollback transaction on yield.
 	 * This must be done in begin(), since it's
@@ -516,19 +922,25 @@ MemtxEngine::begin(struct txn *txn)
 				NULL, NULL);
 		/*
 		 * Memtx doesn't allow yields between statements of
-		 * a transaction. Set a trigger which would roll
-		 * back the transaction if there is a yield.
+		 * a transaction unless the transaction manager is
+		 * on. Set a trigger which would roll back the
+		 * transaction if there is a yield.
 		 */
-		trigger_add(&fiber()->on_yield, &txn->fiber_on_yield);
+		if (!memtx_tx_manager_use_mvcc_engine)
+			trigger_add(&fiber()->on_yield, &txn->fiber_on_yield);
 		trigger_add(&fiber()->on_stop, &txn->fiber_on_stop);
 	}
+	if (memtx_tx_manager_use_mvcc_engine)
+		memtx_tx_begin(txn);
 }
 
 void
-MemtxEngine::rollbackStatement(struct txn *, struct txn_stmt *stmt)
+MemtxEngine::rollbackStatement(struct txn *txn, struct txn_stmt *stmt)
 {
 	if (stmt->old_tuple == NULL && stmt->new_tuple == NULL)
 		return;
+	if (memtx_tx_stmt_is_tracked(txn, stmt))
+		return memtx_tx_rollback_stmt(stmt);
 	struct space *space = stmt->space;
 	int index_count;
 	struct MemtxSpace *handler = (struct MemtxSpace *) space->handler;
@@ -557,11 +969,17 @@ MemtxEngine::rollbackStatement(struct txn *, struct txn_stmt *stmt)
 void
 MemtxEngine::rollback(struct txn *txn)
 {
-	prepare(txn);
+	if (!txn->is_autocommit) {
+		trigger_clear(&txn->fiber_on_yield);
+		trigger_clear(&txn->fiber_on_stop);
+	}
 	struct txn_stmt *stmt;
 	stailq_reverse(&txn->stmts);
 	stailq_foreach_entry(stmt, &txn->stmts, next)
 		rollbackStatement(txn, stmt);
+	memtx_tx_end(txn);
+	assert(m_txn_count > 0);
+	m_txn_count--;
 }
 
 void
@@ -573,6 +991,8 @@ MemtxEngine::commit(struct txn *txn, int64_t signature)
 		if (stmt->old_tuple)
 			tuple_unref(stmt->old_tuple);
 	}
+	assert(m_txn_count > 0);
+	m_txn_count--;
 }
 
 void
@@ -600,60 +1020,56 @@ MemtxEngine::bootstrap()
 		recoverSnapshotRow(&row);
 }
 
-static void
-checkpoint_write_row(struct xlog *l, struct xrow_header *row)
-{
-	static ev_tstamp last = 0;
-	if (last == 0) {
-		ev_now_update(loop());
-		last = ev_now(loop());
-	}
+enum {
+	/** Max number of tuples in a snapshot chunk. */
+	CHECKPOINT_CHUNK_TUPLES_MAX = 4096,
+	/** Max size of tuple data in a snapshot chunk. */
+	CHECKPOINT_CHUNK_SIZE_MAX = 128 * 1024,
+	/** Number of chunks in flight per snapshot worker. */
+	CHECKPOINT_CHUNKS_PER_WORKER = 2,
+};
 
-	row->tm = last;
-	row->server_id = 0;
+enum checkpoint_chunk_state {
+	/** The chunk is free or being filled by the snapshot thread. */
+	CHECKPOINT_CHUNK_FREE,
+	/** The chunk is waiting for a worker to encode it. */
+	CHECKPOINT_CHUNK_SUBMITTED,
+	/** The chunk is encoded and can be written to the file. */
+	CHECKPOINT_CHUNK_DONE,
+};
+
+/**
+ * A run of consecutive tuples of a space, encoded to snapshot
+ * rows and compressed by a worker thread, then written to the
+ * snapshot file by the snapshot thread as a single xlog tx.
+ */
+struct checkpoint_chunk {
+	enum checkpoint_chunk_state state;
+	/** Ordinal number of the chunk in the snapshot file. */
+	int64_t seq;
+	uint32_t space_id;
+	/** LSN of the first row of the chunk. */
+	int64_t lsn;
+	/** Size of tuple data in the chunk. */
+	size_t size;
+	uint32_t tuple_count;
+	struct tuple *tuples[CHECKPOINT_CHUNK_TUPLES_MAX];
 	/**
-	 * Rows in snapshot are numbered from 1 to %rows.
-	 * This makes streaming such rows to a replica or
-	 * to recovery look similar to streaming a normal
-	 * WAL. @sa the place which skips old rows in
-	 * recovery_apply_row().
+	 * Encoded rows. Allocated on the slab cache of the
+	 * worker thread which the chunk is assigned to.
 	 */
-	row->lsn = ++l->rows;
-	row->sync = 0; /* don't write sync to wal */
-
-	ssize_t written = xlog_write_row(l, row);
-	fiber_gc();
-	if (written < 0) {
-		diag_raise();
-	}
-
-	if (l->rows % 100000 == 0)
-		say_crit("%.1fM rows written", l->rows / 1000000.);
-
-}
-
-static void
-checkpoint_write_tuple(struct xlog *l, uint32_t n, struct tuple *tuple)
-{
-	struct request_replace_body body;
-	body.m_body = 0x82; /* map of two elements. */
-	body.k_space_id = IPROTO_SPACE_ID;
-	body.m_space_id = 0xce; /* uint32 */
-	body.v_space_id = mp_bswap_u32(n);
-	body.k_tuple = IPROTO_TUPLE;
-
-	struct xrow_header row;
-	memset(&row, 0, sizeof(struct xrow_header));
-	row.type = IPROTO_INSERT;
+	struct xlog_block block;
+	/** Encoding status and the error if it failed. */
+	int status;
+	struct diag diag;
+};
 
-	row.bodycnt = 2;
-	row.body[0].iov_base = &body;
-	row.body[0].iov_len = sizeof(body);
-	uint32_t bsize;
-	row.body[1].iov_base = (char *) tuple_data_range(tuple, &bsize);
-	row.body[1].iov_len = bsize;
-	checkpoint_write_row(l, &row);
-}
+struct checkpoint_worker {
+	struct cord cord;
+	struct checkpoint *ckpt;
+	/** Chunks i with i % snap_threads == id go to this worker. */
+	int id;
+};
 
 struct checkpoint_entry {
 	struct space *space;
@@ -667,22 +1083,55 @@ struct checkpoint {
 	 * read view iterators.
 	 */
 	struct rlist entries;
+	/** Committed versions of uncommitted tuples in the read views. */
+	struct memtx_tx_snapshot_cleaner cleaner;
 	uint64_t snap_io_rate_limit;
 	struct cord cord;
 	bool waiting_for_snap_thread;
 	/** The vclock of the snapshot file. */
 	struct vclock vclock;
 	struct xdir dir;
+	/** Timestamp of all snapshot rows. */
+	ev_tstamp tm;
+	/** Number of threads encoding and compressing rows. */
+	int snap_threads;
+	struct checkpoint_worker *workers;
+	/** Number of worker threads started so far. */
+	int worker_count;
+	bool is_worker_pool_running;
+	/**
+	 * A ring of chunks in flight. The chunk with ordinal
+	 * number seq is stored at chunks[seq % chunk_count].
+	 */
+	struct checkpoint_chunk *chunks;
+	int chunk_count;
+	/** Ordinal number of the next chunk to fill. */
+	int64_t fill_seq;
+	/** Ordinal number of the next chunk to write. */
+	int64_t write_seq;
+	/** Protects chunk states and is_worker_pool_running. */
+	pthread_mutex_t mutex;
+	/** Signaled when a chunk is submitted to workers. */
+	pthread_cond_t worker_cond;
+	/** Signaled when a worker is done with a chunk. */
+	pthread_cond_t writer_cond;
 };
 
 static void
 checkpoint_init(struct checkpoint *ckpt, const char *snap_dirname,
-		uint64_t snap_io_rate_limit)
+		uint64_t snap_io_rate_limit, int snap_threads)
 {
 	ckpt->entries = RLIST_HEAD_INITIALIZER(ckpt->entries);
+	ckpt->cleaner.hash = NULL;
 	ckpt->waiting_for_snap_thread = false;
 	xdir_create(&ckpt->dir, snap_dirname, SNAP, &SERVER_UUID);
 	ckpt->snap_io_rate_limit = snap_io_rate_limit;
+	ckpt->snap_threads = snap_threads;
+	ckpt->workers = NULL;
+	ckpt->worker_count = 0;
+	ckpt->is_worker_pool_running = false;
+	ckpt->chunks = NULL;
+	ckpt->chunk_count = 0;
 	/* May be used in abortCheckpoint() */
 	vclock_create(&ckpt->vclock);
 }
@@ -697,6 +1146,7 @@ checkpoint_destroy(struct checkpoint *ckpt)
 		entry->iterator->free(entry->iterator);
 	}
 	ckpt->entries = RLIST_HEAD_INITIALIZER(ckpt->entries);
+	memtx_tx_snapshot_cleaner_destroy(&ckpt->cleaner);
 	xdir_destroy(&ckpt->dir);
 }
 
@@ -723,6 +1173,275 @@ checkpoint_add_space(struct space *sp, void *data)
 	pk->createReadViewForIterator(entry->iterator);
 };
 
+/**
+ * Encode tuples of a chunk to snapshot rows and compress them.
+ * Called from a worker thread.
+ */
+static int
+checkpoint_chunk_encode(struct checkpoint *ckpt,
+			struct checkpoint_chunk *chunk)
+{
+	if (chunk->block.zctx == NULL &&
+	    xlog_block_create(&chunk->block) != 0)
+		return -1;
+	xlog_block_reset(&chunk->block);
+
+	struct request_replace_body body;
+	body.m_body = 0x82; /* map of two elements. */
+	body.k_space_id = IPROTO_SPACE_ID;
+	body.m_space_id = 0xce; /* uint32 */
+	body.v_space_id = mp_bswap_u32(chunk->space_id);
+	body.k_tuple = IPROTO_TUPLE;
+
+	struct xrow_header row;
+	memset(&row, 0, sizeof(struct xrow_header));
+	row.type = IPROTO_INSERT;
+	row.tm = ckpt->tm;
+	row.server_id = 0;
+	row.sync = 0; /* don't write sync to wal */
+
+	row.bodycnt = 2;
+	row.body[0].iov_base = &body;
+	row.body[0].iov_len = sizeof(body);
+	for (uint32_t i = 0; i < chunk->tuple_count; i++) {
+		struct tuple *tuple = chunk->tuples[i];
+		uint32_t bsize = tuple->bsize;
+		const char *data = tuple_data(tuple);
+		/*
+		 * Don't use tuple_data_range(): its buffer of
+		 * decompressed tuples belongs to the tx thread.
+		 */
+		if (tuple->is_compressed) {
+			data = tuple_decompress(tuple, &fiber()->gc, &bsize);
+			if (data == NULL)
+				return -1;
+		}
+		row.lsn = chunk->lsn + i;
+		row.body[1].iov_base = (char *) data;
+		row.body[1].iov_len = bsize;
+		ssize_t written = xlog_block_write_row(&chunk->block, &row);
+		fiber_gc();
+		if (written < 0)
+			return -1;
+	}
+	return xlog_block_finish(&chunk->block);
+}
+
+/**
+ * Find the oldest chunk submitted to a worker.
+ * Must be called with the checkpoint mutex held.
+ */
+static struct checkpoint_chunk *
+checkpoint_worker_next_chunk(struct checkpoint_worker *worker)
+{
+	struct checkpoint *ckpt = worker->ckpt;
+	struct checkpoint_chunk *next = NULL;
+	for (int i = worker->id; i < ckpt->chunk_count;
+	     i += ckpt->snap_threads) {
+		struct checkpoint_chunk *chunk = &ckpt->chunks[i];
+		if (chunk->state == CHECKPOINT_CHUNK_SUBMITTED &&
+		    (next == NULL || chunk->seq < next->seq))
+			next = chunk;
+	}
+	return next;
+}
+
+static int
+checkpoint_worker_f(va_list ap)
+{
+	struct checkpoint_worker *worker =
+		va_arg(ap, struct checkpoint_worker *);
+	struct checkpoint *ckpt = worker->ckpt;
+
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	while (ckpt->is_worker_pool_running) {
+		struct checkpoint_chunk *chunk =
+			checkpoint_worker_next_chunk(worker);
+		if (chunk == NULL) {
+			tt_pthread_cond_wait(&ckpt->worker_cond,
+					     &ckpt->mutex);
+			continue;
+		}
+		tt_pthread_mutex_unlock(&ckpt->mutex);
+
+		chunk->status = checkpoint_chunk_encode(ckpt, chunk);
+		if (chunk->status != 0) {
+			struct diag *diag = diag_get();
+			assert(!diag_is_empty(diag));
+			diag_move(diag, &chunk->diag);
+		}
+
+		tt_pthread_mutex_lock(&ckpt->mutex);
+		chunk->state = CHECKPOINT_CHUNK_DONE;
+		tt_pthread_cond_signal(&ckpt->writer_cond);
+	}
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+
+	/* Blocks must be freed by the thread which created them. */
+	for (int i = worker->id; i < ckpt->chunk_count;
+	     i += ckpt->snap_threads) {
+		struct checkpoint_chunk *chunk = &ckpt->chunks[i];
+		if (chunk->block.zctx != NULL)
+			xlog_block_destroy(&chunk->block);
+	}
+	return 0;
+}
+
+static void
+checkpoint_stop_workers(struct checkpoint *ckpt);
+
+static void
+checkpoint_start_workers(struct checkpoint *ckpt)
+{
+	assert(!ckpt->is_worker_pool_running);
+	assert(ckpt->snap_threads > 0);
+
+	ckpt->chunk_count = ckpt->snap_threads * CHECKPOINT_CHUNKS_PER_WORKER;
+	ckpt->chunks = (struct checkpoint_chunk *)
+		calloc(ckpt->chunk_count, sizeof(struct checkpoint_chunk));
+	ckpt->workers = (struct checkpoint_worker *)
+		calloc(ckpt->snap_threads, sizeof(struct checkpoint_worker));
+	if (ckpt->chunks == NULL || ckpt->workers == NULL) {
+		free(ckpt->chunks);
+		free(ckpt->workers);
+		ckpt->chunks = NULL;
+		ckpt->workers = NULL;
+		ckpt->chunk_count = 0;
+		tnt_raise(OutOfMemory, ckpt->snap_threads *
+			  CHECKPOINT_CHUNKS_PER_WORKER *
+			  sizeof(struct checkpoint_chunk),
+			  "malloc", "snapshot chunks");
+	}
+	for (int i = 0; i < ckpt->chunk_count; i++) {
+		ckpt->chunks[i].state = CHECKPOINT_CHUNK_FREE;
+		diag_create(&ckpt->chunks[i].diag);
+	}
+	ckpt->fill_seq = 0;
+	ckpt->write_seq = 0;
+	tt_pthread_mutex_init(&ckpt->mutex, NULL);
+	tt_pthread_cond_init(&ckpt->worker_cond, NULL);
+	tt_pthread_cond_init(&ckpt->writer_cond, NULL);
+
+	ckpt->is_worker_pool_running = true;
+	ckpt->worker_count = 0;
+	for (int i = 0; i < ckpt->snap_threads; i++) {
+		struct checkpoint_worker *worker = &ckpt->workers[i];
+		worker->ckpt = ckpt;
+		worker->id = i;
+		if (cord_costart(&worker->cord, "snapshot.worker",
+				 checkpoint_worker_f, worker) != 0) {
+			/* Nothing is submitted yet, just stop. */
+			checkpoint_stop_workers(ckpt);
+			diag_raise();
+		}
+		ckpt->worker_count++;
+	}
+}
+
+static void
+checkpoint_stop_workers(struct checkpoint *ckpt)
+{
+	assert(ckpt->is_worker_pool_running);
+
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	ckpt->is_worker_pool_running = false;
+	tt_pthread_cond_broadcast(&ckpt->worker_cond);
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+
+	for (int i = 0; i < ckpt->worker_count; i++)
+		cord_join(&ckpt->workers[i].cord);
+	ckpt->worker_count = 0;
+
+	for (int i = 0; i < ckpt->chunk_count; i++)
+		diag_destroy(&ckpt->chunks[i].diag);
+	tt_pthread_cond_destroy(&ckpt->writer_cond);
+	tt_pthread_cond_destroy(&ckpt->worker_cond);
+	tt_pthread_mutex_destroy(&ckpt->mutex);
+	free(ckpt->workers);
+	free(ckpt->chunks);
+	ckpt->workers = NULL;
+	ckpt->chunks = NULL;
+	ckpt->chunk_count = 0;
+}
+
+/**
+ * Wait for a worker to encode the oldest chunk in flight
+ * and write it to the snapshot file.
+ */
+static void
+checkpoint_write_chunk(struct checkpoint *ckpt, struct xlog *snap,
+		       struct checkpoint_chunk *chunk)
+{
+	assert(chunk->seq == ckpt->write_seq);
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	while (chunk->state != CHECKPOINT_CHUNK_DONE)
+		tt_pthread_cond_wait(&ckpt->writer_cond, &ckpt->mutex);
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+
+	if (chunk->status != 0) {
+		diag_move(&chunk->diag, diag_get());
+		diag_raise();
+	}
+	if (xlog_write_block(snap, &chunk->block) < 0)
+		diag_raise();
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	chunk->state = CHECKPOINT_CHUNK_FREE;
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	ckpt->write_seq++;
+}
+
+/**
+ * Get a chunk to fill with tuples of the given space,
+ * writing the chunk previously stored in the same slot
+ * of the ring if necessary.
+ */
+static struct checkpoint_chunk *
+checkpoint_next_chunk(struct checkpoint *ckpt, struct xlog *snap,
+		      uint32_t space_id)
+{
+	struct checkpoint_chunk *chunk =
+		&ckpt->chunks[ckpt->fill_seq % ckpt->chunk_count];
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	bool is_free = chunk->state == CHECKPOINT_CHUNK_FREE;
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+	if (!is_free)
+		checkpoint_write_chunk(ckpt, snap, chunk);
+	chunk->seq = ckpt->fill_seq++;
+	chunk->space_id = space_id;
+	/**
+	 * Rows in snapshot are numbered from 1 to %rows.
+	 * This makes streaming such rows to a replica or
+	 * to recovery look similar to streaming a normal
+	 * WAL. @sa the place which skips old rows in
+	 * recovery_apply_row().
+	 */
+	chunk->lsn = snap->rows + 1;
+	chunk->size = 0;
+	chunk->tuple_count = 0;
+	return chunk;
+}
+
+static void
+checkpoint_submit_chunk(struct checkpoint *ckpt,
+			struct checkpoint_chunk *chunk)
+{
+	tt_pthread_mutex_lock(&ckpt->mutex);
+	chunk->state = CHECKPOINT_CHUNK_SUBMITTED;
+	tt_pthread_cond_broadcast(&ckpt->worker_cond);
+	tt_pthread_mutex_unlock(&ckpt->mutex);
+}
+
+/** Write all chunks in flight to the snapshot file. */
+static void
+checkpoint_write_chunks(struct checkpoint *ckpt, struct xlog *snap)
+{
+	while (ckpt->write_seq < ckpt->fill_seq) {
+		struct checkpoint_chunk *chunk =
+			&ckpt->chunks[ckpt->write_seq % ckpt->chunk_count];
+		checkpoint_write_chunk(ckpt, snap, chunk);
+	}
+}
+
 int
 checkpoint_f(va_list ap)
 {
@@ -735,16 +1454,54 @@ checkpoint_f(va_list ap)
 	auto guard = make_scoped_guard([&]{ xlog_close(&snap, false); });
 	snap.rate_limit = ckpt->snap_io_rate_limit;
 
+	ev_now_update(loop());
+	ckpt->tm = ev_now(loop());
+	/*
+	 * Encoding and compression of rows is done by a pool of
+	 * worker threads, chunk by chunk. This thread only walks
+	 * the read view and writes encoded chunks to the file in
+	 * the order they were filled, so the resulting file is
+	 * no different from one written by a single thread.
+	 */
+	checkpoint_start_workers(ckpt);
+	auto workers_guard = make_scoped_guard([&]{
+		checkpoint_stop_workers(ckpt);
+	});
+
 	say_info("saving snapshot `%s'", snap.filename);
+	ERROR_INJECT(ERRINJ_SNAP_WRITE_DELAY,
+	{
+		while (errinj_getb(ERRINJ_SNAP_WRITE_DELAY))
+			fiber_sleep(0.01);
+	});
 	struct checkpoint_entry *entry;
 	rlist_foreach_entry(entry, &ckpt->entries, link) {
+		struct checkpoint_chunk *chunk = NULL;
 		struct tuple *tuple;
 		struct iterator *it = entry->iterator;
 		for (tuple = it->next(it); tuple; tuple = it->next(it)) {
-			checkpoint_write_tuple(&snap, space_id(entry->space),
-					       tuple);
+			tuple = memtx_tx_snapshot_clarify(&ckpt->cleaner,
+							  tuple);
+			if (tuple == NULL)
+				continue;
+			if (chunk == NULL)
+				chunk = checkpoint_next_chunk(ckpt, &snap,
+						space_id(entry->space));
+			chunk->tuples[chunk->tuple_count++] = tuple;
+			chunk->size += tuple->bsize;
+			if (++snap.rows % 100000 == 0)
+				say_crit("%.1fM rows written",
+					 snap.rows / 1000000.);
+			if (chunk->tuple_count == CHECKPOINT_CHUNK_TUPLES_MAX ||
+			    chunk->size >= CHECKPOINT_CHUNK_SIZE_MAX) {
+				checkpoint_submit_chunk(ckpt, chunk);
+				chunk = NULL;
+			}
 		}
+		if (chunk != NULL)
+			checkpoint_submit_chunk(ckpt, chunk);
 	}
+	checkpoint_write_chunks(ckpt, &snap);
 	xlog_flush(&snap);
 	say_info("done");
 	return 0;
@@ -757,8 +1514,10 @@ MemtxEngine::beginCheckpoint()
 
 	m_checkpoint = region_alloc_object_xc(&fiber()->gc, struct checkpoint);
 
-	checkpoint_init(m_checkpoint, m_snap_dir.dirname, m_snap_io_rate_limit);
+	checkpoint_init(m_checkpoint, m_snap_dir.dirname, m_snap_io_rate_limit,
+			m_snap_threads);
 	space_foreach(checkpoint_add_space, m_checkpoint);
+	memtx_tx_snapshot_cleaner_create(&m_checkpoint->cleaner);
 
 	/* increment snapshot version; set tuple deletion to delayed mode */
 	memtx_tuple_begin_snapshot();
@@ -74,7 +74,8 @@ struct MemtxEngine: public Engine {
 	MemtxEngine(const char *snap_dirname, bool panic_on_snap_error,
 		    bool panic_on_wal_error, float tuple_arena_max_size,
 		    uint32_t objsize_min, uint32_t objsize_max,
-		    float alloc_factor);
+		    float alloc_factor, bool huge_pages, const char *numa,
+		    bool use_mvcc_engine);
 	~MemtxEngine();
 	virtual Handler *open() override;
 	virtual void addPrimaryKey(struct space *space) override;
@@ -104,6 +105,18 @@ struct MemtxEngine: public Engine {
 	{
 		m_snap_io_rate_limit = new_limit * 1024 * 1024;
 	}
+	/* Update snap_threads. */
+	void setSnapThreads(int snap_threads)
+	{
+		m_snap_threads = snap_threads;
+	}
+	/**
+	 * True if tuples may be moved in memory, @sa memtx_compact.h:
+	 * there is no transaction in progress, which could roll back
+	 * its changes of indexes, and no checkpoint, which reads a
+	 * frozen view of tuples.
+	 */
+	bool canRelocateTuples() const;
 	/**
 	 * Return LSN of the most recent snapshot or -1 if there is
 	 * no snapshot.
@@ -113,6 +126,8 @@ struct MemtxEngine: public Engine {
 private:
 	void
 	recoverSnapshotRow(struct xrow_header *row);
+	void
+	recoverSnapshotRequest(struct request *request);
 	/** Non-zero if there is a checkpoint (snapshot) in progress. */
 	struct checkpoint *m_checkpoint;
 	enum memtx_recovery_state m_state;
@@ -120,9 +135,13 @@ private:
 	struct xdir m_snap_dir;
 	/** Limit disk usage of checkpointing (bytes per second). */
 	uint64_t m_snap_io_rate_limit;
+	/** Number of threads encoding snapshot rows. */
+	int m_snap_threads;
 	struct vclock m_last_checkpoint;
 	bool m_has_checkpoint;
 	bool m_panic_on_wal_error;
+	/** Number of memtx transactions in progress. */
+	int m_txn_count;
 };
 
 enum {
@@ -130,6 +149,18 @@ enum {
 	MEMTX_SLAB_SIZE = 4 * 1024 * 1024
 };
 
+enum {
+	/**
+	 * This number is calculated based on the
+	 * max (realistic) number of insertions
+	 * a deletion from a B-tree or an R-tree
+	 * can lead to, and, as a result, the max
+	 * number of new block allocations.
+	 */
+	RESERVE_EXTENTS_BEFORE_DELETE = 8,
+	RESERVE_EXTENTS_BEFORE_REPLACE = 16
+};
+
 /**
  * Initialize arena for indexes.
  * The arena is used for memtx_index_extent_alloc
@@ -32,16 +32,13 @@
 #include "say.h"
 #include "tuple.h"
 #include "tuple_compare.h"
+#include "tuple_hash.h"
 #include "memtx_engine.h"
+#include "memtx_tx.h"
 #include "space.h"
 #include "schema.h" /* space_cache_find() */
 #include "errinj.h"
 
-#include "third_party/PMurHash.h"
-
-enum {
-	HASH_SEED = 13U
-};
 
 static inline bool
 equal(struct tuple *tuple_a, struct tuple *tuple_b,
@@ -58,92 +55,6 @@ equal_key(struct tuple *tuple, const char *key,
 					       key_def) == 0;
 }
 
-static inline uint32_t
-mh_hash_field(uint32_t *ph1, uint32_t *pcarry, const char **field,
-	      enum field_type type)
-{
-	const char *f = *field;
-	uint32_t size;
-
-	switch (type) {
-	case FIELD_TYPE_STRING:
-		/*
-		 * (!) MP_STR fields hashed **excluding** MsgPack format
-		 * indentifier. We have to do that to keep compatibility
-		 * with old third-party MsgPack (spec-old.md) implementations.
-		 * \sa https://github.com/tarantool/tarantool/issues/522
-		 */
-		f = mp_decode_str(field, &size);
-		break;
-	default:
-		mp_next(field);
-		size = *field - f;  /* calculate the size of field */
-		/*
-		 * (!) All other fields hashed **including** MsgPack format
-		 * identifier (e.g. 0xcc). This was done **intentionally**
-		 * for performance reasons. Please follow MsgPack specification
-		 * and pack all your numbers to the most compact representation.
-		 * If you still want to add support for broken MsgPack,
-		 * please don't forget to patch tuple_compare_field().
-		 */
-		break;
-	}
-	assert(size < INT32_MAX);
-	PMurHash32_Process(ph1, pcarry, f, size);
-	return size;
-}
-
-static inline uint32_t
-tuple_hash(struct tuple *tuple, const struct key_def *key_def)
-{
-	const struct key_part *part = key_def->parts;
-	/*
-	 * Speed up the simplest case when we have a
-	 * single-part hash_table over an integer field.
-	 */
-	if (key_def->part_count == 1 && part->type == FIELD_TYPE_UNSIGNED) {
-		const char *field = tuple_field(tuple, part->fieldno);
-		uint64_t val = mp_decode_uint(&field);
-		if (likely(val <= UINT32_MAX))
-			return val;
-		return ((uint32_t)((val)>>33^(val)^(val)<<11));
-	}
-
-	uint32_t h = HASH_SEED;
-	uint32_t carry = 0;
-	uint32_t total_size = 0;
-
-	for ( ; part < key_def->parts + key_def->part_count; part++) {
-		const char *field = tuple_field(tuple, part->fieldno);
-		total_size += mh_hash_field(&h, &carry, &field, part->type);
-	}
-
-	return PMurHash32_Result(h, carry, total_size);
-}
-
-static inline uint32_t
-key_hash(const char *key, const struct key_def *key_def)
-{
-	const struct key_part *part = key_def->parts;
-
-	if (key_def->part_count == 1 && part->type == FIELD_TYPE_UNSIGNED) {
-		uint64_t val = mp_decode_uint(&key);
-		if (likely(val <= UINT32_MAX))
-			return val;
-		return ((uint32_t)((val)>>33^(val)^(val)<<11));
-	}
-
-	uint32_t h = HASH_SEED;
-	uint32_t carry = 0;
-	uint32_t total_size = 0;
-
-	/* Hash fields part by part (see mh_hash_field() comments) */
-	for ( ; part < key_def->parts + key_def->part_count; part++)
-		total_size += mh_hash_field(&h, &carry, &key, part->type);
-
-	return PMurHash32_Result(h, carry, total_size);
-}
-
 #define LIGHT_NAME _index
 #define LIGHT_DATA_TYPE struct tuple *
 #define LIGHT_KEY_TYPE const char *
@@ -169,8 +80,16 @@ hash_iterator_free(struct iterator *iterator)
 	free(iterator);
 }
 
-struct tuple *
-hash_iterator_ge(struct iterator *ptr)
+/*
+ * Methods with the _base suffix walk the hash table, the
+ * methods without it, which are set as iterator->next, skip
+ * tuples invisible to the current transaction.
+ */
+static struct tuple *
+hash_iterator_ge(struct iterator *ptr);
+
+static struct tuple *
+hash_iterator_ge_base(struct iterator *ptr)
 {
 	assert(ptr->free == hash_iterator_free);
 	struct hash_iterator *it = (struct hash_iterator *) ptr;
@@ -179,8 +98,8 @@ hash_iterator_ge(struct iterator *ptr)
 	return res ? *res : 0;
 }
 
-struct tuple *
-hash_iterator_gt(struct iterator *ptr)
+static struct tuple *
+hash_iterator_gt_base(struct iterator *ptr)
 {
 	assert(ptr->free == hash_iterator_free);
 	ptr->next = hash_iterator_ge;
@@ -201,12 +120,16 @@ hash_iterator_eq_next(MAYBE_UNUSED struct iterator *it)
 }
 
 static struct tuple *
-hash_iterator_eq(struct iterator *it)
+hash_iterator_eq_base(struct iterator *it)
 {
 	it->next = hash_iterator_eq_next;
-	return hash_iterator_ge(it);
+	return hash_iterator_ge_base(it);
 }
 
+MEMTX_TX_WRAP_ITERATOR(hash_iterator_ge)
+MEMTX_TX_WRAP_ITERATOR(hash_iterator_gt)
+MEMTX_TX_WRAP_ITERATOR(hash_iterator_eq)
+
 /* }}} */
 
 /* {{{ MemtxHash -- implementation of all hashes. **********************/
@@ -259,7 +182,8 @@ MemtxHash::random(uint32_t rnd) const
 		rnd++;
 		rnd %= (hash_table->table_size);
 	}
-	return light_index_get(hash_table, rnd);
+	return memtx_tx_tuple_clarify(light_index_get(hash_table, rnd),
+				      key_def->iid);
 }
 
 struct tuple *
@@ -273,7 +197,7 @@ MemtxHash::findByKey(const char *key, uint32_t part_count) const
 	uint32_t k = light_index_find_key(hash_table, h, key);
 	if (k != light_index_end)
 		ret = light_index_get(hash_table, k);
-	return ret;
+	return memtx_tx_tuple_clarify(ret, key_def->iid);
 }
 
 struct tuple *
@@ -339,6 +263,7 @@ MemtxHash::allocIterator() const
 
 	it->base.next = hash_iterator_ge;
 	it->base.free = hash_iterator_free;
+	it->base.index = (Index *) this;
 	it->hash_table = hash_table;
 	light_index_iterator_begin(it->hash_table, &it->iterator);
 	return (struct iterator *) it;
@@ -51,6 +51,16 @@ MemtxIndex::buildNext(struct tuple *tuple)
 	replace(NULL, tuple, DUP_INSERT);
 }
 
+void
+MemtxIndex::prepareBuild()
+{}
+
+bool
+MemtxIndex::canPrepareBuildInThread() const
+{
+	return false;
+}
+
 void
 MemtxIndex::endBuild()
 {}
@@ -71,6 +81,17 @@ MemtxIndex::max(const char *key, uint32_t part_count) const
 	return it->next(it);
 }
 
+void
+MemtxIndex::initIteratorWithOffset(struct iterator *it,
+				   enum iterator_type type,
+				   const char *key, uint32_t part_count,
+				   uint32_t offset, uint32_t /* limit */) const
+{
+	initIterator(it, type, key, part_count);
+	while (offset > 0 && it->next(it) != NULL)
+		--offset;
+}
+
 size_t
 MemtxIndex::count(enum iterator_type type, const char *key,
 		  uint32_t part_count) const
@@ -85,27 +106,3 @@ MemtxIndex::count(enum iterator_type type, const char *key,
 		++count;
 	return count;
 }
-
-void
-index_build(MemtxIndex *index, MemtxIndex *pk)
-{
-	uint32_t n_tuples = pk->size();
-	uint32_t estimated_tuples = n_tuples * 1.2;
-
-	index->beginBuild();
-	index->reserve(estimated_tuples);
-
-	if (n_tuples > 0) {
-		say_info("Adding %" PRIu32 " keys to %s index '%s' ...",
-			 n_tuples, index_type_strs[index->key_def->type],
-			 index_name(index));
-	}
-
-	struct iterator *it = pk->position();
-	pk->initIterator(it, ITER_ALL, NULL, 0);
-	struct tuple *tuple;
-	while ((tuple = it->next(it)))
-		index->buildNext(tuple);
-
-	index->endBuild();
-}
@@ -55,6 +55,20 @@ public:
 		return m_position;
 	}
 
+	/**
+	 * Same as initIterator(), but also skip the first @a offset
+	 * tuples. The default implementation calls next() @a offset
+	 * times, ordered indexes can do better. The caller fetches
+	 * at most @a limit tuples after that, so an index may avoid
+	 * looking for more.
+	 */
+	virtual void initIteratorWithOffset(struct iterator *iterator,
+					    enum iterator_type type,
+					    const char *key,
+					    uint32_t part_count,
+					    uint32_t offset,
+					    uint32_t limit) const;
+
 	/**
 	 * Two-phase index creation: begin building, add tuples, finish.
 	 */
@@ -66,6 +80,20 @@ public:
 	 */
 	virtual void reserve(uint32_t /* size_hint */);
 	virtual void buildNext(struct tuple *tuple);
+	/**
+	 * Do the heavy part of the build which doesn't need
+	 * the memtx index allocator, e.g. sort the tuples given
+	 * to buildNext(). Called, optionally, after the last
+	 * buildNext() and before endBuild().
+	 */
+	virtual void prepareBuild();
+	/**
+	 * True if beginBuild(), reserve(), buildNext() and
+	 * prepareBuild() may be called from a thread other
+	 * than tx, concurrently with builds of other indexes.
+	 * endBuild() is always called from tx.
+	 */
+	virtual bool canPrepareBuildInThread() const;
 	virtual void endBuild();
 protected:
 	/*
@@ -75,8 +103,4 @@ protected:
 	mutable struct iterator *m_position;
 };
 
-/** Build this index based on the contents of another index. */
-void
-index_build(MemtxIndex *index, MemtxIndex *pk);
-
 #endif /* TARANTOOL_BOX_MEMTX_INDEX_H_INCLUDED */
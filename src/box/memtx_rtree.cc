@@ -39,6 +39,7 @@
 #include "tuple.h"
 #include "space.h"
 #include "memtx_engine.h"
+#include "memtx_tx.h"
 
 /* {{{ Utilities. *************************************************/
 
@@ -143,12 +144,14 @@ index_rtree_iterator_free(struct iterator *i)
 }
 
 static struct tuple *
-index_rtree_iterator_next(struct iterator *i)
+index_rtree_iterator_next_base(struct iterator *i)
 {
 	struct index_rtree_iterator *itr = (struct index_rtree_iterator *)i;
 	return (struct tuple *)rtree_iterator_next(&itr->impl);
 }
 
+MEMTX_TX_WRAP_ITERATOR(index_rtree_iterator_next)
+
 /* }}} */
 
 /* {{{ MemtxRTree  **********************************************************/
@@ -160,6 +163,7 @@ MemtxRTree::~MemtxRTree()
 		index_rtree_iterator_free(m_position);
 		m_position = NULL;
 	}
+	rtree_bulk_destroy(&m_bulk);
 	rtree_destroy(&m_tree);
 }
 
@@ -186,6 +190,7 @@ MemtxRTree::MemtxRTree(struct key_def *key_def_arg)
 	rtree_init(&m_tree, m_dimension, MEMTX_EXTENT_SIZE,
 		   memtx_index_extent_alloc, memtx_index_extent_free, NULL,
 		   distance_type);
+	rtree_bulk_create(&m_bulk, &m_tree);
 }
 
 size_t
@@ -247,6 +252,7 @@ MemtxRTree::allocIterator() const
 	rtree_iterator_init(&it->impl);
 	it->base.next = index_rtree_iterator_next;
 	it->base.free = index_rtree_iterator_free;
+	it->base.index = (Index *) this;
 	return &it->base;
 }
 
@@ -300,9 +306,75 @@ MemtxRTree::initIterator(struct iterator *iterator, enum iterator_type type,
 	rtree_search(&m_tree, &rect, op, &it->impl);
 }
 
+void
+MemtxRTree::initIteratorWithOffset(struct iterator *iterator,
+				   enum iterator_type type,
+				   const char *key, uint32_t part_count,
+				   uint32_t offset, uint32_t limit) const
+{
+	initIterator(iterator, type, key, part_count);
+	/*
+	 * A limited NEIGHBOR search needs only offset + limit nearest
+	 * tuples. Uncommitted changes may hide some of them, so don't
+	 * limit the search while there are any.
+	 */
+	if (type == ITER_NEIGHBOR && !memtx_tx_has_stories() &&
+	    limit <= RTREE_NEIGHBOR_LIMIT_MAX &&
+	    offset <= RTREE_NEIGHBOR_LIMIT_MAX - limit) {
+		index_rtree_iterator *it = (index_rtree_iterator *)iterator;
+		rtree_iterator_set_limit(&it->impl, offset + limit);
+	}
+	while (offset > 0 && iterator->next(iterator) != NULL)
+		--offset;
+}
+
 void
 MemtxRTree::beginBuild()
 {
 	rtree_purge(&m_tree);
+	rtree_bulk_destroy(&m_bulk);
+}
+
+void
+MemtxRTree::reserve(uint32_t size_hint)
+{
+	if (rtree_bulk_reserve(&m_bulk, size_hint) != 0) {
+		tnt_raise(OutOfMemory, size_hint * m_tree.page_branch_size,
+			  "MemtxRTree", "build array");
+	}
+}
+
+void
+MemtxRTree::buildNext(struct tuple *tuple)
+{
+	struct rtree_rect rect;
+	extract_rectangle(&rect, tuple, key_def);
+	if (rtree_bulk_add(&m_bulk, &rect, tuple) != 0) {
+		tnt_raise(OutOfMemory, m_bulk.capacity * m_tree.page_branch_size,
+			  "MemtxRTree", "build array");
+	}
+}
+
+void
+MemtxRTree::prepareBuild()
+{
+	rtree_bulk_sort(&m_bulk);
+}
+
+bool
+MemtxRTree::canPrepareBuildInThread() const
+{
+	/* The build array is allocated with malloc(). */
+	return true;
+}
+
+void
+MemtxRTree::endBuild()
+{
+	size_t count = m_bulk.count;
+	if (rtree_bulk_load(&m_tree, &m_bulk) != 0) {
+		tnt_raise(OutOfMemory, count * m_tree.page_branch_size,
+			  "MemtxRTree", "bulk load");
+	}
 }
 
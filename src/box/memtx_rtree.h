@@ -41,6 +41,11 @@ public:
 	~MemtxRTree();
 
 	virtual void beginBuild() override;
+	virtual void reserve(uint32_t size_hint) override;
+	virtual void buildNext(struct tuple *tuple) override;
+	virtual void prepareBuild() override;
+	virtual bool canPrepareBuildInThread() const override;
+	virtual void endBuild() override;
 	virtual size_t size() const override;
 	virtual struct tuple *findByKey(const char *key,
 					uint32_t part_count) const override;
@@ -54,10 +59,18 @@ public:
                                   enum iterator_type type,
                                   const char *key,
 				  uint32_t part_count) const override;
+	virtual void initIteratorWithOffset(struct iterator *iterator,
+					    enum iterator_type type,
+					    const char *key,
+					    uint32_t part_count,
+					    uint32_t offset,
+					    uint32_t limit) const override;
 
 protected:
 	unsigned m_dimension;
 	struct rtree m_tree;
+	/** Tuples collected by buildNext() for a bulk load. */
+	struct rtree_bulk m_bulk;
 };
 
 #endif /* TARANTOOL_BOX_MEMTX_RTREE_H_INCLUDED */
@@ -40,6 +40,9 @@
 #include "memtx_bitset.h"
 #include "port.h"
 #include "memtx_tuple.h"
+#include "memtx_engine.h"
+#include "memtx_tx.h"
+#include "schema.h"
 
 /**
  * A version of space_replace for a space which has
@@ -54,18 +57,6 @@ memtx_replace_no_keys(struct txn_stmt * /* stmt */, struct space *space,
 	(void) index;
 }
 
-enum {
-	/**
-	 * This number is calculated based on the
-	 * max (realistic) number of insertions
-	 * a deletion from a B-tree or an R-tree
-	 * can lead to, and, as a result, the max
-	 * number of new block allocations.
-	 */
-	RESERVE_EXTENTS_BEFORE_DELETE = 8,
-	RESERVE_EXTENTS_BEFORE_REPLACE = 16
-};
-
 /**
  * A short-cut version of replace() used during bulk load
  * from snapshot.
@@ -186,6 +177,10 @@ memtx_replace_primary_key(struct txn_stmt *stmt, struct space *space,
  * old_tuple is given, dup_replace_mode is ignored.
  * Otherwise, it's taken into account only for the
  * primary key.
+ *
+ * With the memtx transaction manager enabled, the
+ * changes are versioned by memtx_tx_replace(), see
+ * memtx_tx.h.
  */
 void
 memtx_replace_all_keys(struct txn_stmt *stmt, struct space *space,
@@ -200,6 +195,14 @@ memtx_replace_all_keys(struct txn_stmt *stmt, struct space *space,
 	memtx_index_extent_reserve(new_tuple ?
 				   RESERVE_EXTENTS_BEFORE_REPLACE :
 				   RESERVE_EXTENTS_BEFORE_DELETE);
+	if (memtx_tx_manager_use_mvcc_engine) {
+		struct txn *txn = in_txn();
+		if (memtx_tx_is_tracked(txn)) {
+			if (!space_is_system(space))
+				return memtx_tx_replace(stmt, space, mode);
+			memtx_tx_abort_on_yield(txn);
+		}
+	}
 	uint32_t i = 0;
 	try {
 		/* Update the primary key */
@@ -302,6 +305,8 @@ MemtxSpace::prepareUpdate(struct txn_stmt *stmt, struct space *space,
 	/* Update the tuple; legacy, request ops are in request->tuple */
 	uint32_t new_size = 0, bsize;
 	const char *old_data = tuple_data_range(stmt->old_tuple, &bsize);
+	if (old_data == NULL)
+		diag_raise();
 	const char *new_data =
 		tuple_update_execute(region_aligned_alloc_cb, &fiber()->gc,
 				     request->tuple, request->tuple_end,
@@ -372,6 +377,8 @@ MemtxSpace::prepareUpsert(struct txn_stmt *stmt, struct space *space,
 		uint32_t new_size = 0, bsize;
 		const char *old_data = tuple_data_range(stmt->old_tuple,
 							&bsize);
+		if (old_data == NULL)
+			diag_raise();
 		/*
 		 * Update the tuple.
 		 * tuple_upsert_execute() fails on totally wrong
@@ -463,7 +470,9 @@ MemtxSpace::createIndex(struct space *space, struct key_def *key_def_arg)
 	case HASH:
 		return new MemtxHash(key_def_arg);
 	case TREE:
-		return new MemtxTree(key_def_arg);
+		if (key_def_arg->opts.hint)
+			return new MemtxTree<true>(key_def_arg);
+		return new MemtxTree<false>(key_def_arg);
 	case RTREE:
 		return new MemtxRTree(key_def_arg);
 	case BITSET:
@@ -494,6 +503,12 @@ void
 MemtxSpace::prepareAlterSpace(struct space *old_space, struct space *new_space)
 {
 	(void)new_space;
+	/*
+	 * Stories of uncommitted tuples refer to indexes
+	 * of the old space.
+	 */
+	if (memtx_tx_space_has_stories(old_space))
+		tnt_raise(ClientError, ER_TRANSACTION_CONFLICT);
 	MemtxSpace *handler = (MemtxSpace *) old_space->handler;
 	replace = handler->replace;
 }
@@ -519,14 +534,11 @@ MemtxSpace::executeSelect(struct txn *, struct space *space,
 		diag_raise();
 
 	struct iterator *it = index->position();
-	index->initIterator(it, type, key, part_count);
+	index->initIteratorWithOffset(it, type, key, part_count,
+				      offset, limit);
 
 	struct tuple *tuple;
 	while ((tuple = it->next(it)) != NULL) {
-		if (offset > 0) {
-			offset--;
-			continue;
-		}
 		if (limit == found++)
 			break;
 		port_add_tuple(port, tuple);
@@ -29,6 +29,7 @@
  * SUCH DAMAGE.
  */
 #include "memtx_tree.h"
+#include "memtx_tx.h"
 #include "tuple_compare.h"
 #include "space.h"
 #include "schema.h" /* space_cache_find() */
@@ -37,55 +38,27 @@
 #include "fiber.h"
 #include <third_party/qsort_arg.h>
 
-/* {{{ Utilities. *************************************************/
-
-struct key_data
-{
-	const char *key;
-	uint32_t part_count;
-};
-
-int
-memtx_tree_compare(const tuple *a, const tuple *b, struct key_def *key_def)
-{
-	int r = tuple_compare(a, b, key_def);
-	if (r == 0 && !key_def->opts.is_unique)
-		r = a < b ? -1 : a > b;
-	return r;
-}
-
-int
-memtx_tree_compare_key(const tuple *a, const struct key_data *key_data,
-		       struct key_def *key_def)
-{
-	return tuple_compare_with_key(a, key_data->key,
-				      key_data->part_count, key_def);
-}
-
-int
-memtx_tree_qcompare(const void* a, const void *b, void *c)
-{
-	return memtx_tree_compare(*(struct tuple **)a,
-		*(struct tuple **)b, (struct key_def *)c);
-}
-
 /* {{{ MemtxTree Iterators ****************************************/
+template <bool USE_HINT>
 struct tree_iterator {
+	typedef memtx_tree_traits<USE_HINT> traits;
+
 	struct iterator base;
-	const struct memtx_tree *tree;
+	const typename traits::tree *tree;
 	struct key_def *key_def;
-	struct memtx_tree_iterator tree_iterator;
+	typename traits::iterator tree_iterator;
 	struct key_data key_data;
 };
 
 static void
 tree_iterator_free(struct iterator *iterator);
 
-static inline struct tree_iterator *
-tree_iterator(struct iterator *it)
+template <bool USE_HINT>
+static inline struct tree_iterator<USE_HINT> *
+tree_iterator_cast(struct iterator *it)
 {
 	assert(it->free == tree_iterator_free);
-	return (struct tree_iterator *) it;
+	return (struct tree_iterator<USE_HINT> *) it;
 }
 
 static void
@@ -101,161 +74,294 @@ tree_iterator_dummie(struct iterator *iterator)
 	return 0;
 }
 
+/*
+ * Methods with the _base suffix walk the tree, the methods
+ * without it, which are set as iterator->next, skip tuples
+ * invisible to the current transaction.
+ */
+#define MEMTX_TREE_WRAP_ITERATOR(name)					\
+template <bool USE_HINT>						\
+static struct tuple *							\
+name(struct iterator *iterator)						\
+{									\
+	return memtx_tx_iterator_next(iterator, name##_base<USE_HINT>,	\
+				      name<USE_HINT>);			\
+}
+
+template <bool USE_HINT>
 static struct tuple *
-tree_iterator_fwd(struct iterator *iterator)
+tree_iterator_fwd_check_equality(struct iterator *iterator);
+
+template <bool USE_HINT>
+static struct tuple *
+tree_iterator_bwd(struct iterator *iterator);
+
+template <bool USE_HINT>
+static struct tuple *
+tree_iterator_bwd_check_equality(struct iterator *iterator);
+
+template <bool USE_HINT>
+static struct tuple *
+tree_iterator_fwd_base(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	typedef memtx_tree_traits<USE_HINT> traits;
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	typename traits::elem *res =
+		traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res)
 		return 0;
-	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	return *res;
+	traits::iterator_next(it->tree, &it->tree_iterator);
+	return traits::elem_tuple(res);
 }
 
+template <bool USE_HINT>
 static struct tuple *
-tree_iterator_bwd(struct iterator *iterator)
+tree_iterator_bwd_base(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	typedef memtx_tree_traits<USE_HINT> traits;
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	typename traits::elem *res =
+		traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res)
 		return 0;
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	return *res;
+	traits::iterator_prev(it->tree, &it->tree_iterator);
+	return traits::elem_tuple(res);
 }
 
+template <bool USE_HINT>
 static struct tuple *
-tree_iterator_fwd_check_equality(struct iterator *iterator)
+tree_iterator_fwd_check_equality_base(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	typedef memtx_tree_traits<USE_HINT> traits;
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	typename traits::elem *res =
+		traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res)
 		return 0;
-	if (memtx_tree_compare_key(*res, &it->key_data, it->key_def) != 0) {
-		it->tree_iterator = memtx_tree_invalid_iterator();
+	if (traits::elem_compare_key(res, &it->key_data, it->key_def) != 0) {
+		it->tree_iterator = traits::invalid_iterator();
 		return 0;
 	}
-	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	return *res;
+	traits::iterator_next(it->tree, &it->tree_iterator);
+	return traits::elem_tuple(res);
 }
 
+template <bool USE_HINT>
 static struct tuple *
-tree_iterator_fwd_check_next_equality(struct iterator *iterator)
+tree_iterator_fwd_check_next_equality_base(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	typedef memtx_tree_traits<USE_HINT> traits;
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	typename traits::elem *res =
+		traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res)
 		return 0;
-	memtx_tree_iterator_next(it->tree, &it->tree_iterator);
-	iterator->next = tree_iterator_fwd_check_equality;
-	return *res;
+	traits::iterator_next(it->tree, &it->tree_iterator);
+	iterator->next = tree_iterator_fwd_check_equality<USE_HINT>;
+	return traits::elem_tuple(res);
 }
 
+template <bool USE_HINT>
 static struct tuple *
-tree_iterator_bwd_skip_one(struct iterator *iterator)
+tree_iterator_bwd_skip_one_base(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	iterator->next = tree_iterator_bwd;
-	return tree_iterator_bwd(iterator);
+	typedef memtx_tree_traits<USE_HINT> traits;
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	traits::iterator_prev(it->tree, &it->tree_iterator);
+	iterator->next = tree_iterator_bwd<USE_HINT>;
+	return tree_iterator_bwd_base<USE_HINT>(iterator);
 }
 
+template <bool USE_HINT>
 static struct tuple *
-tree_iterator_bwd_check_equality(struct iterator *iterator)
+tree_iterator_bwd_check_equality_base(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	tuple **res = memtx_tree_iterator_get_elem(it->tree, &it->tree_iterator);
+	typedef memtx_tree_traits<USE_HINT> traits;
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	typename traits::elem *res =
+		traits::iterator_get_elem(it->tree, &it->tree_iterator);
 	if (!res)
 		return 0;
-	if (memtx_tree_compare_key(*res, &it->key_data, it->key_def) != 0) {
-		it->tree_iterator = memtx_tree_invalid_iterator();
+	if (traits::elem_compare_key(res, &it->key_data, it->key_def) != 0) {
+		it->tree_iterator = traits::invalid_iterator();
 		return 0;
 	}
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	return *res;
+	traits::iterator_prev(it->tree, &it->tree_iterator);
+	return traits::elem_tuple(res);
 }
 
+template <bool USE_HINT>
 static struct tuple *
-tree_iterator_bwd_skip_one_check_next_equality(struct iterator *iterator)
+tree_iterator_bwd_skip_one_check_next_equality_base(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	memtx_tree_iterator_prev(it->tree, &it->tree_iterator);
-	iterator->next = tree_iterator_bwd_check_equality;
-	return tree_iterator_bwd_check_equality(iterator);
+	typedef memtx_tree_traits<USE_HINT> traits;
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	traits::iterator_prev(it->tree, &it->tree_iterator);
+	iterator->next = tree_iterator_bwd_check_equality<USE_HINT>;
+	return tree_iterator_bwd_check_equality_base<USE_HINT>(iterator);
 }
+
+MEMTX_TREE_WRAP_ITERATOR(tree_iterator_fwd)
+MEMTX_TREE_WRAP_ITERATOR(tree_iterator_bwd)
+MEMTX_TREE_WRAP_ITERATOR(tree_iterator_fwd_check_equality)
+MEMTX_TREE_WRAP_ITERATOR(tree_iterator_fwd_check_next_equality)
+MEMTX_TREE_WRAP_ITERATOR(tree_iterator_bwd_skip_one)
+MEMTX_TREE_WRAP_ITERATOR(tree_iterator_bwd_check_equality)
+MEMTX_TREE_WRAP_ITERATOR(tree_iterator_bwd_skip_one_check_next_equality)
+
+#undef MEMTX_TREE_WRAP_ITERATOR
 /* }}} */
 
+/**
+ * Find the offsets of the first matching tuple and of the tuple
+ * past the last matching one in the tree order. Every inner block
+ * of the tree knows the number of tuples below it, so it takes
+ * logarithmic time regardless of the number of matching tuples.
+ */
+template <bool USE_HINT>
+static void
+memtx_tree_range(const typename memtx_tree_traits<USE_HINT>::tree *tree,
+		 enum iterator_type type, struct key_data *key_data,
+		 size_t *begin, size_t *end)
+{
+	typedef memtx_tree_traits<USE_HINT> traits;
+	assert(type >= 0 && type <= ITER_GT);
+	*begin = 0;
+	*end = traits::size(tree);
+	if (key_data->part_count == 0)
+		return;
+	switch (type) {
+	case ITER_EQ:
+	case ITER_REQ:
+		traits::lower_bound_get_offset(tree, key_data, begin);
+		traits::upper_bound_get_offset(tree, key_data, end);
+		break;
+	case ITER_ALL:
+	case ITER_GE:
+		traits::lower_bound_get_offset(tree, key_data, begin);
+		break;
+	case ITER_GT:
+		traits::upper_bound_get_offset(tree, key_data, begin);
+		break;
+	case ITER_LE:
+		traits::upper_bound_get_offset(tree, key_data, end);
+		break;
+	case ITER_LT:
+		traits::lower_bound_get_offset(tree, key_data, end);
+		break;
+	default:
+		unreachable();
+	}
+}
+
 /* {{{ MemtxTree  **********************************************************/
 
-MemtxTree::MemtxTree(struct key_def *key_def_arg)
+template <bool USE_HINT>
+MemtxTree<USE_HINT>::MemtxTree(struct key_def *key_def_arg)
 	: MemtxIndex(key_def_arg), build_array(0), build_array_size(0),
-	  build_array_alloc_size(0)
+	  build_array_alloc_size(0), build_array_is_sorted(false)
 {
 	memtx_index_arena_init();
-	memtx_tree_create(&tree, key_def,
-			      memtx_index_extent_alloc,
-			      memtx_index_extent_free, NULL);
+	traits::create(&tree, key_def);
 }
 
-MemtxTree::~MemtxTree()
+template <bool USE_HINT>
+MemtxTree<USE_HINT>::~MemtxTree()
 {
-	memtx_tree_destroy(&tree);
+	traits::destroy(&tree);
 	free(build_array);
 }
 
+template <bool USE_HINT>
 size_t
-MemtxTree::size() const
+MemtxTree<USE_HINT>::size() const
 {
-	return memtx_tree_size(&tree);
+	return traits::size(&tree);
 }
 
+template <bool USE_HINT>
 size_t
-MemtxTree::bsize() const
+MemtxTree<USE_HINT>::bsize() const
 {
-	return memtx_tree_mem_used(&tree);
+	return traits::mem_used(&tree);
+}
+
+template <bool USE_HINT>
+size_t
+MemtxTree<USE_HINT>::count(enum iterator_type type, const char *key,
+			   uint32_t part_count) const
+{
+	/* Subtree counts include uncommitted tuples. */
+	if (type < 0 || type > ITER_GT || memtx_tx_has_stories())
+		return MemtxIndex::count(type, key, part_count);
+	struct key_data key_data;
+	key_data.key = key;
+	key_data.part_count = part_count;
+	key_data.hint = key_hint(key, part_count, key_def);
+	size_t begin, end;
+	memtx_tree_range<USE_HINT>(&tree, type, &key_data, &begin, &end);
+	return end - begin;
 }
 
+template <bool USE_HINT>
 struct tuple *
-MemtxTree::random(uint32_t rnd) const
+MemtxTree<USE_HINT>::random(uint32_t rnd) const
 {
-	struct tuple **res = memtx_tree_random(&tree, rnd);
-	return res ? *res : 0;
+	typename traits::elem *res = traits::random(&tree, rnd);
+	return res ? memtx_tx_tuple_clarify(traits::elem_tuple(res),
+					    key_def->iid) : 0;
 }
 
+template <bool USE_HINT>
 struct tuple *
-MemtxTree::findByKey(const char *key, uint32_t part_count) const
+MemtxTree<USE_HINT>::findByKey(const char *key, uint32_t part_count) const
 {
 	assert(key_def->opts.is_unique && part_count == key_def->part_count);
 
 	struct key_data key_data;
 	key_data.key = key;
 	key_data.part_count = part_count;
-	struct tuple **res = memtx_tree_find(&tree, &key_data);
-	return res ? *res : 0;
+	key_data.hint = key_hint(key, part_count, key_def);
+	typename traits::elem *res = traits::find(&tree, &key_data);
+	return res ? memtx_tx_tuple_clarify(traits::elem_tuple(res),
+					    key_def->iid) : 0;
 }
 
+template <bool USE_HINT>
 struct tuple *
-MemtxTree::replace(struct tuple *old_tuple, struct tuple *new_tuple,
-		   enum dup_replace_mode mode)
+MemtxTree<USE_HINT>::replace(struct tuple *old_tuple, struct tuple *new_tuple,
+			     enum dup_replace_mode mode)
 {
 	uint32_t errcode;
 
 	if (new_tuple) {
-		struct tuple *dup_tuple = NULL;
+		typename traits::elem new_data;
+		traits::elem_init(&new_data, new_tuple, key_def);
+		typename traits::elem dup_data;
+		memset(&dup_data, 0, sizeof(dup_data));
 
 		/* Try to optimistically replace the new_tuple. */
 		int tree_res =
-		memtx_tree_insert(&tree, new_tuple, &dup_tuple);
+		traits::insert(&tree, new_data, &dup_data);
 		if (tree_res) {
-			tnt_raise(OutOfMemory, BPS_TREE_EXTENT_SIZE,
+			tnt_raise(OutOfMemory, MEMTX_EXTENT_SIZE,
 				  "MemtxTree", "replace");
 		}
 
+		struct tuple *dup_tuple = traits::elem_tuple(&dup_data);
 		errcode = replace_check_dup(old_tuple, dup_tuple, mode);
 
 		if (errcode) {
-			memtx_tree_delete(&tree, new_tuple);
+			traits::remove(&tree, new_data);
 			if (dup_tuple)
-				memtx_tree_insert(&tree, dup_tuple, 0);
+				traits::insert(&tree, dup_data, 0);
 			struct space *sp = space_cache_find(key_def->space_id);
 			tnt_raise(ClientError, errcode, index_name(this),
 				  space_name(sp));
@@ -264,34 +370,41 @@ MemtxTree::replace(struct tuple *old_tuple, struct tuple *new_tuple,
 			return dup_tuple;
 	}
 	if (old_tuple) {
-		memtx_tree_delete(&tree, old_tuple);
+		typename traits::elem old_data;
+		traits::elem_init(&old_data, old_tuple, key_def);
+		traits::remove(&tree, old_data);
 	}
 	return old_tuple;
 }
 
+template <bool USE_HINT>
 struct iterator *
-MemtxTree::allocIterator() const
+MemtxTree<USE_HINT>::allocIterator() const
 {
-	struct tree_iterator *it = (struct tree_iterator *)
+	struct tree_iterator<USE_HINT> *it = (struct tree_iterator<USE_HINT> *)
 			calloc(1, sizeof(*it));
 	if (it == NULL) {
-		tnt_raise(OutOfMemory, sizeof(struct tree_iterator),
+		tnt_raise(OutOfMemory, sizeof(struct tree_iterator<USE_HINT>),
 			  "MemtxTree", "iterator");
 	}
 
 	it->key_def = key_def;
 	it->tree = &tree;
 	it->base.free = tree_iterator_free;
-	it->tree_iterator = memtx_tree_invalid_iterator();
+	it->base.index = (Index *) this;
+	it->tree_iterator = traits::invalid_iterator();
 	return (struct iterator *) it;
 }
 
+template <bool USE_HINT>
 void
-MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
-			const char *key, uint32_t part_count) const
+MemtxTree<USE_HINT>::initIterator(struct iterator *iterator,
+				  enum iterator_type type,
+				  const char *key, uint32_t part_count) const
 {
 	assert(part_count == 0 || key != NULL);
-	struct tree_iterator *it = tree_iterator(iterator);
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
 
 	if (part_count == 0) {
 		/*
@@ -307,22 +420,23 @@ MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
 	}
 	it->key_data.key = key;
 	it->key_data.part_count = part_count;
+	it->key_data.hint = key_hint(key, part_count, key_def);
 
 	bool exact = false;
 	if (key == 0) {
 		if (iterator_type_is_reverse(type))
-			it->tree_iterator = memtx_tree_invalid_iterator();
+			it->tree_iterator = traits::invalid_iterator();
 		else
-			it->tree_iterator = memtx_tree_iterator_first(&tree);
+			it->tree_iterator = traits::iterator_first(&tree);
 	} else {
 		if (type == ITER_ALL || type == ITER_EQ || type == ITER_GE || type == ITER_LT) {
-			it->tree_iterator = memtx_tree_lower_bound(&tree, &it->key_data, &exact);
+			it->tree_iterator = traits::lower_bound(&tree, &it->key_data, &exact);
 			if (type == ITER_EQ && !exact) {
 				it->base.next = tree_iterator_dummie;
 				return;
 			}
 		} else { // ITER_GT, ITER_REQ, ITER_LE
-			it->tree_iterator = memtx_tree_upper_bound(&tree, &it->key_data, &exact);
+			it->tree_iterator = traits::upper_bound(&tree, &it->key_data, &exact);
 			if (type == ITER_REQ && !exact) {
 				it->base.next = tree_iterator_dummie;
 				return;
@@ -332,97 +446,164 @@ MemtxTree::initIterator(struct iterator *iterator, enum iterator_type type,
 
 	switch (type) {
 	case ITER_EQ:
-		it->base.next = tree_iterator_fwd_check_next_equality;
+		it->base.next = tree_iterator_fwd_check_next_equality<USE_HINT>;
 		break;
 	case ITER_REQ:
-		it->base.next = tree_iterator_bwd_skip_one_check_next_equality;
+		it->base.next =
+			tree_iterator_bwd_skip_one_check_next_equality<USE_HINT>;
 		break;
 	case ITER_ALL:
 	case ITER_GE:
-		it->base.next = tree_iterator_fwd;
+		it->base.next = tree_iterator_fwd<USE_HINT>;
 		break;
 	case ITER_GT:
-		it->base.next = tree_iterator_fwd;
+		it->base.next = tree_iterator_fwd<USE_HINT>;
 		break;
 	case ITER_LE:
-		it->base.next = tree_iterator_bwd_skip_one;
+		it->base.next = tree_iterator_bwd_skip_one<USE_HINT>;
 		break;
 	case ITER_LT:
-		it->base.next = tree_iterator_bwd_skip_one;
+		it->base.next = tree_iterator_bwd_skip_one<USE_HINT>;
 		break;
 	default:
 		return Index::initIterator(iterator, type, key, part_count);
 	}
 }
 
+template <bool USE_HINT>
+void
+MemtxTree<USE_HINT>::initIteratorWithOffset(struct iterator *iterator,
+					    enum iterator_type type,
+					    const char *key,
+					    uint32_t part_count,
+					    uint32_t offset,
+					    uint32_t limit) const
+{
+	if (type < 0 || type > ITER_GT || memtx_tx_has_stories()) {
+		MemtxIndex::initIteratorWithOffset(iterator, type, key,
+						   part_count, offset, limit);
+		return;
+	}
+	initIterator(iterator, type, key, part_count);
+	if (offset == 0 || iterator->next == tree_iterator_dummie)
+		return;
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	size_t begin, end;
+	memtx_tree_range<USE_HINT>(&tree, type, &it->key_data, &begin, &end);
+	if (offset >= end - begin) {
+		it->base.next = tree_iterator_dummie;
+		return;
+	}
+	/*
+	 * Reverse iterators step back before returning a tuple,
+	 * so they must be positioned past the first one to return.
+	 */
+	if (iterator_type_is_reverse(type))
+		it->tree_iterator = traits::iterator_at(&tree, end - offset);
+	else
+		it->tree_iterator = traits::iterator_at(&tree, begin + offset);
+}
+
+template <bool USE_HINT>
 void
-MemtxTree::beginBuild()
+MemtxTree<USE_HINT>::beginBuild()
 {
-	assert(memtx_tree_size(&tree) == 0);
+	assert(traits::size(&tree) == 0);
 }
 
+template <bool USE_HINT>
 void
-MemtxTree::reserve(uint32_t size_hint)
+MemtxTree<USE_HINT>::reserve(uint32_t size_hint)
 {
 	if (size_hint < build_array_alloc_size)
 		return;
-	build_array = (struct tuple**)
-		realloc(build_array, size_hint * sizeof(struct tuple *));
+	build_array = (typename traits::elem *)
+		realloc(build_array, size_hint * sizeof(build_array[0]));
 	build_array_alloc_size = size_hint;
 }
 
+template <bool USE_HINT>
 void
-MemtxTree::buildNext(struct tuple *tuple)
+MemtxTree<USE_HINT>::buildNext(struct tuple *tuple)
 {
 	if (!build_array) {
-		build_array = (struct tuple**)malloc(BPS_TREE_EXTENT_SIZE);
+		build_array = (typename traits::elem *)
+			malloc(MEMTX_EXTENT_SIZE);
 		build_array_alloc_size =
-			BPS_TREE_EXTENT_SIZE / sizeof(struct tuple*);
+			MEMTX_EXTENT_SIZE / sizeof(build_array[0]);
 	}
 	assert(build_array_size <= build_array_alloc_size);
 	if (build_array_size == build_array_alloc_size) {
 		build_array_alloc_size = build_array_alloc_size +
 					 build_array_alloc_size / 2;
-		build_array = (struct tuple**)
+		build_array = (typename traits::elem *)
 			realloc(build_array,
 				build_array_alloc_size *
-				sizeof(struct tuple *));
+				sizeof(build_array[0]));
 	}
-	build_array[build_array_size++] = tuple;
+	traits::elem_init(&build_array[build_array_size++], tuple, key_def);
 }
 
+template <bool USE_HINT>
 void
-MemtxTree::endBuild()
+MemtxTree<USE_HINT>::prepareBuild()
 {
-	qsort_arg(build_array, build_array_size, sizeof(struct tuple *), memtx_tree_qcompare, key_def);
-	memtx_tree_build(&tree, build_array, build_array_size);
+	qsort_arg(build_array, build_array_size, sizeof(build_array[0]),
+		  traits::elem_qcompare, key_def);
+	build_array_is_sorted = true;
+}
+
+template <bool USE_HINT>
+bool
+MemtxTree<USE_HINT>::canPrepareBuildInThread() const
+{
+	/* The build array is allocated with malloc(). */
+	return true;
+}
+
+template <bool USE_HINT>
+void
+MemtxTree<USE_HINT>::endBuild()
+{
+	if (!build_array_is_sorted)
+		prepareBuild();
+	traits::build(&tree, build_array, build_array_size);
 
 	free(build_array);
 	build_array = 0;
 	build_array_size = 0;
 	build_array_alloc_size = 0;
+	build_array_is_sorted = false;
 }
 
 /**
  * Create a read view for iterator so further index modifications
  * will not affect the iterator iteration.
  */
+template <bool USE_HINT>
 void
-MemtxTree::createReadViewForIterator(struct iterator *iterator)
+MemtxTree<USE_HINT>::createReadViewForIterator(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	struct memtx_tree *tree = (struct memtx_tree *)it->tree;
-	memtx_tree_iterator_freeze(tree, &it->tree_iterator);
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	typename traits::tree *tree = (typename traits::tree *)it->tree;
+	traits::iterator_freeze(tree, &it->tree_iterator);
 }
 
 /**
  * Destroy a read view of an iterator. Must be called for iterators,
  * for which createReadViewForIterator was called.
  */
+template <bool USE_HINT>
 void
-MemtxTree::destroyReadViewForIterator(struct iterator *iterator)
+MemtxTree<USE_HINT>::destroyReadViewForIterator(struct iterator *iterator)
 {
-	struct tree_iterator *it = tree_iterator(iterator);
-	struct memtx_tree *tree = (struct memtx_tree *)it->tree;
-	memtx_tree_iterator_destroy(tree, &it->tree_iterator);
+	struct tree_iterator<USE_HINT> *it =
+		tree_iterator_cast<USE_HINT>(iterator);
+	typename traits::tree *tree = (typename traits::tree *)it->tree;
+	traits::iterator_destroy(tree, &it->tree_iterator);
 }
+
+template class MemtxTree<false>;
+template class MemtxTree<true>;
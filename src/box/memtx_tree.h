@@ -33,15 +33,72 @@
 
 #include "memtx_index.h"
 #include "memtx_engine.h"
+#include "tuple_compare.h"
 
-struct tuple;
-struct key_data;
+/** A search key of a TREE index. */
+struct key_data {
+	/** Key parts without MessagePack array header. */
+	const char *key;
+	/** The number of parts in the key. */
+	uint32_t part_count;
+	/** Comparison hint of the key, see key_hint(). */
+	uint64_t hint;
+};
+
+/**
+ * Compare two tuples of a TREE index. Equal tuples of
+ * a non-unique index are ordered by address, since all
+ * elements of the tree must differ.
+ */
+static inline int
+memtx_tree_compare(const struct tuple *a, const struct tuple *b,
+		   struct key_def *key_def)
+{
+	int r = tuple_compare(a, b, key_def);
+	if (r == 0 && !key_def->opts.is_unique)
+		r = a < b ? -1 : a > b;
+	return r;
+}
+
+static inline int
+memtx_tree_compare_key(const struct tuple *a,
+		       const struct key_data *key_data,
+		       struct key_def *key_def)
+{
+	return tuple_compare_with_key(a, key_data->key,
+				      key_data->part_count, key_def);
+}
 
-int
-memtx_tree_compare(const struct tuple *a, const struct tuple *b, struct key_def *key_def);
+/**
+ * An element of a TREE index with hint = true. An index
+ * with hint = false stores bare tuple pointers instead.
+ */
+struct memtx_tree_data {
+	/** The indexed tuple. */
+	struct tuple *tuple;
+	/** Comparison hint of the tuple, see tuple_hint(). */
+	uint64_t hint;
+};
 
-int
-memtx_tree_compare_key(const tuple *a, const key_data *b, struct key_def *key_def);
+static inline int
+memtx_hint_tree_compare(const struct memtx_tree_data *a,
+			const struct memtx_tree_data *b,
+			struct key_def *key_def)
+{
+	if (a->hint != b->hint)
+		return a->hint < b->hint ? -1 : 1;
+	return memtx_tree_compare(a->tuple, b->tuple, key_def);
+}
+
+static inline int
+memtx_hint_tree_compare_key(const struct memtx_tree_data *a,
+			    const struct key_data *key_data,
+			    struct key_def *key_def)
+{
+	if (key_data->part_count > 0 && a->hint != key_data->hint)
+		return a->hint < key_data->hint ? -1 : 1;
+	return memtx_tree_compare_key(a->tuple, key_data, key_def);
+}
 
 #define BPS_TREE_NAME memtx_tree
 #define BPS_TREE_BLOCK_SIZE (512)
@@ -51,19 +108,243 @@ memtx_tree_compare_key(const tuple *a, const key_data *b, struct key_def *key_de
 #define bps_tree_elem_t struct tuple *
 #define bps_tree_key_t struct key_data *
 #define bps_tree_arg_t struct key_def *
+#define BPS_TREE_NO_DEBUG
+#define BPS_TREE_INNER_ELEM_COUNT
+
+#include "salad/bps_tree.h"
+
+#undef BPS_TREE_NAME
+#undef BPS_TREE_BLOCK_SIZE
+#undef BPS_TREE_EXTENT_SIZE
+#undef BPS_TREE_COMPARE
+#undef BPS_TREE_COMPARE_KEY
+#undef bps_tree_elem_t
+#undef bps_tree_key_t
+#undef bps_tree_arg_t
+#undef BPS_TREE_NO_DEBUG
+#undef BPS_TREE_INNER_ELEM_COUNT
+
+#define BPS_TREE_NAME memtx_hint_tree
+#define BPS_TREE_BLOCK_SIZE (512)
+#define BPS_TREE_EXTENT_SIZE MEMTX_EXTENT_SIZE
+#define BPS_TREE_COMPARE(a, b, arg) memtx_hint_tree_compare(&(a), &(b), arg)
+#define BPS_TREE_COMPARE_KEY(a, b, arg) memtx_hint_tree_compare_key(&(a), b, arg)
+#define bps_tree_elem_t struct memtx_tree_data
+#define bps_tree_key_t struct key_data *
+#define bps_tree_arg_t struct key_def *
+#define BPS_TREE_NO_DEBUG
+#define BPS_TREE_INNER_ELEM_COUNT
 
 #include "salad/bps_tree.h"
 
+#undef BPS_TREE_NAME
+#undef BPS_TREE_BLOCK_SIZE
+#undef BPS_TREE_EXTENT_SIZE
+#undef BPS_TREE_COMPARE
+#undef BPS_TREE_COMPARE_KEY
+#undef bps_tree_elem_t
+#undef bps_tree_key_t
+#undef bps_tree_arg_t
+#undef BPS_TREE_NO_DEBUG
+#undef BPS_TREE_INNER_ELEM_COUNT
+
+/**
+ * Wrap the functions of the bps_tree instantiation @a name,
+ * so that MemtxTree calls them by the same names for both
+ * element layouts.
+ */
+#define MEMTX_TREE_TRAITS_OPS(name)					\
+	typedef struct name tree;					\
+	typedef struct name##_iterator iterator;			\
+	static void							\
+	create(tree *t, struct key_def *key_def)			\
+	{								\
+		name##_create(t, key_def, memtx_index_extent_alloc,	\
+			      memtx_index_extent_free, NULL);		\
+	}								\
+	static void destroy(tree *t) { name##_destroy(t); }		\
+	static size_t size(const tree *t) { return name##_size(t); }	\
+	static size_t							\
+	mem_used(const tree *t) { return name##_mem_used(t); }		\
+	static elem *							\
+	random(const tree *t, size_t rnd)				\
+	{								\
+		return name##_random(t, rnd);				\
+	}								\
+	static elem *							\
+	find(const tree *t, struct key_data *key)			\
+	{								\
+		return name##_find(t, key);				\
+	}								\
+	static int							\
+	insert(tree *t, elem new_elem, elem *replaced)			\
+	{								\
+		return name##_insert(t, new_elem, replaced);		\
+	}								\
+	static int							\
+	remove(tree *t, elem old_elem)					\
+	{								\
+		return name##_delete(t, old_elem);			\
+	}								\
+	static int							\
+	build(tree *t, elem *sorted_array, size_t array_size)		\
+	{								\
+		return name##_build(t, sorted_array, array_size);	\
+	}								\
+	static iterator							\
+	invalid_iterator() { return name##_invalid_iterator(); }	\
+	static iterator							\
+	iterator_first(const tree *t)					\
+	{								\
+		return name##_iterator_first(t);			\
+	}								\
+	static iterator							\
+	lower_bound(const tree *t, struct key_data *key, bool *exact)	\
+	{								\
+		return name##_lower_bound(t, key, exact);		\
+	}								\
+	static iterator							\
+	upper_bound(const tree *t, struct key_data *key, bool *exact)	\
+	{								\
+		return name##_upper_bound(t, key, exact);		\
+	}								\
+	static iterator							\
+	lower_bound_get_offset(const tree *t, struct key_data *key,	\
+			       size_t *offset)				\
+	{								\
+		return name##_lower_bound_get_offset(t, key, NULL,	\
+						     offset);		\
+	}								\
+	static iterator							\
+	upper_bound_get_offset(const tree *t, struct key_data *key,	\
+			       size_t *offset)				\
+	{								\
+		return name##_upper_bound_get_offset(t, key, NULL,	\
+						     offset);		\
+	}								\
+	static iterator							\
+	iterator_at(const tree *t, size_t offset)			\
+	{								\
+		return name##_iterator_at(t, offset);			\
+	}								\
+	static elem *							\
+	iterator_get_elem(const tree *t, iterator *itr)			\
+	{								\
+		return name##_iterator_get_elem(t, itr);		\
+	}								\
+	static bool							\
+	iterator_next(const tree *t, iterator *itr)			\
+	{								\
+		return name##_iterator_next(t, itr);			\
+	}								\
+	static bool							\
+	iterator_prev(const tree *t, iterator *itr)			\
+	{								\
+		return name##_iterator_prev(t, itr);			\
+	}								\
+	static void							\
+	iterator_freeze(tree *t, iterator *itr)				\
+	{								\
+		name##_iterator_freeze(t, itr);				\
+	}								\
+	static void							\
+	iterator_destroy(tree *t, iterator *itr)			\
+	{								\
+		name##_iterator_destroy(t, itr);			\
+	}
+
+/**
+ * The tree and the element layout of a TREE index, chosen
+ * by the index option hint, see MemtxTree.
+ */
+template <bool USE_HINT>
+struct memtx_tree_traits;
+
+template <>
+struct memtx_tree_traits<false> {
+	typedef struct tuple *elem;
+	MEMTX_TREE_TRAITS_OPS(memtx_tree)
+
+	static struct tuple *
+	elem_tuple(const elem *e)
+	{
+		return *e;
+	}
+	static void
+	elem_init(elem *e, struct tuple *tuple, struct key_def *key_def)
+	{
+		(void) key_def;
+		*e = tuple;
+	}
+	static int
+	elem_compare_key(const elem *e, const struct key_data *key_data,
+			 struct key_def *key_def)
+	{
+		return memtx_tree_compare_key(*e, key_data, key_def);
+	}
+	static int
+	elem_qcompare(const void *a, const void *b, void *key_def)
+	{
+		return memtx_tree_compare(*(const elem *)a, *(const elem *)b,
+					  (struct key_def *)key_def);
+	}
+};
+
+template <>
+struct memtx_tree_traits<true> {
+	typedef struct memtx_tree_data elem;
+	MEMTX_TREE_TRAITS_OPS(memtx_hint_tree)
+
+	static struct tuple *
+	elem_tuple(const elem *e)
+	{
+		return e->tuple;
+	}
+	static void
+	elem_init(elem *e, struct tuple *tuple, struct key_def *key_def)
+	{
+		e->tuple = tuple;
+		e->hint = tuple_hint(tuple, key_def);
+	}
+	static int
+	elem_compare_key(const elem *e, const struct key_data *key_data,
+			 struct key_def *key_def)
+	{
+		return memtx_hint_tree_compare_key(e, key_data, key_def);
+	}
+	static int
+	elem_qcompare(const void *a, const void *b, void *key_def)
+	{
+		return memtx_hint_tree_compare((const elem *)a,
+					       (const elem *)b,
+					       (struct key_def *)key_def);
+	}
+};
+
+#undef MEMTX_TREE_TRAITS_OPS
+
+/**
+ * A memtx TREE index. An index with hint = false stores bare
+ * tuple pointers in the tree, one with hint = true stores them
+ * along with comparison hints, see struct memtx_tree_data.
+ */
+template <bool USE_HINT>
 class MemtxTree: public MemtxIndex {
 public:
+	typedef memtx_tree_traits<USE_HINT> traits;
+
 	MemtxTree(struct key_def *key_def);
 	virtual ~MemtxTree() override;
 
 	virtual void beginBuild() override;
 	virtual void reserve(uint32_t size_hint) override;
 	virtual void buildNext(struct tuple *tuple) override;
+	virtual void prepareBuild() override;
+	virtual bool canPrepareBuildInThread() const override;
 	virtual void endBuild() override;
 	virtual size_t size() const override;
+	virtual size_t count(enum iterator_type type, const char *key,
+			     uint32_t part_count) const override;
 	virtual struct tuple *random(uint32_t rnd) const override;
 	virtual struct tuple *findByKey(const char *key,
 					uint32_t part_count) const override;
@@ -77,6 +358,12 @@ public:
 				  enum iterator_type type,
 				  const char *key,
 				  uint32_t part_count) const override;
+	virtual void initIteratorWithOffset(struct iterator *iterator,
+					    enum iterator_type type,
+					    const char *key,
+					    uint32_t part_count,
+					    uint32_t offset,
+					    uint32_t limit) const override;
 
 	/**
 	 * Create a read view for iterator so further index modifications
@@ -90,9 +377,11 @@ public:
 	virtual void destroyReadViewForIterator(struct iterator *iterator) override;
 
 // protected:
-	struct memtx_tree tree;
-	struct tuple **build_array;
+	typename traits::tree tree;
+	typename traits::elem *build_array;
 	size_t build_array_size, build_array_alloc_size;
+	/** Set by prepareBuild(), so that endBuild() doesn't sort again. */
+	bool build_array_is_sorted;
 };
 
 #endif /* TARANTOOL_BOX_MEMTX_TREE_H_INCLUDED */
@@ -30,6 +30,8 @@
  */
 
 #include "memtx_tuple.h"
+#include "tuple_compression.h"
+#include "memtx_arena.h"
 
 #include "small/small.h"
 #include "small/region.h"
@@ -71,7 +73,8 @@ enum {
 
 void
 memtx_tuple_init(float tuple_arena_max_size, uint32_t objsize_min,
-		 uint32_t objsize_max, float alloc_factor)
+		 uint32_t objsize_max, float alloc_factor, bool huge_pages,
+		 const char *numa)
 {
 	/* Apply lowest allowed objsize bounds */
 	if (objsize_min < OBJSIZE_MIN)
@@ -83,6 +86,9 @@ memtx_tuple_init(float tuple_arena_max_size, uint32_t objsize_min,
 	size_t slab_size = small_round(objsize_max * 4);
 	if (slab_size < SLAB_SIZE_MIN)
 		slab_size = SLAB_SIZE_MIN;
+	/* A slab must consist of whole huge pages */
+	if (huge_pages && slab_size < memtx_arena_huge_page_size())
+		slab_size = memtx_arena_huge_page_size();
 
 	/*
 	 * Ensure that quota is a multiple of slab_size, to
@@ -95,8 +101,8 @@ memtx_tuple_init(float tuple_arena_max_size, uint32_t objsize_min,
 
 	say_info("mapping %zu bytes for tuple arena...", prealloc);
 
-	if (slab_arena_create(&memtx_arena, &memtx_quota,
-			      prealloc, slab_size, MAP_PRIVATE)) {
+	if (memtx_arena_create(&memtx_arena, &memtx_quota, prealloc,
+			       slab_size, huge_pages, numa)) {
 		if (ENOMEM == errno) {
 			panic("failed to preallocate %zu bytes: "
 			      "Cannot allocate memory, check option "
@@ -126,11 +132,20 @@ memtx_tuple_new(struct tuple_format *format, const char *data, const char *end)
 {
 	assert(mp_typeof(*data) == MP_ARRAY);
 	size_t tuple_len = end - data;
-	size_t total =
-		sizeof(struct memtx_tuple) + tuple_len + format->field_map_size;
+	struct region *region = &fiber()->gc;
+	size_t region_svp = region_used(region);
+	uint32_t prefix_len = 0, zsize = 0;
+	const char *zdata = NULL;
+	if (format->compression != NULL)
+		zdata = tuple_compress(format, data, end, &prefix_len, &zsize);
+	size_t header_size = zdata != NULL ? sizeof(struct tuple_compressed) : 0;
+	size_t bsize = zdata != NULL ? prefix_len + zsize : tuple_len;
+	size_t total = sizeof(struct memtx_tuple) + header_size + bsize +
+		       format->field_map_size;
 	ERROR_INJECT(ERRINJ_TUPLE_ALLOC,
 		     do { diag_set(OutOfMemory, (unsigned) total,
-				   "slab allocator", "memtx_tuple"); return NULL; }
+				   "slab allocator", "memtx_tuple");
+			  region_truncate(region, region_svp); return NULL; }
 		     while(false); );
 	struct memtx_tuple *memtx_tuple =
 		(struct memtx_tuple *) smalloc(&memtx_alloc, total);
@@ -151,24 +166,43 @@ memtx_tuple_new(struct tuple_format *format, const char *data, const char *end)
 			diag_set(OutOfMemory, (unsigned) total,
 				 "slab allocator", "memtx_tuple");
 		}
+		region_truncate(region, region_svp);
 		return NULL;
 	}
 	struct tuple *tuple = &memtx_tuple->base;
-	tuple->refs = 0;
+	tuple_create(tuple, 0, format);
+	tuple->is_compressed = zdata != NULL;
 	memtx_tuple->version = snapshot_version;
-	tuple->bsize = tuple_len;
-	tuple->format_id = tuple_format_id(format);
-	tuple_format_ref(format, 1);
+	tuple->bsize = bsize;
 	/*
 	 * Data offset is calculated from the begin of the struct
 	 * tuple base, not from memtx_tuple, because the struct
 	 * tuple is not the first field of the memtx_tuple.
 	 */
-	tuple->data_offset = sizeof(struct tuple) + format->field_map_size;
+	tuple->data_offset = sizeof(struct tuple) + header_size +
+			     format->field_map_size;
 	char *raw = (char *) tuple + tuple->data_offset;
 	uint32_t *field_map = (uint32_t *) raw;
-	memcpy(raw, data, tuple_len);
-	if (tuple_init_field_map(format, field_map, raw)) {
+	if (zdata != NULL) {
+		struct tuple_compressed *header =
+			(struct tuple_compressed *) (tuple + 1);
+		header->raw_bsize = tuple_len;
+		header->prefix_bsize = prefix_len;
+		header->compression = format->compression;
+		memcpy(raw, data, prefix_len);
+		memcpy(raw + prefix_len, zdata, zsize);
+		region_truncate(region, region_svp);
+		tuple_compression_stat.raw_size += tuple_len;
+		tuple_compression_stat.size += bsize;
+	} else {
+		memcpy(raw, data, tuple_len);
+	}
+	/*
+	 * The offsets in the field map are the same for the
+	 * plain and the compressed MessagePack, but only the
+	 * plain one has all of the fields to check.
+	 */
+	if (tuple_init_field_map(format, field_map, data)) {
 		memtx_tuple_delete(format, tuple);
 		return NULL;
 	}
@@ -181,8 +215,13 @@ memtx_tuple_delete(struct tuple_format *format, struct tuple *tuple)
 {
 	say_debug("%s(%p)", __func__, tuple);
 	assert(tuple->refs == 0);
-	size_t total = sizeof(struct memtx_tuple) + tuple->bsize +
-		       format->field_map_size;
+	size_t total = memtx_tuple_size(tuple);
+	if (tuple->is_compressed) {
+		tuple_compression_stat.raw_size -=
+			tuple_compressed(tuple)->raw_bsize;
+		tuple_compression_stat.size -= tuple->bsize;
+		tuple_decompress_cache_drop(tuple);
+	}
 	tuple_format_ref(format, -1);
 	struct memtx_tuple *memtx_tuple =
 		container_of(tuple, struct memtx_tuple, base);
@@ -193,17 +232,57 @@ memtx_tuple_delete(struct tuple_format *format, struct tuple *tuple)
 		smfree_delayed(&memtx_alloc, memtx_tuple, total);
 }
 
+size_t
+memtx_tuple_size(const struct tuple *tuple)
+{
+	/* Data offset includes the field map and the compression header. */
+	return sizeof(struct memtx_tuple) - sizeof(struct tuple) +
+	       tuple->data_offset + tuple->bsize;
+}
+
+struct tuple *
+memtx_tuple_relocate(struct tuple *tuple, uint32_t slab_size)
+{
+	assert(!memtx_alloc.is_delayed_free_mode);
+	struct memtx_tuple *memtx_tuple =
+		container_of(tuple, struct memtx_tuple, base);
+	size_t total = memtx_tuple_size(tuple);
+	struct memtx_tuple *copy =
+		(struct memtx_tuple *) smalloc(&memtx_alloc, total);
+	if (copy == NULL)
+		return NULL;
+	uintptr_t slab_mask = ~((uintptr_t) slab_size - 1);
+	if (((uintptr_t) copy & slab_mask) >=
+	    ((uintptr_t) memtx_tuple & slab_mask)) {
+		smfree(&memtx_alloc, copy, total);
+		return NULL;
+	}
+	/* The field map and the data are addressed by offsets. */
+	memcpy(copy, memtx_tuple, total);
+	copy->version = snapshot_version;
+	copy->base.refs = 0;
+	tuple_format_ref(tuple_format(tuple), 1);
+	if (tuple->is_compressed) {
+		tuple_compression_stat.raw_size +=
+			tuple_compressed(tuple)->raw_bsize;
+		tuple_compression_stat.size += tuple->bsize;
+	}
+	return &copy->base;
+}
+
 void
 memtx_tuple_begin_snapshot()
 {
 	snapshot_version++;
 	small_alloc_setopt(&memtx_alloc, SMALL_DELAYED_FREE_MODE, true);
+	tuple_compression_set_delayed_free_mode(true);
 }
 
 void
 memtx_tuple_end_snapshot()
 {
 	small_alloc_setopt(&memtx_alloc, SMALL_DELAYED_FREE_MODE, false);
+	tuple_compression_set_delayed_free_mode(false);
 }
 
 box_tuple_t *
@@ -212,6 +291,8 @@ box_tuple_update(const box_tuple_t *tuple, const char *expr,
 {
 	uint32_t new_size = 0, bsize;
 	const char *old_data = tuple_data_range(tuple, &bsize);
+	if (old_data == NULL)
+		return NULL;
 	struct region *region = &fiber()->gc;
 	size_t used = region_used(region);
 	const char *new_data =
@@ -237,6 +318,8 @@ box_tuple_upsert(const box_tuple_t *tuple, const char *expr,
 {
 	uint32_t new_size = 0, bsize;
 	const char *old_data = tuple_data_range(tuple, &bsize);
+	if (old_data == NULL)
+		return NULL;
 	struct region *region = &fiber()->gc;
 	size_t used = region_used(region);
 	const char *new_data =
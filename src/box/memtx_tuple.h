@@ -44,7 +44,8 @@ extern "C" {
  */
 void
 memtx_tuple_init(float tuple_arena_max_size, uint32_t objsize_min,
-		uint32_t objsize_max, float alloc_factor);
+		uint32_t objsize_max, float alloc_factor, bool huge_pages,
+		const char *numa);
 
 /**
  * Cleanup memtx_tuple library
@@ -63,6 +64,20 @@ memtx_tuple_new(struct tuple_format *format, const char *data, const char *end);
 void
 memtx_tuple_delete(struct tuple_format *format, struct tuple *tuple);
 
+/** Size of the memory taken by a memtx tuple. */
+size_t
+memtx_tuple_size(const struct tuple *tuple);
+
+/**
+ * Copy a tuple to a slab with a lower address, to let its
+ * slab become empty, @sa memtx_compact.h. @a slab_size is
+ * the slab size of the size class of the tuple.
+ * @retval NULL there is no free item in a lower slab
+ * @retval the copy with zero reference counter
+ */
+struct tuple *
+memtx_tuple_relocate(struct tuple *tuple, uint32_t slab_size);
+
 /** tuple format vtab for memtx engine. */
 extern struct tuple_format_vtab memtx_tuple_format_vtab;
 
@@ -0,0 +1,613 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "memtx_tx.h"
+
+#include "assoc.h"
+#include "fiber.h"
+#include "memtx_engine.h"
+#include "schema.h"
+#include "space.h"
+#include "tuple.h"
+#include "txn.h"
+
+bool memtx_tx_manager_use_mvcc_engine = false;
+
+/** The memtx engine, to tell memtx transactions from others. */
+static Engine *memtx_tx_engine;
+
+/** Per-index part of a tuple story. */
+struct memtx_story_link {
+	/**
+	 * The tuple replaced in the index when the tuple of the
+	 * story was inserted. The transaction which did it is not
+	 * prepared yet, so the replaced tuple may still be visible
+	 * to others.
+	 */
+	struct tuple *older;
+	/** True if the tuple of the story is in the index. */
+	bool in_index;
+};
+
+/**
+ * History of a tuple inserted or deleted by a transaction
+ * which is not prepared yet.
+ */
+struct memtx_story {
+	struct tuple *tuple;
+	struct space *space;
+	/** The transaction which inserted the tuple or NULL. */
+	struct txn *add_txn;
+	/** The transaction which deleted the tuple or NULL. */
+	struct txn *del_txn;
+	/** Number of links, space->index_id_max + 1. */
+	uint32_t link_count;
+	/** Links, by index id. */
+	struct memtx_story_link link[0];
+};
+
+/** Memtx part of a transaction, txn->engine_tx. */
+struct memtx_tx {
+	struct txn *txn;
+	/** Link in memtx_tx_active. */
+	struct rlist in_active;
+	/** Tuples read by the transaction, created on demand. */
+	struct mh_i64ptr_t *read_set;
+	/**
+	 * Set if a tuple read by the transaction was overwritten
+	 * by a prepared transaction.
+	 */
+	bool is_conflicted;
+};
+
+/** Tuple -> struct memtx_story. */
+static struct mh_i64ptr_t *memtx_tx_stories;
+/** Multi-statement transactions which are not prepared yet. */
+static RLIST_HEAD(memtx_tx_active);
+
+void
+memtx_tx_manager_init(Engine *engine, bool use_mvcc)
+{
+	memtx_tx_engine = engine;
+	memtx_tx_manager_use_mvcc_engine = use_mvcc;
+	memtx_tx_stories = mh_i64ptr_new();
+	if (memtx_tx_stories == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*memtx_tx_stories),
+			  "malloc", "memtx_tx_stories");
+	}
+}
+
+void
+memtx_tx_manager_free()
+{
+	mh_int_t k;
+	mh_foreach(memtx_tx_stories, k)
+		free(mh_i64ptr_node(memtx_tx_stories, k)->val);
+	mh_i64ptr_delete(memtx_tx_stories);
+	memtx_tx_stories = NULL;
+}
+
+/* {{{ Stories */
+
+static struct memtx_story *
+memtx_story_find(struct tuple *tuple)
+{
+	mh_int_t k = mh_i64ptr_find(memtx_tx_stories, (uint64_t) tuple, NULL);
+	if (k == mh_end(memtx_tx_stories))
+		return NULL;
+	return (struct memtx_story *) mh_i64ptr_node(memtx_tx_stories, k)->val;
+}
+
+static struct memtx_story *
+memtx_story_new(struct tuple *tuple, struct space *space)
+{
+	uint32_t link_count = space->index_id_max + 1;
+	size_t size = sizeof(struct memtx_story) +
+		      link_count * sizeof(struct memtx_story_link);
+	struct memtx_story *story = (struct memtx_story *) malloc(size);
+	if (story == NULL)
+		tnt_raise(OutOfMemory, size, "malloc", "struct memtx_story");
+	story->tuple = tuple;
+	story->space = space;
+	story->add_txn = NULL;
+	story->del_txn = NULL;
+	story->link_count = link_count;
+	for (uint32_t i = 0; i < link_count; i++) {
+		story->link[i].older = NULL;
+		story->link[i].in_index = true;
+	}
+	struct mh_i64ptr_node_t node = { (uint64_t) tuple, story };
+	if (mh_i64ptr_put(memtx_tx_stories, &node, NULL, NULL) ==
+	    mh_end(memtx_tx_stories)) {
+		free(story);
+		tnt_raise(OutOfMemory, sizeof(node), "mh_i64ptr_put",
+			  "mh_i64ptr_node_t");
+	}
+	return story;
+}
+
+static void
+memtx_story_delete(struct memtx_story *story)
+{
+	mh_int_t k = mh_i64ptr_find(memtx_tx_stories,
+				    (uint64_t) story->tuple, NULL);
+	assert(k != mh_end(memtx_tx_stories));
+	mh_i64ptr_del(memtx_tx_stories, k, NULL);
+	free(story);
+}
+
+/**
+ * True if the tuple of the story was inserted or deleted by
+ * a transaction other than @a txn.
+ */
+static inline bool
+memtx_story_is_foreign(struct memtx_story *story, struct txn *txn)
+{
+	return (story->add_txn != NULL && story->add_txn != txn) ||
+	       (story->del_txn != NULL && story->del_txn != txn);
+}
+
+/** Set the in_index flag of the story of a tuple, if any. */
+static void
+memtx_story_set_in_index(struct tuple *tuple, uint32_t iid, bool in_index)
+{
+	struct memtx_story *story = memtx_story_find(tuple);
+	if (story != NULL) {
+		assert(iid < story->link_count);
+		story->link[iid].in_index = in_index;
+	}
+}
+
+/* }}} */
+
+/* {{{ Transactions */
+
+static inline struct memtx_tx *
+memtx_tx(struct txn *txn)
+{
+	if (txn == NULL || txn->engine != memtx_tx_engine)
+		return NULL;
+	return (struct memtx_tx *) txn->engine_tx;
+}
+
+void
+memtx_tx_begin(struct txn *txn)
+{
+	struct memtx_tx *tx = region_alloc_object_xc(&fiber()->gc,
+						     struct memtx_tx);
+	tx->txn = txn;
+	tx->read_set = NULL;
+	tx->is_conflicted = false;
+	rlist_create(&tx->in_active);
+	if (!txn->is_autocommit)
+		rlist_add_tail_entry(&memtx_tx_active, tx, in_active);
+	txn->engine_tx = tx;
+}
+
+bool
+memtx_tx_is_tracked(struct txn *txn)
+{
+	return memtx_tx(txn) != NULL;
+}
+
+void
+memtx_tx_abort_on_yield(struct txn *txn)
+{
+	if (!txn->is_autocommit && rlist_empty(&txn->fiber_on_yield.link))
+		trigger_add(&fiber()->on_yield, &txn->fiber_on_yield);
+}
+
+bool
+memtx_tx_stmt_is_tracked(struct txn *txn, struct txn_stmt *stmt)
+{
+	struct memtx_tx *tx = memtx_tx(txn);
+	return tx != NULL && stmt->engine_savepoint == tx;
+}
+
+void
+memtx_tx_end(struct txn *txn)
+{
+	struct memtx_tx *tx = memtx_tx(txn);
+	if (tx == NULL)
+		return;
+	rlist_del_entry(tx, in_active);
+	if (tx->read_set != NULL) {
+		mh_i64ptr_delete(tx->read_set);
+		tx->read_set = NULL;
+	}
+}
+
+/** Remember that the current transaction has read a tuple. */
+static void
+memtx_tx_track_read(struct txn *txn, struct tuple *tuple)
+{
+	struct memtx_tx *tx = memtx_tx(txn);
+	if (tx == NULL || txn->is_autocommit || tx->is_conflicted)
+		return;
+	if (tx->read_set == NULL) {
+		tx->read_set = mh_i64ptr_new();
+		if (tx->read_set == NULL) {
+			/* Can't track reads, fail at commit. */
+			tx->is_conflicted = true;
+			return;
+		}
+	}
+	struct mh_i64ptr_node_t node = { (uint64_t) tuple, NULL };
+	if (mh_i64ptr_put(tx->read_set, &node, NULL, NULL) ==
+	    mh_end(tx->read_set))
+		tx->is_conflicted = true;
+}
+
+/**
+ * Abort all active transactions except @a txn which have read
+ * a tuple that @a txn is going to remove.
+ */
+static void
+memtx_tx_abort_readers(struct txn *txn, struct tuple *tuple)
+{
+	struct memtx_tx *tx;
+	rlist_foreach_entry(tx, &memtx_tx_active, in_active) {
+		if (tx->txn == txn || tx->read_set == NULL)
+			continue;
+		if (mh_i64ptr_find(tx->read_set, (uint64_t) tuple, NULL) !=
+		    mh_end(tx->read_set))
+			tx->is_conflicted = true;
+	}
+}
+
+bool
+memtx_tx_has_stories()
+{
+	return memtx_tx_stories != NULL && mh_size(memtx_tx_stories) > 0;
+}
+
+bool
+memtx_tx_space_has_stories(struct space *space)
+{
+	if (!memtx_tx_has_stories())
+		return false;
+	mh_int_t k;
+	mh_foreach(memtx_tx_stories, k) {
+		struct memtx_story *story = (struct memtx_story *)
+			mh_i64ptr_node(memtx_tx_stories, k)->val;
+		if (story->space == space)
+			return true;
+	}
+	return false;
+}
+
+/* }}} */
+
+/* {{{ Reads */
+
+/**
+ * Walk the story chain of a tuple found in index @a iid and
+ * return the version visible to @a txn: either committed or
+ * written by @a txn itself.
+ */
+static struct tuple *
+memtx_tx_visible(struct tuple *tuple, uint32_t iid, struct txn *txn)
+{
+	while (tuple != NULL) {
+		struct memtx_story *story = memtx_story_find(tuple);
+		if (story == NULL)
+			return tuple;
+		if (story->add_txn == NULL || story->add_txn == txn) {
+			if (story->del_txn != NULL && story->del_txn == txn)
+				return NULL;
+			return tuple;
+		}
+		assert(iid < story->link_count);
+		tuple = story->link[iid].older;
+	}
+	return NULL;
+}
+
+struct tuple *
+memtx_tx_tuple_clarify_slow(struct tuple *tuple, uint32_t iid)
+{
+	/* The checkpoint thread has its own read view. */
+	if (!cord_is_main())
+		return tuple;
+	struct txn *txn = in_txn();
+	if (memtx_tx_has_stories())
+		tuple = memtx_tx_visible(tuple, iid, txn);
+	if (tuple != NULL)
+		memtx_tx_track_read(txn, tuple);
+	return tuple;
+}
+
+/* }}} */
+
+/* {{{ Writes */
+
+/**
+ * Raise ER_TRANSACTION_CONFLICT if the tuple is inserted or
+ * deleted by another transaction that isn't prepared yet.
+ */
+static void
+memtx_tx_check_writable(struct txn *txn, struct tuple *tuple)
+{
+	struct memtx_story *story = memtx_story_find(tuple);
+	if (story != NULL && memtx_story_is_foreign(story, txn))
+		tnt_raise(ClientError, ER_TRANSACTION_CONFLICT);
+}
+
+/**
+ * Put back the tuples replaced by the tuple of the story in the
+ * first @a index_count indexes of the space.
+ */
+static void
+memtx_tx_undo_replace(struct space *space, struct memtx_story *story,
+		      uint32_t index_count)
+{
+	for (uint32_t i = 0; i < index_count; i++) {
+		Index *index = space->index[i];
+		uint32_t iid = index->key_def->iid;
+		struct tuple *older = story->link[iid].older;
+		index->replace(story->tuple, older, DUP_INSERT);
+		if (older != NULL)
+			memtx_story_set_in_index(older, iid, true);
+	}
+}
+
+void
+memtx_tx_replace(struct txn_stmt *stmt, struct space *space,
+		 enum dup_replace_mode mode)
+{
+	struct txn *txn = in_txn();
+	struct memtx_tx *tx = memtx_tx(txn);
+	assert(tx != NULL);
+	struct tuple *old_tuple = stmt->old_tuple;
+	struct tuple *new_tuple = stmt->new_tuple;
+
+	if (old_tuple != NULL)
+		memtx_tx_check_writable(txn, old_tuple);
+
+	if (new_tuple == NULL) {
+		/*
+		 * DELETE: leave the tuple in indexes until the
+		 * transaction is prepared, just hide it.
+		 */
+		assert(old_tuple != NULL);
+		struct memtx_story *story = memtx_story_find(old_tuple);
+		if (story == NULL)
+			story = memtx_story_new(old_tuple, space);
+		story->del_txn = txn;
+		stmt->engine_savepoint = tx;
+		return;
+	}
+
+	struct memtx_story *story = memtx_story_new(new_tuple, space);
+	story->add_txn = txn;
+	struct memtx_story *old_story = NULL;
+	uint32_t done = 0;
+	try {
+		for (uint32_t i = 0; i < space->index_count; i++) {
+			Index *index = space->index[i];
+			uint32_t iid = index->key_def->iid;
+			/*
+			 * Insert the tuple unconditionally, the
+			 * displaced tuple is kept in the story and
+			 * checked below.
+			 */
+			struct tuple *dup = index->replace(NULL, new_tuple,
+							   DUP_REPLACE_OR_INSERT);
+			story->link[iid].older = dup;
+			done++;
+			struct tuple *visible_dup = dup;
+			if (dup != NULL && dup != old_tuple) {
+				struct memtx_story *dup_story =
+					memtx_story_find(dup);
+				if (dup_story != NULL &&
+				    dup_story->del_txn == txn)
+					visible_dup = NULL;
+				else if (dup_story != NULL &&
+					 memtx_story_is_foreign(dup_story, txn))
+					tnt_raise(ClientError,
+						  ER_TRANSACTION_CONFLICT);
+			}
+			uint32_t errcode = replace_check_dup(old_tuple,
+				visible_dup, i == 0 ? mode : DUP_INSERT);
+			if (errcode) {
+				tnt_raise(ClientError, errcode,
+					  index_name(index), space_name(space));
+			}
+			if (i == 0 && old_tuple == NULL)
+				old_tuple = visible_dup;
+		}
+		if (old_tuple != NULL) {
+			old_story = memtx_story_find(old_tuple);
+			if (old_story == NULL)
+				old_story = memtx_story_new(old_tuple, space);
+		}
+	} catch (Exception *e) {
+		memtx_tx_undo_replace(space, story, done);
+		memtx_story_delete(story);
+		throw;
+	}
+	if (old_story != NULL)
+		old_story->del_txn = txn;
+	/* Tuples displaced from indexes are only kept in the story. */
+	for (uint32_t i = 0; i < space->index_count; i++) {
+		uint32_t iid = space->index[i]->key_def->iid;
+		struct tuple *older = story->link[iid].older;
+		if (older != NULL)
+			memtx_story_set_in_index(older, iid, false);
+	}
+	stmt->old_tuple = old_tuple;
+	stmt->engine_savepoint = tx;
+}
+
+void
+memtx_tx_rollback_stmt(struct txn_stmt *stmt)
+{
+	struct space *space = stmt->space;
+	if (stmt->new_tuple != NULL) {
+		struct memtx_story *story = memtx_story_find(stmt->new_tuple);
+		assert(story != NULL);
+		memtx_tx_undo_replace(space, story, space->index_count);
+		memtx_story_delete(story);
+		tuple_unref(stmt->new_tuple);
+	}
+	if (stmt->old_tuple != NULL) {
+		struct memtx_story *story = memtx_story_find(stmt->old_tuple);
+		assert(story != NULL);
+		story->del_txn = NULL;
+		if (story->add_txn == NULL)
+			memtx_story_delete(story);
+	}
+	stmt->old_tuple = NULL;
+	stmt->new_tuple = NULL;
+}
+
+void
+memtx_tx_prepare(struct txn *txn)
+{
+	struct memtx_tx *tx = memtx_tx(txn);
+	if (tx == NULL)
+		return;
+	bool has_writes = false;
+	struct txn_stmt *stmt;
+	stailq_foreach_entry(stmt, &txn->stmts, next) {
+		if (stmt->engine_savepoint == tx) {
+			has_writes = true;
+			break;
+		}
+	}
+	if (!has_writes) {
+		memtx_tx_end(txn);
+		return;
+	}
+	if (tx->is_conflicted)
+		tnt_raise(ClientError, ER_TRANSACTION_CONFLICT);
+	/*
+	 * Removal of deleted tuples below must not fail, same
+	 * as statement rollback.
+	 */
+	memtx_index_extent_reserve(RESERVE_EXTENTS_BEFORE_DELETE);
+	memtx_tx_end(txn);
+
+	stailq_foreach_entry(stmt, &txn->stmts, next) {
+		if (stmt->engine_savepoint != tx)
+			continue;
+		/* From now on the statement is rolled back in place. */
+		stmt->engine_savepoint = stmt;
+		if (stmt->new_tuple != NULL) {
+			struct memtx_story *story =
+				memtx_story_find(stmt->new_tuple);
+			assert(story != NULL);
+			story->add_txn = NULL;
+			for (uint32_t i = 0; i < story->link_count; i++)
+				story->link[i].older = NULL;
+			/* Keep it if deleted by a later statement. */
+			if (story->del_txn == NULL)
+				memtx_story_delete(story);
+		}
+		if (stmt->old_tuple != NULL) {
+			struct space *space = stmt->space;
+			struct memtx_story *story =
+				memtx_story_find(stmt->old_tuple);
+			assert(story != NULL && story->del_txn == txn);
+			for (uint32_t i = 0; i < space->index_count; i++) {
+				Index *index = space->index[i];
+				uint32_t iid = index->key_def->iid;
+				if (story->link[iid].in_index)
+					index->replace(stmt->old_tuple, NULL,
+						       DUP_INSERT);
+			}
+			memtx_tx_abort_readers(txn, stmt->old_tuple);
+			memtx_story_delete(story);
+		}
+	}
+}
+
+/* }}} */
+
+/* {{{ Checkpoint */
+
+void
+memtx_tx_snapshot_cleaner_create(struct memtx_tx_snapshot_cleaner *cleaner)
+{
+	cleaner->hash = NULL;
+	if (!memtx_tx_has_stories())
+		return;
+	struct mh_i64ptr_t *hash = mh_i64ptr_new();
+	if (hash == NULL) {
+		tnt_raise(OutOfMemory, sizeof(*hash), "malloc",
+			  "snapshot cleaner");
+	}
+	mh_int_t k;
+	mh_foreach(memtx_tx_stories, k) {
+		struct memtx_story *story = (struct memtx_story *)
+			mh_i64ptr_node(memtx_tx_stories, k)->val;
+		if (story->add_txn == NULL)
+			continue;
+		/* Find the last committed version in the primary key. */
+		struct tuple *committed = story->link[0].older;
+		while (committed != NULL) {
+			struct memtx_story *older = memtx_story_find(committed);
+			if (older == NULL || older->add_txn == NULL)
+				break;
+			committed = older->link[0].older;
+		}
+		struct mh_i64ptr_node_t node = {
+			(uint64_t) story->tuple, committed
+		};
+		if (mh_i64ptr_put(hash, &node, NULL, NULL) == mh_end(hash)) {
+			mh_i64ptr_delete(hash);
+			tnt_raise(OutOfMemory, sizeof(node), "mh_i64ptr_put",
+				  "mh_i64ptr_node_t");
+		}
+	}
+	cleaner->hash = hash;
+}
+
+struct tuple *
+memtx_tx_snapshot_clarify(struct memtx_tx_snapshot_cleaner *cleaner,
+			  struct tuple *tuple)
+{
+	if (cleaner->hash == NULL)
+		return tuple;
+	mh_int_t k = mh_i64ptr_find(cleaner->hash, (uint64_t) tuple, NULL);
+	if (k == mh_end(cleaner->hash))
+		return tuple;
+	return (struct tuple *) mh_i64ptr_node(cleaner->hash, k)->val;
+}
+
+void
+memtx_tx_snapshot_cleaner_destroy(struct memtx_tx_snapshot_cleaner *cleaner)
+{
+	if (cleaner->hash != NULL)
+		mh_i64ptr_delete(cleaner->hash);
+	cleaner->hash = NULL;
+}
+
+/* }}} */
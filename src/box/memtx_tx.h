@@ -0,0 +1,233 @@
+#ifndef TARANTOOL_BOX_MEMTX_TX_H_INCLUDED
+#define TARANTOOL_BOX_MEMTX_TX_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "index.h"
+
+/**
+ * Multi-version concurrency control for memtx transactions.
+ *
+ * By default a memtx transaction is aborted as soon as its fiber
+ * yields, because its changes are applied to indexes in place and
+ * would be visible to everyone else. With the transaction manager
+ * enabled (box.cfg.memtx_use_mvcc_engine) changes are still made
+ * in place, but every tuple inserted or deleted by a transaction
+ * which is not prepared yet gets a story: the transaction which
+ * added it, the transaction which deleted it and, for each index,
+ * the tuple it has replaced in the index. Index iterators and
+ * lookups pass each tuple through memtx_tx_tuple_clarify(), which
+ * walks the story chain and returns the version visible to the
+ * current transaction: the last committed one or one written by
+ * the transaction itself.
+ *
+ * Conflicts are resolved as follows:
+ * - a statement which overwrites or deletes a tuple written or
+ *   deleted by another active transaction fails with
+ *   ER_TRANSACTION_CONFLICT at once;
+ * - a transaction which has read a tuple later overwritten by
+ *   a committed transaction fails with ER_TRANSACTION_CONFLICT
+ *   at commit, unless it is read-only.
+ *
+ * The isolation level is thus read-committed with own writes
+ * visible plus first-committer-wins for tuples that have been
+ * read; gaps are not tracked. Index size and len() include
+ * uncommitted tuples. System spaces are not versioned: a
+ * transaction that writes to one is still aborted on yield.
+ */
+
+class Engine;
+struct txn;
+struct txn_stmt;
+struct space;
+struct tuple;
+struct mh_i64ptr_t;
+
+/** True if box.cfg.memtx_use_mvcc_engine is set. */
+extern bool memtx_tx_manager_use_mvcc_engine;
+
+/** Initialize the transaction manager of the memtx engine. */
+void
+memtx_tx_manager_init(Engine *engine, bool use_mvcc);
+
+/** Free the transaction manager. */
+void
+memtx_tx_manager_free();
+
+/**
+ * Start tracking a transaction. Called from Engine::begin()
+ * when the transaction manager is enabled.
+ */
+void
+memtx_tx_begin(struct txn *txn);
+
+/**
+ * Return true if the transaction is tracked by the manager
+ * and its statements must go through memtx_tx_replace().
+ */
+bool
+memtx_tx_is_tracked(struct txn *txn);
+
+/**
+ * Make the transaction abort on yield, as it would without
+ * the transaction manager. Used for changes which are not
+ * versioned, e.g. in system spaces.
+ */
+void
+memtx_tx_abort_on_yield(struct txn *txn);
+
+/**
+ * A version of memtx_replace_all_keys() for tracked
+ * transactions. Inserts the new tuple into all indexes and
+ * records the replaced tuples in its story. The old tuple is
+ * not removed from indexes until the transaction is prepared.
+ */
+void
+memtx_tx_replace(struct txn_stmt *stmt, struct space *space,
+		 enum dup_replace_mode mode);
+
+/**
+ * Return true if the statement was executed by
+ * memtx_tx_replace() and hasn't been prepared yet, so its
+ * rollback must be done with memtx_tx_rollback_stmt().
+ */
+bool
+memtx_tx_stmt_is_tracked(struct txn *txn, struct txn_stmt *stmt);
+
+/** Roll back a statement executed by memtx_tx_replace(). */
+void
+memtx_tx_rollback_stmt(struct txn_stmt *stmt);
+
+/**
+ * Check the transaction for conflicts and make its changes
+ * committed from the point of view of other transactions:
+ * remove deleted and replaced tuples from indexes and drop
+ * the stories. After this the transaction can only be rolled
+ * back in the classic way, by undoing index replacements.
+ * @throws ER_TRANSACTION_CONFLICT
+ */
+void
+memtx_tx_prepare(struct txn *txn);
+
+/** Stop tracking a transaction. Safe to call more than once. */
+void
+memtx_tx_end(struct txn *txn);
+
+/** Return true if there are uncommitted changes in memtx. */
+bool
+memtx_tx_has_stories();
+
+/** Return true if there are uncommitted changes in the space. */
+bool
+memtx_tx_space_has_stories(struct space *space);
+
+struct tuple *
+memtx_tx_tuple_clarify_slow(struct tuple *tuple, uint32_t iid);
+
+/**
+ * Return the version of a tuple found in index @a iid which is
+ * visible to the current transaction, or NULL if there is none.
+ */
+static inline struct tuple *
+memtx_tx_tuple_clarify(struct tuple *tuple, uint32_t iid)
+{
+	if (!memtx_tx_manager_use_mvcc_engine || tuple == NULL)
+		return tuple;
+	return memtx_tx_tuple_clarify_slow(tuple, iid);
+}
+
+/**
+ * Return the next tuple of @a iterator visible to the current
+ * transaction: call @a base, which walks the index, skipping
+ * invisible tuples. The base method may switch iterator->next
+ * from @a self to another method, which takes over then.
+ */
+static inline struct tuple *
+memtx_tx_iterator_next(struct iterator *iterator,
+		       struct tuple *(*base)(struct iterator *),
+		       struct tuple *(*self)(struct iterator *))
+{
+	uint32_t iid = iterator->index->key_def->iid;
+	for (;;) {
+		struct tuple *tuple = base(iterator);
+		if (tuple == NULL)
+			return NULL;
+		tuple = memtx_tx_tuple_clarify(tuple, iid);
+		if (tuple != NULL)
+			return tuple;
+		if (iterator->next != self)
+			return iterator->next(iterator);
+	}
+}
+
+/**
+ * Define an iterator method @a name which calls @a name##_base
+ * and skips tuples invisible to the current transaction, see
+ * memtx_tx_iterator_next().
+ */
+#define MEMTX_TX_WRAP_ITERATOR(name)					\
+static struct tuple *							\
+name(struct iterator *iterator)						\
+{									\
+	return memtx_tx_iterator_next(iterator, name##_base, name);	\
+}
+
+/**
+ * Checkpoint of a space with uncommitted changes: maps every
+ * tuple of the primary key read view that is not committed yet
+ * to its committed version.
+ */
+struct memtx_tx_snapshot_cleaner {
+	struct mh_i64ptr_t *hash;
+};
+
+/**
+ * Fill the cleaner for the primary key of all spaces.
+ * Must be called together with creation of the read views.
+ */
+void
+memtx_tx_snapshot_cleaner_create(struct memtx_tx_snapshot_cleaner *cleaner);
+
+/**
+ * Return the committed version of a tuple found in the
+ * primary key read view, or NULL if there is none.
+ * Safe to call from any thread.
+ */
+struct tuple *
+memtx_tx_snapshot_clarify(struct memtx_tx_snapshot_cleaner *cleaner,
+			  struct tuple *tuple);
+
+void
+memtx_tx_snapshot_cleaner_destroy(struct memtx_tx_snapshot_cleaner *cleaner);
+
+#endif /* TARANTOOL_BOX_MEMTX_TX_H_INCLUDED */
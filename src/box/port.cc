@@ -85,22 +85,51 @@ port_destroy(struct port *port)
 	}
 }
 
-void
+int
 port_dump(struct port *port, struct obuf *out)
 {
+	int rc = 0;
 	struct port_entry *e = port->first;
 	if (e == NULL)
-		return;
-	tuple_to_obuf(e->tuple, out);
+		return 0;
+	if (tuple_to_obuf(e->tuple, out) != 0)
+		rc = -1;
+	tuple_unref(e->tuple);
+	e = e->next;
+	while (e != NULL) {
+		struct port_entry *cur = e;
+		if (rc == 0 && tuple_to_obuf(e->tuple, out) != 0)
+			rc = -1;
+		e = e->next;
+		tuple_unref(cur->tuple);
+		mempool_free(&port_entry_pool, cur);
+	}
+	return rc;
+}
+
+int
+port_dump_fields(struct port *port, struct obuf *out, const char *fields,
+		 uint32_t index_base)
+{
+	int rc = 0;
+	struct port_entry *e = port->first;
+	if (e == NULL)
+		return 0;
+	if (tuple_fields_to_obuf(e->tuple, fields, index_base, out) != 0)
+		rc = -1;
 	tuple_unref(e->tuple);
 	e = e->next;
 	while (e != NULL) {
 		struct port_entry *cur = e;
-		tuple_to_obuf(e->tuple, out);
+		if (rc == 0 &&
+		    tuple_fields_to_obuf(e->tuple, fields, index_base,
+					 out) != 0)
+			rc = -1;
 		e = e->next;
 		tuple_unref(cur->tuple);
 		mempool_free(&port_entry_pool, cur);
 	}
+	return rc;
 }
 
 void
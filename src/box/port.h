@@ -78,9 +78,24 @@ port_create(struct port *port);
 void
 port_destroy(struct port *port);
 
-void
+/**
+ * Encode all tuples to the output buffer and release them. The
+ * tuples are released even if encoding fails.
+ * @retval  0 success
+ * @retval -1 out of memory or a tuple can't be decompressed,
+ *            the diag is set
+ */
+int
 port_dump(struct port *port, struct obuf *out);
 
+/**
+ * Same as port_dump(), but dump only the given fields of every
+ * tuple, see tuple_extract_fields().
+ */
+int
+port_dump_fields(struct port *port, struct obuf *out, const char *fields,
+		 uint32_t index_base);
+
 void
 port_add_tuple(struct port *port, struct tuple *tuple);
 
@@ -32,12 +32,14 @@
 
 #include "scoped_guard.h"
 #include "fiber.h"
+#include "clock.h"
 #include "xlog.h"
 #include "xrow.h"
 #include "xstream.h"
 #include "wal.h" /* wal_watcher */
 #include "cluster.h"
 #include "session.h"
+#include "small/ibuf.h"
 
 /*
  * Recovery subsystem
@@ -199,6 +201,24 @@ recovery_exit(struct recovery *r)
 	recovery_delete(r);
 }
 
+void
+recovery_progress_create(struct recovery_progress *progress)
+{
+	progress->row_count = 0;
+	progress->last_report = clock_monotonic();
+}
+
+void
+recovery_progress_report(struct recovery_progress *progress)
+{
+	double now = clock_monotonic();
+	double elapsed = MAX(now - progress->last_report, 1e-6);
+	say_info("%.1fM rows processed, %.0f rows/sec",
+		 progress->row_count / 1000000.,
+		 RECOVERY_PROGRESS_ROWS / elapsed);
+	progress->last_report = now;
+}
+
 /**
  * Read all rows in a file starting from the last position.
  * Advance the position. If end of file is reached,
@@ -211,7 +231,8 @@ recover_xlog(struct recovery *r, struct xstream *stream,
 	     struct vclock *stop_vclock)
 {
 	struct xrow_header row;
-	uint64_t row_count = 0;
+	struct recovery_progress progress;
+	recovery_progress_create(&progress);
 	while (xlog_cursor_next_xc(&r->cursor, &row,
 				   r->wal_dir.panic_if_error) == 0) {
 		/*
@@ -231,10 +252,7 @@ recover_xlog(struct recovery *r, struct xstream *stream,
 
 		try {
 			xstream_write(stream, &row);
-			++row_count;
-			if (row_count % 100000 == 0)
-				say_info("%.1fM rows processed",
-					 row_count / 1000000.);
+			recovery_progress_add_row(&progress);
 		} catch (ClientError *e) {
 			say_error("can't apply row: ");
 			e->log();
@@ -480,6 +498,38 @@ public:
 	}
 };
 
+/**
+ * Recover rows following the recovery vclock from the WAL ring,
+ * which is much cheaper than reading them from xlogs.
+ *
+ * @retval 0  success
+ * @retval -1 the ring lacks some of the rows, read xlogs
+ */
+static int
+recover_wal_ring(struct recovery *r, struct xstream *stream,
+		 uint64_t *pos, struct ibuf *buf)
+{
+	int count = wal_ring_read(wal, pos, &r->vclock, buf);
+	if (count < 0)
+		return -1;
+	if (r->cursor.state != XLOG_CURSOR_CLOSED) {
+		/*
+		 * The xlog position is stale from now on, in case
+		 * we lag behind the ring, we'll look up the xlog
+		 * by vclock.
+		 */
+		xlog_cursor_close(&r->cursor, false);
+	}
+	const char *data = buf->rpos;
+	for (int i = 0; i < count; i++) {
+		struct xrow_header row;
+		wal_ring_decode_row(&data, &row);
+		xstream_write(stream, &row);
+	}
+	ibuf_reset(buf);
+	return 0;
+}
+
 static int
 recovery_follow_f(va_list ap)
 {
@@ -490,7 +540,17 @@ recovery_follow_f(va_list ap)
 
 	WalSubscription subscription(r->wal_dir.dirname);
 
+	/* Rows copied from the WAL ring, see recover_wal_ring(). */
+	uint64_t ring_pos = UINT64_MAX;
+	struct ibuf ring_buf;
+	ibuf_create(&ring_buf, &cord()->slabc, 16 * 1024);
+	auto ring_guard = make_scoped_guard([&]{
+		ibuf_destroy(&ring_buf);
+	});
+
 	while (! fiber_is_cancelled()) {
+		if (recover_wal_ring(r, stream, &ring_pos, &ring_buf) == 0)
+			goto wait;
 
 		/*
 		 * Recover until there is no new stuff which appeared in
@@ -528,7 +588,7 @@ recovery_follow_f(va_list ap)
 
 		subscription.set_log_path(r->cursor.state != XLOG_CURSOR_CLOSED ?
 					  r->cursor.name: NULL);
-
+wait:
 		if (subscription.signaled == false) {
 			/**
 			 * Allow an immediate wakeup/break loop
@@ -84,6 +84,40 @@ recovery_finalize(struct recovery *r, struct xstream *stream);
 void
 recovery_fill_lsn(struct recovery *r, struct xrow_header *row);
 
+enum {
+	/** Number of recovered rows between progress reports. */
+	RECOVERY_PROGRESS_ROWS = 100000,
+};
+
+/** Recovery progress, reported to the log as it goes. */
+struct recovery_progress {
+	/** Number of rows recovered so far. */
+	uint64_t row_count;
+	/** Time of the last report, monotonic clock. */
+	double last_report;
+};
+
+void
+recovery_progress_create(struct recovery_progress *progress);
+
+/**
+ * Log the number of rows recovered so far and the recovery
+ * rate since the last report.
+ */
+void
+recovery_progress_report(struct recovery_progress *progress);
+
+/**
+ * Account a recovered row, report the progress every
+ * RECOVERY_PROGRESS_ROWS rows.
+ */
+static inline void
+recovery_progress_add_row(struct recovery_progress *progress)
+{
+	if (++progress->row_count % RECOVERY_PROGRESS_ROWS == 0)
+		recovery_progress_report(progress);
+}
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
@@ -293,6 +293,11 @@ relay_send_subscribe_row(struct xstream *stream, struct xrow_header *packet)
 		{
 			fiber_sleep(1000.0);
 		});
+		ERROR_INJECT(ERRINJ_RELAY_DELAY,
+		{
+			while (errinj_getb(ERRINJ_RELAY_DELAY))
+				fiber_sleep(0.01);
+		});
 	}
 	/*
 	 * Update local vclock. During normal operation wal_write()
@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "tuple_format.h"
+#include "tuple_compression.h"
 #include "tuple_compare.h"
 #include "scoped_guard.h"
 #include "trigger.h"
@@ -117,12 +118,19 @@ space_new(struct space_def *def, struct rlist *key_list)
 				      index_count * sizeof(Index *));
 	space->def = *def;
 	Engine *engine = engine_find(def->engine_name);
-	space->format = tuple_format_new(key_list, engine->format);
+	space->format = tuple_format_new(key_list, def->opts.field_offsets,
+					 engine->format);
 	if (space->format == NULL)
 		diag_raise();
 	space->has_unique_secondary_key = has_unique_secondary_key;
 	tuple_format_ref(space->format, 1);
 	space->format->exact_field_count = def->exact_field_count;
+	if (def->opts.compression != TUPLE_COMPRESSION_NONE) {
+		space->format->compression =
+			tuple_compression_new(def->opts.compression_threshold);
+		if (space->format->compression == NULL)
+			diag_raise();
+	}
 	space->index_id_max = index_id_max;
 	/* init space engine instance */
 	space->handler = engine->open();
@@ -29,6 +29,7 @@
  * SUCH DAMAGE.
  */
 #include "tuple.h"
+#include "tuple_compression.h"
 
 #include "trivia/util.h"
 #include "fiber.h"
@@ -87,7 +88,12 @@ tuple_validate_raw(struct tuple_format *format, const char *tuple)
 const char *
 tuple_seek(struct tuple_iterator *it, uint32_t fieldno)
 {
-	const char *field = tuple_field(it->tuple, fieldno);
+	if (unlikely(it->data == NULL))
+		return NULL;
+	/* A compressed tuple is decompressed to it->data. */
+	const char *field = tuple_field_raw(tuple_format(it->tuple), it->data,
+					    tuple_field_map(it->tuple),
+					    fieldno);
 	if (likely(field != NULL)) {
 		it->pos = field;
 		it->fieldno = fieldno;
@@ -153,6 +159,81 @@ tuple_extract_key(const struct tuple *tuple, const struct key_def *key_def,
 	return key;
 }
 
+int
+tuple_fields_check(const char *fields, uint32_t index_base)
+{
+	if (mp_typeof(*fields) != MP_ARRAY)
+		goto error;
+	uint32_t count = mp_decode_array(&fields);
+	for (uint32_t i = 0; i < count; i++) {
+		if (mp_typeof(*fields) != MP_UINT)
+			goto error;
+		uint64_t field_no = mp_decode_uint(&fields);
+		if (field_no < index_base ||
+		    field_no - index_base >= BOX_FIELD_MAX)
+			goto error;
+	}
+	return 0;
+error:
+	diag_set(ClientError, ER_ILLEGAL_PARAMS,
+		 "fields must be an array of field numbers");
+	return -1;
+}
+
+char *
+tuple_extract_fields(const struct tuple *tuple, const char *fields,
+		     uint32_t index_base, uint32_t *size)
+{
+	const char *pos = fields;
+	uint32_t count = mp_decode_array(&pos);
+	uint32_t bsize = mp_sizeof_array(count);
+	/* Decompress a compressed tuple once for all of the fields. */
+	const struct tuple_format *format = tuple_format(tuple);
+	const uint32_t *field_map = tuple_field_map(tuple);
+	uint32_t tuple_bsize;
+	const char *tuple_raw = tuple_data_range(tuple, &tuple_bsize);
+	if (tuple_raw == NULL)
+		return NULL;
+
+	/* Calculate the result size, missing fields are nil. */
+	for (uint32_t i = 0; i < count; i++) {
+		const char *field = tuple_field_raw(format, tuple_raw, field_map,
+				mp_decode_uint(&pos) - index_base);
+		if (field == NULL) {
+			bsize += mp_sizeof_nil();
+			continue;
+		}
+		const char *end = field;
+		mp_next(&end);
+		bsize += end - field;
+	}
+
+	char *data = (char *) region_alloc(&fiber()->gc, bsize);
+	if (data == NULL) {
+		diag_set(OutOfMemory, bsize, "region", "tuple_extract_fields");
+		return NULL;
+	}
+	pos = fields;
+	mp_decode_array(&pos);
+	char *data_end = mp_encode_array(data, count);
+	for (uint32_t i = 0; i < count; i++) {
+		const char *field = tuple_field_raw(format, tuple_raw, field_map,
+				mp_decode_uint(&pos) - index_base);
+		if (field == NULL) {
+			data_end = mp_encode_nil(data_end);
+			continue;
+		}
+		const char *end = field;
+		mp_next(&end);
+		memcpy(data_end, field, end - field);
+		data_end += end - field;
+	}
+	assert(data_end == data + bsize);
+	if (size != NULL)
+		*size = bsize;
+	return data;
+}
+
 char *
 tuple_extract_key_raw(const char *data, const char *data_end,
 		      const struct key_def *key_def, uint32_t *key_size)
@@ -198,6 +279,7 @@ void
 tuple_init(void)
 {
 	tuple_format_init();
+	tuple_compression_init();
 
 	mempool_create(&tuple_iterator_pool, &cord()->slabc,
 		       sizeof(struct tuple_iterator));
@@ -216,6 +298,7 @@ tuple_free(void)
 
 	mempool_destroy(&tuple_iterator_pool);
 
+	tuple_compression_free();
 	tuple_format_free();
 }
 
@@ -250,6 +333,8 @@ size_t
 box_tuple_bsize(const box_tuple_t *tuple)
 {
 	assert(tuple != NULL);
+	if (tuple->is_compressed)
+		return tuple_compressed(tuple)->raw_bsize;
 	return tuple->bsize;
 }
 
@@ -292,12 +377,37 @@ box_tuple_iterator(box_tuple_t *tuple)
 		return NULL;
 	}
 	tuple_rewind(it, tuple);
+	if (tuple->is_compressed) {
+		/*
+		 * The iterator may be used for long, keep a copy
+		 * of the decompressed MessagePack.
+		 */
+		size_t size = it->end - it->data;
+		char *data = NULL;
+		if (it->data != NULL) {
+			data = (char *) malloc(size);
+			if (data == NULL)
+				diag_set(OutOfMemory, size, "malloc",
+					 "tuple iterator");
+		}
+		if (data == NULL) {
+			tuple_unref(tuple);
+			mempool_free(&tuple_iterator_pool, it);
+			return NULL;
+		}
+		memcpy(data, it->data, size);
+		it->pos = data + (it->pos - it->data);
+		it->end = data + size;
+		it->data = data;
+	}
 	return it;
 }
 
 void
 box_tuple_iterator_free(box_tuple_iterator_t *it)
 {
+	if (it->tuple->is_compressed)
+		free((char *) it->data);
 	tuple_unref(it->tuple);
 	mempool_free(&tuple_iterator_pool, it);
 }
@@ -311,7 +421,10 @@ box_tuple_position(box_tuple_iterator_t *it)
 void
 box_tuple_rewind(box_tuple_iterator_t *it)
 {
-	tuple_rewind(it, it->tuple);
+	/* Don't drop the copy of a compressed tuple. */
+	it->pos = it->data;
+	(void) mp_decode_array(&it->pos);
+	it->fieldno = 0;
 }
 
 const char *
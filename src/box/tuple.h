@@ -254,6 +254,11 @@ box_tuple_extract_key(const box_tuple_t *tuple, uint32_t space_id,
  * +---------------------------------------data_offset
  *
  * Each 'off_i' is the offset to the i-th indexed field.
+ *
+ * The MessagePack of a compressed tuple is stored as is up to
+ * the end of its last indexed field, and the rest of it is
+ * compressed, see tuple_compressed. The offsets in the field
+ * map are the same as in the plain MessagePack.
  */
 struct PACKED tuple
 {
@@ -270,6 +275,15 @@ struct PACKED tuple
 	 * Offset to the MessagePack from the begin of the tuple.
 	 */
 	uint16_t data_offset;
+	/**
+	 * True if the tuple is compressed, see tuple_compressed.
+	 * It takes the padding of struct memtx_tuple, and is out
+	 * of the free list pointer which smfree_delayed() stores
+	 * in the first 8 bytes of a memtx tuple, so snapshot
+	 * threads can check it in tuples deleted after the
+	 * snapshot has started.
+	 */
+	bool is_compressed;
 	/**
 	 * Engine specific fields and offsets array concatenated
 	 * with MessagePack fields array.
@@ -277,6 +291,83 @@ struct PACKED tuple
 	 */
 };
 
+/**
+ * Header of a compressed tuple, stored right after struct tuple,
+ * before the field map.
+ */
+struct PACKED tuple_compressed {
+	/** Length of the plain MessagePack data. */
+	uint32_t raw_bsize;
+	/**
+	 * Length of the leading part of the MessagePack which
+	 * is not compressed: the array header and the indexed
+	 * fields.
+	 */
+	uint32_t prefix_bsize;
+	/**
+	 * Compression of the tuple format, with the dictionary
+	 * the tuple is compressed with. Snapshot threads can't
+	 * look up the format of a tuple.
+	 */
+	struct tuple_compression *compression;
+};
+
+/** Return the header of a compressed tuple. */
+static inline const struct tuple_compressed *
+tuple_compressed(const struct tuple *tuple)
+{
+	assert(tuple->is_compressed);
+	return (const struct tuple_compressed *) (tuple + 1);
+}
+
+struct region;
+
+/**
+ * Decompress the MessagePack of a compressed tuple to a region.
+ * Can be called from any thread.
+ * @param tuple compressed tuple.
+ * @param region region to allocate the MessagePack on.
+ * @param[out] p_size Size in bytes of the MessagePack array.
+ * @retval not NULL MessagePack array.
+ * @retval     NULL Memory or decompression error, diag is set.
+ * @sa tuple_compression.h
+ */
+const char *
+tuple_decompress(const struct tuple *tuple, struct region *region,
+		 uint32_t *p_size);
+
+/**
+ * Decompress the MessagePack of a compressed tuple to the buffer
+ * of the tx thread, which keeps the last decompressed tuple, so
+ * that access to several fields of a tuple decompresses it once.
+ * The data is valid until another tuple is decompressed or the
+ * tuple is deleted.
+ * @param tuple compressed tuple.
+ * @param[out] p_size Size in bytes of the MessagePack array.
+ * @retval not NULL MessagePack array.
+ * @retval     NULL Memory or decompression error, diag is set.
+ */
+const char *
+tuple_decompress_cached(const struct tuple *tuple, uint32_t *p_size);
+
+/**
+ * Initialize the header of a new tuple of any engine and
+ * reference its format.
+ * @param tuple Tuple to initialize.
+ * @param refs Reference counter.
+ * @param format Format of the tuple.
+ */
+static inline void
+tuple_create(struct tuple *tuple, uint16_t refs, struct tuple_format *format)
+{
+	tuple->refs = refs;
+	tuple->format_id = tuple_format_id(format);
+	tuple_format_ref(format, 1);
+	tuple->bsize = 0;
+	tuple->data_offset = 0;
+	tuple->is_compressed = false;
+}
+
 /** Size of the tuple including size of struct tuple. */
 static inline size_t
 tuple_size(const struct tuple *tuple)
@@ -287,6 +378,8 @@ tuple_size(const struct tuple *tuple)
 
 /**
  * Get pointer to MessagePack data of the tuple.
+ * Only the array header and the indexed fields of a compressed
+ * tuple are there, use tuple_data_range() to get all of them.
  * @param tuple tuple.
  * @return MessagePack array.
  */
@@ -298,13 +391,18 @@ tuple_data(const struct tuple *tuple)
 
 /**
  * Get pointer to MessagePack data of the tuple.
+ * The MessagePack of a compressed tuple is valid until another
+ * tuple is decompressed, see tuple_decompress_cached().
  * @param tuple tuple.
  * @param[out] size Size in bytes of the MessagePack array.
- * @return MessagePack array.
+ * @retval not NULL MessagePack array.
+ * @retval     NULL Failed to decompress the tuple, diag is set.
  */
 static inline const char *
 tuple_data_range(const struct tuple *tuple, uint32_t *p_size)
 {
+	if (unlikely(tuple->is_compressed))
+		return tuple_decompress_cached(tuple, p_size);
 	*p_size = tuple->bsize;
 	return tuple_data(tuple);
 }
@@ -340,6 +438,34 @@ char *
 tuple_extract_key_raw(const char *data, const char *data_end,
 		      const struct key_def *key_def, uint32_t *key_size);
 
+/**
+ * Check a list of fields to extract from tuples with
+ * tuple_extract_fields() or tuple_fields_to_obuf().
+ * @param fields - MessagePack array of field numbers
+ * @param index_base - number of the first field, 0 or 1
+ *
+ * @retval  0 Success
+ * @retval -1 Not an array of field numbers, diag is set
+ */
+int
+tuple_fields_check(const char *fields, uint32_t index_base);
+
+/**
+ * Extract the given fields of a tuple as a MessagePack array
+ * allocated on the fiber region. A field missing in the tuple
+ * is extracted as nil.
+ * @param tuple - tuple from which need to extract fields
+ * @param fields - field numbers, see tuple_fields_check()
+ * @param index_base - number of the first field, 0 or 1
+ * @param size - here will be size of extracted fields
+ *
+ * @retval not NULL Success
+ * @retval NULL     Memory allocation error
+ */
+char *
+tuple_extract_fields(const struct tuple *tuple, const char *fields,
+		     uint32_t index_base, uint32_t *size);
+
 /**
  * Get the format of the tuple.
  * @param tuple Tuple.
@@ -389,7 +515,11 @@ tuple_validate_raw(struct tuple_format *format, const char *data);
 static inline int
 tuple_validate(struct tuple_format *format, struct tuple *tuple)
 {
-	return tuple_validate_raw(format, tuple_data(tuple));
+	uint32_t bsize;
+	const char *data = tuple_data_range(tuple, &bsize);
+	if (data == NULL)
+		return -1;
+	return tuple_validate_raw(format, data);
 }
 
 /*
@@ -422,13 +552,21 @@ tuple_field_count(const struct tuple *tuple)
  * @param fieldno the index of field to return
  * @param len pointer where the len of the field will be stored
  * @retval pointer to MessagePack data
- * @retval NULL when fieldno is out of range
+ * @retval NULL when fieldno is out of range or, if the field
+ *         is compressed, it failed to decompress and diag is set
  */
 static inline const char *
 tuple_field(const struct tuple *tuple, uint32_t fieldno)
 {
-	return tuple_field_raw(tuple_format(tuple), tuple_data(tuple),
-			       tuple_field_map(tuple), fieldno);
+	const struct tuple_format *format = tuple_format(tuple);
+	const char *data = tuple_data(tuple);
+	if (unlikely(tuple->is_compressed) && fieldno >= format->field_count) {
+		uint32_t bsize;
+		data = tuple_decompress_cached(tuple, &bsize);
+		if (data == NULL)
+			return NULL;
+	}
+	return tuple_field_raw(format, data, tuple_field_map(tuple), fieldno);
 }
 
 /**
@@ -438,6 +576,8 @@ struct tuple_iterator {
 	/** @cond false **/
 	/* State */
 	struct tuple *tuple;
+	/** Beginning of the MessagePack of the tuple. */
+	const char *data;
 	/** Always points to the beginning of the next field. */
 	const char *pos;
 	/** End of the tuple. */
@@ -461,6 +601,10 @@ struct tuple_iterator {
  *
  * @endcode
  *
+ * The fields of a compressed tuple are valid until another tuple
+ * is decompressed, see tuple_data_range(). If the tuple fails
+ * to decompress, the iterator is empty and diag is set.
+ *
  * @param[out] it tuple iterator
  * @param[in]  tuple tuple
  */
@@ -470,6 +614,12 @@ tuple_rewind(struct tuple_iterator *it, struct tuple *tuple)
 	it->tuple = tuple;
 	uint32_t bsize;
 	const char *data = tuple_data_range(tuple, &bsize);
+	it->data = data;
+	if (unlikely(data == NULL)) {
+		it->pos = it->end = NULL;
+		it->fieldno = 0;
+		return;
+	}
 	it->pos = data;
 	(void) mp_decode_array(&it->pos); /* Skip array header */
 	it->fieldno = 0;
@@ -590,6 +740,14 @@ struct obuf;
 int
 tuple_to_obuf(struct tuple *tuple, struct obuf *buf);
 
+/**
+ * Store the given fields of a tuple in the output buffer in
+ * iproto format, see tuple_extract_fields().
+ */
+int
+tuple_fields_to_obuf(const struct tuple *tuple, const char *fields,
+		     uint32_t index_base, struct obuf *buf);
+
 /**
  * \copydoc box_tuple_to_buf()
  */
@@ -537,6 +537,131 @@ static const comparator_signature cmp_arr[] = {
 
 #undef COMPARATOR
 
+/**
+ * Comparators for key definitions which are not listed in
+ * cmp_arr: specialized by the sequence of part types, while
+ * field numbers are taken from the key definition at runtime.
+ * Generated for every combination of unsigned and string parts
+ * of keys up to 5 parts long.
+ */
+
+namespace /* local symbols */ {
+
+template <int TYPE, int ...MORE_TYPES>
+struct FieldCompareTyped
+{
+	inline static int compare(const struct tuple_format *format_a,
+				  const char *tuple_a,
+				  const uint32_t *field_map_a,
+				  const struct tuple_format *format_b,
+				  const char *tuple_b,
+				  const uint32_t *field_map_b,
+				  const struct key_part *part)
+	{
+		const char *field_a = tuple_field_raw(format_a, tuple_a,
+						      field_map_a,
+						      part->fieldno);
+		const char *field_b = tuple_field_raw(format_b, tuple_b,
+						      field_map_b,
+						      part->fieldno);
+		int r = field_compare<TYPE>(&field_a, &field_b);
+		if (r != 0)
+			return r;
+		return FieldCompareTyped<MORE_TYPES...>::
+			compare(format_a, tuple_a, field_map_a,
+				format_b, tuple_b, field_map_b, part + 1);
+	}
+};
+
+template <int TYPE>
+struct FieldCompareTyped<TYPE>
+{
+	inline static int compare(const struct tuple_format *format_a,
+				  const char *tuple_a,
+				  const uint32_t *field_map_a,
+				  const struct tuple_format *format_b,
+				  const char *tuple_b,
+				  const uint32_t *field_map_b,
+				  const struct key_part *part)
+	{
+		const char *field_a = tuple_field_raw(format_a, tuple_a,
+						      field_map_a,
+						      part->fieldno);
+		const char *field_b = tuple_field_raw(format_b, tuple_b,
+						      field_map_b,
+						      part->fieldno);
+		return field_compare<TYPE>(&field_a, &field_b);
+	}
+};
+
+template <int ...TYPES>
+struct TupleCompareTyped
+{
+	static int compare(const struct tuple *tuple_a,
+			   const struct tuple *tuple_b,
+			   const struct key_def *key_def)
+	{
+		assert(key_def->part_count == sizeof...(TYPES));
+		return FieldCompareTyped<TYPES...>::
+			compare(tuple_format(tuple_a), tuple_data(tuple_a),
+				tuple_field_map(tuple_a),
+				tuple_format(tuple_b), tuple_data(tuple_b),
+				tuple_field_map(tuple_b), key_def->parts);
+	}
+};
+
+/**
+ * Walk the key parts and pick the instance matching their
+ * types. LEFT is the number of parts not yet looked at.
+ */
+template <uint32_t LEFT, int ...TYPES>
+struct TupleCompareTypedSelect
+{
+	static tuple_compare_t select(const struct key_part *part)
+	{
+		switch (part->type) {
+		case FIELD_TYPE_UNSIGNED:
+			return TupleCompareTypedSelect<LEFT - 1, TYPES...,
+				FIELD_TYPE_UNSIGNED>::select(part + 1);
+		case FIELD_TYPE_STRING:
+			return TupleCompareTypedSelect<LEFT - 1, TYPES...,
+				FIELD_TYPE_STRING>::select(part + 1);
+		default:
+			return NULL;
+		}
+	}
+};
+
+template <int ...TYPES>
+struct TupleCompareTypedSelect<0, TYPES...>
+{
+	static tuple_compare_t select(const struct key_part *)
+	{
+		return TupleCompareTyped<TYPES...>::compare;
+	}
+};
+
+} /* end of anonymous namespace */
+
+static tuple_compare_t
+tuple_compare_typed_create(const struct key_def *def)
+{
+	switch (def->part_count) {
+	case 1:
+		return TupleCompareTypedSelect<1>::select(def->parts);
+	case 2:
+		return TupleCompareTypedSelect<2>::select(def->parts);
+	case 3:
+		return TupleCompareTypedSelect<3>::select(def->parts);
+	case 4:
+		return TupleCompareTypedSelect<4>::select(def->parts);
+	case 5:
+		return TupleCompareTypedSelect<5>::select(def->parts);
+	default:
+		return NULL;
+	}
+}
+
 tuple_compare_t
 tuple_compare_create(const struct key_def *def) {
 	for (uint32_t k = 0; k < sizeof(cmp_arr) / sizeof(cmp_arr[0]); k++) {
@@ -550,6 +675,9 @@ tuple_compare_create(const struct key_def *def) {
 	}
 	if (key_def_is_sequential(def))
 		return tuple_compare_sequential;
+	tuple_compare_t typed = tuple_compare_typed_create(def);
+	if (typed != NULL)
+		return typed;
 	return tuple_compare_slowpath;
 }
 
@@ -732,6 +860,111 @@ static const comparator_with_key_signature cmp_wk_arr[] = {
 
 #undef KEY_COMPARATOR
 
+namespace /* local symbols */ {
+
+template <int TYPE, int ...MORE_TYPES>
+struct FieldCompareWithKeyTyped
+{
+	inline static int compare(const struct tuple_format *format,
+				  const char *tuple,
+				  const uint32_t *field_map,
+				  const char *key, uint32_t part_count,
+				  const struct key_part *part)
+	{
+		const char *field = tuple_field_raw(format, tuple, field_map,
+						    part->fieldno);
+		int r = field_compare_with_key_and_next<TYPE>(&field, &key);
+		if (r != 0 || part_count == 1)
+			return r;
+		return FieldCompareWithKeyTyped<MORE_TYPES...>::
+			compare(format, tuple, field_map, key,
+				part_count - 1, part + 1);
+	}
+};
+
+template <int TYPE>
+struct FieldCompareWithKeyTyped<TYPE>
+{
+	inline static int compare(const struct tuple_format *format,
+				  const char *tuple,
+				  const uint32_t *field_map,
+				  const char *key, uint32_t,
+				  const struct key_part *part)
+	{
+		const char *field = tuple_field_raw(format, tuple, field_map,
+						    part->fieldno);
+		return field_compare_with_key<TYPE>(&field, &key);
+	}
+};
+
+template <int ...TYPES>
+struct TupleCompareWithKeyTyped
+{
+	static int compare(const struct tuple *tuple, const char *key,
+			   uint32_t part_count,
+			   const struct key_def *key_def)
+	{
+		assert(key_def->part_count == sizeof...(TYPES));
+		assert(part_count <= key_def->part_count);
+		/* Part count can be 0 in wildcard searches. */
+		if (part_count == 0)
+			return 0;
+		return FieldCompareWithKeyTyped<TYPES...>::
+			compare(tuple_format(tuple), tuple_data(tuple),
+				tuple_field_map(tuple), key, part_count,
+				key_def->parts);
+	}
+};
+
+/** @copydoc TupleCompareTypedSelect */
+template <uint32_t LEFT, int ...TYPES>
+struct TupleCompareWithKeyTypedSelect
+{
+	static tuple_compare_with_key_t select(const struct key_part *part)
+	{
+		switch (part->type) {
+		case FIELD_TYPE_UNSIGNED:
+			return TupleCompareWithKeyTypedSelect<LEFT - 1,
+				TYPES..., FIELD_TYPE_UNSIGNED>::select(part + 1);
+		case FIELD_TYPE_STRING:
+			return TupleCompareWithKeyTypedSelect<LEFT - 1,
+				TYPES..., FIELD_TYPE_STRING>::select(part + 1);
+		default:
+			return NULL;
+		}
+	}
+};
+
+template <int ...TYPES>
+struct TupleCompareWithKeyTypedSelect<0, TYPES...>
+{
+	static tuple_compare_with_key_t select(const struct key_part *)
+	{
+		return TupleCompareWithKeyTyped<TYPES...>::compare;
+	}
+};
+
+} /* end of anonymous namespace */
+
+static tuple_compare_with_key_t
+tuple_compare_with_key_typed_create(const struct key_def *def)
+{
+	switch (def->part_count) {
+	case 1:
+		return TupleCompareWithKeyTypedSelect<1>::select(def->parts);
+	case 2:
+		return TupleCompareWithKeyTypedSelect<2>::select(def->parts);
+	case 3:
+		return TupleCompareWithKeyTypedSelect<3>::select(def->parts);
+	case 4:
+		return TupleCompareWithKeyTypedSelect<4>::select(def->parts);
+	case 5:
+		return TupleCompareWithKeyTypedSelect<5>::select(def->parts);
+	default:
+		return NULL;
+	}
+}
+
 tuple_compare_with_key_t
 tuple_compare_with_key_create(const struct key_def *def)
 {
@@ -751,7 +984,193 @@ tuple_compare_with_key_create(const struct key_def *def)
 	}
 	if (key_def_is_sequential(def))
 		return tuple_compare_with_key_sequential;
+	tuple_compare_with_key_t typed =
+		tuple_compare_with_key_typed_create(def);
+	if (typed != NULL)
+		return typed;
 	return tuple_compare_with_key_slowpath;
 }
 
 /* }}} tuple_compare_with_key */
+
+/* {{{ tuple_hint */
+
+/**
+ * A hint is an unsigned 64-bit number built from the first key
+ * part so that hint(a) < hint(b) implies a < b. Equal hints say
+ * nothing, and the values must be compared in full.
+ */
+
+enum {
+	/** Bits of a SCALAR hint occupied by the mp_class. */
+	HINT_CLASS_BITS = 3,
+	/** Bits of a SCALAR hint left for the value. */
+	HINT_VALUE_BITS = 64 - HINT_CLASS_BITS,
+};
+
+static inline uint64_t
+hint_uint(uint64_t val)
+{
+	return val;
+}
+
+/**
+ * Non-negative values may come as MP_INT too, they get the
+ * same hints as the equal MP_UINT values.
+ */
+static inline uint64_t
+hint_int(int64_t val)
+{
+	return (uint64_t)val - (uint64_t)INT64_MIN;
+}
+
+/**
+ * Map an integer to [0, UINT64_MAX] preserving the order:
+ * negative values go below 2^63, and unsigned values which
+ * do not fit are clamped to UINT64_MAX.
+ */
+static inline uint64_t
+hint_integer(const char *field)
+{
+	if (mp_typeof(*field) == MP_INT)
+		return hint_int(mp_decode_int(&field));
+	uint64_t val = mp_decode_uint(&field);
+	if (val > INT64_MAX)
+		return UINT64_MAX;
+	return val - (uint64_t)INT64_MIN;
+}
+
+/**
+ * Take the bit pattern of a double and make it compare as
+ * an unsigned number: flip all bits of negative values and
+ * the sign bit of positive ones.
+ */
+static inline uint64_t
+hint_double(double val)
+{
+	/* -0.0 and 0.0 are equal and must have equal hints. */
+	if (val == 0)
+		val = 0;
+	uint64_t bits;
+	memcpy(&bits, &val, sizeof(bits));
+	if ((bits & (UINT64_C(1) << 63)) != 0)
+		return ~bits;
+	return bits | (UINT64_C(1) << 63);
+}
+
+static inline uint64_t
+hint_number(const char *field)
+{
+	double val;
+	switch (mp_typeof(*field)) {
+	case MP_UINT:
+		val = mp_decode_uint(&field);
+		break;
+	case MP_INT:
+		val = mp_decode_int(&field);
+		break;
+	default:
+		if (mp_read_double(&field, &val) != 0)
+			unreachable();
+		break;
+	}
+	return hint_double(val);
+}
+
+/** The first 8 bytes of a string in big-endian, zero padded. */
+static inline uint64_t
+hint_str(const char *str, uint32_t len)
+{
+	uint32_t process_len = MIN(len, sizeof(uint64_t));
+	if (process_len == 0)
+		return 0;
+	uint64_t result = 0;
+	for (uint32_t i = 0; i < process_len; i++) {
+		result <<= CHAR_BIT;
+		result |= (unsigned char)str[i];
+	}
+	return result << CHAR_BIT * (sizeof(uint64_t) - process_len);
+}
+
+static inline uint64_t
+hint_string(const char *field)
+{
+	uint32_t len;
+	const char *str = mp_decode_str(&field, &len);
+	return hint_str(str, len);
+}
+
+/**
+ * SCALAR values are ordered by mp_class first, so the class
+ * goes to the high bits and a coarsened value hint follows.
+ */
+static inline uint64_t
+hint_scalar(const char *field)
+{
+	enum mp_class mp_class = mp_classof(mp_typeof(*field));
+	uint64_t value;
+	uint32_t len;
+	const char *str;
+	switch (mp_class) {
+	case MP_CLASS_BOOL:
+		value = mp_decode_bool(&field);
+		break;
+	case MP_CLASS_NUMBER:
+		value = hint_number(field) >> HINT_CLASS_BITS;
+		break;
+	case MP_CLASS_STR:
+		str = mp_decode_str(&field, &len);
+		value = hint_str(str, len) >> HINT_CLASS_BITS;
+		break;
+	case MP_CLASS_BIN:
+		str = mp_decode_bin(&field, &len);
+		value = hint_str(str, len) >> HINT_CLASS_BITS;
+		break;
+	default:
+		value = 0;
+		break;
+	}
+	return ((uint64_t)mp_class << HINT_VALUE_BITS) | value;
+}
+
+static inline uint64_t
+field_hint(const char *field, enum field_type type)
+{
+	switch (type) {
+	case FIELD_TYPE_UNSIGNED:
+		return hint_uint(mp_decode_uint(&field));
+	case FIELD_TYPE_INTEGER:
+		return hint_integer(field);
+	case FIELD_TYPE_NUMBER:
+		return hint_number(field);
+	case FIELD_TYPE_STRING:
+		return hint_string(field);
+	case FIELD_TYPE_SCALAR:
+		return hint_scalar(field);
+	default:
+		return 0;
+	}
+}
+
+uint64_t
+tuple_hint(const struct tuple *tuple, const struct key_def *key_def)
+{
+	if (!key_def->opts.hint)
+		return 0;
+	const struct key_part *part = &key_def->parts[0];
+	const char *field = tuple_field(tuple, part->fieldno);
+	if (field == NULL)
+		return 0;
+	return field_hint(field, part->type);
+}
+
+uint64_t
+key_hint(const char *key, uint32_t part_count,
+	 const struct key_def *key_def)
+{
+	if (!key_def->opts.hint || part_count == 0)
+		return 0;
+	return field_hint(key, key_def->parts[0].type);
+}
+
+/* }}} tuple_hint */
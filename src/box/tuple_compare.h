@@ -109,6 +109,29 @@ tuple_compare_with_key(const struct tuple *tuple, const char *key,
 					       key_def);
 }
 
+/**
+ * Calculate a comparison hint of a tuple: an order preserving
+ * digest of its first key part. If hint(a) < hint(b) then
+ * a < b, equal hints require a full comparison. Always 0 if
+ * hints are disabled in the key definition or not supported
+ * for the type of the first key part.
+ *
+ * @param tuple tuple
+ * @param key_def key definition
+ * @return the hint
+ */
+uint64_t
+tuple_hint(const struct tuple *tuple, const struct key_def *key_def);
+
+/**
+ * @copydoc tuple_hint()
+ * @param key key parts without MessagePack array header
+ * @param part_count the number of parts in @a key, 0 gives 0
+ */
+uint64_t
+key_hint(const char *key, uint32_t part_count,
+	 const struct key_def *key_def);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
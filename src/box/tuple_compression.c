@@ -0,0 +1,477 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "tuple_compression.h"
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "zdict.h"
+
+#include "tt_pthread.h"
+#include "fiber.h"
+#include "coeio.h"
+#include "say.h"
+#include "errinj.h"
+#include "tuple.h"
+
+enum {
+	/** zstd compression level. */
+	TUPLE_COMPRESSION_LEVEL = 3,
+	/** Max size of a trained dictionary. */
+	TUPLE_COMPRESSION_DICT_SIZE = 16 * 1024,
+	/**
+	 * A dictionary is trained once this many samples
+	 * are collected...
+	 */
+	TUPLE_COMPRESSION_SAMPLE_COUNT = 1000,
+	/** ...or this many bytes of them, whichever is first. */
+	TUPLE_COMPRESSION_SAMPLE_SIZE = 1024 * 1024,
+};
+
+enum tuple_compression_state {
+	/** Large tuples are collected as samples. */
+	TUPLE_COMPRESSION_SAMPLING,
+	/** A dictionary is being trained on the samples. */
+	TUPLE_COMPRESSION_TRAINING,
+	/**
+	 * Large tuples are compressed, with the dictionary if
+	 * it has been trained successfully, without it otherwise.
+	 */
+	TUPLE_COMPRESSION_READY,
+};
+
+struct tuple_compression {
+	enum tuple_compression_state state;
+	/** Tuples shorter than this are not compressed. */
+	uint32_t threshold;
+	/** Samples, one after another. */
+	char *samples;
+	/** Total length of the samples. */
+	size_t samples_size;
+	/** Length of each sample. */
+	size_t *sample_sizes;
+	/** Number of samples. */
+	uint32_t sample_count;
+	/** Trained dictionary. */
+	void *dict;
+	/** Dictionary digested for compression, NULL if none. */
+	ZSTD_CDict *cdict;
+	/** Dictionary digested for decompression, NULL if none. */
+	ZSTD_DDict *ddict;
+	/** Next in the list of delayed compression objects. */
+	struct tuple_compression *next_delayed;
+};
+
+struct tuple_compression_stat tuple_compression_stat;
+
+/**
+ * The last tuple decompressed by the tx thread, see
+ * tuple_decompress_cached().
+ */
+struct tuple_decompress_cache {
+	/** The tuple, NULL if none. */
+	const struct tuple *tuple;
+	/** Its plain MessagePack. */
+	char *data;
+	/** Size of the allocated buffer. */
+	size_t capacity;
+};
+
+static struct tuple_decompress_cache tuple_decompress_cache;
+
+/**
+ * Compression objects deleted while a snapshot is in progress.
+ * Snapshot threads decompress tuples of the read view with them,
+ * so they are freed once the snapshot is over.
+ */
+static struct tuple_compression *tuple_compression_delayed;
+static bool tuple_compression_is_delayed_free_mode;
+
+/** Compression context, only the tx thread compresses tuples. */
+static ZSTD_CCtx *tuple_compression_cctx;
+/**
+ * Key of the decompression context of the calling thread,
+ * deleted on thread exit. Snapshot threads decompress tuples
+ * too.
+ */
+static pthread_key_t tuple_compression_dctx_key;
+
+static void
+tuple_compression_dctx_delete(void *arg)
+{
+	ZSTD_freeDCtx((ZSTD_DCtx *) arg);
+}
+
+static ZSTD_DCtx *
+tuple_compression_dctx(void)
+{
+	ZSTD_DCtx *dctx = (ZSTD_DCtx *)
+		tt_pthread_getspecific(tuple_compression_dctx_key);
+	if (dctx == NULL) {
+		dctx = ZSTD_createDCtx();
+		if (dctx == NULL)
+			return NULL;
+		tt_pthread_setspecific(tuple_compression_dctx_key, dctx);
+	}
+	return dctx;
+}
+
+void
+tuple_compression_init(void)
+{
+	tt_pthread_key_create(&tuple_compression_dctx_key,
+			      tuple_compression_dctx_delete);
+}
+
+void
+tuple_compression_free(void)
+{
+	if (tuple_compression_cctx != NULL) {
+		ZSTD_freeCCtx(tuple_compression_cctx);
+		tuple_compression_cctx = NULL;
+	}
+	free(tuple_decompress_cache.data);
+	memset(&tuple_decompress_cache, 0, sizeof(tuple_decompress_cache));
+}
+
+struct tuple_compression *
+tuple_compression_new(uint32_t threshold)
+{
+	struct tuple_compression *compression =
+		(struct tuple_compression *) calloc(1, sizeof(*compression));
+	if (compression == NULL) {
+		diag_set(OutOfMemory, sizeof(*compression), "calloc",
+			 "struct tuple_compression");
+		return NULL;
+	}
+	compression->state = TUPLE_COMPRESSION_SAMPLING;
+	compression->threshold = threshold;
+	return compression;
+}
+
+/** Free the samples once they are not needed. */
+static void
+tuple_compression_free_samples(struct tuple_compression *compression)
+{
+	free(compression->samples);
+	free(compression->sample_sizes);
+	compression->samples = NULL;
+	compression->sample_sizes = NULL;
+	compression->samples_size = 0;
+	compression->sample_count = 0;
+}
+
+void
+tuple_compression_delete(struct tuple_compression *compression)
+{
+	/* The training fiber references the format. */
+	assert(compression->state != TUPLE_COMPRESSION_TRAINING);
+	if (tuple_compression_is_delayed_free_mode) {
+		compression->next_delayed = tuple_compression_delayed;
+		tuple_compression_delayed = compression;
+		return;
+	}
+	tuple_compression_free_samples(compression);
+	if (compression->cdict != NULL)
+		ZSTD_freeCDict(compression->cdict);
+	if (compression->ddict != NULL)
+		ZSTD_freeDDict(compression->ddict);
+	free(compression->dict);
+	free(compression);
+}
+
+void
+tuple_compression_set_delayed_free_mode(bool mode)
+{
+	tuple_compression_is_delayed_free_mode = mode;
+	if (mode)
+		return;
+	while (tuple_compression_delayed != NULL) {
+		struct tuple_compression *compression =
+			tuple_compression_delayed;
+		tuple_compression_delayed = compression->next_delayed;
+		tuple_compression_delete(compression);
+	}
+}
+
+/** Train a dictionary, runs in a coeio thread. */
+static ssize_t
+tuple_compression_train_f(va_list ap)
+{
+	struct tuple_compression *compression =
+		va_arg(ap, struct tuple_compression *);
+	size_t size = ZDICT_trainFromBuffer(compression->dict,
+					    TUPLE_COMPRESSION_DICT_SIZE,
+					    compression->samples,
+					    compression->sample_sizes,
+					    compression->sample_count);
+	if (ZDICT_isError(size)) {
+		say_warn("failed to train a tuple compression "
+			 "dictionary: %s", ZDICT_getErrorName(size));
+		return -1;
+	}
+	compression->cdict = ZSTD_createCDict(compression->dict, size,
+					      TUPLE_COMPRESSION_LEVEL);
+	compression->ddict = ZSTD_createDDict(compression->dict, size);
+	if (compression->cdict == NULL || compression->ddict == NULL) {
+		say_warn("failed to allocate a tuple compression "
+			 "dictionary");
+		return -1;
+	}
+	say_info("trained a %zu-byte tuple compression dictionary "
+		 "on %u samples", size, compression->sample_count);
+	return 0;
+}
+
+static int
+tuple_compression_train_fiber_f(va_list ap)
+{
+	struct tuple_format *format = va_arg(ap, struct tuple_format *);
+	struct tuple_compression *compression = format->compression;
+	assert(compression->state == TUPLE_COMPRESSION_TRAINING);
+	compression->dict = malloc(TUPLE_COMPRESSION_DICT_SIZE);
+	if (compression->dict == NULL ||
+	    coio_call(tuple_compression_train_f, compression) != 0) {
+		/* Compress tuples without a dictionary. */
+		if (compression->cdict != NULL)
+			ZSTD_freeCDict(compression->cdict);
+		if (compression->ddict != NULL)
+			ZSTD_freeDDict(compression->ddict);
+		compression->cdict = NULL;
+		compression->ddict = NULL;
+	}
+	tuple_compression_free_samples(compression);
+	compression->state = TUPLE_COMPRESSION_READY;
+	tuple_format_ref(format, -1);
+	return 0;
+}
+
+/**
+ * Start training a dictionary for the format in a background
+ * fiber, so as not to block the tx thread.
+ */
+static void
+tuple_compression_start_training(struct tuple_format *format)
+{
+	struct tuple_compression *compression = format->compression;
+	compression->state = TUPLE_COMPRESSION_TRAINING;
+	struct fiber *fiber = fiber_new("tuple_compression",
+					tuple_compression_train_fiber_f);
+	if (fiber == NULL) {
+		diag_log();
+		tuple_compression_free_samples(compression);
+		compression->state = TUPLE_COMPRESSION_READY;
+		return;
+	}
+	/* Don't let the format go while the fiber uses it. */
+	tuple_format_ref(format, 1);
+	fiber_start(fiber, format);
+}
+
+static void
+tuple_compression_add_sample(struct tuple_format *format,
+			     const char *sample, size_t size)
+{
+	struct tuple_compression *compression = format->compression;
+	if (compression->samples == NULL) {
+		compression->samples = (char *)
+			malloc(TUPLE_COMPRESSION_SAMPLE_SIZE);
+		compression->sample_sizes = (size_t *)
+			malloc(TUPLE_COMPRESSION_SAMPLE_COUNT * sizeof(size_t));
+		if (compression->samples == NULL ||
+		    compression->sample_sizes == NULL) {
+			say_warn("failed to allocate tuple compression "
+				 "samples, compressing without a dictionary");
+			tuple_compression_free_samples(compression);
+			compression->state = TUPLE_COMPRESSION_READY;
+			return;
+		}
+	}
+	size = MIN(size, TUPLE_COMPRESSION_SAMPLE_SIZE -
+			 compression->samples_size);
+	memcpy(compression->samples + compression->samples_size,
+	       sample, size);
+	compression->samples_size += size;
+	compression->sample_sizes[compression->sample_count++] = size;
+	if (compression->sample_count == TUPLE_COMPRESSION_SAMPLE_COUNT ||
+	    compression->samples_size == TUPLE_COMPRESSION_SAMPLE_SIZE)
+		tuple_compression_start_training(format);
+}
+
+const char *
+tuple_compress(struct tuple_format *format, const char *data,
+	       const char *end, uint32_t *prefix_bsize, uint32_t *zsize)
+{
+	struct tuple_compression *compression = format->compression;
+	assert(compression != NULL);
+	if ((size_t) (end - data) < compression->threshold)
+		return NULL;
+	/* Skip the array header and the indexed fields. */
+	const char *tail = data;
+	uint32_t field_count = mp_decode_array(&tail);
+	field_count = MIN(field_count, format->field_count);
+	for (uint32_t i = 0; i < field_count; i++)
+		mp_next(&tail);
+	size_t tail_size = end - tail;
+	if (tail_size == 0)
+		return NULL;
+
+	switch (compression->state) {
+	case TUPLE_COMPRESSION_SAMPLING:
+		tuple_compression_add_sample(format, tail, tail_size);
+		return NULL;
+	case TUPLE_COMPRESSION_TRAINING:
+		return NULL;
+	case TUPLE_COMPRESSION_READY:
+		break;
+	}
+
+	if (tuple_compression_cctx == NULL) {
+		tuple_compression_cctx = ZSTD_createCCtx();
+		if (tuple_compression_cctx == NULL)
+			return NULL;
+	}
+	size_t bound = ZSTD_compressBound(tail_size);
+	char *buf = (char *) region_alloc(&fiber()->gc, bound);
+	if (buf == NULL)
+		return NULL;
+	size_t size;
+	if (compression->cdict != NULL) {
+		size = ZSTD_compress_usingCDict(tuple_compression_cctx,
+						buf, bound, tail, tail_size,
+						compression->cdict);
+	} else {
+		size = ZSTD_compressCCtx(tuple_compression_cctx,
+					 buf, bound, tail, tail_size,
+					 TUPLE_COMPRESSION_LEVEL);
+	}
+	/* Not worth it if the header eats up the gain. */
+	if (ZSTD_isError(size) ||
+	    size + sizeof(struct tuple_compressed) >= tail_size)
+		return NULL;
+	*prefix_bsize = tail - data;
+	*zsize = size;
+	return buf;
+}
+
+/**
+ * Decompress the MessagePack of a compressed tuple to a buffer
+ * of tuple_compressed(tuple)->raw_bsize bytes.
+ */
+static int
+tuple_decompress_to(const struct tuple *tuple, char *buf)
+{
+	const struct tuple_compressed *header = tuple_compressed(tuple);
+	struct tuple_compression *compression = header->compression;
+	ZSTD_DCtx *dctx = tuple_compression_dctx();
+	if (dctx == NULL) {
+		diag_set(ClientError, ER_DECOMPRESSION,
+			 "failed to create context");
+		return -1;
+	}
+	ERROR_INJECT(ERRINJ_TUPLE_DECOMPRESS, {
+		diag_set(ClientError, ER_DECOMPRESSION, "error injection");
+		return -1;
+	});
+	const char *data = tuple_data(tuple);
+	memcpy(buf, data, header->prefix_bsize);
+	char *tail = buf + header->prefix_bsize;
+	size_t tail_size = header->raw_bsize - header->prefix_bsize;
+	const char *src = data + header->prefix_bsize;
+	size_t src_size = tuple->bsize - header->prefix_bsize;
+	size_t size;
+	if (compression->ddict != NULL) {
+		size = ZSTD_decompress_usingDDict(dctx, tail, tail_size,
+						  src, src_size,
+						  compression->ddict);
+	} else {
+		size = ZSTD_decompressDCtx(dctx, tail, tail_size,
+					   src, src_size);
+	}
+	if (ZSTD_isError(size) || size != tail_size) {
+		diag_set(ClientError, ER_DECOMPRESSION,
+			 ZSTD_isError(size) ? ZSTD_getErrorName(size) :
+			 "wrong size of a tuple");
+		return -1;
+	}
+	return 0;
+}
+
+const char *
+tuple_decompress(const struct tuple *tuple, struct region *region,
+		 uint32_t *p_size)
+{
+	uint32_t raw_bsize = tuple_compressed(tuple)->raw_bsize;
+	char *buf = (char *) region_alloc(region, raw_bsize);
+	if (buf == NULL) {
+		diag_set(OutOfMemory, raw_bsize, "region",
+			 "decompressed tuple");
+		return NULL;
+	}
+	if (tuple_decompress_to(tuple, buf) != 0)
+		return NULL;
+	*p_size = raw_bsize;
+	return buf;
+}
+
+const char *
+tuple_decompress_cached(const struct tuple *tuple, uint32_t *p_size)
+{
+	assert(cord_is_main());
+	struct tuple_decompress_cache *cache = &tuple_decompress_cache;
+	uint32_t raw_bsize = tuple_compressed(tuple)->raw_bsize;
+	if (cache->tuple == tuple) {
+		*p_size = raw_bsize;
+		return cache->data;
+	}
+	cache->tuple = NULL;
+	if (cache->capacity < raw_bsize) {
+		char *data = (char *) realloc(cache->data, raw_bsize);
+		if (data == NULL) {
+			diag_set(OutOfMemory, raw_bsize, "realloc",
+				 "decompressed tuple");
+			return NULL;
+		}
+		cache->data = data;
+		cache->capacity = raw_bsize;
+	}
+	if (tuple_decompress_to(tuple, cache->data) != 0)
+		return NULL;
+	cache->tuple = tuple;
+	*p_size = raw_bsize;
+	return cache->data;
+}
+
+void
+tuple_decompress_cache_drop(const struct tuple *tuple)
+{
+	if (tuple_decompress_cache.tuple == tuple)
+		tuple_decompress_cache.tuple = NULL;
+}
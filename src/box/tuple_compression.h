@@ -0,0 +1,132 @@
+#ifndef TARANTOOL_BOX_TUPLE_COMPRESSION_H_INCLUDED
+#define TARANTOOL_BOX_TUPLE_COMPRESSION_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * Compression of memtx tuples with zstd.
+ *
+ * A space with compression = 'zstd' has the compression object
+ * in its tuple format. The tail of a large tuple, past its last
+ * indexed field, is compressed, while the array header and the
+ * indexed fields are stored as is, so that indexes compare and
+ * hash tuples without decompressing them. Other fields and the
+ * whole MessagePack are decompressed on demand to a buffer which
+ * keeps the last decompressed tuple.
+ *
+ * The first large tuples of a format are not compressed, but
+ * are collected as samples. Then a dictionary is trained on the
+ * samples in a coeio thread, and the next tuples are compressed
+ * with it. The dictionary is not persisted: snapshots and xlogs
+ * contain plain tuples, and a new dictionary is trained after
+ * restart.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+struct tuple;
+struct tuple_format;
+struct tuple_compression;
+
+/** Statistics of compressed memtx tuples, for box.slab.info(). */
+struct tuple_compression_stat {
+	/** Length of the plain MessagePack of compressed tuples. */
+	size_t raw_size;
+	/** Length of the MessagePack of compressed tuples as stored. */
+	size_t size;
+};
+
+extern struct tuple_compression_stat tuple_compression_stat;
+
+/** Initialize the tuple compression library. */
+void
+tuple_compression_init(void);
+
+/** Cleanup the tuple compression library. */
+void
+tuple_compression_free(void);
+
+/**
+ * Create compression of tuples of a format.
+ * @param threshold Tuples shorter than this are not compressed.
+ * @retval not NULL Success.
+ * @retval     NULL Memory error.
+ */
+struct tuple_compression *
+tuple_compression_new(uint32_t threshold);
+
+/** Destroy compression of tuples of a format. */
+void
+tuple_compression_delete(struct tuple_compression *compression);
+
+/**
+ * Don't free compression objects, but put them aside until the
+ * mode is off, while snapshot threads decompress tuples with
+ * them, @sa memtx_tuple_begin_snapshot().
+ */
+void
+tuple_compression_set_delayed_free_mode(bool mode);
+
+/**
+ * Forget the decompressed MessagePack of a tuple which is
+ * deleted, @sa tuple_decompress_cached().
+ */
+void
+tuple_decompress_cache_drop(const struct tuple *tuple);
+
+/**
+ * Compress the MessagePack of a new tuple of the format, if it
+ * is long enough and there is a dictionary for the format, or
+ * take it as a sample otherwise. Never fails: a tuple which is
+ * not worth compressing or can't be compressed is stored as is.
+ * @param format Tuple format with compression.
+ * @param data MessagePack array.
+ * @param end End of @a data.
+ * @param[out] prefix_bsize Length of the leading part of @a data
+ *             left as is.
+ * @param[out] zsize Length of the compressed rest.
+ * @retval NULL The tuple must be stored as is.
+ * @retval not NULL The compressed rest, allocated on the fiber
+ *         region.
+ */
+const char *
+tuple_compress(struct tuple_format *format, const char *data,
+	       const char *end, uint32_t *prefix_bsize, uint32_t *zsize);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_BOX_TUPLE_COMPRESSION_H_INCLUDED */
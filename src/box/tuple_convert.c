@@ -36,6 +36,8 @@ tuple_to_obuf(struct tuple *tuple, struct obuf *buf)
 {
 	uint32_t bsize;
 	const char *data = tuple_data_range(tuple, &bsize);
+	if (data == NULL)
+		return -1;
 	if (obuf_dup(buf, data, bsize) != bsize) {
 		diag_set(OutOfMemory, bsize, "tuple_to_obuf", "dup");
 		return -1;
@@ -43,11 +45,51 @@ tuple_to_obuf(struct tuple *tuple, struct obuf *buf)
 	return 0;
 }
 
+int
+tuple_fields_to_obuf(const struct tuple *tuple, const char *fields,
+		     uint32_t index_base, struct obuf *buf)
+{
+	char nil[1];
+	mp_encode_nil(nil);
+	/* Decompress a compressed tuple once for all of the fields. */
+	const struct tuple_format *format = tuple_format(tuple);
+	const uint32_t *field_map = tuple_field_map(tuple);
+	uint32_t tuple_bsize;
+	const char *tuple_raw = tuple_data_range(tuple, &tuple_bsize);
+	if (tuple_raw == NULL)
+		return -1;
+	uint32_t count = mp_decode_array(&fields);
+	char header[5];
+	uint32_t bsize = mp_encode_array(header, count) - header;
+	if (obuf_dup(buf, header, bsize) != bsize)
+		goto error;
+	for (uint32_t i = 0; i < count; i++) {
+		const char *field = tuple_field_raw(format, tuple_raw, field_map,
+				mp_decode_uint(&fields) - index_base);
+		const char *end = field;
+		if (field == NULL) {
+			field = nil;
+			end = nil + sizeof(nil);
+		} else {
+			mp_next(&end);
+		}
+		bsize = end - field;
+		if (obuf_dup(buf, field, bsize) != bsize)
+			goto error;
+	}
+	return 0;
+error:
+	diag_set(OutOfMemory, bsize, "tuple_fields_to_obuf", "dup");
+	return -1;
+}
+
 ssize_t
 tuple_to_buf(const struct tuple *tuple, char *buf, size_t size)
 {
 	uint32_t bsize;
 	const char *data = tuple_data_range(tuple, &bsize);
+	if (data == NULL)
+		return -1;
 	if (likely(bsize <= size)) {
 		memcpy(buf, data, bsize);
 	}
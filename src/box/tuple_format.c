@@ -29,6 +29,7 @@
  * SUCH DAMAGE.
  */
 #include "tuple_format.h"
+#include "tuple_compression.h"
 
 /** Global table of tuple formats */
 struct tuple_format **tuple_formats;
@@ -47,8 +48,10 @@ tuple_format_create(struct tuple_format *format, struct rlist *key_list)
 		return 0;
 	}
 
+	uint32_t field_count = MAX(format->field_count,
+				   format->offset_field_count);
 	/* There may be fields between indexed fields (gaps). */
-	for (uint32_t i = 0; i < format->field_count; i++) {
+	for (uint32_t i = 0; i < field_count; i++) {
 		format->fields[i].type = FIELD_TYPE_ANY;
 		format->fields[i].offset_slot = TUPLE_OFFSET_SLOT_NIL;
 	}
@@ -97,6 +100,15 @@ tuple_format_create(struct tuple_format *format, struct rlist *key_list)
 		}
 	}
 
+	/*
+	 * Store offsets of the leading fields requested by space
+	 * options, whether they are indexed or not.
+	 */
+	for (uint32_t i = 1; i < format->offset_field_count; i++) {
+		if (format->fields[i].offset_slot == TUPLE_OFFSET_SLOT_NIL)
+			format->fields[i].offset_slot = --current_slot;
+	}
+
 	assert(format->fields[0].offset_slot == TUPLE_OFFSET_SLOT_NIL);
 	if (-current_slot * sizeof(uint32_t) > UINT16_MAX) {
 		/** tuple->data_offset is 16 bits */
@@ -155,7 +167,7 @@ tuple_format_deregister(struct tuple_format *format)
 }
 
 static struct tuple_format *
-tuple_format_alloc(struct rlist *key_list)
+tuple_format_alloc(struct rlist *key_list, uint32_t offset_field_count)
 {
 	struct key_def *key_def;
 	uint32_t max_fieldno = 0;
@@ -170,9 +182,13 @@ tuple_format_alloc(struct rlist *key_list)
 			max_fieldno = MAX(max_fieldno, part->fieldno);
 	}
 	uint32_t field_count = key_count > 0 ? max_fieldno + 1 : 0;
+	/* A format without keys is never used for tuples in a space. */
+	if (field_count == 0)
+		offset_field_count = 0;
 
 	uint32_t total = sizeof(struct tuple_format) +
-			 field_count * sizeof(struct tuple_field_format);
+			 MAX(field_count, offset_field_count) *
+			 sizeof(struct tuple_field_format);
 
 	struct tuple_format *format = (struct tuple_format *) malloc(total);
 	if (format == NULL) {
@@ -184,7 +200,9 @@ tuple_format_alloc(struct rlist *key_list)
 	format->refs = 0;
 	format->id = FORMAT_ID_NIL;
 	format->field_count = field_count;
+	format->offset_field_count = offset_field_count;
 	format->exact_field_count = 0;
+	format->compression = NULL;
 	return format;
 }
 
@@ -192,13 +210,17 @@ void
 tuple_format_delete(struct tuple_format *format)
 {
 	tuple_format_deregister(format);
+	if (format->compression != NULL)
+		tuple_compression_delete(format->compression);
 	free(format);
 }
 
 struct tuple_format *
-tuple_format_new(struct rlist *key_list, struct tuple_format_vtab *vtab)
+tuple_format_new(struct rlist *key_list, uint32_t offset_field_count,
+		 struct tuple_format_vtab *vtab)
 {
-	struct tuple_format *format = tuple_format_alloc(key_list);
+	struct tuple_format *format = tuple_format_alloc(key_list,
+							 offset_field_count);
 	if (format == NULL)
 		return NULL;
 	format->vtab = *vtab;
@@ -256,6 +278,17 @@ tuple_init_field_map(const struct tuple_format *format, uint32_t *field_map,
 				(uint32_t) (pos - tuple);
 		mp_next(&pos);
 	}
+	/* non-indexed fields with stored offsets */
+	for (uint32_t i = format->field_count;
+	     i < format->offset_field_count; i++) {
+		int32_t offset_slot = format->fields[i].offset_slot;
+		if (i < field_count) {
+			field_map[offset_slot] = (uint32_t) (pos - tuple);
+			mp_next(&pos);
+		} else {
+			field_map[offset_slot] = 0;
+		}
+	}
 	return 0;
 }
 
@@ -263,7 +296,8 @@ int
 tuple_format_init()
 {
 	RLIST_HEAD(empty_list);
-	tuple_format_default = tuple_format_new(&empty_list, &memtx_tuple_format_vtab);
+	tuple_format_default = tuple_format_new(&empty_list, 0,
+					       &memtx_tuple_format_vtab);
 	if (tuple_format_default == NULL)
 		return -1;
 	/* Make sure this one stays around. */
@@ -87,8 +87,10 @@ struct tuple_field_format {
 	 * used fields without parsing entire mspack.
 	 * This member stores position in the field map of tuple
 	 * for current field.
-	 * If the field does not participate in indexes then it has
-	 * no offset in field map and INT_MAX is stored in this member.
+	 * If the field does not participate in indexes and is not
+	 * one of the first tuple_format::offset_field_count fields
+	 * then it has no offset in field map and INT_MAX is stored
+	 * in this member.
 	 * Due to specific field map in tuple (it is stored before tuple),
 	 * the positions in field map is negative.
 	 * Thus if this member is negative, smth like
@@ -100,6 +102,7 @@ struct tuple_field_format {
 
 struct tuple;
 struct tuple_format;
+struct tuple_compression;
 
 /** Engine-specific tuple format methods. */
 struct tuple_format_vtab {
@@ -129,13 +132,29 @@ struct tuple_format {
 	 * fields. If set, each tuple must have exactly this number of fields.
 	 */
 	uint32_t exact_field_count;
-	/* Length of 'fields' array. */
+	/*
+	 * Number of indexed fields, i.e. the minimal number of
+	 * fields in a tuple.
+	 */
 	uint32_t field_count;
+	/**
+	 * Offsets of fields below this number are stored in the
+	 * field map even if the fields are not indexed. A tuple
+	 * may have less fields, then the offsets of missing fields
+	 * are 0. Length of 'fields' array is the maximum of this
+	 * member and field_count.
+	 */
+	uint32_t offset_field_count;
 	/**
 	 * Size of field map of tuple in bytes.
 	 * See tuple_field_format::ofset for details//
 	 */
 	uint16_t field_map_size;
+	/**
+	 * Compression of large tuples of this format, NULL if
+	 * they are stored as is, see tuple_compression.h.
+	 */
+	struct tuple_compression *compression;
 
 	/* Formats of the fields */
 	struct tuple_field_format fields[];
@@ -181,13 +200,16 @@ tuple_format_ref(struct tuple_format *format, int count)
 /**
  * Allocate, construct and register a new in-memory tuple format.
  * @param key_list List of key_defs of a space.
- * @param name  name of the tuple format
+ * @param offset_field_count Number of leading fields to store
+ *        offsets of, see tuple_format::offset_field_count.
+ * @param vtab Engine-specific tuple format methods.
  *
  * @retval not NULL Tuple format.
  * @retval     NULL Memory error.
  */
 struct tuple_format *
-tuple_format_new(struct rlist *key_list, struct tuple_format_vtab *vtab);
+tuple_format_new(struct rlist *key_list, uint32_t offset_field_count,
+		 struct tuple_format_vtab *vtab);
 
 /**
  * Fill the field map of tuple with field offsets.
@@ -204,6 +226,8 @@ tuple_format_new(struct rlist *key_list, struct tuple_format_vtab *vtab);
  *                                ^
  *                             field_map
  * tuple + off_i = indexed_field_i;
+ * The offsets of the first format->offset_field_count fields
+ * are also stored, 0 for fields missing in the tuple.
  */
 int
 tuple_init_field_map(const struct tuple_format *format, uint32_t *field_map,
@@ -235,6 +259,10 @@ tuple_field_raw(const struct tuple_format *format, const char *tuple,
 		int32_t offset_slot = format->fields[field_no].offset_slot;
 		if (offset_slot != TUPLE_OFFSET_SLOT_NIL)
 			return tuple + field_map[offset_slot];
+	} else if (field_no < format->offset_field_count) {
+		/* Non-indexed field with a stored offset */
+		uint32_t offset = field_map[format->fields[field_no].offset_slot];
+		return offset != 0 ? tuple + offset : NULL;
 	}
 	ERROR_INJECT(ERRINJ_TUPLE_FIELD, return NULL);
 	uint32_t field_count = mp_decode_array(&tuple);
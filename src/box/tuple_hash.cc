@@ -0,0 +1,323 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "tuple_hash.h"
+#include "tuple.h"
+
+#include "third_party/PMurHash.h"
+
+uint32_t
+tuple_hash_field(uint32_t *ph1, uint32_t *pcarry, const char **field,
+		 enum field_type type)
+{
+	const char *f = *field;
+	uint32_t size;
+
+	switch (type) {
+	case FIELD_TYPE_STRING:
+		/*
+		 * (!) MP_STR fields hashed **excluding** MsgPack format
+		 * indentifier. We have to do that to keep compatibility
+		 * with old third-party MsgPack (spec-old.md) implementations.
+		 * \sa https://github.com/tarantool/tarantool/issues/522
+		 */
+		f = mp_decode_str(field, &size);
+		break;
+	default:
+		mp_next(field);
+		size = *field - f;  /* calculate the size of field */
+		/*
+		 * (!) All other fields hashed **including** MsgPack format
+		 * identifier (e.g. 0xcc). This was done **intentionally**
+		 * for performance reasons. Please follow MsgPack specification
+		 * and pack all your numbers to the most compact representation.
+		 * If you still want to add support for broken MsgPack,
+		 * please don't forget to patch tuple_compare_field().
+		 */
+		break;
+	}
+	assert(size < INT32_MAX);
+	PMurHash32_Process(ph1, pcarry, f, size);
+	return size;
+}
+
+/**
+ * Hash a single unsigned field. Speeds up the simplest case
+ * when we have a single-part hash over an integer field.
+ */
+static inline uint32_t
+field_hash_uint(const char *field)
+{
+	uint64_t val = mp_decode_uint(&field);
+	if (likely(val <= UINT32_MAX))
+		return val;
+	return ((uint32_t)((val)>>33^(val)^(val)<<11));
+}
+
+static uint32_t
+tuple_hash_uint(const struct tuple *tuple, const struct key_def *key_def)
+{
+	assert(key_def->part_count == 1);
+	return field_hash_uint(tuple_field(tuple, key_def->parts[0].fieldno));
+}
+
+static uint32_t
+key_hash_uint(const char *key, const struct key_def *key_def)
+{
+	assert(key_def->part_count == 1);
+	(void) key_def;
+	return field_hash_uint(key);
+}
+
+static uint32_t
+tuple_hash_slowpath(const struct tuple *tuple, const struct key_def *key_def)
+{
+	const struct key_part *part = key_def->parts;
+	uint32_t h = HASH_SEED;
+	uint32_t carry = 0;
+	uint32_t total_size = 0;
+
+	for ( ; part < key_def->parts + key_def->part_count; part++) {
+		const char *field = tuple_field(tuple, part->fieldno);
+		total_size += tuple_hash_field(&h, &carry, &field, part->type);
+	}
+
+	return PMurHash32_Result(h, carry, total_size);
+}
+
+static uint32_t
+key_hash_slowpath(const char *key, const struct key_def *key_def)
+{
+	const struct key_part *part = key_def->parts;
+	uint32_t h = HASH_SEED;
+	uint32_t carry = 0;
+	uint32_t total_size = 0;
+
+	/* Hash fields part by part (see tuple_hash_field() comments) */
+	for ( ; part < key_def->parts + key_def->part_count; part++)
+		total_size += tuple_hash_field(&h, &carry, &key, part->type);
+
+	return PMurHash32_Result(h, carry, total_size);
+}
+
+/**
+ * Hash functions specialized by the sequence of part types,
+ * see TupleCompareTyped in tuple_compare.cc. Must give the
+ * same result as tuple_hash_field().
+ */
+template <int TYPE>
+static inline uint32_t
+field_hash(uint32_t *ph1, uint32_t *pcarry, const char **field);
+
+template <>
+inline uint32_t
+field_hash<FIELD_TYPE_UNSIGNED>(uint32_t *ph1, uint32_t *pcarry,
+				const char **field)
+{
+	const char *f = *field;
+	mp_next(field);
+	uint32_t size = *field - f;
+	PMurHash32_Process(ph1, pcarry, f, size);
+	return size;
+}
+
+template <>
+inline uint32_t
+field_hash<FIELD_TYPE_STRING>(uint32_t *ph1, uint32_t *pcarry,
+			       const char **field)
+{
+	uint32_t size;
+	const char *f = mp_decode_str(field, &size);
+	assert(size < INT32_MAX);
+	PMurHash32_Process(ph1, pcarry, f, size);
+	return size;
+}
+
+namespace /* local symbols */ {
+
+template <int TYPE, int ...MORE_TYPES>
+struct KeyFieldHash
+{
+	inline static uint32_t hash(uint32_t *ph1, uint32_t *pcarry,
+				    const char **key)
+	{
+		uint32_t size = field_hash<TYPE>(ph1, pcarry, key);
+		return size + KeyFieldHash<MORE_TYPES...>::
+			hash(ph1, pcarry, key);
+	}
+};
+
+template <int TYPE>
+struct KeyFieldHash<TYPE>
+{
+	inline static uint32_t hash(uint32_t *ph1, uint32_t *pcarry,
+				    const char **key)
+	{
+		return field_hash<TYPE>(ph1, pcarry, key);
+	}
+};
+
+template <int TYPE, int ...MORE_TYPES>
+struct TupleFieldHash
+{
+	inline static uint32_t hash(uint32_t *ph1, uint32_t *pcarry,
+				    const struct tuple_format *format,
+				    const char *tuple,
+				    const uint32_t *field_map,
+				    const struct key_part *part)
+	{
+		const char *field = tuple_field_raw(format, tuple, field_map,
+						    part->fieldno);
+		uint32_t size = field_hash<TYPE>(ph1, pcarry, &field);
+		return size + TupleFieldHash<MORE_TYPES...>::
+			hash(ph1, pcarry, format, tuple, field_map, part + 1);
+	}
+};
+
+template <int TYPE>
+struct TupleFieldHash<TYPE>
+{
+	inline static uint32_t hash(uint32_t *ph1, uint32_t *pcarry,
+				    const struct tuple_format *format,
+				    const char *tuple,
+				    const uint32_t *field_map,
+				    const struct key_part *part)
+	{
+		const char *field = tuple_field_raw(format, tuple, field_map,
+						    part->fieldno);
+		return field_hash<TYPE>(ph1, pcarry, &field);
+	}
+};
+
+template <int ...TYPES>
+struct TupleHashTyped
+{
+	static uint32_t tuple_hash(const struct tuple *tuple,
+				   const struct key_def *key_def)
+	{
+		assert(key_def->part_count == sizeof...(TYPES));
+		uint32_t h = HASH_SEED;
+		uint32_t carry = 0;
+		uint32_t total_size = TupleFieldHash<TYPES...>::
+			hash(&h, &carry, tuple_format(tuple),
+			     tuple_data(tuple), tuple_field_map(tuple),
+			     key_def->parts);
+		return PMurHash32_Result(h, carry, total_size);
+	}
+
+	static uint32_t key_hash(const char *key,
+				 const struct key_def *key_def)
+	{
+		assert(key_def->part_count == sizeof...(TYPES));
+		(void) key_def;
+		uint32_t h = HASH_SEED;
+		uint32_t carry = 0;
+		uint32_t total_size = KeyFieldHash<TYPES...>::
+			hash(&h, &carry, &key);
+		return PMurHash32_Result(h, carry, total_size);
+	}
+};
+
+/**
+ * Walk the key parts and pick the instance matching their
+ * types. LEFT is the number of parts not yet looked at.
+ */
+template <uint32_t LEFT, int ...TYPES>
+struct TupleHashTypedSelect
+{
+	static void select(const struct key_part *part,
+			   tuple_hash_t *tuple_hash, key_hash_t *key_hash)
+	{
+		switch (part->type) {
+		case FIELD_TYPE_UNSIGNED:
+			return TupleHashTypedSelect<LEFT - 1, TYPES...,
+				FIELD_TYPE_UNSIGNED>::select(part + 1,
+							     tuple_hash,
+							     key_hash);
+		case FIELD_TYPE_STRING:
+			return TupleHashTypedSelect<LEFT - 1, TYPES...,
+				FIELD_TYPE_STRING>::select(part + 1,
+							   tuple_hash,
+							   key_hash);
+		default:
+			return;
+		}
+	}
+};
+
+template <int ...TYPES>
+struct TupleHashTypedSelect<0, TYPES...>
+{
+	static void select(const struct key_part *,
+			   tuple_hash_t *tuple_hash, key_hash_t *key_hash)
+	{
+		*tuple_hash = TupleHashTyped<TYPES...>::tuple_hash;
+		*key_hash = TupleHashTyped<TYPES...>::key_hash;
+	}
+};
+
+} /* end of anonymous namespace */
+
+void
+tuple_hash_func_set(struct key_def *def)
+{
+	if (def->part_count == 1 &&
+	    def->parts[0].type == FIELD_TYPE_UNSIGNED) {
+		def->tuple_hash = tuple_hash_uint;
+		def->key_hash = key_hash_uint;
+		return;
+	}
+	def->tuple_hash = tuple_hash_slowpath;
+	def->key_hash = key_hash_slowpath;
+	switch (def->part_count) {
+	case 1:
+		TupleHashTypedSelect<1>::select(def->parts, &def->tuple_hash,
+						&def->key_hash);
+		break;
+	case 2:
+		TupleHashTypedSelect<2>::select(def->parts, &def->tuple_hash,
+						&def->key_hash);
+		break;
+	case 3:
+		TupleHashTypedSelect<3>::select(def->parts, &def->tuple_hash,
+						&def->key_hash);
+		break;
+	case 4:
+		TupleHashTypedSelect<4>::select(def->parts, &def->tuple_hash,
+						&def->key_hash);
+		break;
+	case 5:
+		TupleHashTypedSelect<5>::select(def->parts, &def->tuple_hash,
+						&def->key_hash);
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef TARANTOOL_BOX_TUPLE_HASH_H_INCLUDED
+#define TARANTOOL_BOX_TUPLE_HASH_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+#include <stddef.h>
+#include <stdint.h>
+
+#include "key_def.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+struct tuple;
+
+enum {
+	HASH_SEED = 13U
+};
+
+/**
+ * Feed a single MsgPack field to an incremental PMurHash32
+ * calculation and advance the field pointer past it.
+ *
+ * @param ph1 PMurHash32 state
+ * @param pcarry PMurHash32 carry
+ * @param field the field, advanced to the next one on return
+ * @param type the field type
+ * @return the number of bytes hashed
+ */
+uint32_t
+tuple_hash_field(uint32_t *ph1, uint32_t *pcarry, const char **field,
+		 enum field_type type);
+
+/**
+ * Initialize tuple_hash and key_hash functions of the key
+ * definition, specialized for its part types if possible.
+ * @param def key definition
+ */
+void
+tuple_hash_func_set(struct key_def *def);
+
+/**
+ * Calculate a hash of the key fields of a tuple.
+ * @param tuple tuple
+ * @param key_def key definition
+ */
+static inline uint32_t
+tuple_hash(const struct tuple *tuple, const struct key_def *key_def)
+{
+	return key_def->tuple_hash(tuple, key_def);
+}
+
+/**
+ * Calculate a hash of a key. The hash is equal to the hash of
+ * a tuple with the same key fields.
+ * @param key key parts without MessagePack array header
+ * @param key_def key definition
+ */
+static inline uint32_t
+key_hash(const char *key, const struct key_def *key_def)
+{
+	return key_def->key_hash(key, key_def);
+}
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_BOX_TUPLE_HASH_H_INCLUDED */
@@ -102,6 +102,7 @@ txn_begin(bool is_autocommit)
 	txn->n_rows = 0;
 	txn->is_autocommit = is_autocommit;
 	txn->has_triggers  = false;
+	txn->is_async = false;
 	txn->in_sub_stmt = 0;
 	txn->engine = NULL;
 	txn->engine_tx = NULL;
@@ -219,6 +220,10 @@ txn_write_to_wal(struct txn *txn)
 	if (wal == NULL) {
 		/** wal_mode = NONE or initial recovery. */
 		res = vclock_sum(&recovery->vclock);
+	} else if (txn->is_async) {
+		res = wal_write_async(wal, req);
+		if (res == 0)
+			res = vclock_sum(&recovery->vclock);
 	} else {
 		res = wal_write(wal, req);
 	}
@@ -342,8 +347,8 @@ box_txn_begin()
 	return 0;
 }
 
-int
-box_txn_commit()
+static int
+box_txn_commit_impl(bool is_async)
 {
 	struct txn *txn = in_txn();
 	/**
@@ -358,6 +363,7 @@ box_txn_commit()
 		diag_set(ClientError, ER_COMMIT_IN_SUB_STMT);
 		return -1;
 	}
+	txn->is_async = is_async;
 	try {
 		txn_commit(txn);
 	} catch (Exception *e) {
@@ -367,6 +373,18 @@ box_txn_commit()
 	return 0;
 }
 
+int
+box_txn_commit()
+{
+	return box_txn_commit_impl(false);
+}
+
+int
+box_txn_commit_async()
+{
+	return box_txn_commit_impl(true);
+}
+
 int
 box_txn_rollback()
 {
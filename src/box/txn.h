@@ -87,6 +87,11 @@ struct txn {
 	bool is_autocommit;
 	/** True if on_commit and on_rollback lists are non-empty. */
 	bool has_triggers;
+	/**
+	 * True if the commit must not wait for the transaction
+	 * to be written to WAL, see box_txn_commit_async().
+	 */
+	bool is_async;
 	/** The number of active nested statement-level transactions. */
 	int in_sub_stmt;
 	/** Engine involved in multi-statement transaction. */
@@ -291,4 +296,22 @@ box_txn_alloc(size_t size);
 
 /** \endcond public */
 
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * Commit the current transaction without waiting for it to
+ * be written to WAL. The changes become visible at once, while
+ * a failure to write them is only reported to the log.
+ * @retval 0 - success
+ * @retval -1 - failed, the transaction is rolled back
+ */
+int
+box_txn_commit_async(void);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
 #endif /* TARANTOOL_BOX_TXN_H_INCLUDED */
@@ -75,6 +75,7 @@
 #include "xrow.h"
 #include "xlog.h"
 #include "fio.h"
+#include "uring.h"
 #include "space.h"
 #include "index.h"
 
@@ -82,6 +83,9 @@
 
 #define HEAP_FORWARD_DECLARATION
 #include "salad/heap.h"
+#include "salad/bloom.h"
+#include "tuple_hash.h"
+#include "third_party/PMurHash.h"
 
 #define vy_cmp(a, b) \
 	((a) == (b) ? 0 : (((a) > (b)) ? 1 : -1))
@@ -102,8 +106,92 @@ struct vy_conf {
 	uint64_t memory_limit;
 	/* read cache quota */
 	uint64_t cache;
+	/* number of pages read ahead by a sequential scan */
+	uint32_t read_ahead;
+	/* page cache quota */
+	uint64_t page_cache;
 };
 
+struct vy_page;
+
+/** An entry of the page cache hash. */
+struct vy_page_cache_node {
+	/** ID of the run the page belongs to. */
+	int64_t run_id;
+	/** Page number in the run. */
+	uint32_t page_no;
+	/** The cached page. */
+	struct vy_page *page;
+};
+
+/** A key to look up a page in the page cache. */
+struct vy_page_cache_key {
+	int64_t run_id;
+	uint32_t page_no;
+};
+
+static inline uint32_t
+vy_page_cache_hash(int64_t run_id, uint32_t page_no)
+{
+	uint64_t h = (uint64_t) run_id * 0x9E3779B97F4A7C15ULL + page_no;
+	return (uint32_t) (h >> 32) ^ (uint32_t) h;
+}
+
+#define mh_name _vy_page_cache
+#define mh_key_t const struct vy_page_cache_key *
+#define mh_node_t struct vy_page_cache_node
+#define mh_arg_t void *
+#define mh_hash(a, arg) vy_page_cache_hash((a)->run_id, (a)->page_no)
+#define mh_hash_key(a, arg) vy_page_cache_hash((a)->run_id, (a)->page_no)
+#define mh_cmp(a, b, arg) ((a)->run_id != (b)->run_id || \
+			   (a)->page_no != (b)->page_no)
+#define mh_cmp_key(a, b, arg) mh_cmp(a, b, arg)
+#define MH_SOURCE 1
+#include "salad/mhash.h"
+
+/**
+ * Cache of decompressed run pages shared by all indexes.
+ * Pages are looked up by (run id, page number), which never
+ * change since runs are immutable and run ids are not reused.
+ * Once the total size of cached pages exceeds the quota, the
+ * least recently used pages are evicted. Pages of deleted runs
+ * are never looked up again and age out of the cache.
+ * Used only in the tx thread.
+ */
+struct vy_page_cache {
+	/** Cached pages by (run id, page number). */
+	struct mh_vy_page_cache_t *hash;
+	/** LRU list of cached pages. The first page is the newest. */
+	struct rlist lru;
+	/** Total size of cached pages. */
+	uint64_t used;
+	/** Memory quota. 0 disables the cache. */
+	uint64_t limit;
+	/** The number of lookups which found the page. */
+	uint64_t hit;
+	/** The number of lookups which didn't find the page. */
+	uint64_t miss;
+};
+
+static int
+vy_page_cache_create(struct vy_page_cache *cache, uint64_t limit)
+{
+	cache->hash = mh_vy_page_cache_new();
+	if (cache->hash == NULL) {
+		diag_set(OutOfMemory, sizeof(*cache->hash), "malloc",
+			 "page cache");
+		return -1;
+	}
+	rlist_create(&cache->lru);
+	cache->used = 0;
+	cache->limit = limit;
+	cache->hit = cache->miss = 0;
+	return 0;
+}
+
+static void
+vy_page_cache_destroy(struct vy_page_cache *cache);
+
 struct vy_env {
 	/** Recovery status */
 	enum vy_status status;
@@ -137,6 +225,8 @@ struct vy_env {
 	ev_timer            quota_timer;
 	/** Enviroment for cache subsystem */
 	struct vy_cache_env cache_env;
+	/** Cache of decompressed run pages */
+	struct vy_page_cache page_cache;
 };
 
 #define vy_crcs(p, size, crc) \
@@ -213,6 +303,12 @@ struct vy_stat {
 	 */
 	struct histogram *dump_bw;
 	int64_t dump_total;
+	/** Time it takes to read a page from disk, in microseconds. */
+	struct histogram *read_latency;
+	/** The number of pages submitted for reading ahead. */
+	uint64_t read_ahead;
+	/** The number of pages read ahead and then used. */
+	uint64_t read_ahead_hit;
 };
 
 static struct vy_stat *
@@ -232,6 +328,10 @@ vy_stat_new()
 		700 * MB, 750 * MB, 800 * MB, 850 * MB, 900 * MB,
 		950 * MB, 1000 * MB,
 	};
+	static int64_t read_latency_buckets[] = {
+		10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000,
+		20000, 50000, 100000, 200000, 500000, 1000000,
+	};
 
 	struct vy_stat *s = calloc(1, sizeof(*s));
 	if (s == NULL) {
@@ -244,6 +344,13 @@ vy_stat_new()
 		free(s);
 		return NULL;
 	}
+	s->read_latency = histogram_new(read_latency_buckets,
+					lengthof(read_latency_buckets));
+	if (s->read_latency == NULL) {
+		histogram_delete(s->dump_bw);
+		free(s);
+		return NULL;
+	}
 	/*
 	 * Until we dump anything, assume bandwidth to be 10 MB/s,
 	 * which should be fine for initial guess.
@@ -252,6 +359,7 @@ vy_stat_new()
 
 	s->rmean = rmean_new(vy_stat_strings, VY_STAT_LAST);
 	if (s->rmean == NULL) {
+		histogram_delete(s->read_latency);
 		histogram_delete(s->dump_bw);
 		free(s);
 		return NULL;
@@ -262,6 +370,7 @@ vy_stat_new()
 static void
 vy_stat_delete(struct vy_stat *s)
 {
+	histogram_delete(s->read_latency);
 	histogram_delete(s->dump_bw);
 	rmean_delete(s->rmean);
 	free(s);
@@ -296,6 +405,13 @@ vy_stat_cursor(struct vy_stat *s, ev_tstamp start, int ops)
 	vy_latency_update(&s->cursor_latency, diff);
 }
 
+static void
+vy_stat_read(struct vy_stat *s, ev_tstamp start)
+{
+	ev_tstamp diff = ev_now(loop()) - start;
+	histogram_collect(s->read_latency, diff * 1000000);
+}
+
 static void
 vy_stat_dump(struct vy_stat *s, ev_tstamp time, size_t written,
 	     uint64_t dumped_statements)
@@ -360,6 +476,15 @@ struct vy_run_info {
 	uint64_t size;
 	/** Pages meta. */
 	struct vy_page_info *page_infos;
+	/** Number of bloom filters, 0 if the run has none. */
+	uint32_t bloom_count;
+	/**
+	 * Bloom filters of keys stored in the run. bloom[i]
+	 * contains keys truncated to i + 1 parts, so that a lookup
+	 * by a partial key can be filtered too. The last filter
+	 * contains full keys.
+	 */
+	struct bloom *bloom;
 };
 
 struct vy_page_info {
@@ -585,6 +710,10 @@ struct vy_index {
 	uint64_t used;
 	/** Histogram of number of runs in range. */
 	struct histogram *run_hist;
+	/** Number of run lookups skipped thanks to bloom filters. */
+	uint64_t bloom_hit;
+	/** Number of run lookups bloom filters failed to skip. */
+	uint64_t bloom_miss;
 	/**
 	 * Reference counter. Used to postpone index drop
 	 * until all pending operations have completed.
@@ -946,6 +1075,8 @@ struct vy_page_read_task {
 	struct vy_run *run;
 	/** vy_env - contains environment with task mempool */
 	struct vy_env *env;
+	/** page number in the run */
+	uint32_t page_no;
 	/** [out] resulting vinyl page */
 	struct vy_page *page;
 	/** [out] result code */
@@ -1321,6 +1452,93 @@ vy_run_is_empty(struct vy_run *run)
 	return run->info.count == 0;
 }
 
+/**
+ * Return the number of leading key parts that can be filtered
+ * with bloom filters. Hashes are calculated over raw MsgPack,
+ * so only field types with a single encoding of each value are
+ * suitable: e.g. 1 and 1.0 are equal in a NUMBER field, but
+ * their hashes differ.
+ */
+static uint32_t
+vy_bloom_part_count(const struct key_def *key_def)
+{
+	uint32_t i;
+	for (i = 0; i < key_def->part_count; i++) {
+		enum field_type type = key_def->parts[i].type;
+		if (type != FIELD_TYPE_UNSIGNED &&
+		    type != FIELD_TYPE_INTEGER &&
+		    type != FIELD_TYPE_STRING)
+			break;
+	}
+	return i;
+}
+
+/**
+ * Calculate hashes of key prefixes of a statement: hashes[i]
+ * is the hash of the first i + 1 key parts. The statement may be
+ * either a key (SELECT) or a tuple.
+ *
+ * @param part_count the max number of key parts to hash
+ * @return the number of calculated hashes
+ */
+static uint32_t
+vy_stmt_bloom_hash(const struct tuple *stmt, const struct key_def *key_def,
+		   uint32_t part_count, bloom_hash_t *hashes)
+{
+	uint32_t h = HASH_SEED;
+	uint32_t carry = 0;
+	uint32_t total_size = 0;
+	if (vy_stmt_type(stmt) == IPROTO_SELECT) {
+		const char *key = tuple_data(stmt);
+		part_count = MIN(part_count, mp_decode_array(&key));
+		for (uint32_t i = 0; i < part_count; i++) {
+			total_size += tuple_hash_field(&h, &carry, &key,
+						key_def->parts[i].type);
+			hashes[i] = PMurHash32_Result(h, carry, total_size);
+		}
+		return part_count;
+	}
+	for (uint32_t i = 0; i < part_count; i++) {
+		const struct key_part *part = &key_def->parts[i];
+		const char *field = tuple_field(stmt, part->fieldno);
+		total_size += tuple_hash_field(&h, &carry, &field, part->type);
+		hashes[i] = PMurHash32_Result(h, carry, total_size);
+	}
+	return part_count;
+}
+
+static void
+vy_run_info_destroy_bloom(struct vy_run_info *run_info)
+{
+	for (uint32_t i = 0; i < run_info->bloom_count; i++)
+		bloom_destroy(&run_info->bloom[i]);
+	free(run_info->bloom);
+	run_info->bloom = NULL;
+	run_info->bloom_count = 0;
+}
+
+/**
+ * Check the run bloom filters for a key.
+ * @retval false the run definitely has no statements for the key
+ * @retval true the run may have statements for the key
+ */
+static bool
+vy_run_maybe_has(const struct vy_run *run, const struct tuple *key,
+		 const struct key_def *key_def)
+{
+	if (vy_stmt_type(key) != IPROTO_SELECT)
+		return true;
+	const char *data = tuple_data(key);
+	uint32_t part_count = mp_decode_array(&data);
+	/* There are filters only for hashable key prefixes. */
+	if (part_count == 0 || part_count > run->info.bloom_count)
+		return true;
+	bloom_hash_t hashes[part_count];
+	vy_stmt_bloom_hash(key, key_def, part_count, hashes);
+	return bloom_maybe_has(&run->info.bloom[part_count - 1],
+			       hashes[part_count - 1]);
+}
+
 static struct vy_run *
 vy_run_new(int64_t id)
 {
@@ -1349,6 +1567,7 @@ vy_run_delete(struct vy_run *run)
 			vy_page_info_destroy(run->info.page_infos + page_no);
 		free(run->info.page_infos);
 	}
+	vy_run_info_destroy_bloom(&run->info);
 	TRASH(run);
 	free(run);
 }
@@ -1966,6 +2185,116 @@ vy_row_index_encode(const uint32_t *row_index, uint32_t count,
 	return xrow->bodycnt >= 0 ? 0 : -1;
 }
 
+/**
+ * Hashes of keys written to a run. Bloom filters are sized by
+ * the number of keys, which isn't known until the whole run is
+ * written, so hashes are accumulated first and the filters are
+ * built in the end.
+ */
+struct vy_bloom_builder {
+	/** Number of key parts, i.e. number of filters. */
+	uint32_t part_count;
+	/** Hashes of key prefixes, one buffer per prefix length. */
+	struct ibuf *hashes;
+	/** Prefix hashes of the previous statement. */
+	bloom_hash_t *last;
+	/** True if no statement has been added yet. */
+	bool is_empty;
+};
+
+static struct vy_bloom_builder *
+vy_bloom_builder_new(const struct key_def *key_def)
+{
+	uint32_t part_count = vy_bloom_part_count(key_def);
+	assert(part_count > 0);
+	size_t size = sizeof(struct vy_bloom_builder) +
+		      part_count * sizeof(struct ibuf) +
+		      part_count * sizeof(bloom_hash_t);
+	struct vy_bloom_builder *builder = malloc(size);
+	if (builder == NULL) {
+		diag_set(OutOfMemory, size, "malloc",
+			 "struct vy_bloom_builder");
+		return NULL;
+	}
+	builder->part_count = part_count;
+	builder->hashes = (struct ibuf *) (builder + 1);
+	builder->last = (bloom_hash_t *) (builder->hashes + part_count);
+	builder->is_empty = true;
+	for (uint32_t i = 0; i < part_count; i++) {
+		ibuf_create(&builder->hashes[i], &cord()->slabc,
+			    sizeof(bloom_hash_t) * 4096);
+	}
+	return builder;
+}
+
+static void
+vy_bloom_builder_delete(struct vy_bloom_builder *builder)
+{
+	for (uint32_t i = 0; i < builder->part_count; i++)
+		ibuf_destroy(&builder->hashes[i]);
+	free(builder);
+}
+
+/**
+ * Remember hashes of a statement key. Statements come sorted,
+ * so equal key prefixes are adjacent and are added once.
+ */
+static int
+vy_bloom_builder_add(struct vy_bloom_builder *builder,
+		     const struct tuple *stmt, const struct key_def *key_def)
+{
+	bloom_hash_t hashes[builder->part_count];
+	uint32_t part_count = vy_stmt_bloom_hash(stmt, key_def,
+						 builder->part_count, hashes);
+	assert(part_count == builder->part_count);
+	for (uint32_t i = 0; i < part_count; i++) {
+		if (!builder->is_empty && builder->last[i] == hashes[i])
+			continue;
+		bloom_hash_t *hash = ibuf_alloc(&builder->hashes[i],
+						sizeof(*hash));
+		if (hash == NULL) {
+			diag_set(OutOfMemory, sizeof(*hash), "ibuf",
+				 "bloom hashes");
+			return -1;
+		}
+		*hash = hashes[i];
+		builder->last[i] = hashes[i];
+	}
+	builder->is_empty = false;
+	return 0;
+}
+
+/** Build bloom filters of a run from the collected hashes. */
+static int
+vy_bloom_builder_build(struct vy_bloom_builder *builder,
+		       struct vy_run_info *run_info, double fpr)
+{
+	assert(run_info->bloom == NULL);
+	uint32_t count = builder->part_count;
+	run_info->bloom = calloc(count, sizeof(struct bloom));
+	if (run_info->bloom == NULL) {
+		diag_set(OutOfMemory, count * sizeof(struct bloom),
+			 "malloc", "struct bloom");
+		return -1;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		struct ibuf *buf = &builder->hashes[i];
+		const bloom_hash_t *hash = (const bloom_hash_t *) buf->rpos;
+		const bloom_hash_t *end = (const bloom_hash_t *) buf->wpos;
+		struct bloom *bloom = &run_info->bloom[i];
+		if (bloom_create(bloom, end - hash, fpr) != 0) {
+			diag_set(OutOfMemory, 0, "bloom_create",
+				 "bloom filter");
+			vy_run_info_destroy_bloom(run_info);
+			return -1;
+		}
+		run_info->bloom_count++;
+		for (; hash < end; hash++)
+			bloom_add(bloom, *hash);
+	}
+	return 0;
+}
+
 /**
  * Write statements from the iterator to a new page in the run,
  * update page and run statistics.
@@ -1978,7 +2307,9 @@ static int
 vy_run_write_page(struct vy_run_info *run_info, struct xlog *data_xlog,
 		  struct vy_write_iterator *wi, const struct tuple *split_key,
 		  uint32_t *page_info_capacity, struct tuple **curr_stmt,
-		  const struct key_def *key_def, uint64_t *dumped_statements)
+		  const struct key_def *key_def,
+		  struct vy_bloom_builder *bloom_builder,
+		  uint64_t *dumped_statements)
 {
 	assert(curr_stmt != NULL);
 	assert(*curr_stmt != NULL);
@@ -2020,6 +2351,9 @@ vy_run_write_page(struct vy_run_info *run_info, struct xlog *data_xlog,
 		struct tuple *stmt = *curr_stmt;
 		if (vy_run_dump_stmt(stmt, data_xlog, page, key_def) != 0)
 			goto error_rollback;
+		if (bloom_builder != NULL &&
+		    vy_bloom_builder_add(bloom_builder, stmt, key_def) != 0)
+			goto error_rollback;
 		++*dumped_statements;
 
 		if (vy_write_iterator_next(wi, curr_stmt))
@@ -2113,17 +2447,35 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 	 */
 	run_info->min_lsn = INT64_MAX;
 	assert(run_info->page_infos == NULL);
+	/* Bloom filters are disabled with 100% false positive rate. */
+	double bloom_fpr = key_def->opts.bloom_fpr;
+	struct vy_bloom_builder *bloom_builder = NULL;
+	if (bloom_fpr < 1 && vy_bloom_part_count(key_def) > 0) {
+		bloom_builder = vy_bloom_builder_new(key_def);
+		if (bloom_builder == NULL)
+			goto err;
+	}
 	uint32_t page_infos_capacity = 0;
 	int rc;
 	do {
 		rc = vy_run_write_page(run_info, &data_xlog, wi,
 				       end_key, &page_infos_capacity,
-				       curr_stmt, key_def, dumped_statements);
+				       curr_stmt, key_def, bloom_builder,
+				       dumped_statements);
 		if (rc < 0)
 			goto err;
 		fiber_gc();
 	} while (rc == 0);
 
+	if (bloom_builder != NULL) {
+		rc = vy_bloom_builder_build(bloom_builder, run_info,
+					    bloom_fpr);
+		vy_bloom_builder_delete(bloom_builder);
+		bloom_builder = NULL;
+		if (rc != 0)
+			goto err;
+	}
+
 	/* Sync data and link the file to the final name. */
 	if (xlog_sync(&data_xlog) < 0 ||
 	    xlog_rename(&data_xlog) < 0)
@@ -2135,6 +2487,8 @@ vy_run_write_data(struct vy_run *run, const char *dirpath,
 
 	return 0;
 err:
+	if (bloom_builder != NULL)
+		vy_bloom_builder_delete(bloom_builder);
 	xlog_close(&data_xlog, false);
 	fiber_gc();
 	return -1;
@@ -2312,6 +2666,11 @@ enum vy_request_run_key {
 	VY_RUN_MIN_LSN = 1,
 	VY_RUN_MAX_LSN = 2,
 	VY_RUN_PAGE_COUNT = 3,
+	/**
+	 * Optional. An array of bloom filters, each is
+	 * [block count, hash count, table].
+	 */
+	VY_RUN_BLOOM = 4,
 };
 
 const char *vy_run_info_key_strs[] = {
@@ -2343,14 +2702,27 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	size_t size = mp_sizeof_array(1);
 	/*
 	 * run map size: min lsn, max lsn, page count
+	 * and optional bloom filters
 	 */
-	size += mp_sizeof_map(3);
+	uint32_t map_size = run_info->bloom_count > 0 ? 4 : 3;
+	size += mp_sizeof_map(map_size);
 	size += mp_sizeof_uint(VY_RUN_MIN_LSN) +
 		mp_sizeof_uint(run_info->min_lsn);
 	size += mp_sizeof_uint(VY_RUN_MAX_LSN) +
 		mp_sizeof_uint(run_info->max_lsn);
 	size += mp_sizeof_uint(VY_RUN_PAGE_COUNT) +
 		mp_sizeof_uint(run_info->count);
+	if (run_info->bloom_count > 0) {
+		size += mp_sizeof_uint(VY_RUN_BLOOM) +
+			mp_sizeof_array(run_info->bloom_count);
+		for (uint32_t i = 0; i < run_info->bloom_count; i++) {
+			const struct bloom *bloom = &run_info->bloom[i];
+			size += mp_sizeof_array(3) +
+				mp_sizeof_uint(bloom->block_count) +
+				mp_sizeof_uint(bloom->hash_count) +
+				mp_sizeof_bin(bloom_store_size(bloom));
+		}
+	}
 
 	char *tuple = region_alloc(&fiber()->gc, size);
 	if (tuple == NULL) {
@@ -2360,13 +2732,26 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	char *pos = tuple;
 	/* encode values */
 	pos = mp_encode_array(pos, 1);
-	pos = mp_encode_map(pos, 3);
+	pos = mp_encode_map(pos, map_size);
 	pos = mp_encode_uint(pos, VY_RUN_MIN_LSN);
 	pos = mp_encode_uint(pos, run_info->min_lsn);
 	pos = mp_encode_uint(pos, VY_RUN_MAX_LSN);
 	pos = mp_encode_uint(pos, run_info->max_lsn);
 	pos = mp_encode_uint(pos, VY_RUN_PAGE_COUNT);
 	pos = mp_encode_uint(pos, run_info->count);
+	if (run_info->bloom_count > 0) {
+		pos = mp_encode_uint(pos, VY_RUN_BLOOM);
+		pos = mp_encode_array(pos, run_info->bloom_count);
+		for (uint32_t i = 0; i < run_info->bloom_count; i++) {
+			const struct bloom *bloom = &run_info->bloom[i];
+			pos = mp_encode_array(pos, 3);
+			pos = mp_encode_uint(pos, bloom->block_count);
+			pos = mp_encode_uint(pos, bloom->hash_count);
+			pos = mp_encode_binl(pos, bloom_store_size(bloom));
+			pos = bloom_store(bloom, pos);
+		}
+	}
+	assert(pos == tuple + size);
 
 	/* put tuple in a replace request to run's space */
 	struct request request;
@@ -2382,6 +2767,47 @@ vy_run_info_encode(const struct vy_run_info *run_info,
 	return 0;
 }
 
+/** Decode bloom filters of a run, see VY_RUN_BLOOM. */
+static int
+vy_run_info_decode_bloom(struct vy_run_info *run_info, const char **pos)
+{
+	assert(run_info->bloom == NULL);
+	uint32_t count = mp_decode_array(pos);
+	if (count == 0)
+		return 0;
+	run_info->bloom = calloc(count, sizeof(struct bloom));
+	if (run_info->bloom == NULL) {
+		diag_set(OutOfMemory, count * sizeof(struct bloom),
+			 "malloc", "struct bloom");
+		return -1;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (mp_decode_array(pos) != 3)
+			goto invalid;
+		uint32_t block_count = mp_decode_uint(pos);
+		uint32_t hash_count = mp_decode_uint(pos);
+		uint32_t table_size;
+		const char *table = mp_decode_bin(pos, &table_size);
+		if (table_size != block_count * sizeof(struct bloom_block) ||
+		    hash_count == 0 || hash_count > BLOOM_HASH_COUNT_MAX)
+			goto invalid;
+		if (bloom_load(&run_info->bloom[i], block_count, hash_count,
+			       table) != 0) {
+			diag_set(OutOfMemory, table_size, "malloc",
+				 "bloom filter");
+			goto error;
+		}
+		run_info->bloom_count++;
+	}
+	return 0;
+invalid:
+	diag_set(ClientError, ER_VINYL, "Can't decode run meta: "
+		 "invalid bloom filter");
+error:
+	vy_run_info_destroy_bloom(run_info);
+	return -1;
+}
+
 /**
  * Decode the run metadata from xrow.
  *
@@ -2427,6 +2853,10 @@ vy_run_info_decode(struct vy_run_info *run_info,
 		case VY_RUN_PAGE_COUNT:
 			run_info->count = mp_decode_uint(&pos);
 			break;
+		case VY_RUN_BLOOM:
+			if (vy_run_info_decode_bloom(run_info, &pos) != 0)
+				return -1;
+			break;
 		default:
 			diag_set(ClientError, ER_VINYL,
 				 "Unknown run meta key %d", key);
@@ -4776,6 +5206,9 @@ vy_conf_new()
 			     * 1024 * 1024 * 1024;
 	conf->cache = cfg_getd("vinyl.cache")
 				 * 1024 * 1024 * 1024;
+	conf->read_ahead = cfg_geti("vinyl.read_ahead");
+	conf->page_cache = cfg_getd("vinyl.page_cache")
+			   * 1024 * 1024 * 1024;
 
 	conf->path = strdup(cfg_gets("vinyl_dir"));
 	if (conf->path == NULL) {
@@ -4882,6 +5315,23 @@ vy_info_append_memory(struct vy_env *env, struct vy_info_handler *h)
 	vy_info_table_end(h);
 }
 
+static void
+vy_info_append_page_cache(struct vy_env *env, struct vy_info_handler *h)
+{
+	char buf[16];
+	struct vy_page_cache *cache = &env->page_cache;
+	uint64_t lookups = cache->hit + cache->miss;
+	vy_info_table_begin(h, "page_cache");
+	vy_info_append_u64(h, "used", cache->used);
+	vy_info_append_u64(h, "limit", cache->limit);
+	vy_info_append_u64(h, "hit", cache->hit);
+	vy_info_append_u64(h, "miss", cache->miss);
+	snprintf(buf, sizeof(buf), "%d%%", lookups == 0 ? 0 :
+		 (int)(100 * cache->hit / lookups));
+	vy_info_append_str(h, "hit_ratio", buf);
+	vy_info_table_end(h);
+}
+
 static int
 vy_info_append_stat_rmean(const char *name, int rps, int64_t total, void *ctx)
 {
@@ -4928,6 +5378,12 @@ vy_info_append_performance(struct vy_env *env, struct vy_info_handler *h)
 	vy_info_append_u64(h, "dump_total", stat->dump_total);
 	vy_info_append_u64(h, "dumped_statements", stat->dumped_statements);
 
+	char buf[1024];
+	histogram_snprint(buf, sizeof(buf), stat->read_latency);
+	vy_info_append_str(h, "read_latency", buf);
+	vy_info_append_u64(h, "read_ahead", stat->read_ahead);
+	vy_info_append_u64(h, "read_ahead_hit", stat->read_ahead_hit);
+
 	vy_info_table_end(h);
 }
 
@@ -4953,6 +5409,8 @@ vy_info_append_indices(struct vy_env *env, struct vy_info_handler *h)
 		vy_info_append_u64(h, "memory_used", i->used);
 		vy_info_append_u64(h, "size", i->size);
 		vy_info_append_u64(h, "count", i->stmt_count);
+		vy_info_append_u64(h, "bloom_hit", i->bloom_hit);
+		vy_info_append_u64(h, "bloom_miss", i->bloom_miss);
 		vy_info_append_u32(h, "page_count", i->page_count);
 		vy_info_append_u32(h, "range_count", i->range_count);
 		vy_info_append_u32(h, "run_count", i->run_count);
@@ -4970,6 +5428,7 @@ vy_info_gather(struct vy_env *env, struct vy_info_handler *h)
 	vy_info_append_indices(env, h);
 	vy_info_append_global(env, h);
 	vy_info_append_memory(env, h);
+	vy_info_append_page_cache(env, h);
 	vy_info_append_metric(env, h);
 	vy_info_append_performance(env, h);
 }
@@ -5155,7 +5614,7 @@ vy_index_new(struct vy_env *e, struct key_def *user_key_def,
 	rlist_create(&key_list);
 	rlist_add_entry(&key_list, index->key_def, link);
 
-	index->format = tuple_format_new(&key_list, &vy_tuple_format_vtab);
+	index->format = tuple_format_new(&key_list, 0, &vy_tuple_format_vtab);
 	if (index->format == NULL)
 		goto fail_format;
 	tuple_format_ref(index->format, 1);
@@ -6607,6 +7066,8 @@ vy_env_new(void)
 	e->log = vy_log_new();
 	if (e->log == NULL)
 		goto error_log;
+	if (vy_page_cache_create(&e->page_cache, e->conf->page_cache) != 0)
+		goto error_page_cache;
 
 	struct slab_cache *slab_cache = cord_slab_cache();
 	mempool_create(&e->cursor_pool, slab_cache,
@@ -6624,6 +7085,8 @@ vy_env_new(void)
 	vy_cache_env_create(&e->cache_env, slab_cache,
 			    e->conf->cache);
 	return e;
+error_page_cache:
+	vy_log_delete(e->log);
 error_log:
 	vy_squash_queue_delete(e->squash_queue);
 error_squash_queue:
@@ -6665,6 +7128,7 @@ vy_env_delete(struct vy_env *e)
 	lsregion_destroy(&e->allocator);
 	tt_pthread_key_delete(e->zdctx_key);
 	vy_cache_env_destroy(&e->cache_env);
+	vy_page_cache_destroy(&e->page_cache);
 	TRASH(e);
 	free(e);
 }
@@ -6788,6 +7252,12 @@ struct vy_run_iterator_pos {
  * and next_lsn() switches to an older statement for the same
  * key.
  */
+
+enum {
+	/** Max number of pages read ahead by a run iterator. */
+	VY_READ_AHEAD_MAX = 16,
+};
+
 struct vy_run_iterator {
 	/** Parent class, must be the first member */
 	struct vy_stmt_iterator base;
@@ -6826,6 +7296,14 @@ struct vy_run_iterator {
 	/** LRU cache of two active pages (two pages is enough). */
 	struct vy_page *curr_page;
 	struct vy_page *prev_page;
+	/**
+	 * Pages being read ahead on sequential access, in the
+	 * iteration order, see vy_run_iterator_read_ahead().
+	 */
+	struct vy_page_read_task *read_ahead[VY_READ_AHEAD_MAX];
+	uint32_t read_ahead_count;
+	/** The number of the last page read from disk. */
+	uint32_t last_read_page_no;
 	/** Is false until first .._get or .._next_.. method is called */
 	bool search_started;
 	/** Search is finished, you will not get more values from iterator */
@@ -6856,6 +7334,14 @@ struct vy_page {
 	uint32_t *row_index;
 	/** Page data */
 	char *data;
+	/** Reference counter, see vy_page_unref() */
+	int refs;
+	/** ID of the run the page belongs to, if the page is cached */
+	int64_t run_id;
+	/** Link in vy_page_cache::lru, if the page is cached */
+	struct rlist in_lru;
+	/** True if the page is in the page cache */
+	bool is_cached;
 };
 
 static struct vy_page *
@@ -6869,6 +7355,8 @@ vy_page_new(const struct vy_page_info *page_info)
 	}
 	page->count = page_info->count;
 	page->unpacked_size = page_info->unpacked_size;
+	page->refs = 1;
+	page->is_cached = false;
 	page->row_index = calloc(page_info->count, sizeof(uint32_t));
 	if (page->row_index == NULL) {
 		diag_set(OutOfMemory, page_info->count * sizeof(uint32_t),
@@ -6903,6 +7391,124 @@ vy_page_delete(struct vy_page *page)
 	free(page);
 }
 
+static void
+vy_page_ref(struct vy_page *page)
+{
+	assert(page->refs > 0);
+	page->refs++;
+}
+
+/**
+ * Unreference a page: a page may be used by several iterators
+ * and the page cache at the same time.
+ */
+static void
+vy_page_unref(struct vy_page *page)
+{
+	assert(page->refs > 0);
+	if (--page->refs == 0)
+		vy_page_delete(page);
+}
+
+/** Memory used by a page. */
+static size_t
+vy_page_sizeof(const struct vy_page *page)
+{
+	return sizeof(*page) + page->unpacked_size +
+	       page->count * sizeof(uint32_t);
+}
+
+/** Remove a page from the page cache. */
+static void
+vy_page_cache_remove(struct vy_page_cache *cache, struct vy_page *page)
+{
+	assert(page->is_cached);
+	struct vy_page_cache_key key = { page->run_id, page->page_no };
+	mh_int_t k = mh_vy_page_cache_find(cache->hash, &key, NULL);
+	assert(k != mh_end(cache->hash));
+	mh_vy_page_cache_del(cache->hash, k, NULL);
+	rlist_del_entry(page, in_lru);
+	cache->used -= vy_page_sizeof(page);
+	page->is_cached = false;
+	vy_page_unref(page);
+}
+
+static void
+vy_page_cache_destroy(struct vy_page_cache *cache)
+{
+	struct vy_page *page, *tmp;
+	rlist_foreach_entry_safe(page, &cache->lru, in_lru, tmp)
+		vy_page_cache_remove(cache, page);
+	mh_vy_page_cache_delete(cache->hash);
+}
+
+/**
+ * Look up a page in the page cache.
+ * @retval page referenced page, the caller must unref it
+ * @retval NULL the page is not cached
+ */
+static struct vy_page *
+vy_page_cache_get(struct vy_page_cache *cache, int64_t run_id,
+		  uint32_t page_no)
+{
+	if (cache->limit == 0)
+		return NULL;
+	struct vy_page_cache_key key = { run_id, page_no };
+	mh_int_t k = mh_vy_page_cache_find(cache->hash, &key, NULL);
+	if (k == mh_end(cache->hash)) {
+		cache->miss++;
+		return NULL;
+	}
+	cache->hit++;
+	struct vy_page *page = mh_vy_page_cache_node(cache->hash, k)->page;
+	rlist_move_entry(&cache->lru, page, in_lru);
+	vy_page_ref(page);
+	return page;
+}
+
+/** Return true if the page is in the page cache. */
+static bool
+vy_page_cache_has(struct vy_page_cache *cache, int64_t run_id,
+		  uint32_t page_no)
+{
+	if (cache->limit == 0)
+		return false;
+	struct vy_page_cache_key key = { run_id, page_no };
+	return mh_vy_page_cache_find(cache->hash, &key, NULL) !=
+	       mh_end(cache->hash);
+}
+
+/**
+ * Add a page read from the disk to the page cache, evicting
+ * the least recently used pages if the cache is full.
+ * Failure to add a page is not an error.
+ */
+static void
+vy_page_cache_put(struct vy_page_cache *cache, int64_t run_id,
+		  struct vy_page *page)
+{
+	assert(!page->is_cached);
+	size_t size = vy_page_sizeof(page);
+	if (size > cache->limit)
+		return;
+	while (cache->used + size > cache->limit) {
+		assert(!rlist_empty(&cache->lru));
+		struct vy_page *victim = rlist_last_entry(&cache->lru,
+							  struct vy_page,
+							  in_lru);
+		vy_page_cache_remove(cache, victim);
+	}
+	struct vy_page_cache_node node = { run_id, page->page_no, page };
+	mh_int_t k = mh_vy_page_cache_put(cache->hash, &node, NULL, NULL);
+	if (k == mh_end(cache->hash))
+		return;
+	page->run_id = run_id;
+	page->is_cached = true;
+	vy_page_ref(page);
+	rlist_add_entry(&cache->lru, page, in_lru);
+	cache->used += size;
+}
+
 /**
  * Read raw stmt data from the page
  * \param page page
@@ -6969,27 +7575,31 @@ vy_run_iterator_cache_put(struct vy_run_iterator *itr, struct vy_page *page,
 			  uint32_t page_no)
 {
 	if (itr->prev_page != NULL)
-		vy_page_delete(itr->prev_page);
+		vy_page_unref(itr->prev_page);
 	itr->prev_page = itr->curr_page;
 	itr->curr_page = page;
 	page->page_no = page_no;
 }
 
+static void
+vy_run_iterator_read_ahead_discard(struct vy_run_iterator *itr);
+
 /**
  * Clear LRU cache
  */
 static void
 vy_run_iterator_cache_clean(struct vy_run_iterator *itr)
 {
+	vy_run_iterator_read_ahead_discard(itr);
 	if (itr->curr_stmt != NULL) {
 		tuple_unref(itr->curr_stmt);
 		itr->curr_stmt = NULL;
 		itr->curr_stmt_pos.page_no = UINT32_MAX;
 	}
 	if (itr->curr_page != NULL) {
-		vy_page_delete(itr->curr_page);
+		vy_page_unref(itr->curr_page);
 		if (itr->prev_page != NULL)
-			vy_page_delete(itr->prev_page);
+			vy_page_unref(itr->prev_page);
 		itr->curr_page = itr->prev_page = NULL;
 	}
 }
@@ -7021,14 +7631,16 @@ error:
 	return 0;
 }
 /**
- * Read a page requests from vinyl xlog data file.
+ * Read a page requests from vinyl xlog data file. With
+ * @a use_uring, the calling fiber yields while the page
+ * is read, see uring_pread().
  *
  * @retval 0 on success
  * @retval -1 on error, check diag
  */
 static int
 vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
-	     ZSTD_DStream *zdctx)
+	     ZSTD_DStream *zdctx, bool use_uring)
 {
 	/* read xlog tx from xlog file */
 	size_t region_svp = region_used(&fiber()->gc);
@@ -7037,8 +7649,9 @@ vy_page_read(struct vy_page *page, const struct vy_page_info *page_info, int fd,
 		diag_set(OutOfMemory, page_info->size, "region gc", "page");
 		return -1;
 	}
-	ssize_t readen = fio_pread(fd, data, page_info->size,
-				   page_info->offset);
+	ssize_t readen = use_uring ?
+		uring_pread(fd, data, page_info->size, page_info->offset) :
+		fio_pread(fd, data, page_info->size, page_info->offset);
 	if (readen < 0) {
 		/* TODO: report filename */
 		diag_set(SystemError, "failed to read from file");
@@ -7106,7 +7719,7 @@ vy_page_read_cb(struct coio_task *base)
 	if (zdctx == NULL)
 		return -1;
 	task->rc = vy_page_read(task->page, &task->page_info,
-				task->run->fd, zdctx);
+				task->run->fd, zdctx, false);
 	return task->rc;
 }
 
@@ -7125,6 +7738,163 @@ vy_page_read_cb_free(struct coio_task *base)
 	return 0;
 }
 
+/**
+ * Create a task reading page @a page_no of the iterator run
+ * in a coeio thread.
+ */
+static struct vy_page_read_task *
+vy_page_read_task_new(struct vy_run_iterator *itr, uint32_t page_no)
+{
+	struct vy_page_info *page_info = vy_run_page_info(itr->run, page_no);
+	struct vy_page *page = vy_page_new(page_info);
+	if (page == NULL)
+		return NULL;
+
+	/* Allocate a coio task */
+	struct vy_page_read_task *task =
+		(struct vy_page_read_task *)mempool_alloc(&itr->index->env->read_task_pool);
+	if (task == NULL) {
+		diag_set(OutOfMemory, sizeof(*task), "malloc",
+			 "vy_page_read_task");
+		vy_page_delete(page);
+		return NULL;
+	}
+	coio_task_create(&task->base, vy_page_read_cb,
+			  vy_page_read_cb_free);
+
+	/*
+	 * Make sure the run file descriptor won't be closed
+	 * (even worse, reopened) while a coeio thread is
+	 * reading it.
+	 */
+	task->run = itr->run;
+	vy_run_ref(task->run);
+	task->page_info = *page_info;
+	task->env = itr->index->env;
+	task->page_no = page_no;
+	task->page = page;
+	return task;
+}
+
+/** Iteration direction in the run: 1 - forward, -1 - backward. */
+static inline int
+vy_run_iterator_direction(struct vy_run_iterator *itr)
+{
+	return itr->iterator_type == ITER_LE ||
+	       itr->iterator_type == ITER_LT ? -1 : 1;
+}
+
+/**
+ * Discard all pages being read ahead.
+ */
+static void
+vy_run_iterator_read_ahead_discard(struct vy_run_iterator *itr)
+{
+	for (uint32_t i = 0; i < itr->read_ahead_count; i++) {
+		struct vy_page_read_task *task = itr->read_ahead[i];
+		/* An incomplete task is freed when it's finished. */
+		if (coio_task_abandon(&task->base))
+			vy_page_read_cb_free(&task->base);
+	}
+	itr->read_ahead_count = 0;
+}
+
+/**
+ * Take the read task of page @a page_no from the read-ahead
+ * queue. The pages preceding it in the queue are not going
+ * to be needed, so the whole queue is discarded if the page
+ * is not at its head.
+ *
+ * @retval task the page is being read ahead
+ * @retval NULL otherwise
+ */
+static struct vy_page_read_task *
+vy_run_iterator_read_ahead_take(struct vy_run_iterator *itr,
+				uint32_t page_no)
+{
+	if (itr->read_ahead_count == 0)
+		return NULL;
+	struct vy_page_read_task *task = itr->read_ahead[0];
+	if (task->page_no != page_no) {
+		vy_run_iterator_read_ahead_discard(itr);
+		return NULL;
+	}
+	itr->read_ahead_count--;
+	memmove(itr->read_ahead, itr->read_ahead + 1,
+		itr->read_ahead_count * sizeof(itr->read_ahead[0]));
+	itr->index->env->stat->read_ahead_hit++;
+	return task;
+}
+
+/**
+ * Start reading pages following @a page_no in the iteration
+ * order in coeio threads, so that a sequential scan doesn't
+ * wait for a disk read and decompression of each page.
+ * Keeps up to vinyl.read_ahead pages in flight.
+ */
+static void
+vy_run_iterator_read_ahead(struct vy_run_iterator *itr, uint32_t page_no)
+{
+	uint32_t depth = MIN(itr->index->env->conf->read_ahead,
+			     VY_READ_AHEAD_MAX);
+	int dir = vy_run_iterator_direction(itr);
+	if (itr->read_ahead_count > 0)
+		page_no = itr->read_ahead[itr->read_ahead_count - 1]->page_no;
+	while (itr->read_ahead_count < depth) {
+		if (dir < 0 ? page_no == 0 :
+			      page_no + 1 >= itr->run->info.count)
+			break;
+		page_no += dir;
+		/*
+		 * Stop at a cached page, reading ahead resumes
+		 * once the iterator gets there.
+		 */
+		if (vy_page_cache_has(&itr->index->env->page_cache,
+				      itr->run->id, page_no))
+			break;
+		struct vy_page_read_task *task =
+			vy_page_read_task_new(itr, page_no);
+		if (task == NULL) {
+			/* Read-ahead is optional, ignore the error. */
+			diag_clear(diag_get());
+			break;
+		}
+		coio_task_submit(&task->base);
+		itr->read_ahead[itr->read_ahead_count++] = task;
+		itr->index->env->stat->read_ahead++;
+	}
+}
+
+/**
+ * Read page @a page_no of the iterator run right from the TX
+ * thread with io_uring: the fiber yields while the kernel reads
+ * the page, and then it is decompressed in place.
+ */
+static struct vy_page *
+vy_run_iterator_read_page_uring(struct vy_run_iterator *itr,
+				uint32_t page_no)
+{
+	struct vy_run *run = itr->run;
+	struct vy_page_info *page_info = vy_run_page_info(run, page_no);
+	struct vy_page *page = vy_page_new(page_info);
+	if (page == NULL)
+		return NULL;
+	ZSTD_DStream *zdctx = vy_env_get_zdctx(itr->index->env);
+	if (zdctx == NULL) {
+		vy_page_delete(page);
+		return NULL;
+	}
+	/* Don't let the run file be closed while it's being read. */
+	vy_run_ref(run);
+	int rc = vy_page_read(page, page_info, run->fd, zdctx, true);
+	vy_run_unref(run);
+	if (rc != 0) {
+		vy_page_delete(page);
+		return NULL;
+	}
+	return page;
+}
+
 /**
  * Get a page by the given number the cache or load it from the disk.
  *
@@ -7144,13 +7914,8 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 	if (*result != NULL)
 		return 0;
 
-	/* Allocate buffers */
-	struct vy_page_info *page_info = vy_run_page_info(itr->run, page_no);
-	struct vy_page *page = vy_page_new(page_info);
-	if (page == NULL)
-		return -1;
-
 	/* Read page data from the disk */
+	struct vy_page *page;
 	int rc;
 	if (cord_is_main() && env->status == VINYL_ONLINE) {
 		/*
@@ -7162,67 +7927,98 @@ vy_run_iterator_load_page(struct vy_run_iterator *itr, uint32_t page_no,
 
 		uint32_t index_version = itr->index->version;
 		uint32_t range_version = itr->range->version;
+		struct vy_page_cache *page_cache = &itr->index->env->page_cache;
 
-		/* Allocate a coio task */
 		struct vy_page_read_task *task =
-			(struct vy_page_read_task *)mempool_alloc(&itr->index->env->read_task_pool);
-		if (task == NULL) {
-			diag_set(OutOfMemory, sizeof(*task), "malloc",
-				 "vy_page_read_task");
-			return -1;
-		}
-		coio_task_create(&task->base, vy_page_read_cb,
-				  vy_page_read_cb_free);
-
+			vy_run_iterator_read_ahead_take(itr, page_no);
 		/*
-		 * Make sure the run file descriptor won't be closed
-		 * (even worse, reopened) while a coeio thread is
-		 * reading it.
+		 * Read ahead once the iterator reads a page next to
+		 * the last one it has read.
 		 */
-		task->run = itr->run;
-		vy_run_ref(task->run);
-		task->page_info = *page_info;
-		task->env = index->env;
-		task->page = page;
-
-		/* Post task to coeio */
-		rc = coio_task_post(&task->base, TIMEOUT_INFINITY);
-		if (rc < 0)
-			return -1; /* timed out or cancelled */
+		bool is_sequential = task != NULL ||
+			(itr->last_read_page_no != UINT32_MAX &&
+			 page_no == itr->last_read_page_no +
+				    vy_run_iterator_direction(itr));
+		itr->last_read_page_no = page_no;
+		if (task == NULL) {
+			page = vy_page_cache_get(page_cache, itr->run->id,
+						 page_no);
+			if (page != NULL) {
+				if (is_sequential)
+					vy_run_iterator_read_ahead(itr,
+								   page_no);
+				vy_run_iterator_cache_put(itr, page, page_no);
+				*result = page;
+				return 0;
+			}
+		}
+		ev_tstamp read_start = ev_now(loop());
+		if (task == NULL && uring_is_enabled()) {
+			if (is_sequential)
+				vy_run_iterator_read_ahead(itr, page_no);
+			page = vy_run_iterator_read_page_uring(itr, page_no);
+			if (page == NULL)
+				return -1;
+		} else {
+			if (task == NULL) {
+				task = vy_page_read_task_new(itr, page_no);
+				if (task == NULL)
+					return -1;
+				coio_task_submit(&task->base);
+			}
+			if (is_sequential)
+				vy_run_iterator_read_ahead(itr, page_no);
+
+			/* Wait for the task */
+			rc = coio_task_wait(&task->base, TIMEOUT_INFINITY);
+			if (rc < 0)
+				return -1; /* timed out or cancelled */
+
+			if (task->rc != 0) {
+				/* posted, but failed */
+				diag_move(&task->base.diag, &fiber()->diag);
+				vy_page_read_cb_free(&task->base);
+				return -1;
+			}
 
-		if (task->rc != 0) {
-			/* posted, but failed */
-			diag_move(&task->base.diag, &fiber()->diag);
+			page = task->page;
+			task->page = NULL;
 			vy_page_read_cb_free(&task->base);
-			return -1;
 		}
-
-		task->page = NULL;
-		vy_page_read_cb_free(&task->base);
+		vy_stat_read(env->stat, read_start);
 
 		/*
 		 * Check that vy_index/vy_range/vy_run haven't changed
-		 * during coeio_pread().
+		 * while the page was being read.
 		 */
 		if (index_version != itr->index->version ||
 		    range_version != itr->range->version) {
+			vy_run_iterator_read_ahead_discard(itr);
 			itr->index = NULL;
 			itr->range = NULL;
 			itr->run = NULL;
 			vy_page_delete(page);
 			return -2; /* iterator is no more valid */
 		}
+		page->page_no = page_no;
+		vy_page_cache_put(page_cache, itr->run->id, page);
 	} else {
 		/*
 		 * Optimization: use blocked I/O for non-TX threads or
 		 * during WAL recovery (env->status != VINYL_ONLINE).
 		 */
+		struct vy_page_info *page_info =
+			vy_run_page_info(itr->run, page_no);
+		page = vy_page_new(page_info);
+		if (page == NULL)
+			return -1;
 		ZSTD_DStream *zdctx = vy_env_get_zdctx(itr->index->env);
 		if (zdctx == NULL) {
 			vy_page_delete(page);
 			return -1;
 		}
-		if (vy_page_read(page, page_info, itr->run->fd, zdctx) != 0) {
+		if (vy_page_read(page, page_info, itr->run->fd,
+				 zdctx, false) != 0) {
 			vy_page_delete(page);
 			return -1;
 		}
@@ -7527,6 +8323,18 @@ vy_run_iterator_start(struct vy_run_iterator *itr, struct tuple **ret)
 	itr->search_started = true;
 	*ret = NULL;
 
+	if (itr->iterator_type == ITER_EQ && itr->run->info.bloom_count > 0) {
+		/* Skip disk reads if the key is surely absent. */
+		if (!vy_run_maybe_has(itr->run, itr->key,
+				      itr->index->key_def)) {
+			itr->index->bloom_hit++;
+			vy_run_iterator_cache_clean(itr);
+			itr->search_ended = true;
+			return 0;
+		}
+		itr->index->bloom_miss++;
+	}
+
 	if (itr->run->info.count == 1) {
 		/* there can be a stupid bootstrap run in which it's EOF */
 		struct vy_page_info *page_info = itr->run->info.page_infos;
@@ -7633,6 +8441,8 @@ vy_run_iterator_open(struct vy_run_iterator *itr, struct vy_range *range,
 	itr->curr_stmt_pos.page_no = UINT32_MAX;
 	itr->curr_page = NULL;
 	itr->prev_page = NULL;
+	itr->read_ahead_count = 0;
+	itr->last_read_page_no = UINT32_MAX;
 
 	itr->search_started = false;
 	itr->search_ended = false;
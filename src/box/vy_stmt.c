@@ -75,11 +75,7 @@ vy_stmt_alloc(struct tuple_format *format, uint32_t size)
 			 "malloc", "struct vy_stmt");
 		return NULL;
 	}
-	tuple->refs = 1;
-	tuple->format_id = tuple_format_id(format);
-	tuple_format_ref(format, 1);
-	tuple->bsize = 0;
-	tuple->data_offset = 0;
+	tuple_create(tuple, 1, format);
 	vy_stmt_set_lsn(tuple, 0);
 	vy_stmt_set_type(tuple, 0);
 	vy_stmt_set_n_upserts(tuple, 0);
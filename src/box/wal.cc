@@ -39,11 +39,70 @@
 #include "xrow.h"
 #include "cbus.h"
 #include "coeio.h"
+#include "histogram.h"
+#include "scoped_guard.h"
+#include "small/ibuf.h"
 
 const char *wal_mode_STRS[] = { "none", "write", "fsync", NULL };
 
 int wal_dir_lock = -1;
 
+double wal_group_commit_delay = 0;
+int64_t wal_group_commit_bytes = 1024 * 1024;
+
+enum {
+	/** Size of the ring of recently written rows. */
+	WAL_RING_SIZE = 16 * 1024 * 1024,
+};
+
+/**
+ * A ring buffer of rows recently written to the WAL.
+ *
+ * Replication relays read rows from the ring rather than
+ * re-open and decode the same xlog files, each on its own, as
+ * long as they keep up with the master. A relay which lags
+ * beyond the ring falls back to reading xlogs.
+ *
+ * Positions in the ring are logical, i.e. grow monotonically,
+ * the physical offset of a position is pos % WAL_RING_SIZE.
+ * The ring is filled by the WAL thread and read by relay
+ * threads. Both only take wal_writer::watchers_mutex to update
+ * or read the ring bounds and copy the rows without it:
+ * - the writer evicts old rows and advances @a begin before it
+ *   writes over them, and advances @a end after it has written
+ *   new rows;
+ * - a reader copies rows from [begin, end), then checks that
+ *   @a begin hasn't passed its start meanwhile, otherwise the
+ *   copy may be overwritten and is dropped.
+ */
+struct wal_ring {
+	/** Ring memory, allocated once there are watchers. */
+	char *data;
+	/** Position of the oldest row in the ring. */
+	uint64_t begin;
+	/** Position following the newest row in the ring. */
+	uint64_t end;
+	/**
+	 * WAL vclock preceding the oldest row, i.e. the ring
+	 * contains all rows written after this vclock.
+	 */
+	struct vclock vclock;
+};
+
+/**
+ * Header of a row stored in the ring, followed by the encoded
+ * row body. A header with zero size pads the ring to its end.
+ */
+struct wal_ring_row {
+	/** Size of the header and the body, aligned. */
+	uint32_t size;
+	uint32_t type;
+	uint32_t server_id;
+	uint32_t body_len;
+	int64_t lsn;
+	double tm;
+};
+
 /*
  * WAL writer - maintain a Write Ahead Log for every change
  * in the data state.
@@ -64,6 +123,14 @@ struct wal_writer
 	struct stailq rollback;
 	/** A pipe from 'tx' thread to 'wal' */
 	struct cpipe wal_pipe;
+	/**
+	 * Flushes the pending batch to the WAL thread once
+	 * wal_group_commit_delay has passed since the batch
+	 * was started.
+	 */
+	struct ev_timer group_commit_timer;
+	/** Batch and commit statistics, see wal_stat. */
+	struct wal_stat stat;
 	/* ----------------- wal ------------------- */
 	/** A setting from server configuration - rows_per_wal */
 	int64_t rows_per_wal;
@@ -105,8 +172,10 @@ struct wal_writer
 	 * Used for replication relays.
 	 */
 	struct rlist watchers;
-	/** The lock protecting the watchers list. */
+	/** The lock protecting the watchers list and the ring bounds. */
 	pthread_mutex_t watchers_mutex;
+	/** Rows recently written to the WAL, for relays. */
+	struct wal_ring ring;
 };
 
 struct wal_msg: public cmsg {
@@ -117,6 +186,16 @@ struct wal_msg: public cmsg {
 	 * be rolled back.
 	 */
 	struct stailq rollback;
+	/** The number of rows in the batch. */
+	int n_rows;
+	/** Approximate size of the batch rows, in bytes. */
+	size_t size;
+	/**
+	 * True if the batch was allocated with malloc() rather
+	 * than on the region of a fiber waiting for it, i.e.
+	 * started by an asynchronous request.
+	 */
+	bool is_malloced;
 };
 
 static struct wal_writer wal_writer_singleton;
@@ -141,6 +220,9 @@ wal_msg_create(struct wal_msg *batch)
 	cmsg_init(batch, wal_request_route);
 	stailq_create(&batch->commit);
 	stailq_create(&batch->rollback);
+	batch->n_rows = 0;
+	batch->size = 0;
+	batch->is_malloced = false;
 }
 
 static struct wal_msg *
@@ -149,6 +231,25 @@ wal_msg(struct cmsg *msg)
 	return msg->route == wal_request_route ? (struct wal_msg *) msg : NULL;
 }
 
+/**
+ * Complete an asynchronous request: nobody waits for it, so
+ * report a failure to the log and free the request.
+ */
+static void
+tx_complete_async(struct wal_request *req)
+{
+	if (req->res < 0) {
+		/*
+		 * The transaction has already been committed in
+		 * memory and can not be rolled back.
+		 */
+		say_error("failed to write an asynchronously committed "
+			  "transaction to WAL, lsn %lld is lost",
+			  (long long) req->rows[req->n_rows - 1]->lsn);
+	}
+	free(req);
+}
+
 /**
  * Invoke fibers waiting for their wal_request's to be
  * completed. The fibers are invoked in strict fifo order:
@@ -163,9 +264,30 @@ tx_schedule_queue(struct stailq *queue)
 	 * fiber_wakeup() is faster than fiber_call() when there
 	 * are many ready fibers.
 	 */
+	struct wal_request *req, *next;
+	stailq_foreach_entry_safe(req, next, queue, fifo) {
+		if (req->fiber != NULL)
+			fiber_wakeup(req->fiber);
+		else
+			tx_complete_async(req);
+	}
+}
+
+/** Account a completed batch in WAL statistics. */
+static void
+tx_collect_stat(struct wal_writer *writer, struct wal_msg *batch)
+{
+	struct wal_stat *stat = &writer->stat;
+	stat->batch_count++;
+	stat->batch_rows_total += batch->n_rows;
+	stat->batch_bytes_total += batch->size;
+	histogram_collect(stat->batch_rows, batch->n_rows);
+	double now = ev_now(loop());
 	struct wal_request *req;
-	stailq_foreach_entry(req, queue, fifo)
-		fiber_wakeup(req->fiber);
+	stailq_foreach_entry(req, &batch->commit, fifo) {
+		int64_t latency = (now - req->start_time) * 1e6;
+		histogram_collect(stat->commit_latency, latency);
+	}
 }
 
 /**
@@ -178,17 +300,24 @@ static void
 tx_schedule_commit(struct cmsg *msg)
 {
 	struct wal_msg *batch = (struct wal_msg *) msg;
+	struct wal_writer *writer = wal;
+	tx_collect_stat(writer, batch);
 	/*
 	 * Move the rollback list to the writer first, since
 	 * wal_msg memory disappears after the first
 	 * iteration of tx_schedule_queue loop.
 	 */
 	if (! stailq_empty(&batch->rollback)) {
-		struct wal_writer *writer = wal;
 		/* Closes the input valve. */
 		stailq_concat(&writer->rollback, &batch->rollback);
 	}
-	tx_schedule_queue(&batch->commit);
+	bool is_malloced = batch->is_malloced;
+	struct stailq commit;
+	stailq_create(&commit);
+	stailq_concat(&commit, &batch->commit);
+	if (is_malloced)
+		free(batch);
+	tx_schedule_queue(&commit);
 }
 
 static void
@@ -209,6 +338,41 @@ tx_schedule_rollback(struct cmsg *msg)
 	stailq_create(&writer->rollback);
 }
 
+static void
+wal_stat_create(struct wal_stat *stat)
+{
+	static const int64_t batch_rows_buckets[] = {
+		1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096,
+	};
+	static const int64_t commit_latency_buckets[] = {
+		10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000,
+		20000, 50000, 100000, 200000, 500000, 1000000,
+	};
+	memset(stat, 0, sizeof(*stat));
+	stat->batch_rows = histogram_new(batch_rows_buckets,
+					 lengthof(batch_rows_buckets));
+	stat->commit_latency = histogram_new(commit_latency_buckets,
+					     lengthof(commit_latency_buckets));
+	if (stat->batch_rows == NULL || stat->commit_latency == NULL)
+		panic("failed to allocate WAL statistics");
+}
+
+static void
+wal_stat_destroy(struct wal_stat *stat)
+{
+	histogram_delete(stat->batch_rows);
+	histogram_delete(stat->commit_latency);
+}
+
+static void
+wal_group_commit_timer_cb(ev_loop *loop, ev_timer *timer, int events)
+{
+	(void) loop;
+	(void) events;
+	struct wal_writer *writer = (struct wal_writer *) timer->data;
+	cpipe_flush_input(&writer->wal_pipe);
+}
+
 /**
  * Initialize WAL writer context. Even though it's a singleton,
  * encapsulate the details just in case we may use
@@ -225,7 +389,7 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 	xdir_create(&writer->wal_dir, wal_dirname, XLOG, server_uuid);
 	writer->is_active = false;
 	if (wal_mode == WAL_FSYNC)
-		writer->wal_dir.open_wflags |= O_SYNC;
+		writer->wal_dir.sync_writes = true;
 	cpipe_set_max_input(&writer->wal_pipe, IOV_MAX);
 
 	stailq_create(&writer->rollback);
@@ -237,6 +401,14 @@ wal_writer_create(struct wal_writer *writer, enum wal_mode wal_mode,
 
 	tt_pthread_mutex_init(&writer->watchers_mutex, NULL);
 	rlist_create(&writer->watchers);
+
+	memset(&writer->ring, 0, sizeof(writer->ring));
+	vclock_copy(&writer->ring.vclock, vclock);
+
+	ev_timer_init(&writer->group_commit_timer,
+		      wal_group_commit_timer_cb, 0, 0);
+	writer->group_commit_timer.data = writer;
+	wal_stat_create(&writer->stat);
 }
 
 /** Destroy a WAL writer structure. */
@@ -245,6 +417,8 @@ wal_writer_destroy(struct wal_writer *writer)
 {
 	xdir_destroy(&writer->wal_dir);
 	tt_pthread_mutex_destroy(&writer->watchers_mutex);
+	free(writer->ring.data);
+	wal_stat_destroy(&writer->stat);
 }
 
 /** WAL writer thread routine. */
@@ -305,6 +479,8 @@ wal_writer_stop()
 {
 	struct wal_writer *writer = wal;
 
+	ev_timer_stop(loop(), &writer->group_commit_timer);
+
 	/* Stop the worker thread. */
 	struct cmsg wakeup;
 	struct cmsg_hop route[1] = {
@@ -476,6 +652,300 @@ wal_writer_begin_rollback(struct wal_writer *writer)
 	cpipe_push(&writer->tx_pipe, &writer->in_rollback);
 }
 
+/** Return the ring row at a logical position. */
+static inline struct wal_ring_row *
+wal_ring_row(struct wal_ring *ring, uint64_t pos)
+{
+	uint64_t offset = pos % WAL_RING_SIZE;
+	if (offset + sizeof(struct wal_ring_row) > WAL_RING_SIZE)
+		return NULL;
+	struct wal_ring_row *row = (struct wal_ring_row *)
+		(ring->data + offset);
+	return row->size > 0 ? row : NULL;
+}
+
+/** Return the position of the row following the one at @a pos. */
+static inline uint64_t
+wal_ring_next(struct wal_ring *ring, uint64_t pos)
+{
+	struct wal_ring_row *row = wal_ring_row(ring, pos);
+	if (row == NULL) {
+		/* Padding, skip to the beginning of the ring. */
+		return pos - pos % WAL_RING_SIZE + WAL_RING_SIZE;
+	}
+	return pos + row->size;
+}
+
+/**
+ * Drop all rows from the ring. Readers lagging behind @a vclock
+ * will have to read xlogs.
+ */
+static void
+wal_ring_reset(struct wal_ring *ring, const struct vclock *vclock)
+{
+	/*
+	 * Move the ring past all reader positions so that
+	 * readers get positioned anew, by vclock.
+	 */
+	ring->end += WAL_RING_SIZE - ring->end % WAL_RING_SIZE;
+	ring->begin = ring->end;
+	vclock_copy(&ring->vclock, vclock);
+}
+
+/** Size of a row in the ring, header included. */
+static inline size_t
+wal_ring_row_size(const struct xrow_header *xrow, uint32_t *body_len)
+{
+	*body_len = 0;
+	for (int i = 0; i < xrow->bodycnt; i++)
+		*body_len += xrow->body[i].iov_len;
+	size_t size = sizeof(struct wal_ring_row) + *body_len;
+	return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+/**
+ * Return the position of a row of the given size appended at
+ * @a pos, skipping the tail of the ring if the row doesn't fit.
+ */
+static inline uint64_t
+wal_ring_place(uint64_t pos, size_t size)
+{
+	uint64_t offset = pos % WAL_RING_SIZE;
+	if (offset + size > WAL_RING_SIZE)
+		pos += WAL_RING_SIZE - offset;
+	return pos;
+}
+
+/**
+ * Make room for rows of committed requests, evicting the oldest
+ * rows. Must be called under the watchers mutex.
+ * @retval > 0 the position following the new rows
+ * @retval 0   the rows don't fit in the ring
+ */
+static uint64_t
+wal_ring_reserve(struct wal_ring *ring, struct wal_request *first,
+		 struct wal_request *last)
+{
+	uint64_t end = ring->end;
+	for (struct wal_request *req = first; req != last;
+	     req = stailq_next_entry(req, fifo)) {
+		for (int i = 0; i < req->n_rows; i++) {
+			uint32_t body_len;
+			size_t size = wal_ring_row_size(req->rows[i],
+							&body_len);
+			end = wal_ring_place(end, size) + size;
+		}
+	}
+	if (end - ring->end > WAL_RING_SIZE)
+		return 0;
+	/* Evict the oldest rows. */
+	while (ring->begin != ring->end &&
+	       end - ring->begin > WAL_RING_SIZE) {
+		struct wal_ring_row *old = wal_ring_row(ring, ring->begin);
+		if (old != NULL &&
+		    old->lsn > vclock_get(&ring->vclock, old->server_id))
+			vclock_follow(&ring->vclock, old->server_id, old->lsn);
+		ring->begin = wal_ring_next(ring, ring->begin);
+	}
+	return end;
+}
+
+/**
+ * Write a row to the ring at @a pos, which was reserved with
+ * wal_ring_reserve(), padding the tail of the ring if the row
+ * doesn't fit in it.
+ * @retval the position following the row
+ */
+static uint64_t
+wal_ring_append(struct wal_ring *ring, uint64_t pos,
+		const struct xrow_header *xrow)
+{
+	uint32_t body_len;
+	size_t size = wal_ring_row_size(xrow, &body_len);
+	uint64_t offset = pos % WAL_RING_SIZE;
+	pos = wal_ring_place(pos, size);
+	if (pos % WAL_RING_SIZE != offset &&
+	    offset + sizeof(struct wal_ring_row) <= WAL_RING_SIZE) {
+		/* Pad the tail, it's free after eviction. */
+		struct wal_ring_row *pad = (struct wal_ring_row *)
+			(ring->data + offset);
+		pad->size = 0;
+	}
+
+	struct wal_ring_row *row = (struct wal_ring_row *)
+		(ring->data + pos % WAL_RING_SIZE);
+	row->size = size;
+	row->type = xrow->type;
+	row->server_id = xrow->server_id;
+	row->body_len = body_len;
+	row->lsn = xrow->lsn;
+	row->tm = xrow->tm;
+	char *body = (char *) (row + 1);
+	for (int i = 0; i < xrow->bodycnt; i++) {
+		memcpy(body, xrow->body[i].iov_base, xrow->body[i].iov_len);
+		body += xrow->body[i].iov_len;
+	}
+	return pos + size;
+}
+
+/**
+ * Append rows of committed requests to the ring. Rows are only
+ * kept while there are watchers (relays) to read them. The
+ * watchers mutex is only held to move the ring bounds, so that
+ * relays don't stall the writer while they copy rows.
+ */
+static void
+wal_ring_write(struct wal_writer *writer, struct wal_request *first,
+	       struct wal_request *last)
+{
+	struct wal_ring *ring = &writer->ring;
+	if (first == last)
+		return;
+	tt_pthread_mutex_lock(&writer->watchers_mutex);
+	uint64_t pos = ring->end;
+	uint64_t end = 0;
+	if (rlist_empty(&writer->watchers))
+		goto reset;
+	if (ring->data == NULL) {
+		/* Allocated on the first write with watchers. */
+		ring->data = (char *) malloc(WAL_RING_SIZE);
+		if (ring->data == NULL) {
+			say_warn("failed to allocate %u bytes for "
+				 "WAL ring", (unsigned) WAL_RING_SIZE);
+			goto reset;
+		}
+	}
+	end = wal_ring_reserve(ring, first, last);
+	if (end == 0)
+		goto reset;
+	tt_pthread_mutex_unlock(&writer->watchers_mutex);
+
+	/* Readers don't look past the end, write without the lock. */
+	for (struct wal_request *req = first; req != last;
+	     req = stailq_next_entry(req, fifo)) {
+		for (int i = 0; i < req->n_rows; i++)
+			pos = wal_ring_append(ring, pos, req->rows[i]);
+	}
+	assert(pos == end);
+
+	tt_pthread_mutex_lock(&writer->watchers_mutex);
+	ring->end = end;
+	tt_pthread_mutex_unlock(&writer->watchers_mutex);
+	return;
+reset:
+	wal_ring_reset(ring, &writer->vclock);
+	tt_pthread_mutex_unlock(&writer->watchers_mutex);
+}
+
+/**
+ * Position a reader at the oldest row of the ring unless it is
+ * positioned in the ring already. Must be called under the
+ * watchers mutex.
+ * @retval false the ring lacks some rows following @a vclock
+ */
+static bool
+wal_ring_seek(struct wal_ring *ring, uint64_t *pos,
+	      const struct vclock *vclock)
+{
+	if (ring->data == NULL)
+		return false;
+	if (*pos >= ring->begin && *pos <= ring->end)
+		return true;
+	/*
+	 * Position the reader if it has seen all rows
+	 * preceding the ring.
+	 */
+	int cmp = vclock_compare(&ring->vclock, vclock);
+	if (cmp != 0 && cmp != -1)
+		return false;
+	*pos = ring->begin;
+	return true;
+}
+
+int
+wal_ring_read(struct wal_writer *writer, uint64_t *pos,
+	      const struct vclock *vclock, struct ibuf *out)
+{
+	if (writer == NULL)
+		return -1;
+	struct wal_ring *ring = &writer->ring;
+	tt_pthread_mutex_lock(&writer->watchers_mutex);
+	bool found = wal_ring_seek(ring, pos, vclock);
+	uint64_t begin = *pos;
+	uint64_t end = ring->end;
+	if (!found)
+		writer->stat.ring_misses++;
+	tt_pthread_mutex_unlock(&writer->watchers_mutex);
+	if (!found)
+		return -1;
+	if (begin == end)
+		return 0;
+
+	/* Copy the whole range, it may wrap around the ring. */
+	size_t size = end - begin;
+	char *copy = (char *) ibuf_alloc(out, size);
+	if (copy == NULL)
+		return -1;
+	size_t offset = begin % WAL_RING_SIZE;
+	size_t tail = MIN(size, WAL_RING_SIZE - offset);
+	memcpy(copy, ring->data + offset, tail);
+	memcpy(copy + tail, ring->data, size - tail);
+
+	tt_pthread_mutex_lock(&writer->watchers_mutex);
+	/* The writer advances begin before it overwrites rows. */
+	bool overwritten = ring->begin > begin;
+	if (overwritten)
+		writer->stat.ring_misses++;
+	tt_pthread_mutex_unlock(&writer->watchers_mutex);
+	if (overwritten) {
+		out->wpos = copy;
+		return -1;
+	}
+
+	/* Drop padding and rows the reader has already seen. */
+	char *wpos = copy;
+	int count = 0;
+	for (uint64_t p = begin; p != end; ) {
+		struct wal_ring_row *row = (struct wal_ring_row *)
+			(copy + (p - begin));
+		if (p % WAL_RING_SIZE + sizeof(*row) > WAL_RING_SIZE ||
+		    row->size == 0) {
+			p += WAL_RING_SIZE - p % WAL_RING_SIZE;
+			continue;
+		}
+		p += row->size;
+		if (row->lsn <= vclock_get(vclock, row->server_id))
+			continue;
+		memmove(wpos, row, row->size);
+		wpos += row->size;
+		count++;
+	}
+	out->wpos = wpos;
+	*pos = end;
+
+	tt_pthread_mutex_lock(&writer->watchers_mutex);
+	writer->stat.ring_rows += count;
+	tt_pthread_mutex_unlock(&writer->watchers_mutex);
+	return count;
+}
+
+void
+wal_ring_decode_row(const char **data, struct xrow_header *xrow)
+{
+	const struct wal_ring_row *row = (const struct wal_ring_row *) *data;
+	memset(xrow, 0, sizeof(*xrow));
+	xrow->type = row->type;
+	xrow->server_id = row->server_id;
+	xrow->lsn = row->lsn;
+	xrow->tm = row->tm;
+	if (row->body_len > 0) {
+		xrow->bodycnt = 1;
+		xrow->body[0].iov_base = (void *) (row + 1);
+		xrow->body[0].iov_len = row->body_len;
+	}
+	*data += row->size;
+}
+
 static void
 wal_notify_watchers(struct wal_writer *writer);
 
@@ -571,6 +1041,7 @@ done:
 	req = stailq_first_entry(&wal_msg->commit, struct wal_request, fifo);
 	struct wal_request *rollback_req = last_commit_req ?
 		stailq_next_entry(last_commit_req, fifo) : req;
+	struct wal_request *first_req = req;
 	/* Update status of the successfully committed requests. */
 	for (; req != rollback_req; req = stailq_next_entry(req, fifo)) {
 
@@ -583,6 +1054,8 @@ done:
 		/* Mark request as successful for tx thread */
 		req->res = vclock_sum(&writer->vclock);
 	}
+	/* Share the committed rows with relays. */
+	wal_ring_write(writer, first_req, rollback_req);
 	if (rollback_req) {
 		/* Rollback unprocessed requests */
 		stailq_splice(&wal_msg->commit, &req->fifo, &wal_msg->rollback);
@@ -614,53 +1087,122 @@ wal_writer_f(va_list ap)
 	return 0;
 }
 
-/**
- * WAL writer main entry point: queue a single request
- * to be written to disk and wait until this task is completed.
- */
-int64_t
-wal_write(struct wal_writer *writer, struct wal_request *req)
+/** Size of the request row bodies, in bytes. */
+static size_t
+wal_request_size(struct wal_request *req)
 {
-	ERROR_INJECT_RETURN(ERRINJ_WAL_IO);
-
-	if (! stailq_empty(&writer->rollback)) {
-		/*
-		 * The writer rollback queue is not empty,
-		 * roll back this transaction immediately.
-		 * This is to ensure we do not accidentally
-		 * commit a transaction which has seen changes
-		 * that will be rolled back.
-		 */
-		say_error("Aborting transaction %llu during "
-			  "cascading rollback",
-			  vclock_sum(&writer->vclock));
-		return -1;
+	size_t size = 0;
+	for (int i = 0; i < req->n_rows; i++) {
+		struct xrow_header *row = req->rows[i];
+		for (int j = 0; j < row->bodycnt; j++)
+			size += row->body[j].iov_len;
 	}
+	return size;
+}
 
-	req->fiber = fiber();
+/**
+ * Add a request to the batch at the head of the WAL pipe input
+ * or start a new one, then flush the batch to the WAL thread
+ * unless it's held for group commit: with wal_group_commit_delay
+ * set, a batch is flushed once it grows beyond
+ * wal_group_commit_bytes or the delay expires, whichever comes
+ * first, so that more transactions share a write and a sync.
+ */
+static void
+wal_submit(struct wal_writer *writer, struct wal_request *req)
+{
+	req->start_time = ev_now(loop());
 	req->res = -1;
 
 	struct wal_msg *batch;
+	bool is_delayed = wal_group_commit_delay > 0;
 	if (!stailq_empty(&writer->wal_pipe.input) &&
 	    (batch = wal_msg(stailq_first_entry(&writer->wal_pipe.input,
 						struct cmsg, fifo)))) {
 
 		stailq_add_tail_entry(&batch->commit, req, fifo);
 	} else {
-		batch = (struct wal_msg *)
-			region_alloc_xc(&fiber()->gc,
-					sizeof(struct wal_msg));
-		wal_msg_create(batch);
+		if (req->fiber != NULL) {
+			batch = (struct wal_msg *)
+				region_alloc_xc(&fiber()->gc,
+						sizeof(struct wal_msg));
+			wal_msg_create(batch);
+		} else {
+			/*
+			 * Nobody waits for an asynchronous
+			 * request, so its batch can't live on
+			 * a fiber region.
+			 */
+			batch = (struct wal_msg *) malloc(sizeof(*batch));
+			if (batch == NULL) {
+				tnt_raise(OutOfMemory, sizeof(*batch),
+					  "malloc", "struct wal_msg");
+			}
+			wal_msg_create(batch);
+			batch->is_malloced = true;
+		}
 		/*
 		 * Sic: first add a request, then push the batch,
 		 * since cpipe_push() may pass the batch to WAL
 		 * thread right away.
 		 */
 		stailq_add_tail_entry(&batch->commit, req, fifo);
-		cpipe_push(&writer->wal_pipe, batch);
+		if (is_delayed)
+			cpipe_push_input(&writer->wal_pipe, batch);
+		else
+			cpipe_push(&writer->wal_pipe, batch);
 	}
+	batch->n_rows += req->n_rows;
+	batch->size += wal_request_size(req);
 	writer->wal_pipe.n_input += req->n_rows * XROW_IOVMAX;
+	if (is_delayed && batch->size < (size_t) wal_group_commit_bytes) {
+		if (!ev_is_active(&writer->group_commit_timer)) {
+			ev_timer_set(&writer->group_commit_timer,
+				     wal_group_commit_delay, 0);
+			ev_timer_start(loop(), &writer->group_commit_timer);
+		}
+		return;
+	}
+	ev_timer_stop(loop(), &writer->group_commit_timer);
 	cpipe_flush_input(&writer->wal_pipe);
+}
+
+/**
+ * Check the rollback valve before accepting a new request.
+ */
+static int
+wal_check_rollback(struct wal_writer *writer)
+{
+	if (! stailq_empty(&writer->rollback)) {
+		/*
+		 * The writer rollback queue is not empty,
+		 * roll back this transaction immediately.
+		 * This is to ensure we do not accidentally
+		 * commit a transaction which has seen changes
+		 * that will be rolled back.
+		 */
+		say_error("Aborting transaction %llu during "
+			  "cascading rollback",
+			  vclock_sum(&writer->vclock));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * WAL writer main entry point: queue a single request
+ * to be written to disk and wait until this task is completed.
+ */
+int64_t
+wal_write(struct wal_writer *writer, struct wal_request *req)
+{
+	ERROR_INJECT_RETURN(ERRINJ_WAL_IO);
+
+	if (wal_check_rollback(writer) != 0)
+		return -1;
+
+	req->fiber = fiber();
+	wal_submit(writer, req);
 	/**
 	 * It's not safe to spuriously wakeup this fiber
 	 * since in that case it will ignore a possible
@@ -673,6 +1215,76 @@ wal_write(struct wal_writer *writer, struct wal_request *req)
 	return req->res;
 }
 
+/**
+ * Copy a request with its rows to a single malloc()-ed block,
+ * so that it outlives the fiber which created it.
+ */
+static struct wal_request *
+wal_request_dup(const struct wal_request *req)
+{
+	size_t size = sizeof(*req) + sizeof(req->rows[0]) * req->n_rows;
+	size_t bodies_size = 0;
+	for (int i = 0; i < req->n_rows; i++) {
+		const struct xrow_header *row = req->rows[i];
+		size += sizeof(*row);
+		for (int j = 0; j < row->bodycnt; j++)
+			bodies_size += row->body[j].iov_len;
+	}
+	struct wal_request *copy = (struct wal_request *)
+		malloc(size + bodies_size);
+	if (copy == NULL) {
+		tnt_raise(OutOfMemory, size + bodies_size,
+			  "malloc", "struct wal_request");
+	}
+	memcpy(copy, req, sizeof(*req));
+	struct xrow_header *rows = (struct xrow_header *)
+		((char *) copy + sizeof(*req) +
+		 sizeof(req->rows[0]) * req->n_rows);
+	char *body = (char *) (rows + req->n_rows);
+	for (int i = 0; i < req->n_rows; i++) {
+		const struct xrow_header *row = req->rows[i];
+		struct xrow_header *row_copy = &rows[i];
+		*row_copy = *row;
+		row_copy->bodycnt = 0;
+		if (row->bodycnt > 0) {
+			row_copy->bodycnt = 1;
+			row_copy->body[0].iov_base = body;
+			for (int j = 0; j < row->bodycnt; j++) {
+				memcpy(body, row->body[j].iov_base,
+				       row->body[j].iov_len);
+				body += row->body[j].iov_len;
+			}
+			row_copy->body[0].iov_len =
+				body - (char *) row_copy->body[0].iov_base;
+		}
+		copy->rows[i] = row_copy;
+	}
+	return copy;
+}
+
+int
+wal_write_async(struct wal_writer *writer, struct wal_request *req)
+{
+	ERROR_INJECT_RETURN(ERRINJ_WAL_IO);
+
+	if (wal_check_rollback(writer) != 0)
+		return -1;
+
+	struct wal_request *copy = wal_request_dup(req);
+	copy->fiber = NULL;
+	auto copy_guard = make_scoped_guard([=] { free(copy); });
+	wal_submit(writer, copy);
+	copy_guard.is_active = false;
+	writer->stat.async_count++;
+	return 0;
+}
+
+const struct wal_stat *
+wal_get_stat(void)
+{
+	return wal != NULL ? &wal->stat : NULL;
+}
+
 int
 wal_set_watcher(struct wal_writer *writer, struct wal_watcher *watcher,
 		struct ev_async *async)
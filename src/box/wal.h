@@ -37,6 +37,10 @@
 
 struct fiber;
 struct wal_writer;
+struct vclock;
+struct ibuf;
+struct xrow_header;
+struct histogram;
 
 enum wal_mode { WAL_NONE = 0, WAL_WRITE, WAL_FSYNC, WAL_MODE_MAX };
 
@@ -47,6 +51,15 @@ extern struct wal_writer *wal;
 extern struct rmean *rmean_tx_wal_bus;
 extern int wal_dir_lock;
 
+/**
+ * The longest time a transaction may wait in the tx thread for
+ * other transactions to be written to the WAL in the same batch,
+ * in seconds. 0 disables group commit.
+ */
+extern double wal_group_commit_delay;
+/** A delayed batch is written once it grows beyond this size. */
+extern int64_t wal_group_commit_bytes;
+
 #if defined(__cplusplus)
 
 struct wal_request {
@@ -56,7 +69,10 @@ struct wal_request {
 	 * committed transaction, on error is -1
 	 */
 	int64_t res;
+	/** The waiting fiber, NULL for an asynchronous request. */
 	struct fiber *fiber;
+	/** The time the request was submitted, for statistics. */
+	double start_time;
 	/* Relative position of the start of request (used for rollback) */
 	off_t start_offset;
 	/* Relative position of the end of request (used for rollback) */
@@ -68,6 +84,17 @@ struct wal_request {
 int64_t
 wal_write(struct wal_writer *writer, struct wal_request *req);
 
+/**
+ * Queue a copy of the request to be written to disk and return
+ * without waiting for the write to complete. A failure to write
+ * the request is only reported to the log.
+ *
+ * @retval  0 the request is queued
+ * @retval -1 the request is rejected, the transaction must
+ *            be rolled back
+ */
+int
+wal_write_async(struct wal_writer *writer, struct wal_request *req);
 
 void
 wal_writer_start(enum wal_mode wal_mode, const char *wal_dirname,
@@ -96,6 +123,32 @@ wal_set_watcher(struct wal_writer *, struct wal_watcher *,
 void
 wal_clear_watcher(struct wal_writer *, struct wal_watcher *);
 
+/**
+ * Copy rows recently written to the WAL which follow @a vclock
+ * from the WAL ring to @a out. Used by replication relays to
+ * avoid reading xlogs while they keep up with the writer.
+ *
+ * @param[in,out] pos the reader position in the ring,
+ *                    UINT64_MAX for a new reader
+ * @param vclock      the reader vclock, rows preceding it
+ *                    are skipped
+ * @param out         output buffer, see wal_ring_decode_row()
+ *
+ * @retval >= 0 the number of copied rows
+ * @retval -1   the ring doesn't have all rows following
+ *              @a vclock, they must be read from xlogs
+ */
+int
+wal_ring_read(struct wal_writer *writer, uint64_t *pos,
+	      const struct vclock *vclock, struct ibuf *out);
+
+/**
+ * Decode a row copied by wal_ring_read() and advance @a data.
+ * The row body points to the copied data.
+ */
+void
+wal_ring_decode_row(const char **data, struct xrow_header *row);
+
 void
 wal_atfork();
 
@@ -113,6 +166,36 @@ void
 wal_checkpoint(struct wal_writer *writer, struct vclock *vclock,
 	       bool rotate);
 
+/** WAL batch and commit statistics, see box.info.wal(). */
+struct wal_stat {
+	/** The number of batches written. */
+	int64_t batch_count;
+	/** The total number of rows in written batches. */
+	int64_t batch_rows_total;
+	/** The total size of row bodies in written batches. */
+	int64_t batch_bytes_total;
+	/** The number of asynchronous commits. */
+	int64_t async_count;
+	/** The number of rows relays have read from the WAL ring. */
+	int64_t ring_rows;
+	/**
+	 * The number of times a relay didn't find the rows it
+	 * needed in the WAL ring and had to read xlogs.
+	 */
+	int64_t ring_misses;
+	/** Distribution of the number of rows in a batch. */
+	struct histogram *batch_rows;
+	/**
+	 * Distribution of time from submitting a request to
+	 * the end of the write, in microseconds.
+	 */
+	struct histogram *commit_latency;
+};
+
+/** Return WAL statistics or NULL if there is no WAL writer. */
+const struct wal_stat *
+wal_get_stat(void);
+
 #if defined(__cplusplus)
 } /* extern "C" */
 #endif /* defined(__cplusplus) */
@@ -36,6 +36,7 @@
 #include "fiber.h"
 #include "crc32.h"
 #include "fio.h"
+#include "uring.h"
 #include "third_party/tarantool_eio.h"
 #include <msgpuck.h>
 #include "scoped_guard.h"
@@ -830,6 +831,7 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 
 	/* set sync interval from xdir settings */
 	xlog->sync_interval = dir->sync_interval;
+	xlog->sync_writes = dir->sync_writes;
 	/* free file cache if dir should be synced */
 	xlog->free_cache = dir->sync_interval != 0 ? true: false;
 	xlog->rate_limit = 0;
@@ -846,31 +848,30 @@ xdir_create_xlog(struct xdir *dir, struct xlog *xlog,
 }
 
 /**
- * Write a sequence of uncompressed xrow objects.
- *
- * @retval -1 error
- * @retval >= 0 the number of bytes written
+ * Populate the fixheader of a sequence of uncompressed xrow
+ * objects. The fixheader room is reserved at the beginning
+ * of @a obuf by the first written row.
  */
-static off_t
-xlog_tx_write_plain(struct xlog *log)
+static void
+xlog_tx_encode_plain(struct obuf *obuf)
 {
 	/**
 	 * We created an obuf savepoint at start of xlog_tx,
 	 * now populate it with data.
 	 */
-	char *fixheader = (char *)log->obuf.iov[0].iov_base;
+	char *fixheader = (char *)obuf->iov[0].iov_base;
 	*(log_magic_t *)fixheader = row_marker;
 	char *data = fixheader + sizeof(log_magic_t);
 
 	data = mp_encode_uint(data,
-			      obuf_size(&log->obuf) - XLOG_FIXHEADER_SIZE);
+			      obuf_size(obuf) - XLOG_FIXHEADER_SIZE);
 	/* Encode crc32 for previous row */
 	data = mp_encode_uint(data, 0);
 	/* Encode crc32 for current row */
 	uint32_t crc32c = 0;
 	struct iovec *iov;
 	size_t offset = XLOG_FIXHEADER_SIZE;
-	for (iov = log->obuf.iov; iov->iov_len; ++iov) {
+	for (iov = obuf->iov; iov->iov_len; ++iov) {
 		crc32c = crc32_calc(crc32c,
 				    (char *)iov->iov_base + offset,
 				    iov->iov_len - offset);
@@ -889,13 +890,26 @@ xlog_tx_write_plain(struct xlog *log)
 			data += padding - 1;
 		}
 	}
+}
+
+/**
+ * Write a sequence of uncompressed xrow objects.
+ *
+ * @retval -1 error
+ * @retval >= 0 the number of bytes written
+ */
+static off_t
+xlog_tx_write_plain(struct xlog *log)
+{
+	xlog_tx_encode_plain(&log->obuf);
 
 	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
 		diag_set(ClientError, ER_INJECTION, "xlog write injection");
 		return -1;
 	});
 
-	ssize_t written = fio_writevn(log->fd, log->obuf.iov, log->obuf.pos + 1);
+	ssize_t written = uring_writev(log->fd, log->obuf.iov,
+				       log->obuf.pos + 1, log->sync_writes);
 	if (written < 0) {
 		diag_set(SystemError, "failed to write to '%s' file",
 			 log->filename);
@@ -905,30 +919,37 @@ xlog_tx_write_plain(struct xlog *log)
 }
 
 /**
- * Write a compressed block of xrow objects.
- * @retval -1  error
- * @retval >= 0 the number of bytes written
+ * Compress a sequence of xrow objects from @a obuf, which
+ * starts with a fixheader room, to @a zbuf, prepending it with
+ * a fixheader.
+ *
+ * @retval -1 error
+ * @retval  0 success
  */
-static off_t
-xlog_tx_write_zstd(struct xlog *log)
+static int
+xlog_tx_encode_zstd(ZSTD_CCtx *zctx, struct obuf *obuf, struct obuf *zbuf)
 {
-	char *fixheader = (char *)obuf_alloc(&log->zbuf,
-					     XLOG_FIXHEADER_SIZE);
+	char *fixheader = (char *)obuf_alloc(zbuf, XLOG_FIXHEADER_SIZE);
+	if (fixheader == NULL) {
+		tnt_error(OutOfMemory, XLOG_FIXHEADER_SIZE, "runtime arena",
+			  "compression buffer");
+		return -1;
+	}
 
 	uint32_t crc32c = 0;
 	struct iovec *iov;
 	/* 3 is compression level. */
-	ZSTD_compressBegin(log->zctx, 3);
+	ZSTD_compressBegin(zctx, 3);
 	size_t offset = XLOG_FIXHEADER_SIZE;
-	for (iov = log->obuf.iov; iov->iov_len; ++iov) {
+	for (iov = obuf->iov; iov->iov_len; ++iov) {
 		/* Estimate max output buffer size. */
 		size_t zmax_size = ZSTD_compressBound(iov->iov_len - offset);
 		/* Allocate a destination buffer. */
-		void *zdst = obuf_reserve(&log->zbuf, zmax_size);
+		void *zdst = obuf_reserve(zbuf, zmax_size);
 		if (!zdst) {
 			tnt_error(OutOfMemory, zmax_size, "runtime arena",
 				  "compression buffer");
-			goto error;
+			return -1;
 		}
 		size_t (*fcompress)(ZSTD_CCtx *, void *, size_t,
 				    const void *, size_t);
@@ -936,22 +957,22 @@ xlog_tx_write_zstd(struct xlog *log)
 		 * If it's the last iov or the last
 		 * log has 0 bytes, end the stream.
 		 */
-		if (iov == log->obuf.iov + log->obuf.pos ||
+		if (iov == obuf->iov + obuf->pos ||
 		    !(iov + 1)->iov_len) {
 			fcompress = ZSTD_compressEnd;
 		} else {
 			fcompress = ZSTD_compressContinue;
 		}
-		size_t zsize = fcompress(log->zctx, zdst, zmax_size,
+		size_t zsize = fcompress(zctx, zdst, zmax_size,
 					 (char *)iov->iov_base + offset,
 					 iov->iov_len - offset);
 		if (ZSTD_isError(zsize)) {
 			diag_set(ClientError, ER_COMPRESSION,
 				 ZSTD_getErrorName(zsize));
-			goto error;
+			return -1;
 		}
 		/* Advance output buffer to the end of compressed data. */
-		obuf_alloc(&log->zbuf, zsize);
+		obuf_alloc(zbuf, zsize);
 		/* Update crc32c */
 		crc32c = crc32_calc(crc32c, (char *)zdst, zsize);
 		/* Discount fixheader size for all iovs after first. */
@@ -962,7 +983,7 @@ xlog_tx_write_zstd(struct xlog *log)
 	char *data;
 	data = fixheader + sizeof(log_magic_t);
 	data = mp_encode_uint(data,
-			      obuf_size(&log->zbuf) - XLOG_FIXHEADER_SIZE);
+			      obuf_size(zbuf) - XLOG_FIXHEADER_SIZE);
 	/* Encode crc32 for previous row */
 	data = mp_encode_uint(data, 0);
 	/* Encode crc32 for current row */
@@ -977,6 +998,19 @@ xlog_tx_write_zstd(struct xlog *log)
 			data += padding - 1;
 		}
 	}
+	return 0;
+}
+
+/**
+ * Write a compressed block of xrow objects.
+ * @retval -1  error
+ * @retval >= 0 the number of bytes written
+ */
+static off_t
+xlog_tx_write_zstd(struct xlog *log)
+{
+	if (xlog_tx_encode_zstd(log->zctx, &log->obuf, &log->zbuf) != 0)
+		goto error;
 
 	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
 		diag_set(ClientError, ER_INJECTION, "xlog write injection");
@@ -985,8 +1019,8 @@ xlog_tx_write_zstd(struct xlog *log)
 	});
 	ssize_t written;
 
-	written = fio_writevn(log->fd, log->zbuf.iov,
-			      log->zbuf.pos + 1);
+	written = uring_writev(log->fd, log->zbuf.iov,
+			       log->zbuf.pos + 1, log->sync_writes);
 	if (written < 0) {
 		diag_set(SystemError, "failed to write to '%s' file",
 			 log->filename);
@@ -1005,23 +1039,13 @@ error:
 #define SYNC_ROUND_UP(size)	(SYNC_ROUND_DOWN(size + SYNC_MASK))
 
 /**
- * Writes xlog batch to file
+ * Account a block written to an xlog file: advance the file
+ * offset, sync the file and throttle writes if necessary.
+ * On error, truncate the file to the last good position.
  */
 static ssize_t
-xlog_tx_write(struct xlog *log)
+xlog_tx_write_end(struct xlog *log, ssize_t written)
 {
-	if (obuf_size(&log->obuf) == XLOG_FIXHEADER_SIZE)
-		return 0;
-	ssize_t written;
-
-	if (obuf_size(&log->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
-		written = xlog_tx_write_zstd(log);
-	} else {
-		written = xlog_tx_write_plain(log);
-	}
-	ERROR_INJECT(ERRINJ_WAL_WRITE, written = -1;);
-
-	obuf_reset(&log->obuf);
 	/*
 	 * Simplify recovery after a temporary write failure:
 	 * truncate the file to the best known good write
@@ -1073,50 +1097,84 @@ xlog_tx_write(struct xlog *log)
 	return written;
 }
 
-/*
- * Add a row to a log and possibly flush the log.
+/**
+ * Writes xlog batch to file
+ */
+static ssize_t
+xlog_tx_write(struct xlog *log)
+{
+	if (obuf_size(&log->obuf) == XLOG_FIXHEADER_SIZE)
+		return 0;
+	ssize_t written;
+
+	if (obuf_size(&log->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
+		written = xlog_tx_write_zstd(log);
+	} else {
+		written = xlog_tx_write_plain(log);
+	}
+	ERROR_INJECT(ERRINJ_WAL_WRITE, written = -1;);
+
+	obuf_reset(&log->obuf);
+	return xlog_tx_write_end(log, written);
+}
+
+/**
+ * Encode a row to an xlog tx output buffer.
  *
  * @retval  -1 error, check diag.
  * @retval >=0 the number of bytes written to buffer.
  */
-ssize_t
-xlog_write_row(struct xlog *log, const struct xrow_header *packet)
+static ssize_t
+xlog_tx_encode_row(struct obuf *obuf, const struct xrow_header *packet)
 {
 	/*
 	 * Automatically reserve space for a fixheader when adding
 	 * the first row in * a log. The fixheader is populated
 	 * at write. @sa xlog_tx_write().
 	 */
-	if (obuf_size(&log->obuf) == 0) {
-		if (!obuf_alloc(&log->obuf, XLOG_FIXHEADER_SIZE)) {
+	if (obuf_size(obuf) == 0) {
+		if (!obuf_alloc(obuf, XLOG_FIXHEADER_SIZE)) {
 			tnt_error(OutOfMemory, XLOG_FIXHEADER_SIZE,
 				  "runtime arena", "xlog tx output buffer");
 			return -1;
 		}
 	}
 
-	size_t page_offset = obuf_size(&log->obuf);
+	size_t page_offset = obuf_size(obuf);
 	/** encode row into iovec */
 	struct iovec iov[XROW_IOVMAX];
 	int iovcnt = xrow_header_encode(packet, iov, 0);
-	struct obuf_svp svp = obuf_create_svp(&log->obuf);
+	struct obuf_svp svp = obuf_create_svp(obuf);
 	for (int i = 0; i < iovcnt; ++i) {
 		ERROR_INJECT_U64(ERRINJ_WAL_WRITE_PARTIAL,
-			obuf_size(&log->obuf) > errinj_getu64(ERRINJ_WAL_WRITE_PARTIAL),
+			obuf_size(obuf) > errinj_getu64(ERRINJ_WAL_WRITE_PARTIAL),
 			{	tnt_error(ClientError, ER_INJECTION, "xlog write injection");
-				obuf_rollback_to_svp(&log->obuf, &svp);
+				obuf_rollback_to_svp(obuf, &svp);
 				return -1;});
-		if (obuf_dup(&log->obuf, iov[i].iov_base, iov[i].iov_len) <
+		if (obuf_dup(obuf, iov[i].iov_base, iov[i].iov_len) <
 		    iov[i].iov_len) {
 			tnt_error(OutOfMemory, XLOG_FIXHEADER_SIZE,
 				  "runtime arena", "xlog tx output buffer");
-			obuf_rollback_to_svp(&log->obuf, &svp);
+			obuf_rollback_to_svp(obuf, &svp);
 			return -1;
 		}
 	}
 	assert(iovcnt <= XROW_IOVMAX);
+	return obuf_size(obuf) - page_offset;
+}
 
-	size_t row_size = obuf_size(&log->obuf) - page_offset;
+/*
+ * Add a row to a log and possibly flush the log.
+ *
+ * @retval  -1 error, check diag.
+ * @retval >=0 the number of bytes written to buffer.
+ */
+ssize_t
+xlog_write_row(struct xlog *log, const struct xrow_header *packet)
+{
+	ssize_t row_size = xlog_tx_encode_row(&log->obuf, packet);
+	if (row_size < 0)
+		return -1;
 	if (log->is_autocommit &&
 	    obuf_size(&log->obuf) >= XLOG_TX_AUTOCOMMIT_THRESHOLD &&
 	    xlog_tx_write(log) < 0)
@@ -1177,6 +1235,93 @@ xlog_flush(struct xlog *log)
 	return xlog_tx_write(log);
 }
 
+int
+xlog_block_create(struct xlog_block *block)
+{
+	memset(block, 0, sizeof(*block));
+	obuf_create(&block->obuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
+	obuf_create(&block->zbuf, &cord()->slabc, XLOG_TX_AUTOCOMMIT_THRESHOLD);
+	block->zctx = ZSTD_createCCtx();
+	if (block->zctx == NULL) {
+		obuf_destroy(&block->obuf);
+		obuf_destroy(&block->zbuf);
+		diag_set(ClientError, ER_COMPRESSION,
+			 "failed to create context");
+		return -1;
+	}
+	return 0;
+}
+
+void
+xlog_block_destroy(struct xlog_block *block)
+{
+	obuf_destroy(&block->obuf);
+	obuf_destroy(&block->zbuf);
+	ZSTD_freeCCtx(block->zctx);
+	TRASH(block);
+}
+
+void
+xlog_block_reset(struct xlog_block *block)
+{
+	obuf_reset(&block->obuf);
+	obuf_reset(&block->zbuf);
+	block->data = NULL;
+}
+
+ssize_t
+xlog_block_write_row(struct xlog_block *block,
+		     const struct xrow_header *packet)
+{
+	assert(block->data == NULL);
+	return xlog_tx_encode_row(&block->obuf, packet);
+}
+
+int
+xlog_block_finish(struct xlog_block *block)
+{
+	assert(block->data == NULL);
+	if (obuf_size(&block->obuf) == 0) {
+		block->data = &block->obuf;
+		return 0;
+	}
+	if (obuf_size(&block->obuf) >= XLOG_TX_COMPRESS_THRESHOLD) {
+		if (xlog_tx_encode_zstd(block->zctx, &block->obuf,
+					&block->zbuf) != 0) {
+			obuf_reset(&block->zbuf);
+			return -1;
+		}
+		block->data = &block->zbuf;
+	} else {
+		xlog_tx_encode_plain(&block->obuf);
+		block->data = &block->obuf;
+	}
+	return 0;
+}
+
+ssize_t
+xlog_write_block(struct xlog *log, struct xlog_block *block)
+{
+	assert(log->is_autocommit);
+	assert(block->data != NULL);
+	if (xlog_flush(log) < 0)
+		return -1;
+	if (obuf_size(block->data) == 0)
+		return 0;
+	ssize_t written = -1;
+	ERROR_INJECT(ERRINJ_WAL_WRITE_DISK, {
+		diag_set(ClientError, ER_INJECTION, "xlog write injection");
+		return xlog_tx_write_end(log, written);
+	});
+	written = uring_writev(log->fd, block->data->iov,
+			       block->data->pos + 1, log->sync_writes);
+	if (written < 0) {
+		diag_set(SystemError, "failed to write to '%s' file",
+			 log->filename);
+	}
+	return xlog_tx_write_end(log, written);
+}
+
 static int
 sync_cb(eio_req *req)
 {
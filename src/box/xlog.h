@@ -88,6 +88,12 @@ struct xdir {
 	 * speed up sync of write ahead logs, but not snapshots).
 	 */
 	bool sync_is_async;
+	/**
+	 * true if every write to a log file in this directory
+	 * must reach the disk before it returns, see
+	 * xlog::sync_writes.
+	 */
+	bool sync_writes;
 
 	/* Default filename suffix for a new file. */
 	enum log_suffix suffix;
@@ -206,6 +212,11 @@ struct xlog {
 	struct xlog_meta meta;
 	/** do sync in async mode */
 	bool sync_is_async;
+	/**
+	 * Sync every write with fdatasync(2). With io_uring,
+	 * the sync is submitted along with the write.
+	 */
+	bool sync_writes;
 	/** File handle. */
 	int fd;
 	/**
@@ -363,6 +374,81 @@ xlog_tx_rollback(struct xlog *log);
 ssize_t
 xlog_flush(struct xlog *log);
 
+/**
+ * A standalone block of xlog rows, i.e. a single xlog tx with
+ * its own fixheader and checksum, which can be encoded and
+ * compressed away from the xlog it is written to, e.g. in
+ * another thread. Memory is allocated on the slab cache of the
+ * cord which created the block, so the block must be used and
+ * destroyed in the same cord.
+ */
+struct xlog_block {
+	/** Encoded rows, prepended with a fixheader room. */
+	struct obuf obuf;
+	/** Compressed output buffer. */
+	struct obuf zbuf;
+	/** The context of zstd compression. */
+	ZSTD_CCtx *zctx;
+	/**
+	 * The finished block: either obuf or zbuf,
+	 * NULL until xlog_block_finish() is called.
+	 */
+	struct obuf *data;
+};
+
+/**
+ * Create an empty xlog block.
+ *
+ * @retval 0 success
+ * @retval -1 error
+ */
+int
+xlog_block_create(struct xlog_block *block);
+
+/**
+ * Free memory used by an xlog block.
+ */
+void
+xlog_block_destroy(struct xlog_block *block);
+
+/**
+ * Discard the contents of an xlog block, so that
+ * it can be reused.
+ */
+void
+xlog_block_reset(struct xlog_block *block);
+
+/**
+ * Append a row to an xlog block.
+ *
+ * @retval count of written bytes
+ * @retval -1 for error
+ */
+ssize_t
+xlog_block_write_row(struct xlog_block *block,
+		     const struct xrow_header *packet);
+
+/**
+ * Populate the block fixheader and checksum, compressing
+ * the block if it is big enough. No rows can be added to
+ * the block after this function is called.
+ *
+ * @retval 0 success
+ * @retval -1 error
+ */
+int
+xlog_block_finish(struct xlog_block *block);
+
+/**
+ * Flush buffered rows and write a finished block to xlog.
+ * The block is left intact and must be reset before reuse.
+ *
+ * @retval count of written bytes
+ * @retval -1 for error
+ */
+ssize_t
+xlog_write_block(struct xlog *log, struct xlog_block *block);
+
 
 /**
  * Sync a log file. The exact action is defined
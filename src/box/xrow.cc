@@ -251,6 +251,10 @@ error:
 			request->ops = value;
 			request->ops_end = data;
 			break;
+		case IPROTO_FIELDS:
+			request->fields = value;
+			request->fields_end = data;
+			break;
 		default:
 			break;
 		}
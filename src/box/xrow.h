@@ -120,6 +120,9 @@ struct request
 	/** Upsert operations. */
 	const char *ops;
 	const char *ops_end;
+	/** Numbers of fields to return from select, NULL for all. */
+	const char *fields;
+	const char *fields_end;
 	/** Base field offset for UPDATE/UPSERT, e.g. 0 for C and 1 for Lua. */
 	int index_base;
 };
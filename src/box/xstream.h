@@ -38,15 +38,20 @@ struct xrow_header;
 struct xstream;
 
 typedef void (*xstream_write_f)(struct xstream *, struct xrow_header *);
+typedef void (*xstream_write_batch_f)(struct xstream *, struct xrow_header *,
+				      int);
 
 struct xstream {
 	xstream_write_f write;
+	/** Optional, write rows one by one if not set. */
+	xstream_write_batch_f write_batch;
 };
 
 static inline void
 xstream_create(struct xstream *xstream, xstream_write_f write)
 {
 	xstream->write = write;
+	xstream->write_batch = NULL;
 }
 
 static inline void
@@ -55,4 +60,15 @@ xstream_write(struct xstream *stream, struct xrow_header *row)
 	return stream->write(stream, row);
 }
 
+/** Write @a count rows, in order. */
+static inline void
+xstream_write_batch(struct xstream *stream, struct xrow_header *rows,
+		    int count)
+{
+	if (stream->write_batch != NULL)
+		return stream->write_batch(stream, rows, count);
+	for (int i = 0; i < count; i++)
+		stream->write(stream, &rows[i]);
+}
+
 #endif /* TARANTOOL_XSTREAM_H_INCLUDED */
@@ -184,7 +184,8 @@ coio_on_finish(eio_req *req)
 	task->complete = 1;
 	/* Reset on_timeout hook - resources will be freed by coio_task user */
 	task->base.destroy = NULL;
-	fiber_wakeup(task->fiber);
+	if (task->is_waiting)
+		fiber_wakeup(task->fiber);
 	return 0;
 }
 
@@ -218,6 +219,7 @@ coio_task_create(struct coio_task *task,
 	task->task_cb = func;
 	task->timeout_cb = on_timeout;
 	task->complete = 0;
+	task->is_waiting = false;
 	diag_create(&task->diag);
 }
 
@@ -230,11 +232,28 @@ coio_task_destroy(struct coio_task *task)
 int
 coio_task_post(struct coio_task *task, double timeout)
 {
-	assert(task->base.type == EIO_CUSTOM);
 	assert(task->fiber == fiber());
+	coio_task_submit(task);
+	return coio_task_wait(task, timeout);
+}
 
+void
+coio_task_submit(struct coio_task *task)
+{
+	assert(task->base.type == EIO_CUSTOM);
 	eio_submit(&task->base);
-	fiber_yield_timeout(timeout);
+}
+
+int
+coio_task_wait(struct coio_task *task, double timeout)
+{
+	assert(task->fiber != NULL);
+	if (!task->complete) {
+		task->fiber = fiber();
+		task->is_waiting = true;
+		fiber_yield_timeout(timeout);
+		task->is_waiting = false;
+	}
 	if (!task->complete) {
 		/* timed out or cancelled. */
 		task->fiber = NULL;
@@ -247,6 +266,15 @@ coio_task_post(struct coio_task *task, double timeout)
 	return 0;
 }
 
+bool
+coio_task_abandon(struct coio_task *task)
+{
+	if (task->complete)
+		return true;
+	task->fiber = NULL;
+	return false;
+}
+
 static void
 coio_on_call(eio_req *req)
 {
@@ -272,6 +300,7 @@ coio_call(ssize_t (*func)(va_list ap), ...)
 	task->fiber = fiber();
 	task->call_cb = func;
 	task->complete = 0;
+	task->is_waiting = true;
 	diag_create(&task->diag);
 
 	bool cancellable = fiber_set_cancellable(false);
@@ -35,6 +35,7 @@
 
 #include <sys/types.h> /* ssize_t */
 #include <stdarg.h>
+#include <stdbool.h>
 
 #include "third_party/tarantool_eio.h"
 #include "diag.h"
@@ -78,6 +79,8 @@ struct coio_task {
 	};
 	/** Callback results. */
 	int complete;
+	/** True while the calling fiber sleeps waiting for the task. */
+	bool is_waiting;
 	/** Task diag **/
 	struct diag diag;
 };
@@ -116,6 +119,38 @@ coio_task_destroy(struct coio_task *task);
 int
 coio_task_post(struct coio_task *task, double timeout);
 
+/**
+ * Post coio task to EIO thread pool and return without waiting
+ * for it to complete. Use coio_task_wait() to get the result or
+ * coio_task_abandon() to discard it.
+ *
+ * @param task coio task.
+ */
+void
+coio_task_submit(struct coio_task *task);
+
+/**
+ * Wait for a task posted with coio_task_submit().
+ *
+ * @param task coio task.
+ * @param timeout timeout in seconds.
+ * @retval see coio_task_post().
+ */
+int
+coio_task_wait(struct coio_task *task, double timeout);
+
+/**
+ * Discard a task posted with coio_task_submit(). If the task is
+ * already complete, it's up to the caller to free it, otherwise
+ * it will be freed in the timeout callback once it's finished.
+ *
+ * @param task coio task.
+ * @retval true the task is complete, free it.
+ * @retval false the task is still in progress.
+ */
+bool
+coio_task_abandon(struct coio_task *task);
+
 /** \cond public */
 
 /**
@@ -159,12 +159,16 @@ evio_service_accept_cb(ev_loop * /* loop */, ev_io *watcher,
 		       int /* revents */)
 {
 	struct evio_service *service = (struct evio_service *) watcher->data;
+	int accepted = 0;
 
-	while (1) {
+	while (service->accept_batch == 0 ||
+	       accepted++ < service->accept_batch) {
 		/*
 		 * Accept all pending connections from backlog during event
 		 * loop iteration. Significally speed up acceptor with enabled
-		 * io_collect_interval.
+		 * io_collect_interval. The rest of a limited batch is
+		 * accepted on the next iteration or by another loop
+		 * attached to the same socket.
 		 */
 		int fd = -1;
 		try {
@@ -358,6 +362,26 @@ evio_service_bind(struct evio_service *service, const char *uri)
 		  evio_service_name(service));
 }
 
+void
+evio_service_attach(struct evio_service *dst, const struct evio_service *src)
+{
+	assert(! ev_is_active(&dst->ev));
+	snprintf(dst->host, sizeof(dst->host), "%s", src->host);
+	snprintf(dst->serv, sizeof(dst->serv), "%s", src->serv);
+	memcpy(&dst->addrstorage, &src->addrstorage, sizeof(src->addrstorage));
+	dst->addr_len = src->addr_len;
+	ev_io_set(&dst->ev, src->ev.fd, EV_READ);
+	ev_io_start(dst->loop, &dst->ev);
+}
+
+void
+evio_service_detach(struct evio_service *service)
+{
+	if (ev_is_active(&service->ev))
+		ev_io_stop(service->loop, &service->ev);
+	ev_io_set(&service->ev, -1, 0);
+}
+
 /** It's safe to stop a service which is not started yet. */
 void
 evio_service_stop(struct evio_service *service)
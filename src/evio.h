@@ -86,6 +86,14 @@ struct evio_service
 	void (*on_accept)(struct evio_service *, int,
 			  struct sockaddr *, socklen_t);
 	void *on_accept_param;
+	/**
+	 * The max number of connections accepted per event loop
+	 * iteration, 0 to accept the whole backlog. Services
+	 * sharing an acceptor socket set it low, so that a burst
+	 * of connections is spread among their loops rather than
+	 * taken by the one which wakes up first.
+	 */
+	int accept_batch;
 
 	/** libev io object for the acceptor socket. */
 	struct ev_io ev;
@@ -112,6 +120,24 @@ evio_service_bind(struct evio_service *service, const char *uri);
 void
 evio_service_listen(struct evio_service *service);
 
+/**
+ * Start accepting connections on the acceptor socket of another,
+ * already listening, service in the event loop of this service.
+ * The socket is shared: whichever loop wakes up first accepts
+ * the connection, see also accept_batch. The source service
+ * remains the owner of the socket and must outlive the attached
+ * one.
+ */
+void
+evio_service_attach(struct evio_service *dst, const struct evio_service *src);
+
+/**
+ * Stop event flow of a service attached with
+ * evio_service_attach(). Doesn't close the acceptor socket.
+ */
+void
+evio_service_detach(struct evio_service *service);
+
 /** If started, stop event flow and close the acceptor socket. */
 void
 evio_service_stop(struct evio_service *service);
@@ -38,9 +38,17 @@
 
 void
 bitset_create(struct bitset *bitset, void *(*realloc)(void *ptr, size_t size))
+{
+	bitset_create_layout(bitset, BITSET_LAYOUT_BITMAP, realloc);
+}
+
+void
+bitset_create_layout(struct bitset *bitset, enum bitset_layout layout,
+		     void *(*realloc)(void *ptr, size_t size))
 {
 	memset(bitset, 0, sizeof(*bitset));
 	bitset->realloc = realloc;
+	bitset->layout = layout;
 
 	/* Initialize pages tree */
 	bitset_pages_new(&bitset->pages);
@@ -63,6 +71,116 @@ bitset_destroy(struct bitset *bitset)
 	memset(&bitset->pages, 0, sizeof(bitset->pages));
 }
 
+/**
+ * Allocate an empty page: an array page in a compact bitset,
+ * raw bits otherwise.
+ */
+static struct bitset_page *
+bitset_page_new(struct bitset *bitset, size_t first_pos)
+{
+	struct bitset_page *page;
+	if (bitset->layout == BITSET_LAYOUT_COMPACT) {
+		size_t size = bitset_page_array_alloc_size(BITSET_PAGE_ARRAY_MIN);
+		page = bitset->realloc(NULL, size);
+		if (page == NULL)
+			return NULL;
+		memset(page, 0, sizeof(*page));
+		page->array_capacity = BITSET_PAGE_ARRAY_MIN;
+	} else {
+		size_t size = bitset_page_alloc_size(bitset->realloc);
+		page = bitset->realloc(NULL, size);
+		if (page == NULL)
+			return NULL;
+		bitset_page_create(page);
+	}
+	page->first_pos = first_pos;
+	return page;
+}
+
+/**
+ * Replace \a page with a copy of it storing raw bits.
+ * @retval the new page, NULL on memory error
+ */
+static struct bitset_page *
+bitset_page_to_bits(struct bitset *bitset, struct bitset_page *page)
+{
+	size_t size = bitset_page_alloc_size(bitset->realloc);
+	struct bitset_page *bits = bitset->realloc(NULL, size);
+	if (bits == NULL)
+		return NULL;
+	bitset_page_create(bits);
+	bits->first_pos = page->first_pos;
+	bits->cardinality = page->cardinality;
+	bitset_page_or_array(bits, page);
+
+	bitset_pages_remove(&bitset->pages, page);
+	bitset_pages_insert(&bitset->pages, bits);
+	bitset->realloc(page, 0);
+	return bits;
+}
+
+/**
+ * Replace \a page with a copy of it storing an array of offsets.
+ * @retval the new page, NULL on memory error
+ */
+static struct bitset_page *
+bitset_page_to_array(struct bitset *bitset, struct bitset_page *page)
+{
+	uint32_t capacity = BITSET_PAGE_ARRAY_MIN;
+	while (capacity < page->cardinality)
+		capacity *= 2;
+	size_t size = bitset_page_array_alloc_size(capacity);
+	struct bitset_page *array = bitset->realloc(NULL, size);
+	if (array == NULL)
+		return NULL;
+	memset(array, 0, sizeof(*array));
+	array->first_pos = page->first_pos;
+	array->array_capacity = capacity;
+	uint16_t *offsets = bitset_page_array(array);
+	struct bit_iterator it;
+	bit_iterator_init(&it, bitset_page_data(page),
+			  BITSET_PAGE_DATA_SIZE, true);
+	size_t offset;
+	while ((offset = bit_iterator_next(&it)) != SIZE_MAX)
+		offsets[array->cardinality++] = offset;
+	assert(array->cardinality == page->cardinality);
+
+	bitset_pages_remove(&bitset->pages, page);
+	bitset_pages_insert(&bitset->pages, array);
+	bitset_page_destroy(page);
+	bitset->realloc(page, 0);
+	return array;
+}
+
+/**
+ * Make room for one more offset in a full array page: double
+ * the array up to BITSET_PAGE_ARRAY_MAX offsets or switch the
+ * page to raw bits if the array is already that long.
+ * @retval the new page, NULL on memory error
+ */
+static struct bitset_page *
+bitset_page_array_grow(struct bitset *bitset, struct bitset_page *page)
+{
+	assert(page->cardinality == page->array_capacity);
+	if (page->array_capacity == BITSET_PAGE_ARRAY_MAX)
+		return bitset_page_to_bits(bitset, page);
+
+	uint32_t capacity = page->array_capacity * 2;
+	if (capacity > BITSET_PAGE_ARRAY_MAX)
+		capacity = BITSET_PAGE_ARRAY_MAX;
+	/* Realloc may move the page, unlink it from the tree first */
+	bitset_pages_remove(&bitset->pages, page);
+	struct bitset_page *grown = bitset->realloc(page,
+			bitset_page_array_alloc_size(capacity));
+	if (grown == NULL) {
+		bitset_pages_insert(&bitset->pages, page);
+		return NULL;
+	}
+	grown->array_capacity = capacity;
+	bitset_pages_insert(&bitset->pages, grown);
+	return grown;
+}
+
 bool
 bitset_test(struct bitset *bitset, size_t pos)
 {
@@ -76,7 +194,13 @@ bitset_test(struct bitset *bitset, size_t pos)
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	return bit_test(bitset_page_data(page), pos - page->first_pos);
+	size_t offset = pos - page->first_pos;
+	if (bitset_page_is_array(page)) {
+		uint32_t i = bitset_page_array_find(page, offset);
+		return i < page->cardinality &&
+		       bitset_page_array(page)[i] == offset;
+	}
+	return bit_test(bitset_page_data(page), offset);
 }
 
 int
@@ -89,24 +213,42 @@ bitset_set(struct bitset *bitset, size_t pos)
 	struct bitset_page *page = bitset_pages_search(&bitset->pages, &key);
 	if (page == NULL) {
 		/* Allocate a new page */
-		size_t size = bitset_page_alloc_size(bitset->realloc);
-		page = bitset->realloc(NULL, size);
+		page = bitset_page_new(bitset, key.first_pos);
 		if (page == NULL)
 			return -1;
 
-		bitset_page_create(page);
-		page->first_pos = key.first_pos;
-
 		/* Insert the page into pages tree */
 		bitset_pages_insert(&bitset->pages, page);
 	}
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	bool prev = bit_set(bitset_page_data(page), pos - page->first_pos);
-	if (prev) {
-		/* Value has not changed */
-		return 1;
+	size_t offset = pos - page->first_pos;
+	if (bitset_page_is_array(page)) {
+		uint32_t i = bitset_page_array_find(page, offset);
+		if (i < page->cardinality &&
+		    bitset_page_array(page)[i] == offset) {
+			/* Value has not changed */
+			return 1;
+		}
+		if (page->cardinality == page->array_capacity) {
+			page = bitset_page_array_grow(bitset, page);
+			if (page == NULL)
+				return -1;
+		}
+	}
+	if (bitset_page_is_array(page)) {
+		uint32_t i = bitset_page_array_find(page, offset);
+		uint16_t *offsets = bitset_page_array(page);
+		memmove(offsets + i + 1, offsets + i,
+			(page->cardinality - i) * sizeof(*offsets));
+		offsets[i] = offset;
+	} else {
+		bool prev = bit_set(bitset_page_data(page), offset);
+		if (prev) {
+			/* Value has not changed */
+			return 1;
+		}
 	}
 
 	bitset->cardinality++;
@@ -128,9 +270,19 @@ bitset_clear(struct bitset *bitset, size_t pos)
 
 	assert(page->first_pos <= pos && pos < page->first_pos +
 	       BITSET_PAGE_DATA_SIZE * CHAR_BIT);
-	bool prev = bit_clear(bitset_page_data(page), pos - page->first_pos);
-	if (!prev) {
-		return 0;
+	size_t offset = pos - page->first_pos;
+	if (bitset_page_is_array(page)) {
+		uint32_t i = bitset_page_array_find(page, offset);
+		uint16_t *offsets = bitset_page_array(page);
+		if (i == page->cardinality || offsets[i] != offset)
+			return 0;
+		memmove(offsets + i, offsets + i + 1,
+			(page->cardinality - i - 1) * sizeof(*offsets));
+	} else {
+		bool prev = bit_clear(bitset_page_data(page), offset);
+		if (!prev) {
+			return 0;
+		}
 	}
 
 	assert(bitset->cardinality > 0);
@@ -144,6 +296,11 @@ bitset_clear(struct bitset *bitset, size_t pos)
 		/* Free the page */
 		bitset_page_destroy(page);
 		bitset->realloc(page, 0);
+	} else if (bitset->layout == BITSET_LAYOUT_COMPACT &&
+		   !bitset_page_is_array(page) &&
+		   page->cardinality <= BITSET_PAGE_ARRAY_LWM) {
+		/* Keep raw bits if out of memory, that's fine */
+		bitset_page_to_array(bitset, page);
 	}
 
 	return 1;
@@ -164,6 +321,13 @@ bitset_info(struct bitset *bitset, struct bitset_info *info)
 	struct bitset_page *page = bitset_pages_first(&bitset->pages);
 	while (page != NULL) {
 		info->pages++;
+		if (bitset_page_is_array(page)) {
+			info->array_pages++;
+			info->bsize += bitset_page_array_alloc_size(
+				page->array_capacity);
+		} else {
+			info->bsize += info->page_total_size;
+		}
 		cardinality_check += page->cardinality;
 		page = bitset_pages_next(&bitset->pages, page);
 	}
@@ -186,6 +350,7 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 		info.page_data_size, info.page_total_size);
 	fprintf(stream, "    " "page_bit    = %zu\n", PAGE_BIT);
 	fprintf(stream, "    " "pages       = %zu\n", info.pages);
+	fprintf(stream, "    " "array_pages = %zu\n", info.array_pages);
 
 
 	size_t cardinality = bitset_cardinality(bitset);
@@ -204,8 +369,9 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 		fprintf(stream, "    "
 			"utilization = undefined\n");
 	}
-	size_t mem_data  = info.page_data_size * info.pages;
-	size_t mem_total = info.page_total_size * info.pages;
+	size_t mem_data  = info.page_data_size *
+			   (info.pages - info.array_pages);
+	size_t mem_total = info.bsize;
 
 	fprintf(stream, "    " "mem_data    = %zu bytes\n", mem_data);
 	fprintf(stream, "    " "mem_total   = %zu bytes "
@@ -236,7 +402,7 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 
 		fprintf(stream, "utilization = %8.4f%% (%zu/%zu)",
 			(float) page->cardinality * 1e2 / PAGE_BIT,
-			page->cardinality, PAGE_BIT);
+			(size_t) page->cardinality, PAGE_BIT);
 
 		if (verbose < 2) {
 			fprintf(stream, "\n");
@@ -246,6 +412,16 @@ bitset_dump(struct bitset *bitset, int verbose, FILE *stream)
 
 		fprintf(stream, "vals = {");
 
+		if (bitset_page_is_array(page)) {
+			const uint16_t *offsets = bitset_page_array(page);
+			for (uint32_t i = 0; i < page->cardinality; i++) {
+				fprintf(stream, "%zu, ",
+					page->first_pos + offsets[i]);
+			}
+			fprintf(stream, "}\n");
+			continue;
+		}
+
 		size_t pos = 0;
 		struct bit_iterator it;
 		bit_iterator_init(&it, bitset_page_data(page),
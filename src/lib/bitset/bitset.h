@@ -41,6 +41,12 @@
  * by \a size_t position number.  Initially all bits are set to
  * false. You can use any values in range [0,SIZE_MAX).  The
  * container grows automatically.
+ *
+ * Bits are stored in pages of a fixed size. By default a page
+ * is an array of raw bits. A compact bitset (@see bitset_layout)
+ * stores a page with few bits set as a sorted array of their
+ * offsets instead and switches it to raw bits as it fills up,
+ * which saves memory on sparse data.
  */
 
 #include "bit/bit.h"
@@ -69,13 +75,25 @@ extern "C" {
 struct bitset_page {
 	size_t first_pos;
 	rb_node(struct bitset_page) node;
-	size_t cardinality;
+	uint32_t cardinality;
+	/** Capacity of the array of offsets, 0 for raw bits. */
+	uint32_t array_capacity;
 	uint8_t data[0];
 };
 
 typedef rb_tree(struct bitset_page) bitset_pages_t;
 /** @endcond */
 
+/**
+ * Bitset page layout
+ */
+enum bitset_layout {
+	/** All pages store raw bits. */
+	BITSET_LAYOUT_BITMAP = 0,
+	/** Sparse pages store sorted arrays of bit offsets. */
+	BITSET_LAYOUT_COMPACT = 1,
+};
+
 /**
  * Bitset
  */
@@ -84,6 +102,7 @@ struct bitset {
 	bitset_pages_t pages;
 	size_t cardinality;
 	void *(*realloc)(void *ptr, size_t size);
+	enum bitset_layout layout;
 	/** @endcond */
 };
 
@@ -95,6 +114,16 @@ struct bitset {
 void
 bitset_create(struct bitset *bitset, void *(*realloc)(void *ptr, size_t size));
 
+/**
+ * @brief Construct \a bitset with the given page layout
+ * @param bitset bitset
+ * @param layout page layout
+ * @param realloc memory allocator to use
+ */
+void
+bitset_create_layout(struct bitset *bitset, enum bitset_layout layout,
+		     void *(*realloc)(void *ptr, size_t size));
+
 /**
  * @brief Destruct \a bitset
  * @param bitset bitset
@@ -151,6 +180,10 @@ bitset_cardinality(const struct bitset *bitset) {
 struct bitset_info {
 	/** Number of allocated pages */
 	size_t pages;
+	/** Number of pages storing arrays of offsets */
+	size_t array_pages;
+	/** Memory used by all pages (in bytes) */
+	size_t bsize;
 	/** Data (payload) size of one page (in bytes) */
 	size_t page_data_size;
 	/** Full size of one page (in bytes, including padding and tree data) */
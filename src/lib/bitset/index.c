@@ -44,10 +44,20 @@ bitset_index_reserve(struct bitset_index *index, size_t size);
 int
 bitset_index_create(struct bitset_index *index,
 		    void *(*realloc)(void *ptr, size_t size))
+{
+	return bitset_index_create_layout(index, BITSET_LAYOUT_BITMAP,
+					  realloc);
+}
+
+int
+bitset_index_create_layout(struct bitset_index *index,
+			   enum bitset_layout layout,
+			   void *(*realloc)(void *ptr, size_t size))
 {
 	assert(index != NULL);
 	memset(index, 0, sizeof(*index));
 	index->realloc = realloc;
+	index->layout = layout;
 	if (bitset_index_reserve(index, 1) != 0)
 		return -1;
 
@@ -116,7 +126,8 @@ bitset_index_reserve(struct bitset_index *index, size_t size)
 		if (index->bitsets[b] == NULL)
 			goto error_2;
 
-		bitset_create(index->bitsets[b], index->realloc);
+		bitset_create_layout(index->bitsets[b], index->layout,
+				     index->realloc);
 	}
 
 	index->capacity = capacity;
@@ -393,7 +404,7 @@ bitset_index_bsize(const struct bitset_index *index)
 			continue;
 		struct bitset_info info;
 		bitset_info(index->bitsets[b], &info);
-		result += info.page_total_size * info.pages;
+		result += info.bsize;
 	}
 	return result;
 }
@@ -133,6 +133,8 @@ struct bitset_index {
 	void *(*realloc)(void *ptr, size_t size);
 	/* A buffer used for rollback changes in bitset_insert */
 	char *rollback_buf;
+	/* Page layout of the bitsets */
+	enum bitset_layout layout;
 	/** @endcond **/
 };
 
@@ -147,6 +149,20 @@ int
 bitset_index_create(struct bitset_index *index,
 		    void *(*realloc)(void *ptr, size_t size));
 
+/**
+ * @brief Construct \a index with bitsets of the given page layout
+ * @param index bitset index
+ * @param layout page layout of the bitsets
+ * @param realloc memory allocator to use
+ * @retval 0 on success
+ * @retval -1 on memory error
+ * @see bitset_layout
+ */
+int
+bitset_index_create_layout(struct bitset_index *index,
+			   enum bitset_layout layout,
+			   void *(*realloc)(void *ptr, size_t size));
+
 /**
  * @brief Destruct \a index
  * @param index bitset index
@@ -44,6 +44,18 @@ bitset_page_create(struct bitset_page *page);
 extern inline void
 bitset_page_destroy(struct bitset_page *page);
 
+extern inline size_t
+bitset_page_array_alloc_size(uint32_t capacity);
+
+extern inline bool
+bitset_page_is_array(const struct bitset_page *page);
+
+extern inline uint16_t *
+bitset_page_array(struct bitset_page *page);
+
+extern inline uint32_t
+bitset_page_array_find(struct bitset_page *page, size_t offset);
+
 extern inline size_t
 bitset_page_first_pos(size_t pos);
 
@@ -53,6 +65,15 @@ bitset_page_set_zeros(struct bitset_page *page);
 extern inline void
 bitset_page_set_ones(struct bitset_page *page);
 
+extern inline void
+bitset_page_data_and(void *dst, const void *src);
+
+extern inline void
+bitset_page_data_nand(void *dst, const void *src);
+
+extern inline void
+bitset_page_data_or(void *dst, const void *src);
+
 extern inline void
 bitset_page_and(struct bitset_page *dst, struct bitset_page *src);
 
@@ -62,11 +83,48 @@ bitset_page_nand(struct bitset_page *dst, struct bitset_page *src);
 extern inline void
 bitset_page_or(struct bitset_page *dst, struct bitset_page *src);
 
+void
+bitset_page_and_array(struct bitset_page *dst, struct bitset_page *src)
+{
+	/* Only bits present in the array survive. */
+	uint64_t bits[BITSET_PAGE_DATA_SIZE / sizeof(uint64_t)];
+	memset(bits, 0, sizeof(bits));
+	const uint16_t *offsets = bitset_page_array(src);
+	for (uint32_t i = 0; i < src->cardinality; i++)
+		bit_set(bits, offsets[i]);
+	bitset_page_data_and(bitset_page_data(dst), bits);
+}
+
+void
+bitset_page_nand_array(struct bitset_page *dst, struct bitset_page *src)
+{
+	void *d = bitset_page_data(dst);
+	const uint16_t *offsets = bitset_page_array(src);
+	for (uint32_t i = 0; i < src->cardinality; i++)
+		bit_clear(d, offsets[i]);
+}
+
+void
+bitset_page_or_array(struct bitset_page *dst, struct bitset_page *src)
+{
+	void *d = bitset_page_data(dst);
+	const uint16_t *offsets = bitset_page_array(src);
+	for (uint32_t i = 0; i < src->cardinality; i++)
+		bit_set(d, offsets[i]);
+}
+
 #if defined(DEBUG)
 void
 bitset_page_dump(struct bitset_page *page, FILE *stream)
 {
 	fprintf(stream, "Page %zu:\n", page->first_pos);
+	if (bitset_page_is_array(page)) {
+		const uint16_t *offsets = bitset_page_array(page);
+		for (uint32_t i = 0; i < page->cardinality; i++)
+			fprintf(stream, "%u ", (unsigned) offsets[i]);
+		fprintf(stream, "\n--\n");
+		return;
+	}
 	char *d = bitset_page_data(page);
 	for (int i = 0; i < BITSET_PAGE_DATA_SIZE; i++) {
 		fprintf(stream, "%x ", *d);
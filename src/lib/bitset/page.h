@@ -48,6 +48,11 @@
 #include <string.h>
 #include <limits.h>
 #include <assert.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #if defined(__cplusplus)
 extern "C" {
@@ -55,22 +60,57 @@ extern "C" {
 
 enum {
 	/** How many bytes to store in one page */
-	BITSET_PAGE_DATA_SIZE = 160
+	BITSET_PAGE_DATA_SIZE = 160,
+	/**
+	 * Max number of offsets in an array page: a longer array
+	 * takes more memory than raw bits.
+	 */
+	BITSET_PAGE_ARRAY_MAX = BITSET_PAGE_DATA_SIZE / sizeof(uint16_t),
+	/** Initial number of offsets in an array page */
+	BITSET_PAGE_ARRAY_MIN = 4,
+	/**
+	 * A raw bits page of a compact bitset becomes an array
+	 * page when its cardinality drops down to this value.
+	 * Less than BITSET_PAGE_ARRAY_MAX to not switch the
+	 * layout back and forth on every set and clear.
+	 */
+	BITSET_PAGE_ARRAY_LWM = BITSET_PAGE_ARRAY_MAX / 4,
 };
 
-#if defined(ENABLE_AVX)
-typedef __m256i bitset_word_t;
-#define BITSET_PAGE_DATA_ALIGNMENT 32
-#elif defined(ENABLE_SSE2)
+/*
+ * Raw bits of pages are combined with the widest vectors the
+ * compiler targets: AVX with ENABLE_AVX, SSE2 on x86_64 or with
+ * ENABLE_SSE2 (see cmake/simd.cmake), machine words otherwise.
+ * Vectors are loaded unaligned, so page data needs no alignment.
+ */
+#if defined(__AVX__)
+/* AVX has no 256-bit integer logic, the double one is bitwise. */
+typedef __m256d bitset_word_t;
+#define bitset_word_load(p) _mm256_loadu_pd((const double *) (p))
+#define bitset_word_store(p, w) _mm256_storeu_pd((double *) (p), (w))
+#define bitset_word_and(a, b) _mm256_and_pd((a), (b))
+#define bitset_word_nand(a, b) _mm256_andnot_pd((b), (a))
+#define bitset_word_or(a, b) _mm256_or_pd((a), (b))
+#elif defined(__SSE2__)
 typedef __m128i bitset_word_t;
-#define BITSET_PAGE_DATA_ALIGNMENT 16
-#elif defined(__x86_64__)
+#define bitset_word_load(p) _mm_loadu_si128((const __m128i *) (p))
+#define bitset_word_store(p, w) _mm_storeu_si128((__m128i *) (p), (w))
+#define bitset_word_and(a, b) _mm_and_si128((a), (b))
+#define bitset_word_nand(a, b) _mm_andnot_si128((b), (a))
+#define bitset_word_or(a, b) _mm_or_si128((a), (b))
+#else
+#if defined(__x86_64__)
 typedef uint64_t bitset_word_t;
-#define BITSET_PAGE_DATA_ALIGNMENT 1
 #else
-#define BITSET_PAGE_DATA_ALIGNMENT 1
 typedef uint32_t bitset_word_t;
 #endif
+#define bitset_word_load(p) (*(const bitset_word_t *) (p))
+#define bitset_word_store(p, w) (*(bitset_word_t *) (p) = (w))
+#define bitset_word_and(a, b) ((a) & (b))
+#define bitset_word_nand(a, b) ((a) & ~(b))
+#define bitset_word_or(a, b) ((a) | (b))
+#endif
+#define BITSET_PAGE_DATA_ALIGNMENT 1
 
 #if (defined(__GLIBC__) && (__WORDSIZE == 64) && \
      ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 8))) || \
@@ -128,6 +168,47 @@ bitset_page_destroy(struct bitset_page *page)
 	/* nothing */
 }
 
+/** Size of an array page for \a capacity offsets */
+inline size_t
+bitset_page_array_alloc_size(uint32_t capacity)
+{
+	return sizeof(struct bitset_page) + capacity * sizeof(uint16_t);
+}
+
+inline bool
+bitset_page_is_array(const struct bitset_page *page)
+{
+	return page->array_capacity > 0;
+}
+
+/** Sorted offsets of bits set in an array page */
+inline uint16_t *
+bitset_page_array(struct bitset_page *page)
+{
+	assert(bitset_page_is_array(page));
+	return (uint16_t *) page->data;
+}
+
+/**
+ * Find the first offset not less than \a offset in an array
+ * page.
+ * @return index of the offset in the array
+ */
+inline uint32_t
+bitset_page_array_find(struct bitset_page *page, size_t offset)
+{
+	const uint16_t *offsets = bitset_page_array(page);
+	uint32_t begin = 0, end = page->cardinality;
+	while (begin < end) {
+		uint32_t mid = begin + (end - begin) / 2;
+		if (offsets[mid] < offset)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+	return begin;
+}
+
 inline size_t
 bitset_page_first_pos(size_t pos) {
 	return pos - (pos % (BITSET_PAGE_DATA_SIZE * CHAR_BIT));
@@ -147,43 +228,93 @@ bitset_page_set_ones(struct bitset_page *page)
 	memset(data, -1, BITSET_PAGE_DATA_SIZE);
 }
 
+/** \a dst &= \a src for BITSET_PAGE_DATA_SIZE bytes of raw bits */
 inline void
-bitset_page_and(struct bitset_page *dst, struct bitset_page *src)
+bitset_page_data_and(void *dst, const void *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
-
+	char *d = (char *) dst;
+	const char *s = (const char *) src;
 	assert(BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
-	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
-	for (int i = 0; i < cnt; i++) {
-		*d++ &= *s++;
+	for (size_t i = 0; i < BITSET_PAGE_DATA_SIZE;
+	     i += sizeof(bitset_word_t)) {
+		bitset_word_t w = bitset_word_and(bitset_word_load(d + i),
+						  bitset_word_load(s + i));
+		bitset_word_store(d + i, w);
 	}
 }
 
+/** \a dst &= ~\a src for BITSET_PAGE_DATA_SIZE bytes of raw bits */
 inline void
-bitset_page_nand(struct bitset_page *dst, struct bitset_page *src)
+bitset_page_data_nand(void *dst, const void *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
+	char *d = (char *) dst;
+	const char *s = (const char *) src;
+	assert(BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
+	for (size_t i = 0; i < BITSET_PAGE_DATA_SIZE;
+	     i += sizeof(bitset_word_t)) {
+		bitset_word_t w = bitset_word_nand(bitset_word_load(d + i),
+						   bitset_word_load(s + i));
+		bitset_word_store(d + i, w);
+	}
+}
 
+/** \a dst |= \a src for BITSET_PAGE_DATA_SIZE bytes of raw bits */
+inline void
+bitset_page_data_or(void *dst, const void *src)
+{
+	char *d = (char *) dst;
+	const char *s = (const char *) src;
 	assert(BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
-	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
-	for (int i = 0; i < cnt; i++) {
-		*d++ &= ~*s++;
+	for (size_t i = 0; i < BITSET_PAGE_DATA_SIZE;
+	     i += sizeof(bitset_word_t)) {
+		bitset_word_t w = bitset_word_or(bitset_word_load(d + i),
+						 bitset_word_load(s + i));
+		bitset_word_store(d + i, w);
 	}
 }
 
+void
+bitset_page_and_array(struct bitset_page *dst, struct bitset_page *src);
+
+void
+bitset_page_nand_array(struct bitset_page *dst, struct bitset_page *src);
+
+void
+bitset_page_or_array(struct bitset_page *dst, struct bitset_page *src);
+
+/* The page operations below take a raw bits page as \a dst. */
+
 inline void
-bitset_page_or(struct bitset_page *dst, struct bitset_page *src)
+bitset_page_and(struct bitset_page *dst, struct bitset_page *src)
 {
-	bitset_word_t *d = (bitset_word_t *) bitset_page_data(dst);
-	bitset_word_t *s = (bitset_word_t *) bitset_page_data(src);
+	assert(!bitset_page_is_array(dst));
+	if (bitset_page_is_array(src)) {
+		bitset_page_and_array(dst, src);
+		return;
+	}
+	bitset_page_data_and(bitset_page_data(dst), bitset_page_data(src));
+}
 
-	assert(BITSET_PAGE_DATA_SIZE % sizeof(bitset_word_t) == 0);
-	int cnt = BITSET_PAGE_DATA_SIZE / sizeof(bitset_word_t);
-	for (int i = 0; i < cnt; i++) {
-		*d++ |= *s++;
+inline void
+bitset_page_nand(struct bitset_page *dst, struct bitset_page *src)
+{
+	assert(!bitset_page_is_array(dst));
+	if (bitset_page_is_array(src)) {
+		bitset_page_nand_array(dst, src);
+		return;
+	}
+	bitset_page_data_nand(bitset_page_data(dst), bitset_page_data(src));
+}
+
+inline void
+bitset_page_or(struct bitset_page *dst, struct bitset_page *src)
+{
+	assert(!bitset_page_is_array(dst));
+	if (bitset_page_is_array(src)) {
+		bitset_page_or_array(dst, src);
+		return;
 	}
+	bitset_page_data_or(bitset_page_data(dst), bitset_page_data(src));
 }
 
 #if defined(DEBUG)
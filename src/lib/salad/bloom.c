@@ -0,0 +1,97 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "bloom.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+int
+bloom_create(struct bloom *bloom, uint32_t number_of_values,
+	     double false_positive_rate)
+{
+	if (number_of_values == 0)
+		number_of_values = 1;
+	/*
+	 * The optimal number of bits and hash functions of a
+	 * classic filter. Blocking increases the false positive
+	 * rate, the more hash functions the more so, compensate
+	 * it with some extra space.
+	 */
+	double bits = -log(false_positive_rate) * number_of_values /
+		      (M_LN2 * M_LN2) * (1 - log10(false_positive_rate) / 10);
+	double block_count = ceil(bits / BLOOM_BLOCK_BITS);
+	if (block_count > UINT32_MAX)
+		block_count = UINT32_MAX;
+	double hash_count = round(-log(false_positive_rate) / M_LN2);
+	if (hash_count < 1)
+		hash_count = 1;
+	if (hash_count > BLOOM_HASH_COUNT_MAX)
+		hash_count = BLOOM_HASH_COUNT_MAX;
+
+	bloom->block_count = block_count;
+	bloom->hash_count = hash_count;
+	bloom->table = (struct bloom_block *)
+		calloc(bloom->block_count, sizeof(struct bloom_block));
+	if (bloom->table == NULL)
+		return -1;
+	return 0;
+}
+
+int
+bloom_load(struct bloom *bloom, uint32_t block_count, uint32_t hash_count,
+	   const char *table)
+{
+	bloom->block_count = block_count;
+	bloom->hash_count = hash_count;
+	bloom->table = (struct bloom_block *)
+		malloc(bloom_store_size(bloom));
+	if (bloom->table == NULL)
+		return -1;
+	memcpy(bloom->table, table, bloom_store_size(bloom));
+	return 0;
+}
+
+void
+bloom_destroy(struct bloom *bloom)
+{
+	free(bloom->table);
+	bloom->table = NULL;
+}
+
+char *
+bloom_store(const struct bloom *bloom, char *table)
+{
+	size_t size = bloom_store_size(bloom);
+	memcpy(table, bloom->table, size);
+	return table + size;
+}
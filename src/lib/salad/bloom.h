@@ -0,0 +1,183 @@
+#ifndef TARANTOOL_LIB_SALAD_BLOOM_H_INCLUDED
+#define TARANTOOL_LIB_SALAD_BLOOM_H_INCLUDED
+
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/**
+ * Classic bloom filter with several improvements:
+ *
+ * 1) The filter is split into blocks of a cache line size and
+ *    all bits of a value are set in one block, so a lookup
+ *    costs at most one cache miss regardless of the number of
+ *    hash functions (blocked bloom filter).
+ * 2) Only one 32-bit hash of a value is needed, the rest of
+ *    hash functions are derived from it.
+ *
+ * The filter is a probabilistic set: bloom_maybe_has() may
+ * return true for a value which was never added (a false
+ * positive), but never returns false for an added value.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/** Type of a hash value stored in the filter. */
+typedef uint32_t bloom_hash_t;
+
+enum {
+	/** Size of a filter block, in bits. */
+	BLOOM_BLOCK_BITS = 512,
+	/** Max number of hash functions. */
+	BLOOM_HASH_COUNT_MAX = 16,
+};
+
+/** A block of the filter, fits into one cache line. */
+struct bloom_block {
+	uint64_t bits[BLOOM_BLOCK_BITS / 64];
+};
+
+struct bloom {
+	/** Number of blocks in the table. */
+	uint32_t block_count;
+	/** Number of bits set for every value. */
+	uint32_t hash_count;
+	/** The filter bits. */
+	struct bloom_block *table;
+};
+
+/**
+ * Create an empty filter sized to store @a number_of_values
+ * values with the given false positive rate.
+ * @retval 0 success
+ * @retval -1 memory allocation error
+ */
+int
+bloom_create(struct bloom *bloom, uint32_t number_of_values,
+	     double false_positive_rate);
+
+/**
+ * Create a filter from a table previously saved with
+ * bloom_store(). The table is copied.
+ * @retval 0 success
+ * @retval -1 memory allocation error
+ */
+int
+bloom_load(struct bloom *bloom, uint32_t block_count, uint32_t hash_count,
+	   const char *table);
+
+/** Free the filter table. */
+void
+bloom_destroy(struct bloom *bloom);
+
+/** Size of the buffer needed by bloom_store(). */
+static inline size_t
+bloom_store_size(const struct bloom *bloom)
+{
+	return (size_t) bloom->block_count * sizeof(struct bloom_block);
+}
+
+/**
+ * Save the filter table to a buffer of bloom_store_size() bytes.
+ * @return the end of the written data
+ */
+char *
+bloom_store(const struct bloom *bloom, char *table);
+
+/**
+ * Spread a hash value over 64 bits: the high half selects a
+ * block, the low half selects bits in the block.
+ */
+static inline uint64_t
+bloom_mix(bloom_hash_t hash)
+{
+	/* fmix64 of MurmurHash3. */
+	uint64_t x = hash;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static inline struct bloom_block *
+bloom_block(const struct bloom *bloom, uint64_t mix)
+{
+	/* Multiply-shift is a cheap replacement of modulo. */
+	uint32_t block_no = ((mix >> 32) * bloom->block_count) >> 32;
+	return &bloom->table[block_no];
+}
+
+/** Add a value to the filter. */
+static inline void
+bloom_add(struct bloom *bloom, bloom_hash_t hash)
+{
+	uint64_t mix = bloom_mix(hash);
+	struct bloom_block *block = bloom_block(bloom, mix);
+	uint32_t h1 = (uint32_t) mix;
+	uint32_t h2 = (uint32_t) (mix >> 23) | 1;
+	for (uint32_t i = 0; i < bloom->hash_count; i++) {
+		uint32_t bit = (h1 + i * h2) % BLOOM_BLOCK_BITS;
+		block->bits[bit / 64] |= 1ULL << (bit % 64);
+	}
+}
+
+/**
+ * Check if a value may be in the filter.
+ * @retval false the value was definitely not added
+ * @retval true the value was possibly added
+ */
+static inline bool
+bloom_maybe_has(const struct bloom *bloom, bloom_hash_t hash)
+{
+	uint64_t mix = bloom_mix(hash);
+	const struct bloom_block *block = bloom_block(bloom, mix);
+	uint32_t h1 = (uint32_t) mix;
+	uint32_t h2 = (uint32_t) (mix >> 23) | 1;
+	for (uint32_t i = 0; i < bloom->hash_count; i++) {
+		uint32_t bit = (h1 + i * h2) % BLOOM_BLOCK_BITS;
+		if ((block->bits[bit / 64] & (1ULL << (bit % 64))) == 0)
+			return false;
+	}
+	return true;
+}
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_LIB_SALAD_BLOOM_H_INCLUDED */
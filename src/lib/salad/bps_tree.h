@@ -154,6 +154,12 @@
  * struct bps_tree_iterator bps_tree_lower_bound(tree, key, exact);
  * struct bps_tree_iterator bps_tree_upper_bound(tree, key, exact);
  * size_t bps_tree_approxiamte_count(tree, key);
+ * // offsets (only with BPS_TREE_INNER_ELEM_COUNT):
+ * struct bps_tree_iterator bps_tree_lower_bound_get_offset(tree, key, exact,
+ *                                                          offset);
+ * struct bps_tree_iterator bps_tree_upper_bound_get_offset(tree, key, exact,
+ *                                                          offset);
+ * struct bps_tree_iterator bps_tree_iterator_at(tree, offset);
  * bps_tree_elem_t *bps_tree_iterator_get_elem(tree, itr);
  * bool bps_tree_iterator_next(tree, itr);
  * bool bps_tree_iterator_prev(tree, itr);
@@ -279,6 +285,16 @@
  * #define BPS_BLOCK_LINEAR_SEARCH
  */
 
+/**
+ * A switch that makes every inner block store the number of
+ * elements in its subtree. It costs a few children per inner
+ * block and a touch of every inner block on the path on each
+ * insertion and deletion, but allows to find the offset of an
+ * element in the tree, and an element by its offset, in
+ * logarithmic time. To turn it on,
+ * #define BPS_TREE_INNER_ELEM_COUNT
+ */
+
 /**
  * A switch that enables collection of executions of different
  * branches of code. Used only for debug purposes, I hope you
@@ -357,6 +373,9 @@ typedef uint32_t bps_tree_block_id_t;
 #define bps_tree_iterator_last _api_name(iterator_last)
 #define bps_tree_lower_bound _api_name(lower_bound)
 #define bps_tree_upper_bound _api_name(upper_bound)
+#define bps_tree_lower_bound_get_offset _api_name(lower_bound_get_offset)
+#define bps_tree_upper_bound_get_offset _api_name(upper_bound_get_offset)
+#define bps_tree_iterator_at _api_name(iterator_at)
 #define bps_tree_approximate_count _api_name(approximate_count)
 #define bps_tree_iterator_get_elem _api_name(iterator_get_elem)
 #define bps_tree_iterator_next _api_name(iterator_next)
@@ -381,6 +400,10 @@ typedef uint32_t bps_tree_block_id_t;
 #define bps_tree_restore_block_ver _bps_tree(restore_block_ver)
 #define bps_tree_root _bps_tree(root)
 #define bps_tree_touch_block _bps_tree(touch_block)
+#define bps_tree_block_elem_count _bps_tree(block_elem_count)
+#define bps_tree_inner_elem_count_before _bps_tree(inner_elem_count_before)
+#define bps_tree_inner_update_elem_count _bps_tree(inner_update_elem_count)
+#define bps_tree_path_add_elem_count _bps_tree(path_add_elem_count)
 #define bps_tree_find_ins_point_key _bps_tree(find_ins_point_key)
 #define bps_tree_find_ins_point_elem _bps_tree(find_ins_point_elem)
 #define bps_tree_find_after_ins_point_key _bps_tree(find_after_ins_point_key)
@@ -733,6 +756,52 @@ bps_tree_upper_bound(const struct bps_tree *tree, bps_tree_key_t key,
 static inline size_t
 bps_tree_approximate_count(const struct bps_tree *tree, bps_tree_key_t key);
 
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+/**
+ * @brief Same as bps_tree_lower_bound, but also get the offset of
+ *  the element pointed by the iterator, i.e. the number of elements
+ *  that are less than the key. Takes O(log(N)) time.
+ * @param tree - pointer to a tree
+ * @param key - key that will be compared with elements
+ * @param exact - see bps_tree_lower_bound. Pass NULL if not needed.
+ * @param offset - pointer to a variable that receives the offset.
+ *  It is equal to the size of the tree for an invalid iterator.
+ * @return - Lower-bound iterator.
+ */
+static inline struct bps_tree_iterator
+bps_tree_lower_bound_get_offset(const struct bps_tree *tree,
+				bps_tree_key_t key, bool *exact,
+				size_t *offset);
+
+/**
+ * @brief Same as bps_tree_upper_bound, but also get the offset of
+ *  the element pointed by the iterator, i.e. the number of elements
+ *  that are less than or equal to the key. Takes O(log(N)) time.
+ * @param tree - pointer to a tree
+ * @param key - key that will be compared with elements
+ * @param exact - see bps_tree_upper_bound. Pass NULL if not needed.
+ * @param offset - pointer to a variable that receives the offset.
+ *  It is equal to the size of the tree for an invalid iterator.
+ * @return - Upper-bound iterator.
+ */
+static inline struct bps_tree_iterator
+bps_tree_upper_bound_get_offset(const struct bps_tree *tree,
+				bps_tree_key_t key, bool *exact,
+				size_t *offset);
+
+/**
+ * @brief Get an iterator to the element at the given offset, i.e.
+ *  to the element that has exactly @a offset elements before it.
+ *  Takes O(log(N)) time.
+ * @param tree - pointer to a tree
+ * @param offset - offset of the element, starting from 0
+ * @return - Iterator. Invalid if the offset is not less than the
+ *  size of the tree.
+ */
+static inline struct bps_tree_iterator
+bps_tree_iterator_at(const struct bps_tree *tree, size_t offset);
+#endif /* BPS_TREE_INNER_ELEM_COUNT */
+
 /**
  * @brief Get a pointer to the element pointed by iterator.
  *  If iterator is detected as broken, it is invalidated and NULL returned.
@@ -865,9 +934,16 @@ enum bps_tree_max_sizes {
 		(BPS_TREE_BLOCK_SIZE - sizeof(struct bps_block)
 		 - 2 * sizeof(bps_tree_block_id_t) )
 		/ sizeof(bps_tree_elem_t),
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+	/* The header is padded up to elem_count, see struct bps_inner */
+	BPS_TREE_MAX_COUNT_IN_INNER =
+		(BPS_TREE_BLOCK_SIZE - 2 * sizeof(size_t))
+		/ (sizeof(bps_tree_elem_t) + sizeof(bps_tree_block_id_t)),
+#else
 	BPS_TREE_MAX_COUNT_IN_INNER =
 		(BPS_TREE_BLOCK_SIZE - sizeof(struct bps_block))
 		/ (sizeof(bps_tree_elem_t) + sizeof(bps_tree_block_id_t)),
+#endif
 	BPS_TREE_MAX_DEPTH = 16
 };
 
@@ -877,6 +953,7 @@ enum bps_tree_max_sizes {
  */
 CT_ASSERT_G(BPS_TREE_MAX_COUNT_IN_LEAF >= 3);
 CT_ASSERT_G(BPS_TREE_MAX_COUNT_IN_INNER >= 3);
+CT_ASSERT_G(sizeof(struct bps_block) <= sizeof(size_t));
 
 /**
  * Leaf block definition.
@@ -909,6 +986,10 @@ CT_ASSERT_G(sizeof(struct bps_leaf) <= BPS_TREE_BLOCK_SIZE);
 struct bps_inner {
 	/* Block header */
 	struct bps_block header;
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+	/* Number of elements in the subtree, i.e. in all its leaves */
+	size_t elem_count;
+#endif
 	/* Ordered array of elements. Note -1 in size. See struct descr. */
 	bps_tree_elem_t elems[BPS_TREE_MAX_COUNT_IN_INNER - 1];
 	/* Corresponding child IDs */
@@ -1119,6 +1200,9 @@ bps_tree_build(struct bps_tree *tree, bps_tree_elem_t *sorted_array,
 				}
 				parents[i]->header.type = BPS_TREE_BT_INNER;
 				parents[i]->header.size = 0;
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+				parents[i]->elem_count = 0;
+#endif
 				inner_count++;
 			}
 			parents[i]->child_ids[parents[i]->header.size] =
@@ -1131,6 +1215,11 @@ bps_tree_build(struct bps_tree *tree, bps_tree_elem_t *sorted_array,
 				insert_id = new_id;
 			}
 		}
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+		/* All the parents are on the path to the leaf now */
+		for (bps_tree_block_id_t i = 0; i < depth - 1; i++)
+			parents[i]->elem_count += leaf->header.size;
+#endif
 
 		bps_tree_elem_t insert_value = current[leaf->header.size - 1];
 		for (bps_tree_block_id_t i = 0; i < depth - 1; i++) {
@@ -1248,6 +1337,47 @@ bps_tree_touch_block(struct bps_tree *tree, bps_tree_block_id_t id)
 	return (struct bps_block *)matras_touch(&tree->matras, id);
 }
 
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+/**
+ * @brief Get the number of elements in the subtree of a block.
+ */
+static inline size_t
+bps_tree_block_elem_count(struct bps_block *block)
+{
+	if (block->type == BPS_TREE_BT_LEAF)
+		return block->size;
+	assert(block->type == BPS_TREE_BT_INNER);
+	return ((struct bps_inner *)block)->elem_count;
+}
+
+/**
+ * @brief Get the number of elements in the subtrees of the children
+ *  of an inner block that precede the child at the given position.
+ */
+static inline size_t
+bps_tree_inner_elem_count_before(const struct bps_tree *tree,
+				 struct bps_inner *inner, bps_tree_pos_t pos)
+{
+	size_t count = 0;
+	if (pos <= inner->header.size / 2) {
+		for (bps_tree_pos_t i = 0; i < pos; i++) {
+			struct bps_block *block =
+				bps_tree_restore_block(tree,
+						       inner->child_ids[i]);
+			count += bps_tree_block_elem_count(block);
+		}
+		return count;
+	}
+	/* It's cheaper to subtract the right part from the total */
+	for (bps_tree_pos_t i = pos; i < inner->header.size; i++) {
+		struct bps_block *block =
+			bps_tree_restore_block(tree, inner->child_ids[i]);
+		count += bps_tree_block_elem_count(block);
+	}
+	return inner->elem_count - count;
+}
+#endif /* BPS_TREE_INNER_ELEM_COUNT */
+
 /**
  * @brief Get a random element in a tree.
  * @param tree - pointer to a tree
@@ -1747,6 +1877,158 @@ bps_tree_approximate_count(const struct bps_tree *tree, bps_tree_key_t key)
 	return result;
 }
 
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+/**
+ * @brief Same as bps_tree_lower_bound, but also get the offset of
+ *  the element pointed by the iterator.
+ * @param tree - pointer to a tree
+ * @param key - key that will be compared with elements
+ * @param exact - see bps_tree_lower_bound. Pass NULL if not needed.
+ * @param offset - pointer to a variable that receives the offset.
+ * @return - Lower-bound iterator.
+ */
+static inline struct bps_tree_iterator
+bps_tree_lower_bound_get_offset(const struct bps_tree *tree,
+				bps_tree_key_t key, bool *exact,
+				size_t *offset)
+{
+	struct bps_tree_iterator res;
+	matras_head_read_view(&res.view);
+	bool local_result;
+	if (!exact)
+		exact = &local_result;
+	*exact = false;
+	*offset = 0;
+	if (tree->root_id == (bps_tree_block_id_t)(-1)) {
+		res.block_id = (bps_tree_block_id_t)(-1);
+		res.pos = 0;
+		return res;
+	}
+	struct bps_block *block = bps_tree_root(tree);
+	bps_tree_block_id_t block_id = tree->root_id;
+	for (bps_tree_block_id_t i = 0; i < tree->depth - 1; i++) {
+		struct bps_inner *inner = (struct bps_inner *)block;
+		bps_tree_pos_t pos;
+		pos = bps_tree_find_ins_point_key(tree, inner->elems,
+						  inner->header.size - 1,
+						  key, exact);
+		*offset += bps_tree_inner_elem_count_before(tree, inner, pos);
+		block_id = inner->child_ids[pos];
+		block = bps_tree_restore_block(tree, block_id);
+	}
+
+	struct bps_leaf *leaf = (struct bps_leaf *)block;
+	bps_tree_pos_t pos;
+	pos = bps_tree_find_ins_point_key(tree, leaf->elems, leaf->header.size,
+					  key, exact);
+	*offset += pos;
+	if (pos >= leaf->header.size) {
+		res.block_id = leaf->next_id;
+		res.pos = 0;
+	} else {
+		res.block_id = block_id;
+		res.pos = pos;
+	}
+	return res;
+}
+
+/**
+ * @brief Same as bps_tree_upper_bound, but also get the offset of
+ *  the element pointed by the iterator.
+ * @param tree - pointer to a tree
+ * @param key - key that will be compared with elements
+ * @param exact - see bps_tree_upper_bound. Pass NULL if not needed.
+ * @param offset - pointer to a variable that receives the offset.
+ * @return - Upper-bound iterator.
+ */
+static inline struct bps_tree_iterator
+bps_tree_upper_bound_get_offset(const struct bps_tree *tree,
+				bps_tree_key_t key, bool *exact,
+				size_t *offset)
+{
+	struct bps_tree_iterator res;
+	matras_head_read_view(&res.view);
+	bool local_result;
+	if (!exact)
+		exact = &local_result;
+	*exact = false;
+	*offset = 0;
+	bool exact_test;
+	if (tree->root_id == (bps_tree_block_id_t)(-1)) {
+		res.block_id = (bps_tree_block_id_t)(-1);
+		res.pos = 0;
+		return res;
+	}
+	struct bps_block *block = bps_tree_root(tree);
+	bps_tree_block_id_t block_id = tree->root_id;
+	for (bps_tree_block_id_t i = 0; i < tree->depth - 1; i++) {
+		struct bps_inner *inner = (struct bps_inner *)block;
+		bps_tree_pos_t pos;
+		pos = bps_tree_find_after_ins_point_key(tree, inner->elems,
+							inner->header.size - 1,
+							key, &exact_test);
+		if (exact_test)
+			*exact = true;
+		*offset += bps_tree_inner_elem_count_before(tree, inner, pos);
+		block_id = inner->child_ids[pos];
+		block = bps_tree_restore_block(tree, block_id);
+	}
+
+	struct bps_leaf *leaf = (struct bps_leaf *)block;
+	bps_tree_pos_t pos;
+	pos = bps_tree_find_after_ins_point_key(tree, leaf->elems,
+						leaf->header.size,
+						key, &exact_test);
+	if (exact_test)
+		*exact = true;
+	*offset += pos;
+	if (pos >= leaf->header.size) {
+		res.block_id = leaf->next_id;
+		res.pos = 0;
+	} else {
+		res.block_id = block_id;
+		res.pos = pos;
+	}
+	return res;
+}
+
+/**
+ * @brief Get an iterator to the element at the given offset.
+ * @param tree - pointer to a tree
+ * @param offset - offset of the element, starting from 0
+ * @return - Iterator. Invalid if the offset is out of bounds.
+ */
+static inline struct bps_tree_iterator
+bps_tree_iterator_at(const struct bps_tree *tree, size_t offset)
+{
+	struct bps_tree_iterator res;
+	matras_head_read_view(&res.view);
+	if (offset >= tree->size) {
+		res.block_id = (bps_tree_block_id_t)(-1);
+		res.pos = 0;
+		return res;
+	}
+	struct bps_block *block = bps_tree_root(tree);
+	bps_tree_block_id_t block_id = tree->root_id;
+	for (bps_tree_block_id_t i = 0; i < tree->depth - 1; i++) {
+		struct bps_inner *inner = (struct bps_inner *)block;
+		for (bps_tree_pos_t pos = 0; ; pos++) {
+			assert(pos < inner->header.size);
+			block_id = inner->child_ids[pos];
+			block = bps_tree_restore_block(tree, block_id);
+			size_t count = bps_tree_block_elem_count(block);
+			if (offset < count)
+				break;
+			offset -= count;
+		}
+	}
+	assert(offset < (size_t)block->size);
+	res.block_id = block_id;
+	res.pos = (bps_tree_pos_t)offset;
+	return res;
+}
+#endif /* BPS_TREE_INNER_ELEM_COUNT */
+
 /**
  * @brief Get a pointer to the element pointed by iterator.
  *  If iterator is detected as broken, it is invalidated and NULL returned.
@@ -2124,6 +2406,45 @@ bps_tree_touch_path(struct bps_tree *tree,
 	}
 }
 
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+/**
+ * @brief Recalculate the number of elements in the subtree of an
+ *  inner block after the set of its children was changed.
+ */
+static inline void
+bps_tree_inner_update_elem_count(struct bps_tree *tree,
+				 struct bps_inner *inner)
+{
+	size_t count = 0;
+	for (bps_tree_pos_t i = 0; i < inner->header.size; i++) {
+		struct bps_block *block =
+			bps_tree_restore_block(tree, inner->child_ids[i]);
+		count += bps_tree_block_elem_count(block);
+	}
+	inner->elem_count = count;
+}
+
+/**
+ * @brief Add a value to the numbers of elements of all inner blocks
+ *  on the path to a leaf. Called before an element is inserted to
+ *  or deleted from the leaf: blocks are rearranged only between
+ *  siblings, so the element stays in the same subtrees, and the
+ *  blocks which get new children recalculate their counts.
+ */
+static inline void
+bps_tree_path_add_elem_count(struct bps_tree *tree,
+			     struct bps_leaf_path_elem *leaf_path_elem,
+			     int diff)
+{
+	for (struct bps_inner_path_elem *path = leaf_path_elem->parent;
+	     path; path = path->parent) {
+		path->block = (struct bps_inner *)
+			bps_tree_touch_block(tree, path->block_id);
+		path->block->elem_count += diff;
+	}
+}
+#endif /* BPS_TREE_INNER_ELEM_COUNT */
+
 /**
  * @brief Replace element by it's path and fill the *replaced argument
  */
@@ -2457,6 +2778,14 @@ bps_tree_move_elems_to_right_inner(struct bps_tree *tree,
 
 	a->header.size -= num;
 	b->header.size += num;
+
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+	/* exclusive behaviuor for debug checks */
+	if (tree->root_id != (bps_tree_block_id_t) -1) {
+		bps_tree_inner_update_elem_count(tree, a);
+		bps_tree_inner_update_elem_count(tree, b);
+	}
+#endif
 }
 
 /**
@@ -2536,6 +2865,14 @@ bps_tree_move_elems_to_left_inner(struct bps_tree *tree,
 
 	a->header.size += num;
 	b->header.size -= num;
+
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+	/* exclusive behaviuor for debug checks */
+	if (tree->root_id != (bps_tree_block_id_t) -1) {
+		bps_tree_inner_update_elem_count(tree, a);
+		bps_tree_inner_update_elem_count(tree, b);
+	}
+#endif
 }
 
 /**
@@ -2735,6 +3072,14 @@ bps_tree_insert_and_move_elems_to_right_inner(struct bps_tree *tree,
 
 	a->header.size -= (num - 1);
 	b->header.size += num;
+
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+	/* exclusive behaviuor for debug checks */
+	if (tree->root_id != (bps_tree_block_id_t) -1) {
+		bps_tree_inner_update_elem_count(tree, a);
+		bps_tree_inner_update_elem_count(tree, b);
+	}
+#endif
 }
 
 /**
@@ -2928,6 +3273,14 @@ bps_tree_insert_and_move_elems_to_left_inner(struct bps_tree *tree,
 
 	a->header.size += num;
 	b->header.size -= (num - 1);
+
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+	/* exclusive behaviuor for debug checks */
+	if (tree->root_id != (bps_tree_block_id_t) -1) {
+		bps_tree_inner_update_elem_count(tree, a);
+		bps_tree_inner_update_elem_count(tree, b);
+	}
+#endif
 }
 
 /**
@@ -3434,6 +3787,9 @@ bps_tree_process_insert_leaf(struct bps_tree *tree,
 		struct bps_inner *new_root = bps_tree_create_inner(tree,
 				&new_root_id);
 		new_root->header.size = 2;
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+		new_root->elem_count = tree->size;
+#endif
 		new_root->child_ids[0] = tree->root_id;
 		new_root->child_ids[1] = new_block_id;
 		new_root->elems[0] = tree->max_elem;
@@ -3750,6 +4106,9 @@ bps_tree_process_insert_inner(struct bps_tree *tree,
 		struct bps_inner *new_root =
 			bps_tree_create_inner(tree, &new_root_id);
 		new_root->header.size = 2;
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+		new_root->elem_count = tree->size;
+#endif
 		new_root->child_ids[0] = tree->root_id;
 		new_root->child_ids[1] = new_block_id;
 		new_root->elems[0] = tree->max_elem;
@@ -4166,10 +4525,19 @@ bps_tree_insert(struct bps_tree *tree, bps_tree_elem_t new_elem,
 		bps_tree_process_replace(tree, &leaf_path_elem, new_elem,
 					 replaced);
 		return 0;
-	} else {
-		return bps_tree_process_insert_leaf(tree, &leaf_path_elem,
-						    new_elem);
 	}
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+	bps_tree_path_add_elem_count(tree, &leaf_path_elem, 1);
+	if (bps_tree_process_insert_leaf(tree, &leaf_path_elem,
+					 new_elem) != 0) {
+		/* The tree is left intact on failure */
+		bps_tree_path_add_elem_count(tree, &leaf_path_elem, -1);
+		return -1;
+	}
+	return 0;
+#else
+	return bps_tree_process_insert_leaf(tree, &leaf_path_elem, new_elem);
+#endif
 }
 
 /**
@@ -4191,6 +4559,9 @@ bps_tree_delete(struct bps_tree *tree, bps_tree_elem_t elem)
 	if (!exact)
 		return -1;
 
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+	bps_tree_path_add_elem_count(tree, &leaf_path_elem, -1);
+#endif
 	bps_tree_process_delete_leaf(tree, &leaf_path_elem);
 	return 0;
 }
@@ -4306,6 +4677,9 @@ bps_tree_debug_check_block(const struct bps_tree *tree, struct bps_block *block,
 				result |= 0x4000000;
 		}
 
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+		size_t calc_count_before = *calc_count;
+#endif
 		for (bps_tree_pos_t i = 0; i < block->size; i++)
 			result |= bps_tree_debug_check_block(tree,
 				bps_tree_restore_block(tree,
@@ -4313,6 +4687,10 @@ bps_tree_debug_check_block(const struct bps_tree *tree, struct bps_block *block,
 				inner->child_ids[i], level - 1, calc_count,
 				expected_prev_id, expected_this_id,
 				check_fullness_next);
+#ifdef BPS_TREE_INNER_ELEM_COUNT
+		if (inner->elem_count != *calc_count - calc_count_before)
+			result |= 0x8000000;
+#endif
 		return result;
 	}
 }
@@ -5722,6 +6100,9 @@ bps_tree_debug_check_internal_functions(bool assertme)
 #undef bps_tree_iterator_last
 #undef bps_tree_lower_bound
 #undef bps_tree_upper_bound
+#undef bps_tree_lower_bound_get_offset
+#undef bps_tree_upper_bound_get_offset
+#undef bps_tree_iterator_at
 #undef bps_tree_approximate_count
 #undef bps_tree_iterator_get_elem
 #undef bps_tree_iterator_next
@@ -5745,6 +6126,10 @@ bps_tree_debug_check_internal_functions(bool assertme)
 #undef bps_tree_restore_block_ver
 #undef bps_tree_root
 #undef bps_tree_touch_block
+#undef bps_tree_block_elem_count
+#undef bps_tree_inner_elem_count_before
+#undef bps_tree_inner_update_elem_count
+#undef bps_tree_path_add_elem_count
 #undef bps_tree_find_ins_point_key
 #undef bps_tree_find_ins_point_elem
 #undef bps_tree_find_after_ins_point_key
@@ -30,10 +30,16 @@
  */
 #include "rtree.h"
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <limits.h>
 #include <stddef.h>
+#include <math.h>
 #include <sys/types.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include <third_party/qsort_arg.h>
 
 /*------------------------------------------------------------------------- */
 /* R-tree internal structures definition */
@@ -132,6 +138,62 @@ rtree_set2dp(struct rtree_rect *rect, coord_t x, coord_t y)
 	rect->coords[3] = y;
 }
 
+#if defined(__SSE2__)
+
+/*
+ * Distances from the low point of neigh_rect to the low and
+ * the high coordinate of rect along one axis:
+ * (low - point, point - high), negative ones replaced with zero.
+ * At most one of them is positive in a normalized rectangle,
+ * so the sum of the two is exactly the distance along the axis.
+ */
+static inline __m128d
+rtree_rect_neigh_diff(const struct rtree_rect *rect,
+		      const struct rtree_rect *neigh_rect, int i)
+{
+	__m128d coords = _mm_loadu_pd(&rect->coords[2 * i]);
+	__m128d point = _mm_set1_pd(neigh_rect->coords[2 * i]);
+	__m128d diff = _mm_mul_pd(_mm_sub_pd(coords, point),
+				  _mm_set_pd(-1, 1));
+	/* NaN yields zero, like a failed comparison */
+	return _mm_max_pd(diff, _mm_setzero_pd());
+}
+
+static inline sq_coord_t
+rtree_sum_pd(__m128d v)
+{
+	return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+/* Manhattan distance */
+static sq_coord_t
+rtree_rect_neigh_distance(const struct rtree_rect *rect,
+			   const struct rtree_rect *neigh_rect,
+			   unsigned dimension)
+{
+	sq_coord_t result = 0;
+	for (int i = dimension; --i >= 0; )
+		result += rtree_sum_pd(rtree_rect_neigh_diff(rect,
+							     neigh_rect, i));
+	return result;
+}
+
+/* Euclid distance, squared */
+static sq_coord_t
+rtree_rect_neigh_distance2(const struct rtree_rect *rect,
+			   const struct rtree_rect *neigh_rect,
+			   unsigned dimension)
+{
+	sq_coord_t result = 0;
+	for (int i = dimension; --i >= 0; ) {
+		__m128d diff = rtree_rect_neigh_diff(rect, neigh_rect, i);
+		result += rtree_sum_pd(_mm_mul_pd(diff, diff));
+	}
+	return result;
+}
+
+#else /* !defined(__SSE2__) */
+
 /* Manhattan distance */
 static sq_coord_t
 rtree_rect_neigh_distance(const struct rtree_rect *rect,
@@ -174,6 +236,8 @@ rtree_rect_neigh_distance2(const struct rtree_rect *rect,
 	return result;
 }
 
+#endif /* defined(__SSE2__) */
+
 static area_t
 rtree_rect_area(const struct rtree_rect *rect, unsigned dimension)
 {
@@ -270,70 +334,138 @@ rtree_rect_intersects_rect(const struct rtree_rect *rt1,
 	return true;
 }
 
-static bool
-rtree_rect_in_rect(const struct rtree_rect *rt1,
-		   const struct rtree_rect *rt2,
-		   unsigned dimension)
+/*------------------------------------------------------------------------- */
+/* R-tree rectangle tests */
+/*------------------------------------------------------------------------- */
+
+/*
+ * Set up a test of node rectangles against rect. The coordinates
+ * of rect are swapped within each dimension if swap is set and
+ * multiplied by the same signs as the coordinates of nodes.
+ */
+static void
+rtree_rect_test_create(struct rtree_rect_test *test, enum rtree_test_op op,
+		       coord_t sign_low, coord_t sign_high, bool swap,
+		       const struct rtree_rect *rect, unsigned dimension)
 {
+	test->op = op;
+	test->sign[0] = sign_low;
+	test->sign[1] = sign_high;
+	if (op == RTREE_TEST_ALL)
+		return;
 	for (int i = dimension; --i >= 0; ) {
-		const coord_t *coords1 = &rt1->coords[2 * i];
-		const coord_t *coords2 = &rt2->coords[2 * i];
-		if (coords1[0] < coords2[0] || coords1[1] > coords2[1])
-			return false;
+		const coord_t *coords = &rect->coords[2 * i];
+		test->coords[2 * i] = coords[swap ? 1 : 0] * sign_low;
+		test->coords[2 * i + 1] = coords[swap ? 0 : 1] * sign_high;
 	}
-	return true;
 }
 
-static bool
-rtree_rect_strict_in_rect(const struct rtree_rect *rt1,
-			  const struct rtree_rect *rt2,
-			  unsigned dimension)
+/* Accept all nodes */
+static void
+rtree_test_all(struct rtree_rect_test *test)
 {
-	for (int i = dimension; --i >= 0; ) {
-		const coord_t *coords1 = &rt1->coords[2 * i];
-		const coord_t *coords2 = &rt2->coords[2 * i];
-		if (coords1[0] <= coords2[0] || coords1[1] >= coords2[1])
-			return false;
-	}
-	return true;
+	rtree_rect_test_create(test, RTREE_TEST_ALL, 1, 1, false, NULL, 0);
 }
 
-static bool
-rtree_rect_holds_rect(const struct rtree_rect *rt1,
-		      const struct rtree_rect *rt2,
-		      unsigned dimension)
+/*
+ * Accept nodes overlapping with rect: reject if
+ * node.low > rect.high or -node.high > -rect.low
+ */
+static void
+rtree_test_overlaps(struct rtree_rect_test *test,
+		    const struct rtree_rect *rect, unsigned dimension)
 {
-	return rtree_rect_in_rect(rt2, rt1, dimension);
+	rtree_rect_test_create(test, RTREE_TEST_GT, 1, -1, true,
+			       rect, dimension);
 }
 
-static bool
-rtree_rect_strict_holds_rect(const struct rtree_rect *rt1,
-			     const struct rtree_rect *rt2,
-			     unsigned dimension)
+/*
+ * Accept nodes holding rect (strictly): reject if
+ * node.low > (>=) rect.low or -node.high > (>=) -rect.high
+ */
+static void
+rtree_test_holds(struct rtree_rect_test *test, const struct rtree_rect *rect,
+		 unsigned dimension, bool strict)
 {
-	return rtree_rect_strict_in_rect(rt2, rt1, dimension);
+	rtree_rect_test_create(test, strict ? RTREE_TEST_GE : RTREE_TEST_GT,
+			       1, -1, false, rect, dimension);
 }
 
-static bool
-rtree_rect_equal_to_rect(const struct rtree_rect *rt1,
-			 const struct rtree_rect *rt2,
-			 unsigned dimension)
+/*
+ * Accept nodes belonging to rect (strictly): reject if
+ * -node.low > (>=) -rect.low or node.high > (>=) rect.high
+ */
+static void
+rtree_test_belongs(struct rtree_rect_test *test,
+		   const struct rtree_rect *rect, unsigned dimension,
+		   bool strict)
 {
-	for (int i = dimension * 2; --i >= 0; )
-		if (rt1->coords[i] != rt2->coords[i])
-			return false;
-	return true;
+	rtree_rect_test_create(test, strict ? RTREE_TEST_GE : RTREE_TEST_GT,
+			       -1, 1, false, rect, dimension);
 }
 
-static bool
-rtree_always_true(const struct rtree_rect *rt1,
-		  const struct rtree_rect *rt2,
-		  unsigned dimension)
+/* Accept nodes equal to rect */
+static void
+rtree_test_equals(struct rtree_rect_test *test,
+		  const struct rtree_rect *rect, unsigned dimension)
 {
-	(void) rt1;
-	(void) rt2;
-	(void) dimension;
-	return true;
+	rtree_rect_test_create(test, RTREE_TEST_NE, 1, 1, false,
+			       rect, dimension);
+}
+
+/*
+ * Check a node rectangle against a test. The op is passed
+ * separately so that it is a constant in a caller's loop.
+ */
+static inline bool
+rtree_rect_test_rejects(const struct rtree_rect_test *test,
+			const struct rtree_rect *rect, unsigned dimension,
+			enum rtree_test_op op)
+{
+#if defined(__SSE2__)
+	__m128d sign = _mm_loadu_pd(test->sign);
+	__m128d reject = _mm_setzero_pd();
+	for (unsigned i = 0; i < dimension; i++) {
+		__m128d node = _mm_mul_pd(_mm_loadu_pd(&rect->coords[2 * i]),
+					  sign);
+		__m128d coords = _mm_loadu_pd(&test->coords[2 * i]);
+		switch (op) {
+		case RTREE_TEST_GT:
+			reject = _mm_or_pd(reject, _mm_cmpgt_pd(node, coords));
+			break;
+		case RTREE_TEST_GE:
+			reject = _mm_or_pd(reject, _mm_cmpge_pd(node, coords));
+			break;
+		case RTREE_TEST_NE:
+			reject = _mm_or_pd(reject, _mm_cmpneq_pd(node, coords));
+			break;
+		default:
+			return false;
+		}
+	}
+	return _mm_movemask_pd(reject) != 0;
+#else
+	for (unsigned i = 0; i < dimension * 2; i++) {
+		coord_t node = rect->coords[i] * test->sign[i % 2];
+		switch (op) {
+		case RTREE_TEST_GT:
+			if (node > test->coords[i])
+				return true;
+			break;
+		case RTREE_TEST_GE:
+			if (node >= test->coords[i])
+				return true;
+			break;
+		case RTREE_TEST_NE:
+			if (node != test->coords[i])
+				return true;
+			break;
+		default:
+			return false;
+		}
+	}
+	return false;
+#endif
 }
 
 /*------------------------------------------------------------------------- */
@@ -370,6 +502,43 @@ rtree_branch_get(const struct rtree *tree, const struct rtree_page *page,
 		((char *)page->data + ind * tree->page_branch_size);
 }
 
+static inline unsigned
+rtree_page_find_op(const struct rtree *tree, const struct rtree_page *page,
+		   unsigned from, const struct rtree_rect_test *test,
+		   enum rtree_test_op op)
+{
+	unsigned d = tree->dimension;
+	for (unsigned i = from, n = page->n; i < n; i++) {
+		struct rtree_page_branch *b = rtree_branch_get(tree, page, i);
+		if (!rtree_rect_test_rejects(test, &b->rect, d, op))
+			return i;
+	}
+	return page->n;
+}
+
+/*
+ * Find the first branch of a page starting from the given one
+ * that passes a test. Returns page->n if there is none.
+ */
+static unsigned
+rtree_page_find(const struct rtree *tree, const struct rtree_page *page,
+		unsigned from, const struct rtree_rect_test *test)
+{
+	switch (test->op) {
+	case RTREE_TEST_GT:
+		return rtree_page_find_op(tree, page, from, test,
+					  RTREE_TEST_GT);
+	case RTREE_TEST_GE:
+		return rtree_page_find_op(tree, page, from, test,
+					  RTREE_TEST_GE);
+	case RTREE_TEST_NE:
+		return rtree_page_find_op(tree, page, from, test,
+					  RTREE_TEST_NE);
+	default:
+		return from < page->n ? from : page->n;
+	}
+}
+
 static void
 rtree_branch_copy(struct rtree_page_branch *to,
 		  const struct rtree_page_branch *from, unsigned dimension)
@@ -724,25 +893,22 @@ static bool
 rtree_iterator_goto_first(struct rtree_iterator *itr, unsigned sp,
 			  struct rtree_page* pg)
 {
-	unsigned d = itr->tree->dimension;
-	if (sp + 1 == itr->tree->height) {
-		for (unsigned i = 0, n = pg->n; i < n; i++) {
-			struct rtree_page_branch *b;
-			b = rtree_branch_get(itr->tree, pg, i);
-			if (itr->leaf_cmp(&itr->rect, &b->rect, d)) {
-				itr->stack[sp].page = pg;
-				itr->stack[sp].pos = i;
-				return true;
-			}
+	const struct rtree *tree = itr->tree;
+	if (sp + 1 == tree->height) {
+		unsigned i = rtree_page_find(tree, pg, 0, &itr->leaf_test);
+		if (i < pg->n) {
+			itr->stack[sp].page = pg;
+			itr->stack[sp].pos = i;
+			return true;
 		}
 	} else {
-		for (unsigned i = 0, n = pg->n; i < n; i++) {
+		for (unsigned i = rtree_page_find(tree, pg, 0, &itr->intr_test);
+		     i < pg->n;
+		     i = rtree_page_find(tree, pg, i + 1, &itr->intr_test)) {
 			struct rtree_page_branch *b;
-			b = rtree_branch_get(itr->tree, pg, i);
-			if (itr->intr_cmp(&itr->rect, &b->rect, d)
-			    && rtree_iterator_goto_first(itr, sp + 1,
-							 b->data.page))
-			{
+			b = rtree_branch_get(tree, pg, i);
+			if (rtree_iterator_goto_first(itr, sp + 1,
+						      b->data.page)) {
 				itr->stack[sp].page = pg;
 				itr->stack[sp].pos = i;
 				return true;
@@ -756,25 +922,25 @@ rtree_iterator_goto_first(struct rtree_iterator *itr, unsigned sp,
 static bool
 rtree_iterator_goto_next(struct rtree_iterator *itr, unsigned sp)
 {
-	unsigned d = itr->tree->dimension;
+	const struct rtree *tree = itr->tree;
 	struct rtree_page *pg = itr->stack[sp].page;
-	if (sp + 1 == itr->tree->height) {
-		for (unsigned i = itr->stack[sp].pos, n = pg->n; ++i < n;) {
-			struct rtree_page_branch *b;
-			b = rtree_branch_get(itr->tree, pg, i);
-			if (itr->leaf_cmp(&itr->rect, &b->rect, d)) {
-				itr->stack[sp].pos = i;
-				return true;
-			}
+	/* The position is -1 right after rtree_search() */
+	unsigned from = itr->stack[sp].pos + 1;
+	if (sp + 1 == tree->height) {
+		unsigned i = rtree_page_find(tree, pg, from, &itr->leaf_test);
+		if (i < pg->n) {
+			itr->stack[sp].pos = i;
+			return true;
 		}
 	} else {
-		for (int i = itr->stack[sp].pos, n = pg->n; ++i < n;) {
+		for (unsigned i = rtree_page_find(tree, pg, from,
+						  &itr->intr_test);
+		     i < pg->n;
+		     i = rtree_page_find(tree, pg, i + 1, &itr->intr_test)) {
 			struct rtree_page_branch *b;
-			b = rtree_branch_get(itr->tree, pg, i);
-			if (itr->intr_cmp(&itr->rect, &b->rect, d)
-			    && rtree_iterator_goto_first(itr, sp + 1,
-							 b->data.page))
-			{
+			b = rtree_branch_get(tree, pg, i);
+			if (rtree_iterator_goto_first(itr, sp + 1,
+						      b->data.page)) {
 				itr->stack[sp].page = pg;
 				itr->stack[sp].pos = i;
 				return true;
@@ -795,6 +961,10 @@ rtree_iterator_destroy(struct rtree_iterator *itr)
 	}
 	itr->page_list = NULL;
 	itr->page_pos = INT_MAX;
+	free(itr->top);
+	itr->top = NULL;
+	itr->top_capacity = 0;
+	itr->top_size = 0;
 }
 
 struct rtree_neighbor *
@@ -859,13 +1029,30 @@ rtree_iterator_init(struct rtree_iterator *itr)
 	itr->neigh_free_list = NULL;
 	itr->page_list = NULL;
 	itr->page_pos = INT_MAX;
+	itr->limit = 0;
+	itr->top = NULL;
+	itr->top_size = 0;
+	itr->top_capacity = 0;
+	itr->top_pos = 0;
+	itr->top_ready = false;
+}
+
+/* Distance from the iterator point to a rectangle */
+static sq_coord_t
+rtree_iterator_neigh_distance(const struct rtree_iterator *itr,
+			      const struct rtree_rect *rect)
+{
+	unsigned d = itr->tree->dimension;
+	if (itr->tree->distance_type == RTREE_EUCLID)
+		return rtree_rect_neigh_distance2(rect, &itr->rect, d);
+	else
+		return rtree_rect_neigh_distance(rect, &itr->rect, d);
 }
 
 static void
 rtree_iterator_process_neigh(struct rtree_iterator *itr,
 			     struct rtree_neighbor *neighbor)
 {
-	unsigned d = itr->tree->dimension;
 	void *child = neighbor->child;
 	struct rtree_page *pg = (struct rtree_page *)child;
 	int level = neighbor->level;
@@ -873,13 +1060,8 @@ rtree_iterator_process_neigh(struct rtree_iterator *itr,
 	for (int i = 0, n = pg->n; i < n; i++) {
 		struct rtree_page_branch *b;
 		b = rtree_branch_get(itr->tree, pg, i);
-		coord_t distance;
-		if (itr->tree->distance_type == RTREE_EUCLID)
-			distance = rtree_rect_neigh_distance2(&b->rect,
-							      &itr->rect, d);
-		else
-			distance = rtree_rect_neigh_distance(&b->rect,
-							     &itr->rect, d);
+		sq_coord_t distance =
+			rtree_iterator_neigh_distance(itr, &b->rect);
 		struct rtree_neighbor *neigh =
 			rtree_iterator_new_neighbor(itr, b->data.page,
 						    distance, level - 1);
@@ -887,6 +1069,142 @@ rtree_iterator_process_neigh(struct rtree_iterator *itr,
 	}
 }
 
+void
+rtree_iterator_set_limit(struct rtree_iterator *itr, unsigned limit)
+{
+	assert(!itr->top_ready);
+	if (itr->op == SOP_NEIGHBOR && limit <= RTREE_NEIGHBOR_LIMIT_MAX)
+		itr->limit = limit;
+}
+
+/* Order of entries in the top heap: farther is greater */
+static bool
+rtree_top_entry_less(const struct rtree_top_entry *a,
+		     const struct rtree_top_entry *b)
+{
+	return a->distance < b->distance ||
+	       (a->distance == b->distance && a->record < b->record);
+}
+
+static void
+rtree_top_sift_down(struct rtree_top_entry *top, unsigned size, unsigned i)
+{
+	struct rtree_top_entry entry = top[i];
+	while (2 * i + 1 < size) {
+		unsigned child = 2 * i + 1;
+		if (child + 1 < size &&
+		    rtree_top_entry_less(&top[child], &top[child + 1]))
+			child++;
+		if (!rtree_top_entry_less(&entry, &top[child]))
+			break;
+		top[i] = top[child];
+		i = child;
+	}
+	top[i] = entry;
+}
+
+static void
+rtree_top_sift_up(struct rtree_top_entry *top, unsigned i)
+{
+	struct rtree_top_entry entry = top[i];
+	while (i > 0) {
+		unsigned parent = (i - 1) / 2;
+		if (!rtree_top_entry_less(&top[parent], &entry))
+			break;
+		top[i] = top[parent];
+		i = parent;
+	}
+	top[i] = entry;
+}
+
+/*
+ * Add a record to the top heap unless it already holds limit
+ * records that are all nearer.
+ */
+static void
+rtree_iterator_top_add(struct rtree_iterator *itr, record_t record,
+		       sq_coord_t distance)
+{
+	struct rtree_top_entry entry = { record, distance };
+	if (itr->top_size < itr->limit) {
+		itr->top[itr->top_size] = entry;
+		rtree_top_sift_up(itr->top, itr->top_size++);
+	} else if (rtree_top_entry_less(&entry, &itr->top[0])) {
+		itr->top[0] = entry;
+		rtree_top_sift_down(itr->top, itr->top_size, 0);
+	}
+}
+
+/*
+ * True if nothing at the given distance can get into the top,
+ * so a page or a record at the distance may be skipped.
+ */
+static bool
+rtree_iterator_top_is_closer(const struct rtree_iterator *itr,
+			     sq_coord_t distance)
+{
+	return itr->top_size == itr->limit &&
+	       distance >= itr->top[0].distance;
+}
+
+/*
+ * Find the limit nearest records. The queue holds tree pages
+ * only: records of a leaf page go straight to the top heap,
+ * and branches which can't beat the farthest record in the full
+ * heap are not queued at all. The search stops as soon as the
+ * nearest queued page is farther than that record.
+ * @retval 0 on success, -1 on memory error
+ */
+static int
+rtree_iterator_find_top(struct rtree_iterator *itr)
+{
+	if (itr->top_capacity < itr->limit) {
+		struct rtree_top_entry *top = (struct rtree_top_entry *)
+			realloc(itr->top, itr->limit * sizeof(*top));
+		if (top == NULL)
+			return -1;
+		itr->top = top;
+		itr->top_capacity = itr->limit;
+	}
+	itr->top_size = 0;
+	itr->top_pos = 0;
+	struct rtree_neighbor *neighbor;
+	while ((neighbor = rtnt_first(&itr->neigh_tree)) != NULL) {
+		if (rtree_iterator_top_is_closer(itr, neighbor->distance))
+			break;
+		rtnt_remove(&itr->neigh_tree, neighbor);
+		struct rtree_page *pg = (struct rtree_page *)neighbor->child;
+		int level = neighbor->level;
+		rtree_iterator_free_neighbor(itr, neighbor);
+		for (int i = 0, n = pg->n; i < n; i++) {
+			struct rtree_page_branch *b;
+			b = rtree_branch_get(itr->tree, pg, i);
+			sq_coord_t distance =
+				rtree_iterator_neigh_distance(itr, &b->rect);
+			if (rtree_iterator_top_is_closer(itr, distance))
+				continue;
+			if (level == 1) {
+				rtree_iterator_top_add(itr, b->data.record,
+						       distance);
+				continue;
+			}
+			struct rtree_neighbor *neigh =
+				rtree_iterator_new_neighbor(itr, b->data.page,
+							    distance,
+							    level - 1);
+			rtnt_insert(&itr->neigh_tree, neigh);
+		}
+	}
+	/* Heap sort: move the farthest record to the end */
+	for (unsigned size = itr->top_size; size > 1; size--) {
+		struct rtree_top_entry tmp = itr->top[0];
+		itr->top[0] = itr->top[size - 1];
+		itr->top[size - 1] = tmp;
+		rtree_top_sift_down(itr->top, size - 1, 0);
+	}
+	return 0;
+}
+
 
 record_t
 rtree_iterator_next(struct rtree_iterator *itr)
@@ -895,6 +1213,19 @@ rtree_iterator_next(struct rtree_iterator *itr)
 		/* Index was updated since cursor initialziation */
 		return NULL;
 	}
+	if (itr->op == SOP_NEIGHBOR && itr->limit > 0) {
+		if (!itr->top_ready) {
+			if (rtree_iterator_find_top(itr) != 0) {
+				/* Fall back to the unlimited search */
+				itr->limit = 0;
+				return rtree_iterator_next(itr);
+			}
+			itr->top_ready = true;
+		}
+		if (itr->top_pos == itr->top_size)
+			return NULL;
+		return itr->top[itr->top_pos++].record;
+	}
 	if (itr->op == SOP_NEIGHBOR) {
 		/* To return element in order of increasing distance from
 		 * specified point, we build sorted list of R-Tree items
@@ -1056,6 +1387,188 @@ rtree_remove(struct rtree *tree, const struct rtree_rect *rect, record_t obj)
 	return true;
 }
 
+void
+rtree_bulk_create(struct rtree_bulk *bulk, const struct rtree *tree)
+{
+	bulk->branches = NULL;
+	bulk->count = 0;
+	bulk->capacity = 0;
+	bulk->is_sorted = false;
+	bulk->dimension = tree->dimension;
+	bulk->page_branch_size = tree->page_branch_size;
+	bulk->page_min_fill = tree->page_min_fill;
+	bulk->page_max_fill = tree->page_max_fill;
+}
+
+void
+rtree_bulk_destroy(struct rtree_bulk *bulk)
+{
+	free(bulk->branches);
+	bulk->branches = NULL;
+	bulk->count = 0;
+	bulk->capacity = 0;
+	bulk->is_sorted = false;
+}
+
+int
+rtree_bulk_reserve(struct rtree_bulk *bulk, size_t count)
+{
+	if (count <= bulk->capacity)
+		return 0;
+	char *branches = (char *)realloc(bulk->branches,
+					 count * bulk->page_branch_size);
+	if (branches == NULL)
+		return -1;
+	bulk->branches = branches;
+	bulk->capacity = count;
+	return 0;
+}
+
+int
+rtree_bulk_add(struct rtree_bulk *bulk, const struct rtree_rect *rect,
+	       record_t obj)
+{
+	if (bulk->count == bulk->capacity &&
+	    rtree_bulk_reserve(bulk, bulk->capacity < 1024 ? 1024 :
+			       bulk->capacity + bulk->capacity / 2) != 0)
+		return -1;
+	struct rtree_page_branch *b = (struct rtree_page_branch *)
+		(bulk->branches + bulk->count * bulk->page_branch_size);
+	b->data.record = obj;
+	rtree_rect_copy(&b->rect, rect, bulk->dimension);
+	bulk->count++;
+	bulk->is_sorted = false;
+	return 0;
+}
+
+/* Order branches by the center of their rectangles along an axis */
+static int
+rtree_bulk_cmp(const void *a, const void *b, void *arg)
+{
+	unsigned axis = *(unsigned *)arg;
+	const coord_t *coords_a =
+		&((const struct rtree_page_branch *)a)->rect.coords[2 * axis];
+	const coord_t *coords_b =
+		&((const struct rtree_page_branch *)b)->rect.coords[2 * axis];
+	coord_t center_a = coords_a[0] + coords_a[1];
+	coord_t center_b = coords_b[0] + coords_b[1];
+	return center_a < center_b ? -1 : center_a > center_b;
+}
+
+/*
+ * Sort-Tile-Recursive: sort branches along an axis, cut them into
+ * slabs so that there are about as many slabs along each of the
+ * remaining axes, and do the same for every slab along the next
+ * axis. Then consecutive runs of page_fill branches make compact
+ * pages, which overlap little.
+ */
+static void
+rtree_bulk_tile(char *branches, size_t n, unsigned axis, unsigned dimension,
+		unsigned branch_size, unsigned page_fill)
+{
+	qsort_arg(branches, n, branch_size, rtree_bulk_cmp, &axis);
+	if (axis + 1 == dimension || n <= page_fill)
+		return;
+	size_t page_count = (n + page_fill - 1) / page_fill;
+	size_t slab_count = ceil(pow(page_count, 1. / (dimension - axis)));
+	size_t slab_size = (page_count + slab_count - 1) / slab_count *
+			   page_fill;
+	for (size_t i = 0; i < n; i += slab_size) {
+		rtree_bulk_tile(branches + i * branch_size,
+				n - i < slab_size ? n - i : slab_size,
+				axis + 1, dimension, branch_size, page_fill);
+	}
+}
+
+void
+rtree_bulk_sort(struct rtree_bulk *bulk)
+{
+	if (bulk->is_sorted)
+		return;
+	rtree_bulk_tile(bulk->branches, bulk->count, 0, bulk->dimension,
+			bulk->page_branch_size, bulk->page_max_fill);
+	bulk->is_sorted = true;
+}
+
+int
+rtree_bulk_load(struct rtree *tree, struct rtree_bulk *bulk)
+{
+	assert(tree->root == NULL);
+	assert(bulk->page_branch_size == tree->page_branch_size);
+	rtree_bulk_sort(bulk);
+	/* Take over the records, the bulk is empty from now on */
+	char *branches = bulk->branches;
+	size_t n = bulk->count;
+	size_t n_records = n;
+	bulk->branches = NULL;
+	rtree_bulk_destroy(bulk);
+	if (n == 0)
+		return 0;
+
+	unsigned branch_size = tree->page_branch_size;
+	unsigned fill = tree->page_max_fill;
+	unsigned height = 1;
+	while (n > fill) {
+		/* Pack the branches into pages of the current level */
+		size_t page_count = (n + fill - 1) / fill;
+		char *upper = (char *)malloc(page_count * branch_size);
+		if (upper == NULL) {
+			for (size_t i = 0; height > 1 && i < n; i++) {
+				struct rtree_page_branch *b =
+					(struct rtree_page_branch *)
+					(branches + i * branch_size);
+				rtree_page_purge(tree, b->data.page,
+						 height - 1);
+			}
+			free(branches);
+			tree->n_pages = 0;
+			return -1;
+		}
+		/*
+		 * The last page may get too few branches, borrow
+		 * them from the previous one then.
+		 */
+		size_t last = n - (page_count - 1) * fill;
+		size_t borrow = last < tree->page_min_fill ?
+				tree->page_min_fill - last : 0;
+		char *from = branches;
+		for (size_t i = 0; i < page_count; i++) {
+			unsigned count = fill;
+			if (i + 2 == page_count)
+				count -= borrow;
+			else if (i + 1 == page_count)
+				count = last + borrow;
+			struct rtree_page *page = rtree_page_alloc(tree);
+			tree->n_pages++;
+			page->n = count;
+			memcpy(page->data, from, count * branch_size);
+			from += count * branch_size;
+			struct rtree_page_branch *b =
+				(struct rtree_page_branch *)
+				(upper + i * branch_size);
+			b->data.page = page;
+			rtree_page_cover(tree, page, &b->rect);
+		}
+		assert(from == branches + n * branch_size);
+		free(branches);
+		branches = upper;
+		n = page_count;
+		height++;
+		rtree_bulk_tile(branches, n, 0, tree->dimension,
+				branch_size, fill);
+	}
+	struct rtree_page *root = rtree_page_alloc(tree);
+	tree->n_pages++;
+	root->n = n;
+	memcpy(root->data, branches, n * branch_size);
+	free(branches);
+	tree->root = root;
+	tree->height = height;
+	tree->n_records = n_records;
+	tree->version++;
+	return 0;
+}
+
 bool
 rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 	     enum spatial_search_op op, struct rtree_iterator *itr)
@@ -1066,31 +1579,40 @@ rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 	itr->version = tree->version;
 	rtree_rect_copy(&itr->rect, rect, tree->dimension);
 	itr->op = op;
+	itr->limit = 0;
+	itr->top_size = 0;
+	itr->top_pos = 0;
+	itr->top_ready = false;
 	assert(tree->height <= RTREE_MAX_HEIGHT);
+	unsigned d = tree->dimension;
 	switch (op) {
 	case SOP_ALL:
-		itr->intr_cmp = itr->leaf_cmp = rtree_always_true;
+		rtree_test_all(&itr->intr_test);
+		rtree_test_all(&itr->leaf_test);
 		break;
 	case SOP_EQUALS:
-		itr->intr_cmp = rtree_rect_in_rect;
-		itr->leaf_cmp = rtree_rect_equal_to_rect;
+		rtree_test_holds(&itr->intr_test, rect, d, false);
+		rtree_test_equals(&itr->leaf_test, rect, d);
 		break;
 	case SOP_CONTAINS:
-		itr->intr_cmp = itr->leaf_cmp = rtree_rect_in_rect;
+		rtree_test_holds(&itr->intr_test, rect, d, false);
+		rtree_test_holds(&itr->leaf_test, rect, d, false);
 		break;
 	case SOP_STRICT_CONTAINS:
-		itr->intr_cmp = itr->leaf_cmp = rtree_rect_strict_in_rect;
+		rtree_test_holds(&itr->intr_test, rect, d, true);
+		rtree_test_holds(&itr->leaf_test, rect, d, true);
 		break;
 	case SOP_OVERLAPS:
-		itr->intr_cmp = itr->leaf_cmp = rtree_rect_intersects_rect;
+		rtree_test_overlaps(&itr->intr_test, rect, d);
+		rtree_test_overlaps(&itr->leaf_test, rect, d);
 		break;
 	case SOP_BELONGS:
-		itr->intr_cmp = rtree_rect_intersects_rect;
-		itr->leaf_cmp = rtree_rect_holds_rect;
+		rtree_test_overlaps(&itr->intr_test, rect, d);
+		rtree_test_belongs(&itr->leaf_test, rect, d, false);
 		break;
 	case SOP_STRICT_BELONGS:
-		itr->intr_cmp = rtree_rect_intersects_rect;
-		itr->leaf_cmp = rtree_rect_strict_holds_rect;
+		rtree_test_overlaps(&itr->intr_test, rect, d);
+		rtree_test_belongs(&itr->leaf_test, rect, d, true);
 		break;
 	case SOP_NEIGHBOR:
 		if (tree->root) {
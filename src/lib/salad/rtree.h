@@ -64,11 +64,19 @@ struct rtree_neighbor {
 
 typedef rb_tree(struct rtree_neighbor) rtnt_t;
 
+/* A record found by a limited NEIGHBOR search */
+struct rtree_top_entry {
+	record_t record;
+	sq_coord_t distance;
+};
+
 enum {
 	/** Maximal possible R-tree height */
 	RTREE_MAX_HEIGHT = 16,
 	/** Maximal possible R-tree height */
-	RTREE_MAX_DIMENSION = 20
+	RTREE_MAX_DIMENSION = 20,
+	/** Maximal limit of a NEIGHBOR search, see rtree_iterator_set_limit */
+	RTREE_NEIGHBOR_LIMIT_MAX = 1024
 };
 
 /**
@@ -109,10 +117,36 @@ struct rtree_rect
 	coord_t coords[RTREE_MAX_DIMENSION * 2];
 };
 
-/* Type of function, comparing two rectangles */
-typedef bool (*rtree_comparator_t)(const struct rtree_rect *rt1,
-				   const struct rtree_rect *rt2,
-				   unsigned dimension);
+/*
+ * Comparison of a rectangle of a tree node with the rectangle of
+ * a search. A node is rejected if, for any dimension, the op
+ * holds for the (low, high) coordinate pair of the node multiplied
+ * by sign and the corresponding pair of coords of the test.
+ */
+enum rtree_test_op {
+	/* Accept all nodes */
+	RTREE_TEST_ALL,
+	/* Reject a node if a coordinate is greater */
+	RTREE_TEST_GT,
+	/* Reject a node if a coordinate is greater or equal */
+	RTREE_TEST_GE,
+	/* Reject a node if a coordinate differs */
+	RTREE_TEST_NE
+};
+
+/*
+ * A rectangle test, prepared from the search rectangle once so
+ * that both coordinates of a dimension are checked with one
+ * vector instruction.
+ */
+struct rtree_rect_test
+{
+	enum rtree_test_op op;
+	/* Multipliers of the low and high coordinates of a node */
+	coord_t sign[2];
+	/* Transformed coordinates of the search rectangle */
+	coord_t coords[RTREE_MAX_DIMENSION * 2];
+};
 
 /* Type distance comparison */
 enum rtree_distance_type {
@@ -154,6 +188,27 @@ struct rtree
 	enum rtree_distance_type distance_type;
 };
 
+/*
+ * Records collected for a bulk load of a tree, see
+ * rtree_bulk_load().
+ */
+struct rtree_bulk
+{
+	/* Records with their rectangles, in tree page branch format */
+	char *branches;
+	/* Number of records */
+	size_t count;
+	/* Number of records the branches buffer can hold */
+	size_t capacity;
+	/* True if the records are sorted for the leaf level */
+	bool is_sorted;
+	/* Parameters of the tree to load, see struct rtree */
+	unsigned dimension;
+	unsigned page_branch_size;
+	unsigned page_min_fill;
+	unsigned page_max_fill;
+};
+
 /* Struct for iteration and retrieving rtree values */
 struct rtree_iterator
 {
@@ -182,14 +237,31 @@ struct rtree_iterator
 	/* Position of ready-to-use list entry in allocated page */
 	unsigned page_pos;
 
-	/* Comparators for comparison rectagnle of the iterator with
-	 * rectangles of tree nodes. If the comparator returns true,
-	 * the node is accepted; if false - skipped.
+	/* Maximal number of records to return by a NEIGHBOR search,
+	 * 0 if not limited, see rtree_iterator_set_limit().
+	 */
+	unsigned limit;
+	/* Nearest records found by a limited NEIGHBOR search: a max-heap
+	 * while the search goes, then sorted by increasing distance.
+	 * Reused by subsequent searches.
+	 */
+	struct rtree_top_entry *top;
+	/* Number of entries in top and number of allocated ones */
+	unsigned top_size;
+	unsigned top_capacity;
+	/* Position of the next record in top to return */
+	unsigned top_pos;
+	/* True if the limited search is done and top is sorted */
+	bool top_ready;
+
+	/* Tests for comparison rectagnle of the iterator with
+	 * rectangles of tree nodes. If the test passes, the node
+	 * is accepted; if not - skipped.
 	 */
-	/* Comparator for interanal (not leaf) nodes of the tree */
-	rtree_comparator_t intr_cmp;
-	/* Comparator for leaf nodes of the tree */
-	rtree_comparator_t leaf_cmp;
+	/* Test for interanal (not leaf) nodes of the tree */
+	struct rtree_rect_test intr_test;
+	/* Test for leaf nodes of the tree */
+	struct rtree_rect_test leaf_test;
 
 	/* Current path of search in tree */
 	struct {
@@ -275,6 +347,63 @@ rtree_search(const struct rtree *tree, const struct rtree_rect *rect,
 void
 rtree_insert(struct rtree *tree, struct rtree_rect *rect, record_t obj);
 
+/**
+ * @brief Prepare a bulk load of a tree
+ * @param bulk - pointer to a bulk to initialize
+ * @param tree - pointer to a tree to be loaded
+ */
+void
+rtree_bulk_create(struct rtree_bulk *bulk, const struct rtree *tree);
+
+/**
+ * @brief Free the records of a bulk that was not loaded
+ * @param bulk - pointer to a bulk
+ */
+void
+rtree_bulk_destroy(struct rtree_bulk *bulk);
+
+/**
+ * @brief Make room for records of a bulk
+ * @return 0 on success, -1 on memory error
+ * @param bulk - pointer to a bulk
+ * @param count - expected total number of records
+ */
+int
+rtree_bulk_reserve(struct rtree_bulk *bulk, size_t count);
+
+/**
+ * @brief Add a record to a bulk
+ * @return 0 on success, -1 on memory error
+ * @param bulk - pointer to a bulk
+ * @param rect - rectangle of the record
+ * @param obj - record to add
+ */
+int
+rtree_bulk_add(struct rtree_bulk *bulk, const struct rtree_rect *rect,
+	       record_t obj);
+
+/**
+ * @brief Order the records of a bulk the way they will be laid
+ * out in tree leaves (Sort-Tile-Recursive). This is the most
+ * expensive part of a bulk load and it doesn't touch the tree,
+ * so it may run in any thread. Optional, rtree_bulk_load() sorts
+ * the records if it was not called.
+ * @param bulk - pointer to a bulk
+ */
+void
+rtree_bulk_sort(struct rtree_bulk *bulk);
+
+/**
+ * @brief Build a tree from the records of a bulk. Much faster
+ * than inserting the records one by one and gives fully packed
+ * pages with little overlap. The bulk is empty after the call.
+ * @return 0 on success, -1 on memory error (the tree is empty)
+ * @param tree - pointer to an empty tree
+ * @param bulk - records to load
+ */
+int
+rtree_bulk_load(struct rtree *tree, struct rtree_bulk *bulk);
+
 /**
  * @brief Remove the record from a tree
  * @return true if the record deleted (false otherwise)
@@ -325,6 +454,20 @@ rtree_iterator_init(struct rtree_iterator *itr);
 void
 rtree_iterator_destroy(struct rtree_iterator *itr);
 
+/**
+ * @brief Limit the number of records a NEIGHBOR search started
+ * by the last rtree_search() returns. The search then keeps only
+ * the limit nearest records found so far and skips tree pages
+ * farther than all of them instead of queueing every visited
+ * branch. Must be called before the first rtree_iterator_next().
+ * Ignored for other searches and for limits greater than
+ * RTREE_NEIGHBOR_LIMIT_MAX.
+ * @param itr - pointer to a iterator
+ * @param limit - maximal number of records to return
+ **/
+void
+rtree_iterator_set_limit(struct rtree_iterator *itr, unsigned limit);
+
 /**
  * @brief Retrieve a record from the iterator and iterate it to the next record
  * @return a record or NULL if no more records
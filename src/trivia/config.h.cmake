@@ -178,6 +178,7 @@
 #cmakedefine HAVE_MREMAP 1
 
 #cmakedefine HAVE_PRCTL_H 1
+#cmakedefine HAVE_LINUX_IO_URING_H 1
 
 #cmakedefine HAVE_OPEN_MEMSTREAM 1
 #cmakedefine HAVE_FMEMOPEN 1
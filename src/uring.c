@@ -0,0 +1,555 @@
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#include "uring.h"
+
+#include "trivia/config.h"
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "fio.h"
+#include "say.h"
+#include "trivia/util.h"
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+/*
+ * Writes at the current file position need Linux 5.6, which is
+ * also the first version having IORING_OP_READ.
+ */
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define URING_SUPPORTED 1
+#endif
+#endif /* defined(HAVE_LINUX_IO_URING_H) */
+
+#if defined(URING_SUPPORTED)
+
+#include "fiber.h"
+#include "ipc.h"
+#include "tt_pthread.h"
+
+enum {
+	/** Number of submission queue entries in a ring. */
+	URING_ENTRIES = 64,
+	/**
+	 * Max number of reads in flight. The rest of the entries
+	 * are reserved for a write and a sync, so that the
+	 * completion queue never overflows.
+	 */
+	URING_READ_MAX = URING_ENTRIES - 2,
+};
+
+/** A submitted request, referenced by the entry user data. */
+struct uring_request {
+	/**
+	 * The fiber to wake up on completion or NULL if the
+	 * thread waits for it in the system call.
+	 */
+	struct fiber *fiber;
+	/** Result of the request, -errno on failure. */
+	int res;
+	/** Set when the request is completed. */
+	bool is_done;
+};
+
+/** A per-thread io_uring instance. */
+struct uring {
+	/** io_uring file descriptor. */
+	int fd;
+	/** Submission queue, mapped from the kernel. */
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	/** Entries filled but not submitted yet. */
+	unsigned sq_pending;
+	/** Completion queue, mapped from the kernel. */
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+	/** Mappings, to unmap them in uring_delete(). */
+	void *sq_ptr;
+	size_t sq_size;
+	void *cq_ptr;
+	size_t cq_size;
+	size_t sqes_size;
+	/** Number of requests submitted and not completed. */
+	unsigned in_flight;
+	/**
+	 * eventfd signaled by the kernel on completions, to wake
+	 * up the fibers waiting for reads. -1 until the thread
+	 * does the first uring_pread().
+	 */
+	int efd;
+	struct ev_io efd_watcher;
+	/** Fibers waiting for the number of reads to go down. */
+	struct ipc_cond read_cond;
+};
+
+/** Set if io_uring is enabled and supported by the kernel. */
+static bool uring_enabled;
+/** Key of the calling thread ring, deleted on thread exit. */
+static pthread_key_t uring_key;
+/** Set if the calling thread has failed to set up its ring. */
+static __thread bool uring_failed;
+/** Number of entries consumed by the kernel, in all threads. */
+static int64_t uring_submitted_count;
+
+static void
+uring_delete(void *arg)
+{
+	struct uring *ring = (struct uring *) arg;
+	if (ring->efd >= 0)
+		close(ring->efd);
+	if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ptr != NULL && ring->cq_ptr != MAP_FAILED)
+		munmap(ring->cq_ptr, ring->cq_size);
+	if (ring->sq_ptr != NULL && ring->sq_ptr != MAP_FAILED)
+		munmap(ring->sq_ptr, ring->sq_size);
+	close(ring->fd);
+	free(ring);
+}
+
+/**
+ * Set up a ring. Returns NULL and sets errno if the kernel
+ * doesn't support io_uring or the features we need.
+ */
+static struct uring *
+uring_new(void)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+	if (fd < 0)
+		return NULL;
+	if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+		close(fd);
+		errno = ENOSYS;
+		return NULL;
+	}
+	struct uring *ring = (struct uring *) calloc(1, sizeof(*ring));
+	if (ring == NULL) {
+		close(fd);
+		errno = ENOMEM;
+		return NULL;
+	}
+	ring->fd = fd;
+	ring->efd = -1;
+	ipc_cond_create(&ring->read_cond);
+
+	ring->sq_size = params.sq_off.array +
+			params.sq_entries * sizeof(unsigned);
+	ring->cq_size = params.cq_off.cqes +
+			params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	ring->sqes = (struct io_uring_sqe *)
+		mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring->sq_ptr == MAP_FAILED || ring->cq_ptr == MAP_FAILED ||
+	    ring->sqes == MAP_FAILED) {
+		int save_errno = errno;
+		uring_delete(ring);
+		errno = save_errno;
+		return NULL;
+	}
+	char *sq = (char *) ring->sq_ptr;
+	ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+	ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+	char *cq = (char *) ring->cq_ptr;
+	ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+	ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+	return ring;
+}
+
+/** Get the ring of the calling thread, set it up if needed. */
+static struct uring *
+uring_get(void)
+{
+	if (!uring_enabled || uring_failed)
+		return NULL;
+	struct uring *ring = (struct uring *)
+		tt_pthread_getspecific(uring_key);
+	if (ring != NULL)
+		return ring;
+	ring = uring_new();
+	if (ring == NULL) {
+		say_syserror("failed to set up io_uring, "
+			     "using the plain system calls");
+		uring_failed = true;
+		return NULL;
+	}
+	tt_pthread_setspecific(uring_key, ring);
+	return ring;
+}
+
+/**
+ * Get a submission queue entry for @a req. The entry is
+ * submitted by the next uring_submit().
+ */
+static struct io_uring_sqe *
+uring_sqe(struct uring *ring, struct uring_request *req)
+{
+	unsigned tail = *ring->sq_tail + ring->sq_pending++;
+	unsigned index = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = (uint64_t) (uintptr_t) req;
+	ring->sq_array[index] = index;
+	req->res = 0;
+	req->is_done = false;
+	return sqe;
+}
+
+/**
+ * Submit the pending entries and wait for @a wait_nr
+ * completions. On failure, the entries the kernel hasn't
+ * consumed are dropped and -1 is returned.
+ */
+static int
+uring_submit(struct uring *ring, unsigned wait_nr)
+{
+	unsigned to_submit = ring->sq_pending;
+	ring->sq_pending = 0;
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + to_submit,
+			 __ATOMIC_RELEASE);
+	while (to_submit > 0 || wait_nr > 0) {
+		unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+		int rc = syscall(__NR_io_uring_enter, ring->fd, to_submit,
+				 wait_nr, flags, NULL, 0);
+		if (rc >= 0) {
+			__atomic_add_fetch(&uring_submitted_count, rc,
+					   __ATOMIC_RELAXED);
+			ring->in_flight += rc;
+			to_submit -= rc;
+			wait_nr = 0;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+		/* Drop the entries the kernel hasn't seen. */
+		__atomic_store_n(ring->sq_tail,
+				 __atomic_load_n(ring->sq_head,
+						 __ATOMIC_ACQUIRE),
+				 __ATOMIC_RELEASE);
+		return to_submit > 0 ? -1 : 0;
+	}
+	return 0;
+}
+
+/** Complete the requests which results are in the queue. */
+static void
+uring_reap(struct uring *ring)
+{
+	unsigned head = *ring->cq_head;
+	unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	if (head == tail)
+		return;
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+		struct uring_request *req = (struct uring_request *)
+			(uintptr_t) cqe->user_data;
+		req->res = cqe->res;
+		req->is_done = true;
+		ring->in_flight--;
+		if (req->fiber != NULL)
+			fiber_wakeup(req->fiber);
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	ipc_cond_broadcast(&ring->read_cond);
+}
+
+/** Block the thread until @a req is completed. */
+static void
+uring_wait(struct uring *ring, struct uring_request *req)
+{
+	uring_reap(ring);
+	while (!req->is_done) {
+		int rc = syscall(__NR_io_uring_enter, ring->fd, 0, 1,
+				 IORING_ENTER_GETEVENTS, NULL, 0);
+		if (rc < 0 && errno != EINTR)
+			panic_syserror("io_uring_enter");
+		uring_reap(ring);
+	}
+}
+
+static void
+uring_efd_cb(ev_loop *loop, struct ev_io *watcher, int events)
+{
+	(void) loop;
+	(void) events;
+	struct uring *ring = (struct uring *) watcher->data;
+	uint64_t count;
+	while (read(ring->efd, &count, sizeof(count)) < 0 && errno == EINTR)
+		;
+	uring_reap(ring);
+}
+
+/**
+ * Make the kernel signal completions to the cord event loop,
+ * for fibers to wait for them without blocking the thread.
+ */
+static int
+uring_watch(struct uring *ring)
+{
+	if (ring->efd >= 0)
+		return 0;
+	int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (efd < 0) {
+		say_syserror("eventfd");
+		return -1;
+	}
+	if (syscall(__NR_io_uring_register, ring->fd,
+		    IORING_REGISTER_EVENTFD, &efd, 1) != 0) {
+		say_syserror("io_uring_register");
+		close(efd);
+		return -1;
+	}
+	ring->efd = efd;
+	ev_io_init(&ring->efd_watcher, uring_efd_cb, efd, EV_READ);
+	ring->efd_watcher.data = ring;
+	ev_io_start(loop(), &ring->efd_watcher);
+	return 0;
+}
+
+#endif /* defined(URING_SUPPORTED) */
+
+void
+uring_init(bool enable)
+{
+	if (!enable)
+		return;
+#if defined(URING_SUPPORTED)
+	struct uring *ring = uring_new();
+	if (ring == NULL) {
+		say_syserror("io_uring is not supported, "
+			     "using the plain system calls");
+		return;
+	}
+	tt_pthread_key_create(&uring_key, uring_delete);
+	tt_pthread_setspecific(uring_key, ring);
+	uring_enabled = true;
+	say_info("using io_uring for disk I/O");
+#else
+	say_warn("io_uring is not supported by this build, "
+		 "using the plain system calls");
+#endif
+}
+
+bool
+uring_is_enabled(void)
+{
+#if defined(URING_SUPPORTED)
+	return uring_get() != NULL;
+#else
+	return false;
+#endif
+}
+
+int64_t
+uring_submitted(void)
+{
+#if defined(URING_SUPPORTED)
+	return __atomic_load_n(&uring_submitted_count, __ATOMIC_RELAXED);
+#else
+	return 0;
+#endif
+}
+
+static ssize_t
+uring_writev_plain(int fd, const struct iovec *iov, int iovcnt, bool sync)
+{
+	ssize_t written = fio_writevn(fd, (struct iovec *) iov, iovcnt);
+	if (written >= 0 && sync && fdatasync(fd) != 0) {
+		say_syserror("fdatasync, [%s]", fio_filename(fd));
+		return -1;
+	}
+	return written;
+}
+
+#if defined(URING_SUPPORTED)
+
+/**
+ * Write the data left after a partial write of @a written
+ * bytes out of @a total. The linked sync is cancelled by
+ * the kernel in this case, so sync it here as well.
+ */
+static ssize_t
+uring_writev_rest(int fd, const struct iovec *iov, int iovcnt,
+		  size_t written, size_t total, bool sync)
+{
+	int i = 0;
+	while (written >= iov[i].iov_len) {
+		written -= iov[i].iov_len;
+		i++;
+	}
+	assert(i < iovcnt);
+	if (fio_writen(fd, (char *) iov[i].iov_base + written,
+		       iov[i].iov_len - written) != 0)
+		return -1;
+	if (uring_writev_plain(fd, iov + i + 1, iovcnt - i - 1, sync) < 0)
+		return -1;
+	return total;
+}
+
+static ssize_t
+uring_writev_ring(struct uring *ring, int fd, const struct iovec *iov,
+		  int iovcnt, bool sync)
+{
+	size_t total = 0;
+	for (int i = 0; i < iovcnt; i++)
+		total += iov[i].iov_len;
+
+	struct uring_request write_req, sync_req;
+	write_req.fiber = sync_req.fiber = NULL;
+	struct io_uring_sqe *sqe = uring_sqe(ring, &write_req);
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->off = (uint64_t) -1; /* the current file position */
+	sqe->addr = (uint64_t) (uintptr_t) iov;
+	sqe->len = iovcnt;
+	if (sync) {
+		sqe->flags |= IOSQE_IO_LINK;
+		sqe = uring_sqe(ring, &sync_req);
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fd = fd;
+		sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	}
+	if (uring_submit(ring, sync ? 2 : 1) != 0)
+		return uring_writev_plain(fd, iov, iovcnt, sync);
+	uring_wait(ring, &write_req);
+	if (sync)
+		uring_wait(ring, &sync_req);
+
+	if (write_req.res == -EINTR || write_req.res == -EAGAIN)
+		return uring_writev_plain(fd, iov, iovcnt, sync);
+	if (write_req.res < 0) {
+		errno = -write_req.res;
+		say_syserror("writev, [%s]", fio_filename(fd));
+		return -1;
+	}
+	if ((size_t) write_req.res < total)
+		return uring_writev_rest(fd, iov, iovcnt, write_req.res,
+					 total, sync);
+	if (sync && sync_req.res < 0) {
+		errno = -sync_req.res;
+		say_syserror("fdatasync, [%s]", fio_filename(fd));
+		return -1;
+	}
+	return total;
+}
+
+#endif /* defined(URING_SUPPORTED) */
+
+ssize_t
+uring_writev(int fd, const struct iovec *iov, int iovcnt, bool sync)
+{
+#if defined(URING_SUPPORTED)
+	struct uring *ring = uring_get();
+	if (ring != NULL && iovcnt > 0 && iovcnt <= IOV_MAX)
+		return uring_writev_ring(ring, fd, iov, iovcnt, sync);
+#endif
+	return uring_writev_plain(fd, iov, iovcnt, sync);
+}
+
+ssize_t
+uring_pread(int fd, void *buf, size_t count, off_t offset)
+{
+#if defined(URING_SUPPORTED)
+	struct uring *ring = uring_get();
+	assert(ring != NULL);
+	if (uring_watch(ring) != 0)
+		return fio_pread(fd, buf, count, offset);
+	size_t n = 0;
+	while (n < count) {
+		while (ring->in_flight >= URING_READ_MAX)
+			ipc_cond_wait(&ring->read_cond);
+		struct uring_request req;
+		req.fiber = fiber();
+		struct io_uring_sqe *sqe = uring_sqe(ring, &req);
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->off = offset + n;
+		sqe->addr = (uint64_t) (uintptr_t) ((char *) buf + n);
+		sqe->len = count - n;
+		if (uring_submit(ring, 0) != 0) {
+			ssize_t rc = fio_pread(fd, (char *) buf + n,
+					       count - n, offset + n);
+			return rc < 0 ? -1 : (ssize_t) (n + rc);
+		}
+		/*
+		 * The buffer must stay valid until the kernel is
+		 * done with it, so ignore spurious wakeups and
+		 * cancellation.
+		 */
+		while (!req.is_done)
+			fiber_yield();
+		if (req.res == -EINTR || req.res == -EAGAIN)
+			continue;
+		if (req.res < 0) {
+			errno = -req.res;
+			say_syserror("pread, [%s]", fio_filename(fd));
+			return -1;
+		}
+		if (req.res == 0)
+			break; /* EOF */
+		n += req.res;
+	}
+	return n;
+#else
+	(void) fd;
+	(void) buf;
+	(void) count;
+	(void) offset;
+	unreachable();
+	return -1;
+#endif
+}
@@ -0,0 +1,106 @@
+#ifndef TARANTOOL_URING_H_INCLUDED
+#define TARANTOOL_URING_H_INCLUDED
+/*
+ * Copyright 2010-2016, Tarantool AUTHORS, please see AUTHORS file.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above
+ *    copyright notice, this list of conditions and the
+ *    following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials
+ *    provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY <COPYRIGHT HOLDER> ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ * <COPYRIGHT HOLDER> OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * Disk I/O with io_uring(7), for Linux kernels supporting it.
+ *
+ * Every thread has its own ring, created on first use. Writes
+ * are synchronous: they block the calling thread, like
+ * writev(2), but may be followed by fdatasync(2) in the same
+ * system call. Reads done from a cord yield the calling fiber
+ * until the data arrives, so the thread doesn't have to hand
+ * them to the coeio thread pool.
+ *
+ * When io_uring is disabled or not supported, the functions
+ * fall back to the plain system calls.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+struct iovec;
+
+/**
+ * Enable or disable io_uring. Must be called from the main
+ * thread before any other thread uses it. Logs whether the
+ * kernel supports io_uring.
+ */
+void
+uring_init(bool enable);
+
+/**
+ * Return true if io_uring is enabled, supported by the kernel
+ * and the calling thread has managed to set up its ring.
+ */
+bool
+uring_is_enabled(void);
+
+/**
+ * Return the number of requests submitted to io_uring by all
+ * threads so far, 0 if io_uring has never been used.
+ */
+int64_t
+uring_submitted(void);
+
+/**
+ * Write the data at the current file position, re-trying for
+ * partial writes, and then, if @a sync is set, sync it with
+ * fdatasync(2). With io_uring, the write and the sync are
+ * submitted at once, as a linked pair.
+ *
+ * @return the number of bytes written or -1 on error, errno
+ *         is set and a message is written to the error log.
+ */
+ssize_t
+uring_writev(int fd, const struct iovec *iov, int iovcnt, bool sync);
+
+/**
+ * Read up to @a count bytes at @a offset, yielding the current
+ * fiber until the read completes. The calling thread must be a
+ * cord and uring_is_enabled() must be true.
+ *
+ * @return the number of bytes read, less than @a count only at
+ *         the end of file, or -1 on error, errno is set and a
+ *         message is written to the error log.
+ */
+ssize_t
+uring_pread(int fd, void *buf, size_t count, off_t offset);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* defined(__cplusplus) */
+
+#endif /* TARANTOOL_URING_H_INCLUDED */
@@ -147,3 +147,31 @@ for j=1,100 do check(math.random(9) - 1, {iterator = box.index.BITS_ALL_NOT_SET}
 good
 s:drop()
 s = nil
+
+-- compact = true stores sparse bitset pages as arrays of offsets
+s = box.schema.space.create('test')
+_ = s:create_index('primary', { type = 'hash', parts = {1, 'unsigned'}, unique = true })
+b = s:create_index('bitmap', { type = 'bitset', parts = {2, 'unsigned'}, unique = false })
+c = s:create_index('compact', { type = 'bitset', parts = {2, 'unsigned'}, unique = false, compact = true })
+for i=1,5000 do s:insert{i, bit.lshift(1, i % 31)} end
+for i=1,5000,3 do s:delete{i} end
+good = true
+function ids(index, key, opts) local r = {} for _, t in index:pairs({key}, opts) do table.insert(r, t[1]) end table.sort(r) return r end
+function same(key, opts) local x, y = ids(b, key, opts), ids(c, key, opts) if #x ~= #y then return false end for k = 1, #x do if x[k] ~= y[k] then return false end end return true end
+function check(key, opts) good = good and same(key, opts) and b:count({key}, opts) == c:count({key}, opts) end
+for j=0,30 do check(bit.lshift(1, j)) end
+for j=1,100 do check(math.random(2^31), {iterator = box.index.BITS_ANY_SET}) end
+for j=1,100 do check(math.random(2^31), {iterator = box.index.BITS_ALL_SET}) end
+for j=1,100 do check(math.random(2^31), {iterator = box.index.BITS_ALL_NOT_SET}) end
+good
+c:count() == b:count()
+c:bsize() < b:bsize()
+s:drop()
+s = nil
+
+-- compact and hint are rejected by indexes which don't use them
+s = box.schema.space.create('test')
+s:create_index('primary', { type = 'tree', parts = {1, 'unsigned'}, compact = true })
+s:create_index('primary', { type = 'hash', parts = {1, 'unsigned'}, hint = true })
+s:drop()
+s = nil
@@ -0,0 +1,29 @@
+-- offsets of non-indexed fields stored in tuples
+s = box.schema.space.create('test', {field_offsets = 8})
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {3, 'string'}, unique = false})
+t = s:insert{1, 2, 'a', 4, 5}
+t[1], t[2], t[3], t[4], t[5], t[6], t[8], t[9]
+fields = {}
+for i = 1, 20 do fields[i] = i * 10 end
+fields[3] = 'c'
+t = s:replace(fields)
+sum = 0
+for i = 1, 20 do if i ~= 3 then sum = sum + t[i] end end
+sum
+t[7], t[8], t[9], t[20], t[21]
+t = s:update(10, {{'#', 4, 10}})
+t[4], t[7], t[8], t[10], t[11]
+s.index.sk:select{'c'}[1][8]
+-- tuples keep the offsets of their format after alter
+_ = box.space._space:update(s.id, {{'=', 6, {field_offsets = 2}}})
+s = box.space.test
+t[7]
+s:get{10}[8]
+s:replace{2, 0, 'd', 4, 5, 6, 7}[7]
+s:get{1}[5], s:get{1}[6]
+s:drop()
+-- wrong values
+box.schema.space.create('t2', {field_offsets = -1})
+box.schema.space.create('t2', {field_offsets = 100000})
+box.schema.space.create('t2', {engine = 'vinyl', field_offsets = 2})
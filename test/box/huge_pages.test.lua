@@ -0,0 +1,27 @@
+env = require('test_run')
+test_run = env.new()
+
+-- results are the same whether or not the host has huge pages
+test_run:cmd('create server huge_pages with script = "box/lua/huge_pages.lua"')
+test_run:cmd("start server huge_pages")
+test_run:cmd('switch huge_pages')
+box.cfg.slab_alloc_huge_pages
+box.cfg.slab_alloc_numa
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+_ = s:create_index('secondary', {type = 'hash', parts = {2, 'unsigned'}})
+for i = 1, 10000 do s:insert{i, i, string.rep('x', i % 100)} end
+s:count()
+s.index.secondary:get(5000)[1]
+info = box.slab.info()
+info.huge_page_size == 0 or info.huge_page_size >= 2 * 1024 * 1024
+info.huge_pages_used <= info.quota_used
+s:drop()
+test_run:cmd("switch default")
+test_run:cmd("stop server huge_pages")
+test_run:cmd("cleanup server huge_pages")
+
+-- huge pages are off by default
+box.cfg.slab_alloc_huge_pages
+box.slab.info().huge_page_size
+box.slab.info().huge_pages_used
@@ -0,0 +1,42 @@
+env = require('test_run')
+test_run = env.new()
+
+-- results are the same whether or not the kernel supports io_uring
+test_run:cmd('create server io_uring with script = "box/lua/io_uring.lua"')
+test_run:cmd("start server io_uring")
+test_run:cmd('switch io_uring')
+box.cfg.io_uring
+box.cfg.wal_mode
+-- io_uring is used for disk I/O if the kernel supports it
+function uring_used(since) local info = box.info.io_uring return not info.enabled or info.submitted > since end
+submitted = box.info.io_uring.submitted
+memtx = box.schema.space.create('memtx')
+_ = memtx:create_index('primary')
+vinyl = box.schema.space.create('vinyl', {engine = 'vinyl'})
+_ = vinyl:create_index('primary', {page_size = 256})
+for i = 1, 100 do memtx:insert{i, string.rep('x', i)} end
+for i = 1, 100 do vinyl:insert{i, string.rep('x', i)} end
+-- dump vinyl to disk to read it back page by page
+box.snapshot()
+#vinyl:select()
+vinyl:get(50)[2] == string.rep('x', 50)
+vinyl:select({90}, {iterator = 'GE'})[11]
+uring_used(submitted)
+test_run:cmd("switch default")
+
+-- rows written to WAL are recovered
+test_run:cmd("stop server io_uring")
+test_run:cmd("start server io_uring")
+test_run:cmd('switch io_uring')
+box.space.memtx:count()
+box.space.memtx:get(100)[2] == string.rep('x', 100)
+#box.space.vinyl:select()
+box.space.memtx:drop()
+box.space.vinyl:drop()
+test_run:cmd("switch default")
+test_run:cmd("stop server io_uring")
+test_run:cmd("cleanup server io_uring")
+
+-- io_uring is not used unless enabled
+box.info.io_uring.enabled
+box.info.io_uring.submitted
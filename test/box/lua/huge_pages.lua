@@ -0,0 +1,11 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    slab_alloc_arena    = 0.1,
+    slab_alloc_huge_pages = true,
+    slab_alloc_numa     = 'interleave',
+}
+
+require('console').listen(os.getenv('ADMIN'))
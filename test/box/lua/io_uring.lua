@@ -0,0 +1,10 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    io_uring            = true,
+    wal_mode            = 'fsync',
+}
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,9 @@
+#!/usr/bin/env tarantool
+os = require('os')
+
+box.cfg{
+    listen              = os.getenv("LISTEN"),
+    memtx_use_mvcc_engine = true,
+}
+
+require('console').listen(os.getenv('ADMIN'))
@@ -0,0 +1,29 @@
+env = require('test_run').new()
+
+--
+-- Secondary keys are built in bulk, in several threads,
+-- when the server is restarted.
+--
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+_ = s:create_index('t1', {parts = {2, 'unsigned'}, unique = false})
+_ = s:create_index('t2', {parts = {3, 'string'}})
+_ = s:create_index('h', {type = 'hash', parts = {3, 'string'}})
+_ = s:create_index('t3', {parts = {2, 'unsigned', 1, 'unsigned'}})
+for i = 1, 1000 do s:insert{i, i % 10, tostring(i)} end
+env:cmd('restart server default')
+
+s = box.space.test
+function build_info() local r = {} for _, b in ipairs(box.info.memtx.index_build) do if b.space == 'test' then table.insert(r, string.format('%s %d %s', b.index, b.tuples, b.state)) end end return r end
+build_info()
+for _, b in ipairs(box.info.memtx.index_build) do assert(b.time >= 0) end
+
+s.index.t1:count(5)
+s.index.t2:get('500')
+s.index.h:get('777')
+s.index.t2:min()
+s.index.t2:max()
+s.index.t3:select({3}, {limit = 3})
+s.index.t3:select({3}, {iterator = 'lt', limit = 2})
+
+s:drop()
@@ -0,0 +1,40 @@
+net = require('net.box')
+msgpack = require('msgpack')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+_ = s:create_index('secondary', {parts = {2, 'string'}, unique = false})
+for i = 1, 3 do s:insert{i, 'str' .. i % 2, {i}} end
+c = net.connect(box.cfg.listen)
+
+-- responses are decoded into tuples
+res = c.space.test:select()
+res
+box.tuple.is(res[1])
+c.space.test:get(2)
+c:eval('return 1, {2}')
+
+-- raw mode returns the MessagePack as is
+raw = c.space.test:select({}, {raw = true})
+type(raw)
+msgpack.decode(raw)
+msgpack.decode(c.space.test.index.secondary:select({'str1'}, {raw = true}))
+msgpack.decode(c.space.test:select({4}, {raw = true}))
+msgpack.decode(c.space.test:select({}, {raw = true, limit = 1, fields = {3}}))
+c.space.test:select({}, {raw = true, iterator = 'BAD'})
+
+-- errors are reported as before
+c.space.test:insert{1, 'str1'}
+
+-- responses to concurrent requests are matched by sync
+fiber = require('fiber')
+ch = fiber.channel(100)
+for i = 1, 100 do fiber.create(function() ch:put(c.space.test:get(i % 3 + 1)[1] == i % 3 + 1) end) end
+ok = 0
+for i = 1, 100 do if ch:get(5) then ok = ok + 1 end end
+ok
+
+c:close()
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
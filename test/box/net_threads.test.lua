@@ -0,0 +1,38 @@
+env = require('test_run')
+test_run = env.new()
+
+test_run:cmd('create server net_threads with script = "box/lua/net_threads.lua"')
+test_run:cmd("start server net_threads")
+test_run:cmd('switch net_threads')
+box.cfg.net_threads
+space = box.schema.space.create('test')
+index = space:create_index('primary')
+for i = 1, 10 do space:insert{i} end
+net = require('net.box')
+LISTEN = require('uri').parse(box.cfg.listen)
+conns = {}
+-- connect all at once, so that the threads have a burst to share
+for i = 1, 16 do conns[i] = net.connect(LISTEN.host, LISTEN.service, {wait_connected = false}) end
+for i = 1, 16 do conns[i]:wait_connected() end
+-- every connection is served regardless of the thread it landed on
+count = 0
+for i = 1, 16 do count = count + #conns[i].space.test:select() end
+count
+-- every thread reports its connections, the total adds up; which
+-- thread accepts a connection is up to the kernel
+threads = box.stat.net.thread()
+#threads
+accepted = 0
+for _, t in ipairs(threads) do accepted = accepted + t.CONNECTIONS.total end
+accepted
+box.stat.net.CONNECTIONS.total
+box.stat.net.SENT.total > 0
+box.stat.net.RECEIVED.total > 0
+for i = 1, 16 do conns[i]:close() end
+space:drop()
+test_run:cmd("switch default")
+test_run:cmd("stop server net_threads")
+test_run:cmd("cleanup server net_threads")
+
+-- net_threads is checked on configuration
+box.cfg{net_threads = 'many'}
@@ -0,0 +1,50 @@
+env = require('test_run')
+test_run = env.new()
+net = require('net.box')
+fiber = require('fiber')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+space = box.schema.space.create('test')
+index = space:create_index('primary')
+-- tuples from a few bytes to 64 KB
+sizes = {10, 1000, 4000, 20000, 65536}
+for i, size in ipairs(sizes) do space:insert{i, string.rep('x', size)} end
+
+box.cfg{net_zero_copy_size = 1024}
+box.cfg.net_zero_copy_size
+c = net.connect(box.cfg.listen)
+function check(tuples) local sum = 0 for _, t in ipairs(tuples) do sum = sum + #t[2] end return #tuples, sum end
+-- large tuples are sent right from tuple memory, small ones are copied
+check(c.space.test:select())
+check(c.space.test:select({5}))
+check(c.space.test:select({1}))
+check(c.space.test:select({6}))
+
+-- zero-copy replies go in order with regular ones
+results = {}
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 100 do
+    fiber.create(function()
+        local _, sum = check(c.space.test:select({i % 6}, {iterator = 'GE'}))
+        c:ping()
+        c.space.test:replace{i % 6 + 10, ''}
+        table.insert(results, sum)
+    end)
+end;
+test_run:cmd("setopt delimiter ''");
+while #results < 100 do fiber.sleep(0.01) end
+total = 0
+for _, sum in ipairs(results) do total = total + sum end
+total
+
+-- a connection closed with replies in flight
+c2 = net.connect(box.cfg.listen)
+for i = 1, 10 do fiber.create(function() pcall(c2.space.test.select, c2.space.test) end) end
+c2:close()
+check(c.space.test:select({5}))
+
+c:close()
+box.cfg{net_zero_copy_size = -1}
+box.cfg{net_zero_copy_size = 0}
+space:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
@@ -20,5 +20,9 @@ s.index.spatial:select({0,0,10,10}, {iterator = 'LE'})
 s.index.spatial:select({10,10}, {iterator = 'EQ'})
 -- select neighbors of point (5,5)
 s.index.spatial:select({5,5}, {iterator = 'NEIGHBOR'})
+-- select nearest neighbors of point (1,2)
+s.index.spatial:select({1,2}, {iterator = 'NEIGHBOR', limit = 3})
+s.index.spatial:select({1,2}, {iterator = 'NEIGHBOR', offset = 2, limit = 3})
+s.index.spatial:select({1,2}, {iterator = 'NEIGHBOR', offset = 7, limit = 5})
 
 s:drop()
@@ -132,3 +132,40 @@ while (true) do table.insert(lots_of_links, s:get{0}) ref_count = ref_count + 1
 ref_count
 lots_of_links = {}
 s:drop()
+
+--------------------------------------------------------------------------------
+-- count and offset in tree indexes
+--------------------------------------------------------------------------------
+
+s = box.schema.space.create('select', { temporary = true })
+index1 = s:create_index('primary', { type = 'tree' })
+index2 = s:create_index('second', { type = 'tree', unique = false, parts = {2, 'unsigned'}})
+for i = 1, 1000 do s:insert({ i, i % 7 }) end
+test_run:cmd("setopt delimiter ';'")
+function check_count_offset(idx, key)
+    for _, it in pairs({'EQ', 'REQ', 'ALL', 'LT', 'LE', 'GE', 'GT'}) do
+        local all = idx:select(key, { iterator = it })
+        if idx:count(key, { iterator = it }) ~= #all then
+            return 'wrong count', it, key
+        end
+        for _, offset in pairs({1, 10, 100, math.max(#all - 1, 0), #all, #all + 1}) do
+            local t = idx:select(key, { iterator = it, offset = offset, limit = 2 })
+            local exp = { all[offset + 1], all[offset + 2] }
+            if msgpack.encode(t) ~= msgpack.encode(exp) then
+                return 'wrong offset', it, key, offset
+            end
+        end
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+check_count_offset(index1, nil)
+check_count_offset(index1, 500)
+check_count_offset(index1, 5000)
+check_count_offset(index2, nil)
+check_count_offset(index2, 0)
+check_count_offset(index2, 3)
+check_count_offset(index2, 6)
+s:truncate()
+check_count_offset(index2, 3)
+s:drop()
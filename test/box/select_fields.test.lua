@@ -0,0 +1,32 @@
+net = require('net.box')
+
+box.schema.user.grant('guest', 'read,write,execute', 'universe')
+s = box.schema.space.create('test')
+_ = s:create_index('primary')
+_ = s:create_index('secondary', {parts = {3, 'string'}, unique = false})
+for i = 1, 5 do s:insert{i, i * 10, 'str' .. i % 2, {i}, i * 100} end
+
+-- only the given fields of tuples, missing ones are nil
+s:select({}, {fields = {1, 3}})
+s.index.secondary:select({'str1'}, {fields = {5, 1}})
+s:select({2}, {fields = {6, 2, 2, 4}})
+s:select({2}, {fields = {}})
+s:select({4}, {iterator = 'GE', fields = {1}})
+s:select({}, {limit = 2, offset = 1, fields = {2}})
+s:select({}, {fields = 1})
+s:select({}, {fields = {0}})
+s:select({}, {fields = {'a'}})
+
+-- the same over the binary protocol
+c = net.connect(box.cfg.listen)
+c.space.test:select({}, {fields = {1, 3}})
+c.space.test.index.secondary:select({'str1'}, {fields = {5, 1}})
+c.space.test:select({2}, {fields = {6, 2, 2, 4}})
+c.space.test:select({2}, {fields = {}})
+c.space.test:select({}, {limit = 2, offset = 1, fields = {2}})
+c.space.test:select({}, {fields = 1})
+c.space.test:select({}, {fields = {0}})
+c:close()
+
+s:drop()
+box.schema.user.revoke('guest', 'read,write,execute', 'universe')
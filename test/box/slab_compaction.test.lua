@@ -0,0 +1,67 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+
+box.cfg{slab_compaction_rate = -1}
+box.cfg{slab_compaction_threshold = 0}
+box.cfg{slab_compaction_threshold = 1.5}
+box.cfg.slab_compaction_rate
+box.cfg.slab_compaction_threshold
+
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+_ = s:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+box.begin() for i = 1, 50000 do s:insert{i, i % 100, string.rep('x', 300)} end box.commit()
+-- keep every tenth tuple, so that all slabs are sparsely used
+box.begin() for i = 1, 50000 do if i % 10 ~= 0 then s:delete{i} end end box.commit()
+items_size = box.slab.info().items_size
+box.slab.compaction_info().moved
+t = s:get(2000)
+
+box.cfg{slab_compaction_rate = 100000}
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 1000 do
+    if box.slab.info().items_size < items_size then
+        break
+    end
+    fiber.sleep(0.01)
+end;
+test_run:cmd("setopt delimiter ''");
+box.cfg{slab_compaction_rate = 0}
+-- the tuples are moved out of the freed slabs
+box.slab.info().items_size < items_size
+info = box.slab.compaction_info()
+info.moved > 0 and info.moved_size >= info.moved * 300
+info.examined >= info.moved
+
+-- indexes point to the moved tuples
+s:count()
+s.index.sk:count(50)
+s:get(1000)[2], #s:get(1000)[3]
+s.index.sk:select(10, {limit = 1})[1][1]
+s:get(1001)
+-- a tuple referenced from Lua is not moved
+t == s:get(2000)
+t = nil
+s:drop()
+
+-- spaces with a bitset or rtree index are not compacted
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+_ = s:create_index('bitset', {type = 'bitset', parts = {2, 'unsigned'}, unique = false})
+_ = s:create_index('rtree', {type = 'rtree', parts = {3, 'array'}, unique = false})
+box.begin() for i = 1, 50000 do s:insert{i, i % 100, {i, i}, string.rep('x', 300)} end box.commit()
+box.begin() for i = 1, 50000 do if i % 10 ~= 0 then s:delete{i} end end box.commit()
+info = box.slab.compaction_info()
+box.cfg{slab_compaction_rate = 100000}
+test_run:cmd("setopt delimiter ';'")
+for i = 1, 1000 do
+    if box.slab.compaction_info().rounds > info.rounds then
+        break
+    end
+    fiber.sleep(0.01)
+end;
+test_run:cmd("setopt delimiter ''");
+box.cfg{slab_compaction_rate = 0}
+box.slab.compaction_info().rounds > info.rounds
+box.slab.compaction_info().moved == info.moved
+s:drop()
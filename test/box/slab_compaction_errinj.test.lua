@@ -0,0 +1,56 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+errinj = box.error.injection
+
+test_run:cmd("setopt delimiter ';'")
+function fragment()
+    local s = box.schema.space.create('test')
+    s:create_index('pk')
+    box.begin()
+    for i = 1, 50000 do s:insert{i, string.rep('x', 300)} end
+    box.commit()
+    -- keep every tenth tuple, so that all slabs are sparsely used
+    box.begin()
+    for i = 1, 50000 do if i % 10 ~= 0 then s:delete{i} end end
+    box.commit()
+    return s
+end;
+function wait_moved(moved)
+    for i = 1, 1000 do
+        if box.slab.compaction_info().moved > moved then
+            return true
+        end
+        fiber.sleep(0.01)
+    end
+    return false
+end;
+test_run:cmd("setopt delimiter ''");
+
+ch = fiber.channel(1)
+
+-- nothing is moved while a transaction is in progress
+s = fragment()
+errinj.set("ERRINJ_WAL_DELAY", true)
+_ = fiber.create(function() box.begin() s:replace{1, 'x'} box.commit() ch:put(true) end)
+moved = box.slab.compaction_info().moved
+box.cfg{slab_compaction_rate = 100000}
+fiber.sleep(0.1)
+box.slab.compaction_info().moved == moved
+ch:get(10)
+wait_moved(moved)
+box.cfg{slab_compaction_rate = 0}
+s:drop()
+
+-- nothing is moved while a snapshot is in progress
+s = fragment()
+errinj.set("ERRINJ_SNAP_WRITE_DELAY", true)
+_ = fiber.create(function() box.snapshot() ch:put(true) end)
+moved = box.slab.compaction_info().moved
+box.cfg{slab_compaction_rate = 100000}
+fiber.sleep(0.1)
+box.slab.compaction_info().moved == moved
+errinj.set("ERRINJ_SNAP_WRITE_DELAY", false)
+ch:get(10)
+wait_moved(moved)
+box.cfg{slab_compaction_rate = 0}
+s:drop()
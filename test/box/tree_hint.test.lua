@@ -0,0 +1,80 @@
+test_run = require('test_run').new()
+
+--
+-- TREE index key hints must not change the order of tuples:
+-- compare every iterator with and without hints.
+--
+test_run:cmd("setopt delimiter ';'")
+function same(a, b)
+    if #a ~= #b then
+        return false
+    end
+    for i = 1, #a do
+        if tostring(a[i][1]) ~= tostring(b[i][1]) then
+            return false
+        end
+    end
+    return true
+end;
+function check_hint(type, values)
+    local on = box.schema.space.create('hint_on')
+    local off = box.schema.space.create('hint_off')
+    on:create_index('pk', {parts = {1, type}, hint = true})
+    off:create_index('pk', {parts = {1, type}, hint = false})
+    on:create_index('sk', {parts = {1, type, 2, 'unsigned'}, unique = false,
+                           hint = true})
+    off:create_index('sk', {parts = {1, type, 2, 'unsigned'}, unique = false,
+                            hint = false})
+    for i, v in ipairs(values) do
+        on:replace{v, i}
+        off:replace{v, i}
+    end
+    local ok = same(on:select(), off:select())
+    for _, v in ipairs(values) do
+        for _, it in ipairs({'EQ', 'REQ', 'GE', 'GT', 'LE', 'LT'}) do
+            local opts = {iterator = it}
+            ok = ok and same(on:select({v}, opts), off:select({v}, opts))
+            ok = ok and same(on.index.sk:select({v}, opts),
+                             off.index.sk:select({v}, opts))
+        end
+    end
+    on:drop()
+    off:drop()
+    return ok
+end;
+test_run:cmd("setopt delimiter ''");
+
+check_hint('unsigned', {0, 1, 2, 4294967296, 9223372036854775807ULL, 9223372036854775808ULL, 18446744073709551615ULL})
+check_hint('integer', {-9223372036854775808LL, -4294967296, -1, 0, 1, 9223372036854775807ULL, 9223372036854775808ULL, 18446744073709551615ULL})
+check_hint('number', {-1e300, -1.5, -1, -0.0, 0, 0.5, 1, 9007199254740992, 9007199254740993ULL, 18446744073709551615ULL, 1e300})
+check_hint('string', {'', 'a', 'a\0', 'abcdefg', 'abcdefgh', 'abcdefgh0', 'abcdefgh1', 'abcdefgi', 'b', '\xff', '\xff\xff\xff\xff\xff\xff\xff\xff\xff'})
+check_hint('scalar', {false, true, -1, -0.5, 0, 1.5, 100, 18446744073709551615ULL, '', 'a', 'abcdefghij', 'abcdefghik', '\xff'})
+
+-- Strings with a common 8 byte prefix are ordered by the rest.
+s = box.schema.space.create('test')
+_ = s:create_index('pk', {parts = {1, 'string'}, hint = true})
+_ = s:insert{'abcdefgh2'}
+_ = s:insert{'abcdefgh10'}
+_ = s:insert{'abcdefgh'}
+_ = s:insert{'abcdefg'}
+s:select()
+s:select({'abcdefgh1'}, {iterator = 'GE'})
+s:drop()
+
+-- A non-negative integer may be encoded as MP_INT.
+ffi = require('ffi')
+ffi.cdef[[int box_insert(uint32_t space_id, const char *tuple, const char *tuple_end, void **result);]]
+s = box.schema.space.create('test')
+_ = s:create_index('pk', {parts = {1, 'integer'}, hint = true})
+_ = s:insert{4}
+_ = s:insert{6}
+data = '\x91\xd0\x05'
+ffi.C.box_insert(s.id, data, ffi.cast('const char *', data) + #data, nil)
+s:select()
+s:get{5}
+s:drop()
+
+-- The option is validated.
+s = box.schema.space.create('test')
+s:create_index('pk', {hint = 'yes'})
+s:drop()
@@ -0,0 +1,81 @@
+#include "module.h"
+
+#include <stdio.h>
+#include <sys/time.h>
+
+#include <msgpuck.h>
+
+static double
+proctime(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (double) tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static int
+encode_key(char *key, uint64_t n)
+{
+	char str[24];
+	int len = snprintf(str, sizeof(str), "key%llu", (unsigned long long) n);
+	char *key_end = mp_encode_array(key, 1);
+	key_end = mp_encode_str(key_end, str, len);
+	return key_end - key;
+}
+
+/**
+ * Insert 'key<N>' strings, N in [1, count], into the given
+ * space in a pseudo-random order, then look up random keys
+ * in its primary index. Log the time spent on each phase.
+ * Arguments: space name, count, number of lookups.
+ */
+int
+tree_hint_bench(box_function_ctx_t *ctx, const char *args,
+		const char *args_end)
+{
+	(void) ctx;
+	(void) args_end;
+	uint32_t arg_count = mp_decode_array(&args);
+	if (arg_count < 3) {
+		return box_error_set(__FILE__, __LINE__, ER_PROC_C, "%s",
+			"usage: tree_hint_bench(space, count, iterations)");
+	}
+	uint32_t name_len;
+	const char *name = mp_decode_str(&args, &name_len);
+	uint64_t count = mp_decode_uint(&args);
+	uint64_t iterations = mp_decode_uint(&args);
+
+	uint32_t space_id = box_space_id_by_name(name, name_len);
+	if (space_id == BOX_ID_NIL || count == 0) {
+		return box_error_set(__FILE__, __LINE__, ER_PROC_C,
+			"Can't find space %.*s", (int) name_len, name);
+	}
+
+	char key[32];
+	int len;
+	box_tuple_t *tuple;
+	/* 2654435761 is prime, so this visits every N once. */
+	double t = proctime();
+	for (uint64_t i = 0; i < count; i++) {
+		len = encode_key(key, (i * 2654435761ULL) % count + 1);
+		if (box_insert(space_id, key, key + len, NULL) != 0)
+			return -1;
+	}
+	t = proctime() - t;
+	say_info("%.*s: %llu inserts, %lf sec", (int) name_len, name,
+		 (unsigned long long) count, t);
+
+	uint64_t found = 0;
+	t = proctime();
+	for (uint64_t i = 0; i < iterations; i++) {
+		len = encode_key(key, (i * 2654435761ULL) % count + 1);
+		if (box_index_get(space_id, 0, key, key + len, &tuple) != 0)
+			return -1;
+		found += tuple != NULL;
+	}
+	t = proctime() - t;
+	say_info("%.*s: %llu lookups, %llu found, %lf sec",
+		 (int) name_len, name, (unsigned long long) iterations,
+		 (unsigned long long) found, t);
+	return 0;
+}
@@ -0,0 +1,27 @@
+package.cpath = '../box/?.so;../box/?.dylib;'..package.cpath
+
+net = require('net.box')
+
+c = net:new(os.getenv("LISTEN"))
+
+box.schema.func.create('tree_hint_bench', {language = "C"})
+box.schema.user.grant('guest', 'execute', 'function', 'tree_hint_bench')
+
+count = 1000000
+
+-- temporary spaces, so that inserts don't wait for WAL
+on = box.schema.space.create('hint_on', {temporary = true})
+_ = on:create_index('primary', {parts = {1, 'string'}, hint = true})
+off = box.schema.space.create('hint_off', {temporary = true})
+_ = off:create_index('primary', {parts = {1, 'string'}, hint = false})
+box.schema.user.grant('guest', 'read,write', 'space', 'hint_on')
+box.schema.user.grant('guest', 'read,write', 'space', 'hint_off')
+
+c:call('tree_hint_bench', 'hint_on', count, 10000000)
+c:call('tree_hint_bench', 'hint_off', count, 10000000)
+on:count() == count and off:count() == count
+
+box.schema.func.drop("tree_hint_bench")
+
+on:drop()
+off:drop()
@@ -76,3 +76,53 @@ tuple_bench(box_function_ctx_t *ctx, const char *args, const char *args_end)
 	say_info("%lf\n", t);
 	return 0;
 }
+
+/**
+ * Measure the cost of box_tuple_field() depending on the field
+ * number. Arguments: a space name and an array of field numbers
+ * (1-based) to access in the first tuple of the space.
+ */
+int
+tuple_field_bench(box_function_ctx_t *ctx, const char *args,
+		  const char *args_end)
+{
+	(void) ctx;
+	(void) args_end;
+	uint32_t arg_count = mp_decode_array(&args);
+	if (arg_count < 2 || mp_typeof(*args) != MP_STR) {
+		return box_error_set(__FILE__, __LINE__, ER_PROC_C, "%s",
+			"usage: tuple_field_bench(space_name, {field_no, ...})");
+	}
+	uint32_t name_len;
+	const char *name = mp_decode_str(&args, &name_len);
+	uint32_t space_id = box_space_id_by_name(name, name_len);
+	if (space_id == BOX_ID_NIL) {
+		return box_error_set(__FILE__, __LINE__, ER_PROC_C,
+			"Can't find space %.*s", (int) name_len, name);
+	}
+
+	char key[8];
+	char *key_end = mp_encode_array(key, 0);
+	box_tuple_t *tuple;
+	if (box_index_min(space_id, 0, key, key_end, &tuple) != 0)
+		return -1;
+	if (tuple == NULL) {
+		return box_error_set(__FILE__, __LINE__, ER_PROC_C,
+			"Space %.*s is empty", (int) name_len, name);
+	}
+
+	uint32_t n = mp_decode_array(&args);
+	for (uint32_t k = 0; k < n; k++) {
+		uint32_t field_no = mp_decode_uint(&args);
+		const int iterations = 10000000;
+		uintptr_t check = 0;
+		double t = proctime();
+		for (int i = 0; i < iterations; i++)
+			check += (uintptr_t) box_tuple_field(tuple, field_no - 1);
+		t = proctime() - t;
+		say_info("%.*s: field %u, %.1lf ns per access (%s)",
+			 (int) name_len, name, field_no, t * 1e9 / iterations,
+			 check != 0 ? "found" : "not found");
+	}
+	return 0;
+}
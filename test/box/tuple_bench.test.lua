@@ -29,3 +29,27 @@ prof.stop()
 box.schema.func.drop("tuple_bench")
 
 box.space.tester:drop()
+
+-- the cost of a field access depending on the field number,
+-- with and without stored offsets of non-indexed fields
+box.schema.func.create('tuple_bench.tuple_field_bench', {language = "C"})
+box.schema.user.grant('guest', 'execute', 'function', 'tuple_bench.tuple_field_bench')
+fields = {}
+for i = 1, 100 do table.insert(fields, i) end
+field_nos = {1, 2, 5, 10, 20, 40, 60, 80, 100}
+
+wide = box.schema.space.create('wide')
+_ = wide:create_index('primary')
+_ = wide:insert(fields)
+box.schema.user.grant('guest', 'read', 'space', 'wide')
+c:call('tuple_bench.tuple_field_bench', 'wide', field_nos)
+
+offsets = box.schema.space.create('offsets', {field_offsets = 100})
+_ = offsets:create_index('primary')
+_ = offsets:insert(fields)
+box.schema.user.grant('guest', 'read', 'space', 'offsets')
+c:call('tuple_bench.tuple_field_bench', 'offsets', field_nos)
+
+box.schema.func.drop('tuple_bench.tuple_field_bench')
+wide:drop()
+offsets:drop()
@@ -0,0 +1,117 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+json = require('json')
+msgpack = require('msgpack')
+
+-- wrong options
+box.schema.space.create('test', {compression = 'lz4'})
+box.schema.space.create('test', {engine = 'vinyl', compression = 'zstd'})
+box.schema.space.create('test', {compression = 'zstd', compression_threshold = -1})
+
+s = box.schema.space.create('test', {compression = 'zstd', compression_threshold = 100})
+_ = s:create_index('pk')
+_ = s:create_index('name', {parts = {2, 'string'}})
+test_run:cmd("setopt delimiter ';'")
+function make(i)
+    return {i, 'name' .. i, string.rep('the quick brown fox ' .. i % 10, 20),
+            {i, 'text'}}
+end;
+function check(n)
+    for i = 1, n do
+        local t = s:get(i)
+        if t == nil or json.encode(t:totable()) ~= json.encode(make(i)) then
+            return i
+        end
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+
+-- the first large tuples are samples to train a dictionary on
+for i = 1, 1000 do s:insert(make(i)) end
+box.slab.info().compressed_size
+-- the next ones are compressed once the dictionary is trained
+test_run:cmd("setopt delimiter ';'")
+n = 1000;
+while box.slab.info().compressed_size == 0 do
+    n = n + 1
+    s:insert(make(n))
+    fiber.sleep(0.01)
+end;
+test_run:cmd("setopt delimiter ''");
+for i = n + 1, 2000 do s:insert(make(i)) end
+info = box.slab.info()
+info.compressed_size > 0 and info.compressed_size * 2 < info.compressed_raw_size
+-- small tuples are stored as is
+s:insert{3000, 'small'}
+box.slab.info().compressed_size == info.compressed_size
+
+-- fields are decompressed on access
+check(2000)
+s:get(2000)[2], #s:get(2000)[3], s:get(2000)[4][2]
+s.index.name:get('name1999')[1]
+s:count()
+#s.index.name:select()
+s:update(2000, {{'=', 3, 'short'}})
+s:upsert({1999, 'x', 'y'}, {{'=', 3, 'short'}})
+s:get(1999)
+
+-- tuples are given to Lua as is
+t1 = s:get(1998)
+t1 == s:get(1998)
+t1:bsize() == #msgpack.encode(make(1998))
+json.encode(msgpack.decode(msgpack.encode(t1))) == json.encode(make(1998))
+-- an iterator keeps its own copy of the fields
+t2 = s:get(1997)
+fields = {}
+for _, v in t1:pairs() do assert(t2[3] == make(1997)[3]) table.insert(fields, v) end
+json.encode(fields) == json.encode(make(1998))
+t1 = nil
+t2 = nil
+
+-- vinyl tuples are never compressed
+v = box.schema.space.create('test_vinyl', {engine = 'vinyl'})
+_ = v:create_index('pk')
+for i = 1, 10 do v:replace(make(i)) end
+json.encode(v:get(10):totable()) == json.encode(make(10))
+v:get(10)[2], v:get(10)[4][2], v:get(10):bsize() == #msgpack.encode(make(10))
+#v:select()
+v:drop()
+
+-- iproto replies
+net = require('net.box')
+box.schema.user.grant('guest', 'read', 'space', 'test')
+c = net.connect(box.cfg.listen)
+json.encode(c.space.test:get(1500):totable()) == json.encode(make(1500))
+#c.space.test:select()
+c:close()
+box.schema.user.revoke('guest', 'read', 'space', 'test')
+
+-- a field compressed in some tuples can't be indexed
+s:create_index('text', {parts = {3, 'string'}, unique = false})
+
+-- snapshots have plain tuples
+box.snapshot()
+test_run:cmd('restart server default')
+json = require('json')
+s = box.space.test
+test_run:cmd("setopt delimiter ';'")
+function make(i)
+    return {i, 'name' .. i, string.rep('the quick brown fox ' .. i % 10, 20),
+            {i, 'text'}}
+end;
+function check(n)
+    for i = 1, n do
+        local t = s:get(i)
+        if t == nil or json.encode(t:totable()) ~= json.encode(make(i)) then
+            return i
+        end
+    end
+    return true
+end;
+test_run:cmd("setopt delimiter ''");
+check(1998)
+s:get(2000)
+s.index.name:get('name1500')[1]
+s:drop()
+box.slab.info().compressed_size
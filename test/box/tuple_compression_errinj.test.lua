@@ -0,0 +1,34 @@
+test_run = require('test_run').new()
+fiber = require('fiber')
+net_box = require('net.box')
+errinj = box.error.injection
+
+s = box.schema.space.create('test', {compression = 'zstd', compression_threshold = 100})
+_ = s:create_index('pk')
+test_run:cmd("setopt delimiter ';'")
+function make(i)
+    return {i, string.rep('the quick brown fox ' .. i % 10, 20)}
+end;
+for i = 1, 1000 do s:insert(make(i)) end;
+n = 1000;
+while box.slab.info().compressed_size == 0 do
+    n = n + 1
+    s:insert(make(n))
+    fiber.sleep(0.01)
+end;
+test_run:cmd("setopt delimiter ''");
+for i = n + 1, n + 10 do s:insert(make(i)) end
+box.schema.user.grant('guest', 'read', 'space', 'test')
+c = net_box.connect(box.cfg.listen)
+
+-- a tuple that can't be decompressed fails the whole select
+errinj.set("ERRINJ_TUPLE_DECOMPRESS", true)
+c.space.test:select({n}, {iterator = 'GT'})
+errinj.set("ERRINJ_TUPLE_DECOMPRESS", false)
+-- the connection is still in sync
+#c.space.test:select({n}, {iterator = 'GT'})
+c.space.test:get(n + 10)[1] == n + 10
+
+c:close()
+box.schema.user.revoke('guest', 'read', 'space', 'test')
+s:drop()
@@ -0,0 +1,123 @@
+env = require('test_run')
+test_run = env.new()
+
+test_run:cmd('create server tx_mvcc with script = "box/lua/tx_mvcc.lua"')
+test_run:cmd("start server tx_mvcc")
+test_run:cmd('switch tx_mvcc')
+box.cfg.memtx_use_mvcc_engine
+fiber = require('fiber')
+s = box.schema.space.create('test')
+pk = s:create_index('pk')
+sk = s:create_index('sk', {parts = {2, 'unsigned'}, unique = false})
+s:insert{1, 10}
+s:insert{2, 20}
+
+-- A transaction survives yields, its changes are invisible to
+-- others until commit.
+ch1 = fiber.channel(1)
+ch2 = fiber.channel(1)
+test_run:cmd("setopt delimiter ';'")
+function tx(f, commit)
+    box.begin()
+    local ok, err = pcall(f)
+    ch1:put(ok or err)
+    ch2:get()
+    if commit then
+        ok, err = pcall(box.commit)
+    else
+        ok, err = pcall(box.rollback)
+    end
+    ch1:put(ok or err)
+end;
+test_run:cmd("setopt delimiter ''");
+f = fiber.create(tx, function() s:replace{1, 11} s:insert{3, 30} s:delete{2} end, true)
+ch1:get()
+s:select{}
+sk:select{}
+s:get{3}
+sk:select{30}
+ch2:put(true)
+ch1:get()
+s:select{}
+sk:select{}
+
+-- Own changes are visible inside a transaction.
+box.begin()
+s:replace{4, 40}
+fiber.sleep(0)
+s:get{4}
+s:delete{3}
+sk:select{}
+box.commit()
+s:select{}
+
+-- Writing a tuple changed by another transaction is a conflict.
+f = fiber.create(tx, function() s:replace{1, 12} end, true)
+ch1:get()
+s:replace{1, 13}
+s:delete{1}
+s:insert{5, 50}
+ch2:put(true)
+ch1:get()
+s:select{}
+
+-- Inserting a key inserted by another transaction is a conflict
+-- as well, even if that transaction is rolled back later.
+f = fiber.create(tx, function() s:insert{6, 60} end, false)
+ch1:get()
+s:insert{6, 61}
+ch2:put(true)
+ch1:get()
+s:get{6}
+s:insert{6, 62}
+
+-- A transaction which has read a tuple overwritten by a
+-- committed transaction can't commit changes.
+box.begin()
+s:get{1}
+f = fiber.create(function() s:replace{1, 14} end)
+s:replace{7, 70}
+box.commit()
+s:get{1}
+s:get{7}
+-- Read-only transactions commit fine.
+box.begin()
+s:get{1}
+f = fiber.create(function() s:replace{1, 15} end)
+box.commit()
+
+-- Rollback puts everything back.
+box.begin()
+s:delete{1}
+s:replace{4, 41}
+s:insert{8, 80}
+s:get{1}
+sk:select{}
+box.rollback()
+s:select{}
+sk:select{}
+
+-- DDL is not allowed while a space has uncommitted changes.
+f = fiber.create(tx, function() s:replace{9, 90} end, true)
+ch1:get()
+s:create_index('sk2', {parts = {2, 'unsigned'}})
+ch2:put(true)
+ch1:get()
+sk2 = s:create_index('sk2', {parts = {2, 'unsigned'}})
+sk2:select{}
+
+-- A snapshot doesn't include uncommitted changes.
+f = fiber.create(tx, function() s:replace{1, 16} s:delete{4} s:insert{10, 100} end, false)
+ch1:get()
+box.snapshot()
+ch2:put(true)
+ch1:get()
+test_run:cmd("switch default")
+test_run:cmd("restart server tx_mvcc")
+test_run:cmd('switch tx_mvcc')
+s = box.space.test
+s:select{}
+s:drop()
+test_run:cmd("switch default")
+test_run:cmd("stop server tx_mvcc")
+test_run:cmd("cleanup server tx_mvcc")
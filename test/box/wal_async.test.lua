@@ -0,0 +1,41 @@
+--
+-- Group commit and asynchronous commit.
+--
+space = box.schema.space.create('test')
+_ = space:create_index('pk')
+
+-- Invalid options.
+box.commit(1)
+box.commit({wait = 'never'})
+box.cfg{wal_group_commit_delay = -1}
+box.cfg.wal_group_commit_delay
+box.cfg{wal_group_commit_bytes = 0}
+box.cfg.wal_group_commit_bytes
+
+-- Commit outside a transaction is a no-op.
+box.commit({wait = 'none'})
+
+-- An asynchronous commit makes changes visible at once.
+async_count = box.info.wal.async_count
+box.begin() space:replace{1} box.commit({wait = 'none'})
+space:get{1}
+box.info.wal.async_count - async_count
+box.begin() space:replace{2} box.commit({wait = 'complete'})
+box.info.wal.async_count - async_count
+
+-- Concurrent transactions share a batch with group commit.
+box.cfg{wal_group_commit_delay = 0.01}
+fiber = require('fiber')
+batch_count = box.info.wal.batch_count
+ch = fiber.channel(10)
+for i = 1, 10 do fiber.create(function() space:replace{i} ch:put(true) end) end
+for i = 1, 10 do ch:get() end
+box.info.wal.batch_count - batch_count < 10
+box.cfg{wal_group_commit_delay = 0}
+
+t = {}
+for k, _ in pairs(box.info.wal) do table.insert(t, k) end
+table.sort(t)
+t
+
+space:drop()
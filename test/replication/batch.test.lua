@@ -0,0 +1,29 @@
+env = require('test_run')
+test_run = env.new()
+engine = test_run:get_cfg('engine')
+fiber = require('fiber')
+box.schema.user.grant('guest', 'replication')
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+s = box.schema.space.create('test', {engine = engine})
+index = s:create_index('primary')
+test_run:cmd("switch replica")
+fiber = require('fiber')
+while box.space.test == nil do fiber.sleep(0.01) end
+batches = box.info.replication[1].batches
+-- stall the replica WAL while the master sends rows
+box.error.injection.set("ERRINJ_WAL_DELAY", true)
+test_run:cmd("switch default")
+for i = 1, 100 do s:insert{i} end
+test_run:cmd("switch replica")
+while box.space.test:count() < 100 do fiber.sleep(0.01) end
+box.space.test:count()
+-- the rows received meanwhile are applied in batches
+box.info.replication[1].batch_max > 1
+box.info.replication[1].batches - batches < 100
+test_run:cmd("switch default")
+-- cleanup
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+s:drop()
+box.schema.user.revoke('guest', 'replication')
@@ -10,6 +10,9 @@ r = box.info.replication[1]
 r.status == "follow"
 r.lag < 1
 r.idle < 1
+r.batches >= 0
+r.batch_max >= 0
+r.rows_per_sec >= 0
 r.uuid ~= nil
 r.vclock[1] > 0
 r.vclock[2] == nil
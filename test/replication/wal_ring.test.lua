@@ -0,0 +1,58 @@
+env = require('test_run')
+test_run = env.new()
+engine = test_run:get_cfg('engine')
+fiber = require('fiber')
+errinj = box.error.injection
+
+box.schema.user.grant('guest', 'replication')
+test_run:cmd("create server replica with rpl_master=default, script='replication/replica.lua'")
+test_run:cmd("start server replica")
+
+s = box.schema.space.create('test', {engine = engine})
+index = s:create_index('primary')
+test_run:cmd("switch replica")
+fiber = require('fiber')
+while box.space.test == nil do fiber.sleep(0.01) end
+test_run:cmd("switch default")
+
+-- a replica keeping up with the master is fed from the WAL ring
+ring_rows = box.info.wal.ring_rows
+for i = 1, 100 do s:insert{i} end
+test_run:cmd("switch replica")
+while box.space.test:count() < 100 do fiber.sleep(0.01) end
+box.space.test:count()
+test_run:cmd("switch default")
+box.info.wal.ring_rows - ring_rows
+
+-- stop the relay after it sends the next row
+errinj.set("ERRINJ_RELAY_DELAY", true)
+s:insert{101}
+test_run:cmd("switch replica")
+while box.space.test:get(101) == nil do fiber.sleep(0.01) end
+test_run:cmd("switch default")
+
+-- write more than the ring holds, the relay falls back to xlogs
+ring_misses = box.info.wal.ring_misses
+pad = string.rep('x', 200 * 1024)
+for i = 102, 201 do s:insert{i, pad} end
+errinj.set("ERRINJ_RELAY_DELAY", false)
+test_run:cmd("switch replica")
+while box.space.test:count() < 201 do fiber.sleep(0.01) end
+box.space.test:count()
+test_run:cmd("switch default")
+box.info.wal.ring_misses > ring_misses
+
+-- and returns to the ring once it has caught up
+ring_rows = box.info.wal.ring_rows
+for i = 202, 211 do s:insert{i} end
+test_run:cmd("switch replica")
+while box.space.test:count() < 211 do fiber.sleep(0.01) end
+box.space.test:count()
+test_run:cmd("switch default")
+box.info.wal.ring_rows > ring_rows
+
+-- cleanup
+test_run:cmd("stop server replica")
+test_run:cmd("cleanup server replica")
+s:drop()
+box.schema.user.revoke('guest', 'replication')
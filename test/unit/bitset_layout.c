@@ -0,0 +1,339 @@
+/*
+ * Check the page kernels, which may be vectorized, against a
+ * byte by byte computation. Check that a compact bitset index,
+ * which stores sparse pages as arrays of offsets, gives the
+ * same results as the default one, and optionally compare their
+ * memory usage and query rates:
+ *
+ *   ./bitset_layout.test bench
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include <bitset/index.h>
+#include <bitset/page.h>
+#include "unit.h"
+
+enum {
+	/** Bits in one page of a bitset, see page.h */
+	PAGE_BIT = 160 * CHAR_BIT,
+	/** Number of key bits */
+	KEY_BIT = 16,
+};
+
+static void
+test_page_layout(void)
+{
+	header();
+
+	struct bitset bm;
+	bitset_create_layout(&bm, BITSET_LAYOUT_COMPACT, realloc);
+	struct bitset_info info;
+
+	/* Few bits go to an array page */
+	for (size_t pos = 0; pos < PAGE_BIT; pos += 64)
+		fail_unless(bitset_set(&bm, pos) == 0);
+	fail_unless(bitset_set(&bm, 64) == 1);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 1 && info.array_pages == 1);
+	fail_unless(info.bsize < info.page_total_size);
+
+	/* Many bits switch the page to raw bits */
+	for (size_t pos = 1; pos < PAGE_BIT; pos += 8)
+		fail_unless(bitset_set(&bm, pos) == 0);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 1 && info.array_pages == 0);
+	fail_unless(bitset_cardinality(&bm) == PAGE_BIT / 64 + PAGE_BIT / 8);
+
+	/* And back after clearing most of them */
+	for (size_t pos = 1; pos < PAGE_BIT; pos += 8)
+		fail_unless(bitset_clear(&bm, pos) == 1);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 1 && info.array_pages == 1);
+	fail_unless(bitset_cardinality(&bm) == PAGE_BIT / 64);
+
+	for (size_t pos = 0; pos < PAGE_BIT; pos++)
+		fail_unless(bitset_test(&bm, pos) == (pos % 64 == 0));
+	for (size_t pos = 0; pos < PAGE_BIT; pos += 64)
+		fail_unless(bitset_clear(&bm, pos) == 1);
+	fail_unless(bitset_clear(&bm, 0) == 0);
+	bitset_info(&bm, &info);
+	fail_unless(info.pages == 0 && info.bsize == 0);
+
+	bitset_destroy(&bm);
+
+	footer();
+}
+
+/** A raw bits page filled with random bytes */
+static struct bitset_page *
+page_new_bits(void)
+{
+	struct bitset_page *page = (struct bitset_page *)
+		malloc(bitset_page_alloc_size(realloc));
+	fail_unless(page != NULL);
+	bitset_page_create(page);
+	uint8_t *data = (uint8_t *) bitset_page_data(page);
+	for (int i = 0; i < BITSET_PAGE_DATA_SIZE; i++)
+		data[i] = rand();
+	return page;
+}
+
+/** An array page of \a count random offsets */
+static struct bitset_page *
+page_new_array(uint32_t count, uint8_t *bits)
+{
+	struct bitset_page *page = (struct bitset_page *)
+		calloc(1, bitset_page_array_alloc_size(count));
+	fail_unless(page != NULL);
+	page->array_capacity = count;
+	page->cardinality = count;
+	uint16_t *offsets = bitset_page_array(page);
+	memset(bits, 0, BITSET_PAGE_DATA_SIZE);
+	uint32_t n = 0;
+	for (uint32_t pos = 0; n < count; pos++) {
+		/* Each offset is taken with an equal probability */
+		if ((uint32_t) rand() % (PAGE_BIT - pos) < count - n) {
+			offsets[n++] = pos;
+			bits[pos / CHAR_BIT] |= 1 << (pos % CHAR_BIT);
+		}
+	}
+	return page;
+}
+
+enum page_op { PAGE_AND, PAGE_NAND, PAGE_OR, page_op_MAX };
+
+static void
+check_page_op(enum page_op op, bool is_array)
+{
+	struct bitset_page *dst = page_new_bits();
+	struct bitset_page *src;
+	uint8_t bits[BITSET_PAGE_DATA_SIZE];
+	if (is_array) {
+		src = page_new_array(1 + rand() % BITSET_PAGE_ARRAY_MAX, bits);
+	} else {
+		src = page_new_bits();
+		memcpy(bits, bitset_page_data(src), sizeof(bits));
+	}
+	uint8_t expected[BITSET_PAGE_DATA_SIZE];
+	const uint8_t *d = (const uint8_t *) bitset_page_data(dst);
+	for (int i = 0; i < BITSET_PAGE_DATA_SIZE; i++) {
+		switch (op) {
+		case PAGE_AND:
+			expected[i] = d[i] & bits[i];
+			break;
+		case PAGE_NAND:
+			expected[i] = d[i] & ~bits[i];
+			break;
+		default:
+			expected[i] = d[i] | bits[i];
+		}
+	}
+	switch (op) {
+	case PAGE_AND:
+		bitset_page_and(dst, src);
+		break;
+	case PAGE_NAND:
+		bitset_page_nand(dst, src);
+		break;
+	default:
+		bitset_page_or(dst, src);
+	}
+	fail_unless(memcmp(bitset_page_data(dst), expected,
+			   sizeof(expected)) == 0);
+	free(src);
+	free(dst);
+}
+
+static void
+test_page_ops(void)
+{
+	header();
+	for (int i = 0; i < 100; i++) {
+		for (int op = 0; op < page_op_MAX; op++) {
+			check_page_op((enum page_op) op, false);
+			check_page_op((enum page_op) op, true);
+		}
+	}
+	footer();
+}
+
+/**
+ * Fill an index with \a count values spread over
+ * [0, count * spread) and random keys.
+ */
+static void
+fill_index(struct bitset_index *index, size_t count, size_t spread,
+	   unsigned seed, size_t *values)
+{
+	srand(seed);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t key = rand() % (1 << KEY_BIT);
+		size_t value = i * spread + rand() % spread;
+		fail_unless(bitset_index_insert(index, &key, sizeof(key),
+						value) == 0);
+		if (values != NULL)
+			values[i] = value;
+	}
+}
+
+static size_t
+count_matches(struct bitset_index *index, struct bitset_expr *expr,
+	      size_t *checksum)
+{
+	struct bitset_iterator it;
+	bitset_iterator_create(&it, realloc);
+	fail_unless(bitset_index_init_iterator(index, &it, expr) == 0);
+	size_t count = 0;
+	size_t value;
+	while ((value = bitset_iterator_next(&it)) != SIZE_MAX) {
+		*checksum = *checksum * 31 + value;
+		count++;
+	}
+	bitset_iterator_destroy(&it);
+	return count;
+}
+
+typedef int (*expr_f)(struct bitset_expr *expr, const void *key,
+		      size_t key_size);
+
+static const expr_f exprs[] = {
+	bitset_index_expr_equals,
+	bitset_index_expr_all_set,
+	bitset_index_expr_any_set,
+	bitset_index_expr_all_not_set,
+};
+
+enum { EXPR_COUNT = sizeof(exprs) / sizeof(exprs[0]) };
+
+static void
+check_same(struct bitset_index *a, struct bitset_index *b)
+{
+	struct bitset_expr expr;
+	bitset_expr_create(&expr, realloc);
+	for (int e = 0; e < EXPR_COUNT; e++) {
+		for (int i = 0; i < 16; i++) {
+			uint32_t key = rand() % (1 << KEY_BIT);
+			if (e != 0)
+				key &= rand() & rand();
+			fail_unless(exprs[e](&expr, &key, sizeof(key)) == 0);
+			size_t sum_a = 0, sum_b = 0;
+			size_t count_a = count_matches(a, &expr, &sum_a);
+			size_t count_b = count_matches(b, &expr, &sum_b);
+			fail_unless(count_a == count_b);
+			fail_unless(sum_a == sum_b);
+		}
+	}
+	bitset_expr_destroy(&expr);
+}
+
+static void
+test_same_results(size_t count, size_t spread)
+{
+	header();
+	printf("count = %zu, spread = %zu\n", count, spread);
+
+	struct bitset_index bitmap, compact;
+	fail_unless(bitset_index_create(&bitmap, realloc) == 0);
+	fail_unless(bitset_index_create_layout(&compact, BITSET_LAYOUT_COMPACT,
+					       realloc) == 0);
+	size_t *values = (size_t *) calloc(count, sizeof(*values));
+	fail_unless(values != NULL);
+	fill_index(&bitmap, count, spread, count, values);
+	fill_index(&compact, count, spread, count, NULL);
+	check_same(&bitmap, &compact);
+
+	/* Remove every other value and check again */
+	for (size_t i = 0; i < count; i += 2) {
+		bitset_index_remove_value(&bitmap, values[i]);
+		bitset_index_remove_value(&compact, values[i]);
+	}
+	free(values);
+	fail_unless(bitset_index_size(&bitmap) ==
+		    bitset_index_size(&compact));
+	check_same(&bitmap, &compact);
+
+	if (spread >= 64)
+		fail_unless(bitset_index_bsize(&compact) <
+			    bitset_index_bsize(&bitmap));
+
+	bitset_index_destroy(&compact);
+	bitset_index_destroy(&bitmap);
+
+	footer();
+}
+
+static double
+clock_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_index(struct bitset_index *index, const char *name)
+{
+	struct bitset_expr expr;
+	bitset_expr_create(&expr, realloc);
+	srand(1);
+	for (int e = 0; e < EXPR_COUNT; e++) {
+		const int iterations = 100;
+		size_t matches = 0, sum = 0;
+		double t = clock_sec();
+		for (int i = 0; i < iterations; i++) {
+			uint32_t key = (1 << (rand() % KEY_BIT)) |
+				       (1 << (rand() % KEY_BIT));
+			fail_unless(exprs[e](&expr, &key, sizeof(key)) == 0);
+			matches += count_matches(index, &expr, &sum);
+		}
+		t = clock_sec() - t;
+		fprintf(stderr, "  %-8s expr %d: %.1f queries/sec, "
+			"%.1f Mvalues/sec\n", name, e, iterations / t,
+			matches / t / 1e6);
+	}
+	bitset_expr_destroy(&expr);
+}
+
+static void
+bench(size_t count, size_t spread)
+{
+	fprintf(stderr, "count = %zu, spread = %zu\n", count, spread);
+	struct bitset_index bitmap, compact;
+	fail_unless(bitset_index_create(&bitmap, realloc) == 0);
+	fail_unless(bitset_index_create_layout(&compact, BITSET_LAYOUT_COMPACT,
+					       realloc) == 0);
+	fill_index(&bitmap, count, spread, 1, NULL);
+	fill_index(&compact, count, spread, 1, NULL);
+	fprintf(stderr, "  bitmap   %.1f bytes per value\n",
+		(double) bitset_index_bsize(&bitmap) / count);
+	fprintf(stderr, "  compact  %.1f bytes per value\n",
+		(double) bitset_index_bsize(&compact) / count);
+	bench_index(&bitmap, "bitmap");
+	bench_index(&compact, "compact");
+	bitset_index_destroy(&compact);
+	bitset_index_destroy(&bitmap);
+}
+
+int
+main(int argc, char **argv)
+{
+	setbuf(stdout, NULL);
+	test_page_ops();
+	test_page_layout();
+	test_same_results(20000, 1);
+	test_same_results(5000, 64);
+	test_same_results(1000, 4096);
+
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench(1000000, 1);
+		bench(100000, 16);
+		bench(100000, 256);
+	}
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "unit.h"
+#include "salad/bloom.h"
+
+enum { VALUE_COUNT = 100000 };
+
+static void
+no_false_negatives_check()
+{
+	header();
+	struct bloom bloom;
+	fail_if(bloom_create(&bloom, VALUE_COUNT, 0.01) != 0);
+	for (uint32_t i = 0; i < VALUE_COUNT; i++)
+		bloom_add(&bloom, i * 2);
+	for (uint32_t i = 0; i < VALUE_COUNT; i++)
+		fail_unless(bloom_maybe_has(&bloom, i * 2));
+	bloom_destroy(&bloom);
+	footer();
+}
+
+static void
+false_positive_rate_check()
+{
+	header();
+	double rates[] = {0.5, 0.1, 0.05, 0.01, 0.001};
+	for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+		struct bloom bloom;
+		fail_if(bloom_create(&bloom, VALUE_COUNT, rates[r]) != 0);
+		for (uint32_t i = 0; i < VALUE_COUNT; i++)
+			bloom_add(&bloom, i * 2);
+		uint32_t false_positives = 0;
+		for (uint32_t i = 0; i < VALUE_COUNT; i++) {
+			if (bloom_maybe_has(&bloom, i * 2 + 1))
+				false_positives++;
+		}
+		/* Allow some deviation from the requested rate. */
+		fail_if(false_positives > VALUE_COUNT * rates[r] * 1.5);
+		bloom_destroy(&bloom);
+	}
+	footer();
+}
+
+static void
+store_load_check()
+{
+	header();
+	struct bloom bloom, copy;
+	fail_if(bloom_create(&bloom, VALUE_COUNT, 0.05) != 0);
+	for (uint32_t i = 0; i < VALUE_COUNT; i++)
+		bloom_add(&bloom, rand());
+	char *table = malloc(bloom_store_size(&bloom));
+	fail_if(table == NULL);
+	fail_if(bloom_store(&bloom, table) !=
+		table + bloom_store_size(&bloom));
+	fail_if(bloom_load(&copy, bloom.block_count, bloom.hash_count,
+			   table) != 0);
+	for (uint32_t i = 0; i < VALUE_COUNT; i++) {
+		bloom_hash_t hash = rand();
+		fail_if(bloom_maybe_has(&bloom, hash) !=
+			bloom_maybe_has(&copy, hash));
+	}
+	free(table);
+	bloom_destroy(&copy);
+	bloom_destroy(&bloom);
+	footer();
+}
+
+int
+main(void)
+{
+	no_false_negatives_check();
+	false_positive_rate_check();
+	store_load_check();
+}
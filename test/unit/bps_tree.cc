@@ -70,6 +70,27 @@ compare(type_t a, type_t b);
 #define bps_tree_key_t uint32_t
 #define bps_tree_arg_t int
 #include "salad/bps_tree.h"
+#undef BPS_TREE_NAME
+#undef BPS_TREE_BLOCK_SIZE
+#undef BPS_TREE_EXTENT_SIZE
+#undef BPS_TREE_COMPARE
+#undef BPS_TREE_COMPARE_KEY
+#undef bps_tree_elem_t
+#undef bps_tree_key_t
+#undef bps_tree_arg_t
+
+/* tree for offset test */
+#define BPS_TREE_NAME offset
+#define BPS_TREE_BLOCK_SIZE 128 /* value is to low specially for tests */
+#define BPS_TREE_EXTENT_SIZE 2048 /* value is to low specially for tests */
+#define BPS_TREE_COMPARE(a, b, arg) compare(a, b)
+#define BPS_TREE_COMPARE_KEY(a, b, arg) compare(a, b)
+#define bps_tree_elem_t type_t
+#define bps_tree_key_t type_t
+#define bps_tree_arg_t int
+#define BPS_TREE_INNER_ELEM_COUNT
+#include "salad/bps_tree.h"
+#undef BPS_TREE_INNER_ELEM_COUNT
 
 static int
 node_comp(const void *p1, const void *p2, void* unused)
@@ -755,6 +776,110 @@ approximate_count()
 	footer();
 }
 
+static void
+offset_check(offset *tree, const bool *present, type_t max)
+{
+	if (offset_debug_check(tree))
+		fail("debug check nonzero", "true");
+	size_t expected = 0;
+	for (type_t i = 0; i <= max; i++) {
+		size_t lower, upper;
+		bool exact;
+		struct offset_iterator itr;
+		itr = offset_lower_bound_get_offset(tree, i, &exact, &lower);
+		if (lower != expected || exact != present[i])
+			fail("wrong lower bound offset", "true");
+		type_t *v = offset_iterator_get_elem(tree, &itr);
+		if (lower < tree->size ? !v || *v < i : v != NULL)
+			fail("wrong lower bound iterator", "true");
+		if (present[i])
+			expected++;
+		itr = offset_upper_bound_get_offset(tree, i, NULL, &upper);
+		if (upper != expected)
+			fail("wrong upper bound offset", "true");
+		v = offset_iterator_get_elem(tree, &itr);
+		if (upper < tree->size ? !v || *v <= i : v != NULL)
+			fail("wrong upper bound iterator", "true");
+	}
+	if (expected != tree->size)
+		fail("wrong tree size", "true");
+
+	struct offset_iterator itr = offset_iterator_first(tree);
+	for (size_t i = 0; i < tree->size; i++) {
+		struct offset_iterator at = offset_iterator_at(tree, i);
+		if (!offset_iterator_are_equal(tree, &itr, &at))
+			fail("wrong iterator at offset", "true");
+		offset_iterator_next(tree, &itr);
+	}
+	struct offset_iterator at = offset_iterator_at(tree, tree->size);
+	if (!offset_iterator_is_invalid(&at))
+		fail("iterator at offset out of bounds is valid", "true");
+}
+
+static void
+offset_test()
+{
+	header();
+	srand(0);
+
+	const type_t max = 1000;
+	bool present[max + 1];
+	memset(present, 0, sizeof(present));
+
+	offset tree;
+	offset_create(&tree, 0, extent_alloc, extent_free, &extents_count);
+	offset_check(&tree, present, max);
+
+	for (int i = 0; i < 20000; i++) {
+		type_t v = rand() % (max + 1);
+		if (rand() % 3 != 0) {
+			if (offset_insert(&tree, v, NULL) != 0)
+				fail("insertion failed", "true");
+			present[v] = true;
+		} else {
+			offset_delete(&tree, v);
+			present[v] = false;
+		}
+		if (i % 100 == 0)
+			offset_check(&tree, present, max);
+	}
+	offset_check(&tree, present, max);
+	printf("Count: %zu\n", tree.size);
+
+	while (tree.size > 0) {
+		struct offset_iterator itr;
+		itr = offset_iterator_at(&tree, rand() % tree.size);
+		type_t v = *offset_iterator_get_elem(&tree, &itr);
+		offset_delete(&tree, v);
+		present[v] = false;
+		if (tree.size % 50 == 0)
+			offset_check(&tree, present, max);
+	}
+	offset_destroy(&tree);
+
+	type_t arr[max];
+	for (type_t i = 0; i < max; i++) {
+		arr[i] = i * 2;
+		present[i] = false;
+	}
+	for (type_t n = 0; n <= max; n += 111) {
+		offset_create(&tree, 0, extent_alloc, extent_free,
+			      &extents_count);
+		if (offset_build(&tree, arr, n))
+			fail("building failed", "true");
+		memset(present, 0, sizeof(present));
+		for (type_t i = 0; i < n && i * 2 <= max; i++)
+			present[i * 2] = true;
+		if (n * 2 <= max + 1)
+			offset_check(&tree, present, max);
+		else if (offset_debug_check(&tree))
+			fail("debug check nonzero", "true");
+		offset_destroy(&tree);
+	}
+
+	footer();
+}
+
 int
 main(void)
 {
@@ -766,6 +891,7 @@ main(void)
 	printing_test();
 	white_box_test();
 	approximate_count();
+	offset_test();
 	if (extents_count != 0)
 		fail("memory leak!", "true");
 }
@@ -0,0 +1,411 @@
+/*
+ * Check that a bulk loaded R-tree finds the same records as
+ * a tree built by inserting records one by one and as a full
+ * scan, and optionally compare the time it takes to build and
+ * search them:
+ *
+ *   ./rtree_bulk.test bench
+ */
+#include <algorithm>
+#include <vector>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "unit.h"
+#include "salad/rtree.h"
+
+const uint32_t extent_size = 1024 * 16;
+const coord_t SPACE_LIMIT = 1000;
+const coord_t BOX_LIMIT = 10;
+const int QUERY_COUNT = 100;
+const unsigned NEIGH_COUNT = 20;
+
+static int page_count = 0;
+
+static void *
+extent_alloc(void *ctx)
+{
+	int *p_page_count = (int *)ctx;
+	assert(p_page_count == &page_count);
+	++*p_page_count;
+	return malloc(extent_size);
+}
+
+static void
+extent_free(void *ctx, void *page)
+{
+	int *p_page_count = (int *)ctx;
+	assert(p_page_count == &page_count);
+	--*p_page_count;
+	free(page);
+}
+
+static coord_t
+rand_coord(coord_t lim)
+{
+	return rand() % 4096 * lim / 4096;
+}
+
+/* A point in a tenth of cases, a small box otherwise */
+static void
+rand_rect(struct rtree_rect *rect, unsigned dimension, coord_t box_limit)
+{
+	bool point = rand() % 10 == 0;
+	for (unsigned i = 0; i < dimension; i++) {
+		coord_t width = point ? 0 : rand_coord(box_limit);
+		rect->coords[2 * i] = rand_coord(SPACE_LIMIT - width);
+		rect->coords[2 * i + 1] = rect->coords[2 * i] + width;
+	}
+}
+
+static std::vector<uintptr_t>
+select_all(struct rtree *tree, const struct rtree_rect *rect,
+	   enum spatial_search_op op, size_t limit = SIZE_MAX)
+{
+	std::vector<uintptr_t> result;
+	struct rtree_iterator iterator;
+	rtree_iterator_init(&iterator);
+	if (rtree_search(tree, rect, op, &iterator)) {
+		record_t rec;
+		while (result.size() < limit &&
+		       (rec = rtree_iterator_next(&iterator)) != NULL)
+			result.push_back((uintptr_t)rec);
+	}
+	rtree_iterator_destroy(&iterator);
+	return result;
+}
+
+/* Nearest records found with a limit pushed into the iterator */
+static std::vector<uintptr_t>
+select_top(struct rtree *tree, const struct rtree_rect *rect, unsigned limit)
+{
+	std::vector<uintptr_t> result;
+	struct rtree_iterator iterator;
+	rtree_iterator_init(&iterator);
+	if (rtree_search(tree, rect, SOP_NEIGHBOR, &iterator)) {
+		rtree_iterator_set_limit(&iterator, limit);
+		record_t rec;
+		while ((rec = rtree_iterator_next(&iterator)) != NULL)
+			result.push_back((uintptr_t)rec);
+	}
+	rtree_iterator_destroy(&iterator);
+	return result;
+}
+
+static coord_t
+neigh_distance(const struct rtree_rect *rect, const struct rtree_rect *point,
+	       unsigned dimension,
+	       enum rtree_distance_type distance_type = RTREE_EUCLID)
+{
+	coord_t result = 0;
+	for (unsigned i = 0; i < dimension; i++) {
+		coord_t p = point->coords[2 * i];
+		coord_t diff = 0;
+		if (p < rect->coords[2 * i])
+			diff = rect->coords[2 * i] - p;
+		else if (p > rect->coords[2 * i + 1])
+			diff = p - rect->coords[2 * i + 1];
+		result += distance_type == RTREE_EUCLID ? diff * diff : diff;
+	}
+	return result;
+}
+
+/* Does a record match a search, checked coordinate by coordinate */
+static bool
+rect_matches(const struct rtree_rect *rec, const struct rtree_rect *rect,
+	     enum spatial_search_op op, unsigned dimension)
+{
+	for (unsigned i = 0; i < dimension; i++) {
+		coord_t r0 = rec->coords[2 * i], r1 = rec->coords[2 * i + 1];
+		coord_t q0 = rect->coords[2 * i], q1 = rect->coords[2 * i + 1];
+		bool ok;
+		switch (op) {
+		case SOP_ALL:
+			ok = true;
+			break;
+		case SOP_EQUALS:
+			ok = r0 == q0 && r1 == q1;
+			break;
+		case SOP_CONTAINS:
+			ok = r0 <= q0 && r1 >= q1;
+			break;
+		case SOP_STRICT_CONTAINS:
+			ok = r0 < q0 && r1 > q1;
+			break;
+		case SOP_OVERLAPS:
+			ok = r0 <= q1 && r1 >= q0;
+			break;
+		case SOP_BELONGS:
+			ok = r0 >= q0 && r1 <= q1;
+			break;
+		case SOP_STRICT_BELONGS:
+			ok = r0 > q0 && r1 < q1;
+			break;
+		default:
+			ok = false;
+		}
+		if (!ok)
+			return false;
+	}
+	return true;
+}
+
+static void
+check_same(struct rtree *a, struct rtree *b,
+	   const std::vector<struct rtree_rect> &rects, unsigned dimension)
+{
+	static const enum spatial_search_op ops[] = {
+		SOP_ALL, SOP_EQUALS, SOP_CONTAINS, SOP_STRICT_CONTAINS,
+		SOP_OVERLAPS, SOP_BELONGS, SOP_STRICT_BELONGS,
+	};
+	fail_unless(rtree_number_of_records(a) ==
+		    rtree_number_of_records(b));
+	for (int q = 0; q < QUERY_COUNT; q++) {
+		struct rtree_rect rect;
+		if (q % 4 == 0 && !rects.empty())
+			rect = rects[rand() % rects.size()];
+		else
+			rand_rect(&rect, dimension, SPACE_LIMIT / 4);
+		for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+			std::vector<uintptr_t> ra = select_all(a, &rect, ops[o]);
+			std::vector<uintptr_t> rb = select_all(b, &rect, ops[o]);
+			std::sort(ra.begin(), ra.end());
+			std::sort(rb.begin(), rb.end());
+			fail_unless(ra == rb);
+		}
+		/* Ties may come in any order, compare distances */
+		std::vector<uintptr_t> na = select_all(a, &rect, SOP_NEIGHBOR,
+						       NEIGH_COUNT);
+		std::vector<uintptr_t> nb = select_all(b, &rect, SOP_NEIGHBOR,
+						       NEIGH_COUNT);
+		std::vector<uintptr_t> ta = select_top(a, &rect, NEIGH_COUNT);
+		std::vector<uintptr_t> tb = select_top(b, &rect, NEIGH_COUNT);
+		fail_unless(na.size() == nb.size());
+		fail_unless(na.size() == ta.size());
+		fail_unless(na.size() == tb.size());
+		for (size_t i = 0; i < na.size(); i++) {
+			coord_t d = neigh_distance(&rects[na[i] - 1], &rect,
+						   dimension);
+			fail_unless(d == neigh_distance(&rects[nb[i] - 1],
+							&rect, dimension));
+			fail_unless(d == neigh_distance(&rects[ta[i] - 1],
+							&rect, dimension));
+			fail_unless(d == neigh_distance(&rects[tb[i] - 1],
+							&rect, dimension));
+		}
+	}
+}
+
+/*
+ * Compare searches with a full scan. Rectangle checks and
+ * distances may be vectorized in the tree, the scan uses plain
+ * comparisons.
+ */
+static void
+check_scan(struct rtree *tree, const std::vector<struct rtree_rect> &rects,
+	   unsigned dimension, enum rtree_distance_type distance_type)
+{
+	static const enum spatial_search_op ops[] = {
+		SOP_ALL, SOP_EQUALS, SOP_CONTAINS, SOP_STRICT_CONTAINS,
+		SOP_OVERLAPS, SOP_BELONGS, SOP_STRICT_BELONGS,
+	};
+	for (int q = 0; q < QUERY_COUNT; q++) {
+		struct rtree_rect rect;
+		if (q % 4 == 0)
+			rect = rects[rand() % rects.size()];
+		else
+			rand_rect(&rect, dimension, SPACE_LIMIT / 4);
+		for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+			std::vector<uintptr_t> found =
+				select_all(tree, &rect, ops[o]);
+			std::vector<uintptr_t> expected;
+			for (size_t i = 0; i < rects.size(); i++) {
+				if (rect_matches(&rects[i], &rect, ops[o],
+						 dimension))
+					expected.push_back(i + 1);
+			}
+			std::sort(found.begin(), found.end());
+			fail_unless(found == expected);
+		}
+		std::vector<coord_t> distances;
+		for (size_t i = 0; i < rects.size(); i++)
+			distances.push_back(neigh_distance(&rects[i], &rect,
+							   dimension,
+							   distance_type));
+		std::sort(distances.begin(), distances.end());
+		std::vector<uintptr_t> found = select_all(tree, &rect,
+							  SOP_NEIGHBOR,
+							  NEIGH_COUNT);
+		fail_unless(found.size() ==
+			    std::min<size_t>(rects.size(), NEIGH_COUNT));
+		for (size_t i = 0; i < found.size(); i++) {
+			fail_unless(neigh_distance(&rects[found[i] - 1], &rect,
+						   dimension, distance_type) ==
+				    distances[i]);
+		}
+	}
+}
+
+static void
+bulk_load(struct rtree *tree, const std::vector<struct rtree_rect> &rects,
+	  size_t begin, size_t end)
+{
+	struct rtree_bulk bulk;
+	rtree_bulk_create(&bulk, tree);
+	fail_unless(rtree_bulk_reserve(&bulk, end - begin) == 0);
+	for (size_t i = begin; i < end; i++)
+		fail_unless(rtree_bulk_add(&bulk, &rects[i],
+					   (record_t)(i + 1)) == 0);
+	rtree_bulk_sort(&bulk);
+	fail_unless(rtree_bulk_load(tree, &bulk) == 0);
+	fail_unless(bulk.count == 0);
+	rtree_bulk_destroy(&bulk);
+}
+
+static void
+test_bulk_load(unsigned dimension, size_t count)
+{
+	header();
+	printf("dimension = %u, count = %zu\n", dimension, count);
+
+	std::vector<struct rtree_rect> rects(count * 2);
+	for (size_t i = 0; i < rects.size(); i++)
+		rand_rect(&rects[i], dimension, BOX_LIMIT);
+
+	struct rtree a, b;
+	rtree_init(&a, dimension, extent_size, extent_alloc, extent_free,
+		   &page_count, RTREE_EUCLID);
+	rtree_init(&b, dimension, extent_size, extent_alloc, extent_free,
+		   &page_count, RTREE_EUCLID);
+	for (size_t i = 0; i < count; i++)
+		rtree_insert(&a, &rects[i], (record_t)(i + 1));
+	bulk_load(&b, rects, 0, count);
+	check_same(&a, &b, rects, dimension);
+	if (count > 0)
+		fail_unless(rtree_used_size(&b) <= rtree_used_size(&a));
+
+	/* The loaded tree must stay valid after updates */
+	for (size_t i = 0; i < count; i += 2) {
+		fail_unless(rtree_remove(&a, &rects[i], (record_t)(i + 1)));
+		fail_unless(rtree_remove(&b, &rects[i], (record_t)(i + 1)));
+	}
+	for (size_t i = count; i < rects.size(); i++) {
+		rtree_insert(&a, &rects[i], (record_t)(i + 1));
+		rtree_insert(&b, &rects[i], (record_t)(i + 1));
+	}
+	check_same(&a, &b, rects, dimension);
+
+	rtree_destroy(&a);
+	rtree_destroy(&b);
+
+	footer();
+}
+
+static void
+test_scan(unsigned dimension, size_t count,
+	  enum rtree_distance_type distance_type)
+{
+	header();
+	printf("dimension = %u, count = %zu, distance = %s\n", dimension,
+	       count, distance_type == RTREE_EUCLID ? "euclid" : "manhattan");
+
+	std::vector<struct rtree_rect> rects(count);
+	for (size_t i = 0; i < count; i++)
+		rand_rect(&rects[i], dimension, BOX_LIMIT);
+
+	struct rtree tree;
+	rtree_init(&tree, dimension, extent_size, extent_alloc, extent_free,
+		   &page_count, distance_type);
+	bulk_load(&tree, rects, 0, count);
+	check_scan(&tree, rects, dimension, distance_type);
+	rtree_destroy(&tree);
+
+	footer();
+}
+
+static double
+clock_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_search(struct rtree *tree, unsigned dimension, const char *name)
+{
+	const int iterations = 100000;
+	size_t found = 0, found_top = 0;
+	srand(1);
+	double t = clock_sec();
+	for (int i = 0; i < iterations; i++) {
+		struct rtree_rect rect;
+		rand_rect(&rect, dimension, SPACE_LIMIT / 100);
+		found += select_all(tree, &rect, SOP_OVERLAPS).size();
+		found += select_all(tree, &rect, SOP_NEIGHBOR, 10).size();
+	}
+	t = clock_sec() - t;
+	fprintf(stderr, "  %-8s %.0f searches/sec (%zu found), %zu bytes\n",
+		name, iterations / t, found, rtree_used_size(tree));
+	srand(1);
+	t = clock_sec();
+	for (int i = 0; i < iterations; i++) {
+		struct rtree_rect rect;
+		rand_rect(&rect, dimension, SPACE_LIMIT / 100);
+		found_top += select_top(tree, &rect, 10).size();
+	}
+	t = clock_sec() - t;
+	fprintf(stderr, "  %-8s %.0f top-10 searches/sec (%zu found)\n",
+		name, iterations / t, found_top);
+}
+
+static void
+bench(unsigned dimension, size_t count)
+{
+	fprintf(stderr, "dimension = %u, count = %zu\n", dimension, count);
+	std::vector<struct rtree_rect> rects(count);
+	for (size_t i = 0; i < count; i++)
+		rand_rect(&rects[i], dimension, BOX_LIMIT);
+
+	struct rtree a, b;
+	rtree_init(&a, dimension, extent_size, extent_alloc, extent_free,
+		   &page_count, RTREE_EUCLID);
+	rtree_init(&b, dimension, extent_size, extent_alloc, extent_free,
+		   &page_count, RTREE_EUCLID);
+	double t = clock_sec();
+	for (size_t i = 0; i < count; i++)
+		rtree_insert(&a, &rects[i], (record_t)(i + 1));
+	fprintf(stderr, "  insert   %.3f sec\n", clock_sec() - t);
+	t = clock_sec();
+	bulk_load(&b, rects, 0, count);
+	fprintf(stderr, "  bulk     %.3f sec\n", clock_sec() - t);
+	bench_search(&a, dimension, "insert");
+	bench_search(&b, dimension, "bulk");
+	rtree_destroy(&a);
+	rtree_destroy(&b);
+}
+
+int
+main(int argc, char **argv)
+{
+	srand(time(NULL));
+	test_bulk_load(2, 0);
+	test_bulk_load(2, 10);
+	test_bulk_load(2, 20000);
+	test_bulk_load(3, 5000);
+	test_bulk_load(8, 5000);
+	test_scan(2, 5000, RTREE_EUCLID);
+	test_scan(2, 5000, RTREE_MANHATTAN);
+	test_scan(5, 2000, RTREE_EUCLID);
+
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench(2, 1000000);
+		bench(8, 200000);
+	}
+	fail_unless(page_count == 0);
+	return 0;
+}
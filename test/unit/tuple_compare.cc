@@ -0,0 +1,227 @@
+/*
+ * Check that comparators and hash functions specialized by part
+ * types agree with the generic ones, and optionally measure
+ * their throughput:
+ *
+ *   ./tuple_compare.test bench
+ */
+#include "box/tuple_compare.cc"
+#include "box/tuple_hash.cc"
+
+#include <time.h>
+
+#include "unit.h"
+
+struct tuple_format **tuple_formats;
+
+enum {
+	FIELD_COUNT = 6,
+	TUPLE_COUNT = 512,
+	STR_LEN_MAX = 24,
+};
+
+static struct tuple_format *format;
+static struct tuple *tuples[TUPLE_COUNT];
+
+static struct tuple_format *
+test_format_new(void)
+{
+	struct tuple_format *format = (struct tuple_format *)
+		calloc(1, sizeof(*format) +
+		       FIELD_COUNT * sizeof(struct tuple_field_format));
+	fail_unless(format != NULL);
+	format->field_count = FIELD_COUNT;
+	format->field_map_size = (FIELD_COUNT - 1) * sizeof(uint32_t);
+	format->fields[0].offset_slot = TUPLE_OFFSET_SLOT_NIL;
+	for (int i = 1; i < FIELD_COUNT; i++)
+		format->fields[i].offset_slot = -i;
+	return format;
+}
+
+/**
+ * Create a tuple of unsigned fields at even and string fields
+ * at odd positions. Values are taken from a narrow range so
+ * that comparisons often go past the first key part.
+ */
+static struct tuple *
+test_tuple_new(void)
+{
+	char data[FIELD_COUNT * (STR_LEN_MAX + 16)];
+	char *end = mp_encode_array(data, FIELD_COUNT);
+	uint32_t offsets[FIELD_COUNT];
+	for (int i = 0; i < FIELD_COUNT; i++) {
+		offsets[i] = end - data;
+		if (i % 2 == 0) {
+			end = mp_encode_uint(end, rand() % 4);
+		} else {
+			char str[STR_LEN_MAX];
+			int len = rand() % STR_LEN_MAX;
+			memset(str, 'a', len);
+			if (len > 0)
+				str[len - 1] = 'a' + rand() % 3;
+			end = mp_encode_str(end, str, len);
+		}
+	}
+	uint32_t bsize = end - data;
+	struct tuple *tuple = (struct tuple *)
+		malloc(sizeof(*tuple) + format->field_map_size + bsize);
+	fail_unless(tuple != NULL);
+	tuple->refs = 1;
+	tuple->format_id = 0;
+	tuple->bsize = bsize;
+	tuple->data_offset = sizeof(*tuple) + format->field_map_size;
+	uint32_t *field_map = (uint32_t *) tuple_field_map(tuple);
+	for (int i = 1; i < FIELD_COUNT; i++)
+		field_map[-i] = offsets[i];
+	memcpy((char *) tuple_data(tuple), data, bsize);
+	return tuple;
+}
+
+static struct key_def *
+test_key_def_new(const struct key_part *parts, uint32_t part_count)
+{
+	struct key_def *def = (struct key_def *)
+		calloc(1, key_def_sizeof(part_count));
+	fail_unless(def != NULL);
+	def->part_count = part_count;
+	memcpy(def->parts, parts, part_count * sizeof(*parts));
+	def->tuple_compare = tuple_compare_create(def);
+	def->tuple_compare_with_key = tuple_compare_with_key_create(def);
+	tuple_hash_func_set(def);
+	return def;
+}
+
+static char *
+test_key_new(const struct tuple *tuple, const struct key_def *def,
+	     char *key)
+{
+	char *end = key;
+	for (uint32_t i = 0; i < def->part_count; i++) {
+		const char *field = tuple_field(tuple, def->parts[i].fieldno);
+		const char *field_end = field;
+		mp_next(&field_end);
+		memcpy(end, field, field_end - field);
+		end += field_end - field;
+	}
+	return end;
+}
+
+static int
+sign(int r)
+{
+	return r < 0 ? -1 : r > 0;
+}
+
+static void
+test_compare(const struct key_def *def)
+{
+	char key[FIELD_COUNT * (STR_LEN_MAX + 16)];
+	for (int i = 0; i < TUPLE_COUNT; i++) {
+		test_key_new(tuples[i], def, key);
+		fail_unless(tuple_hash(tuples[i], def) ==
+			    tuple_hash_slowpath(tuples[i], def));
+		fail_unless(key_hash(key, def) ==
+			    key_hash_slowpath(key, def));
+		fail_unless(key_hash(key, def) == tuple_hash(tuples[i], def));
+		for (int j = 0; j < TUPLE_COUNT; j++) {
+			const struct tuple *a = tuples[j];
+			const struct tuple *b = tuples[i];
+			fail_unless(sign(tuple_compare(a, b, def)) ==
+				    sign(tuple_compare_slowpath(a, b, def)));
+			for (uint32_t n = 0; n <= def->part_count; n++) {
+				int r1 = tuple_compare_with_key(a, key, n,
+								def);
+				int r2 = tuple_compare_with_key_slowpath(
+					a, key, n, def);
+				fail_unless(sign(r1) == sign(r2));
+			}
+		}
+	}
+}
+
+static double
+clock_sec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_compare(const struct key_def *def, tuple_compare_t cmp,
+	      const char *name)
+{
+	const int iterations = 20000000;
+	int sum = 0;
+	double t = clock_sec();
+	for (int i = 0; i < iterations; i++) {
+		sum += cmp(tuples[i % TUPLE_COUNT],
+			   tuples[(i * 7 + 1) % TUPLE_COUNT], def);
+	}
+	t = clock_sec() - t;
+	fprintf(stderr, "%-16s %.1f Mops/sec (%d)\n", name,
+		iterations / t / 1e6, sum);
+}
+
+static void
+bench_hash(const struct key_def *def, tuple_hash_t hash, const char *name)
+{
+	const int iterations = 20000000;
+	uint32_t sum = 0;
+	double t = clock_sec();
+	for (int i = 0; i < iterations; i++)
+		sum += hash(tuples[i % TUPLE_COUNT], def);
+	t = clock_sec() - t;
+	fprintf(stderr, "%-16s %.1f Mops/sec (%u)\n", name,
+		iterations / t / 1e6, sum);
+}
+
+static void
+test_parts(const struct key_part *parts, uint32_t part_count, bool bench)
+{
+	struct key_def *def = test_key_def_new(parts, part_count);
+	test_compare(def);
+	if (bench) {
+		bench_compare(def, tuple_compare_slowpath, "compare slow");
+		bench_compare(def, def->tuple_compare, "compare");
+		bench_hash(def, tuple_hash_slowpath, "hash slow");
+		bench_hash(def, def->tuple_hash, "hash");
+	}
+	free(def);
+}
+
+static void
+test_typed(bool bench)
+{
+	header();
+
+	struct key_part parts[] = {
+		{ 3, FIELD_TYPE_STRING },
+		{ 0, FIELD_TYPE_UNSIGNED },
+		{ 5, FIELD_TYPE_STRING },
+		{ 2, FIELD_TYPE_UNSIGNED },
+		{ 1, FIELD_TYPE_STRING },
+	};
+	for (uint32_t part_count = 1; part_count <= 5; part_count++)
+		test_parts(parts, part_count, bench);
+
+	footer();
+}
+
+int
+main(int argc, char **argv)
+{
+	bool bench = argc > 1 && strcmp(argv[1], "bench") == 0;
+	srand(time(NULL));
+	format = test_format_new();
+	tuple_formats = &format;
+	for (int i = 0; i < TUPLE_COUNT; i++)
+		tuples[i] = test_tuple_new();
+
+	test_typed(bench);
+
+	for (int i = 0; i < TUPLE_COUNT; i++)
+		free(tuples[i]);
+	free(format);
+	return 0;
+}
@@ -0,0 +1,61 @@
+test_run = require('test_run').new()
+
+--
+-- Bloom filters allow to skip runs on point lookups.
+--
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk', {bloom_fpr = 0.001})
+box.space._index:get{s.id, 0}[5].bloom_fpr
+function vyinfo() return box.info.vinyl().db[box.space.test.id..'/0'] end
+
+for i = 1, 1000, 2 do s:replace{i} end
+box.snapshot()
+
+bloom_hit = vyinfo().bloom_hit
+bloom_miss = vyinfo().bloom_miss
+for i = 2, 1000, 2 do assert(s:get(i) == nil) end
+vyinfo().bloom_hit - bloom_hit > 490
+for i = 1, 1000, 2 do assert(s:get(i) ~= nil) end
+vyinfo().bloom_miss - bloom_miss >= 500
+
+-- Bloom filters survive restart.
+test_run:cmd('restart server default')
+s = box.space.test
+function vyinfo() return box.info.vinyl().db[box.space.test.id..'/0'] end
+for i = 2, 1000, 2 do assert(s:get(i) == nil) end
+vyinfo().bloom_hit > 490
+s:drop()
+
+--
+-- Partial keys are checked against bloom filters of key prefixes.
+--
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk', {parts = {1, 'unsigned', 2, 'unsigned'}})
+function vyinfo() return box.info.vinyl().db[box.space.test.id..'/0'] end
+for i = 1, 100 do s:replace{i * 2, i} end
+box.snapshot()
+for i = 1, 100 do assert(#s:select(i * 2 + 1) == 0) end
+vyinfo().bloom_hit > 90
+s:drop()
+
+--
+-- bloom_fpr = 1 disables bloom filters.
+--
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk', {bloom_fpr = 1})
+function vyinfo() return box.info.vinyl().db[box.space.test.id..'/0'] end
+for i = 1, 100, 2 do s:replace{i} end
+box.snapshot()
+for i = 2, 100, 2 do assert(s:get(i) == nil) end
+vyinfo().bloom_hit
+vyinfo().bloom_miss
+s:drop()
+
+--
+-- Invalid bloom_fpr.
+--
+s = box.schema.space.create('test', {engine = 'vinyl'})
+s:create_index('pk', {bloom_fpr = 0})
+s:create_index('pk', {bloom_fpr = 1.1})
+s:create_index('pk', {bloom_fpr = 'x'})
+s:drop()
@@ -67,6 +67,12 @@ end;
 s:drop();
 test_run:cmd("setopt delimiter ''");
 
+-- Pages must be read from disk to hit the injected errors.
+test_run:cmd('create server vinyl_no_page_cache with script="vinyl/vinyl_no_page_cache.lua"')
+test_run:cmd("start server vinyl_no_page_cache")
+test_run:cmd('switch vinyl_no_page_cache')
+fiber = require('fiber')
+errinj = box.error.injection
 s = box.schema.space.create('test', {engine='vinyl'})
 _ = s:create_index('pk')
 for i = 1, 10 do s:insert({i, 'test str' .. tostring(i)}) end
@@ -96,6 +102,8 @@ errinj.set("ERRINJ_VY_READ_PAGE_TIMEOUT", false);
 errinj.set("ERRINJ_VY_READ_PAGE", false);
 s:select()
 s:drop()
+test_run:cmd('switch default')
+test_run:cmd("stop server vinyl_no_page_cache")
 
 s = box.schema.space.create('test', {engine='vinyl'});
 _ = s:create_index('pk');
@@ -0,0 +1,63 @@
+test_run = require('test_run').new()
+test_run:cmd('create server vinyl_page_cache with script="vinyl/vinyl_info.lua"')
+test_run:cmd("start server vinyl_page_cache")
+test_run:cmd('switch vinyl_page_cache')
+
+--
+-- Decompressed run pages are shared by all iterators.
+--
+function page_cache() return box.info.vinyl().page_cache end
+box.cfg.vinyl.page_cache
+
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk')
+pad = string.rep('x', 100)
+for i = 1, 100 do s:replace{i, pad} end
+box.snapshot()
+
+hit = page_cache().hit
+miss = page_cache().miss
+#s:select()
+page_cache().miss - miss > 0
+page_cache().used > 0
+
+-- The second scan finds all pages in the cache.
+miss = page_cache().miss
+#s:select()
+page_cache().miss - miss
+page_cache().hit - hit > 0
+s:get{50}[1]
+page_cache().miss - miss
+
+s:drop()
+
+test_run:cmd('switch default')
+test_run:cmd("stop server vinyl_page_cache")
+
+--
+-- Least recently used pages are evicted once the cache is full.
+--
+test_run:cmd('create server vinyl_small_page_cache with script="vinyl/vinyl_small_page_cache.lua"')
+test_run:cmd("start server vinyl_small_page_cache")
+test_run:cmd('switch vinyl_small_page_cache')
+function page_cache() return box.info.vinyl().page_cache end
+page_cache().limit
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk', {range_size = 1024 * 1024})
+pad = string.rep('x', 100)
+for i = 1, 1000 do s:replace{i, pad} end
+box.snapshot()
+#s:select()
+page_cache().used > 0
+page_cache().used <= page_cache().limit
+-- The last pages of the scan are still cached.
+miss = page_cache().miss
+#s:select({990}, {iterator = 'GE'})
+page_cache().miss - miss
+-- The first pages have been evicted.
+#s:select({1}, {iterator = 'LE'})
+page_cache().miss - miss > 0
+page_cache().used <= page_cache().limit
+s:drop()
+test_run:cmd('switch default')
+test_run:cmd("stop server vinyl_small_page_cache")
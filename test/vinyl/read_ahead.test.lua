@@ -0,0 +1,63 @@
+test_run = require('test_run').new()
+--
+-- Sequential scans read pages ahead. The page cache is disabled
+-- so that every scan reads pages from disk.
+--
+test_run:cmd('create server vinyl_no_page_cache with script="vinyl/vinyl_no_page_cache.lua"')
+test_run:cmd("start server vinyl_no_page_cache")
+test_run:cmd('switch vinyl_no_page_cache')
+box.cfg.vinyl.read_ahead
+
+s = box.schema.space.create('test', {engine = 'vinyl'})
+_ = s:create_index('pk', {range_size = 1024 * 1024})
+pad = string.rep('x', 100)
+for i = 1, 1000 do s:replace{i, pad} end
+box.snapshot()
+
+test_run:cmd("setopt delimiter ';'")
+function check(iterator, key, first, last)
+    local step = first <= last and 1 or -1
+    local expected = first
+    for _, t in s:pairs(key, {iterator = iterator}) do
+        if t[1] ~= expected then
+            return t[1]
+        end
+        expected = expected + step
+    end
+    return expected == last + step
+end;
+test_run:cmd("setopt delimiter ''");
+
+function perf() return box.info.vinyl().performance end
+read_ahead = perf().read_ahead
+read_ahead_hit = perf().read_ahead_hit
+check('GE', {}, 1, 1000)
+-- most pages of the first scan were read ahead and used
+perf().read_ahead - read_ahead > 50
+perf().read_ahead_hit - read_ahead_hit > 50
+check('LE', {}, 1000, 1)
+check('GT', {500}, 501, 1000)
+check('LT', {500}, 499, 1)
+
+-- Two scans interleaved.
+gen1, param1, state1 = s:pairs({}, {iterator = 'GE'})
+gen2, param2, state2 = s:pairs({}, {iterator = 'LE'})
+ok = true
+for i = 1, 1000 do state1, t1 = gen1(param1, state1) state2, t2 = gen2(param2, state2) ok = ok and t1[1] == i and t2[1] == 1001 - i end
+ok
+
+-- A scan abandoned midway.
+n = 0
+for _, t in s:pairs() do n = n + 1 if n == 100 then break end end
+n
+
+-- A scan over a run dumped while the scan is in progress.
+fiber = require('fiber')
+n = 0
+for _, t in s:pairs() do n = n + 1 if n == 500 then s:replace{t[1], pad} fiber.create(box.snapshot) end end
+n
+
+s:drop()
+
+test_run:cmd('switch default')
+test_run:cmd("stop server vinyl_no_page_cache")
@@ -1,5 +1,13 @@
 #!/usr/bin/env tarantool
 
+-- Scripts linked to this one under other names tune the page cache:
+-- vinyl_no_page_cache.lua reads every page from disk and
+-- vinyl_small_page_cache.lua keeps only 16kB of pages.
+local page_cache = ({
+    vinyl_no_page_cache = 0,
+    vinyl_small_page_cache = 16 * 1024 / (1024 * 1024 * 1024),
+})[string.match(arg[0], "([^/]+)%.lua$")]
+
 box.cfg {
     listen            = os.getenv("LISTEN"),
     slab_alloc_arena  = 0.5,
@@ -13,6 +21,7 @@ box.cfg {
         run_count_per_level = 1;
         run_size_ratio = 2;
         cache = 0.00001; -- 10kB
+        page_cache = page_cache;
     }
 }
 
@@ -0,0 +1 @@
+vinyl.lua
\ No newline at end of file
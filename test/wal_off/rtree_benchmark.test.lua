@@ -110,6 +110,46 @@ file:write(string.format("Elapsed time for deleting  %d records: %d\n", n_record
 
 s:drop();
 
+s = box.schema.space.create('rtreebench');
+_ = s:create_index('primary');
+
+file:write(" *** 2D bulk load *** \n");
+
+for i = 1, n_records do
+   s:insert{i,{180*math.random(),180*math.random()}}
+end;
+
+start = os.time();
+_ = s:create_index('spatial', { type = 'rtree', unique = false, parts = {2, 'array'}});
+file:write(string.format("Elapsed time for building index over %d records: %d\n", n_records, os.time() - start));
+
+rect_width = 180 / math.pow(n_records, 1 / 2);
+start = os.time();
+n = 0;
+for i = 1, n_iterations do
+   x = (180 - rect_width) * math.random()
+   y = (180 - rect_width) * math.random()
+   for k,v in s.index.spatial:pairs({x,y,x+rect_width,y+rect_width}, {iterator = 'LE'}) do
+       n = n + 1
+   end
+end;
+file:write(string.format("Elapsed time for %d belongs searches selecting %d records: %d\n", n_iterations, n, os.time() - start));
+
+start = os.time();
+n = 0
+for i = 1, n_iterations do
+   x = 180 * math.random()
+   y = 180 * math.random()
+   for k,v in pairs(s.index.spatial:select({x,y }, {limit = n_neighbors, iterator = 'NEIGHBOR'})) do
+      n = n + 1
+   end
+end;
+file:write(string.format("Elapsed time for %d nearest %d neighbors searches selecting %d records: %d\n", n_iterations, n_neighbors, n, os.time() - start));
+
+s.index.spatial:count() == n_records;
+
+s:drop();
+
 file:close();
 
 test_run:cmd("setopt delimiter ''");
@@ -0,0 +1,23 @@
+env = require('test_run').new()
+--
+-- Check that snapshot recovery, which decodes rows in a
+-- separate thread and applies them in batches, restores rows
+-- larger than a batch and reports the recovery rate.
+--
+s = box.schema.space.create('test')
+_ = s:create_index('pk')
+big = string.rep('x', 600 * 1024)
+for i = 1, 12 do box.begin() for j = 1, 10000 do s:insert{i * 10000 + j} end box.commit() end
+_ = s:insert{0, big}
+_ = s:replace{60000, big}
+_ = s:insert{200000, big}
+box.snapshot()
+env:cmd('restart server default')
+s = box.space.test
+s:count()
+s:get(0)[2] == string.rep('x', 600 * 1024)
+s:get(60000)[2] == string.rep('x', 600 * 1024)
+s:get(200000)[2] == string.rep('x', 600 * 1024)
+s:get(130000) ~= nil
+env:grep_log('default', 'rows processed, %d+ rows/sec') ~= nil
+s:drop()
@@ -0,0 +1,34 @@
+env = require('test_run').new()
+
+box.cfg{snap_threads = 0}
+box.cfg{snap_threads = 65}
+box.cfg.snap_threads
+
+--
+-- Check that a snapshot written by several threads, with
+-- rows of a space split into many chunks, is read back
+-- intact.
+--
+box.cfg{snap_threads = 3}
+s1 = box.schema.space.create('test1')
+_ = s1:create_index('pk')
+s2 = box.schema.space.create('test2')
+_ = s2:create_index('pk')
+box.begin() for i = 1, 20000 do s1:insert{i, string.rep('x', i % 100)} end box.commit()
+for i = 1, 10 do s2:insert{i} end
+box.snapshot()
+env:cmd('restart server default')
+
+s1 = box.space.test1
+s2 = box.space.test2
+s1:count()
+s2:count()
+sum = 0
+for _, t in s1:pairs() do sum = sum + t[1] + #t[2] end
+sum
+s1:get(12345)[2] == string.rep('x', 45)
+s2:select()
+
+s1:drop()
+s2:drop()
+box.cfg{snap_threads = 2}